@@ -0,0 +1,296 @@
+// Refills the MTDAnalyzer histograms from the hit cache files written with
+// its HitCacheFile parameter, without rereading the EDM files: the binning
+// (--binning), the histogram groups, BTLMinimumEnergy and the time-walk
+// parameters can be changed between replays. The SIM energy integration
+// window is applied when the cache is written, and cannot be changed.
+//
+// The chunks of all the files are processed by a TBB work-stealing
+// parallel loop, the largest first; each thread fills its own histogram
+// set, and the sets are added before being written.
+//
+// With --resolution, the resolution sketches of all the files are merged
+// into one table, as MTDAnalyzer's ResolutionFile of a single job.
+
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <exception>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "tbb/blocked_range.h"
+#include "tbb/enumerable_thread_specific.h"
+#include "tbb/global_control.h"
+#include "tbb/parallel_for.h"
+
+#include "FWCore/Utilities/interface/Exception.h"
+#include "PhysicsTools/FWLite/interface/TFileService.h"
+
+#include "MTDtools/MTDAnalyzer/interface/MTDHistoOutput.h"
+#include "MTDtools/MTDAnalyzer/interface/MTDHitCache.h"
+
+#include "MTDtools/MTDCore/interface/MTDHistoFill.h"
+#include "MTDtools/MTDCore/interface/MTDHistoRegistry.h"
+#include "MTDtools/MTDCore/interface/MTDResolution.h"
+#include "MTDtools/MTDCore/interface/MTDTimeWalk.h"
+
+
+static void usage(const char* program) {
+
+  std::cerr << "Usage: " << program << " [options] output.root cache [cache...]\n"
+	    << "\n"
+	    << "  --groups G1,G2,...                  histogram groups (default: all)\n"
+	    << "  --btl-min-energy E                  BTLMinimumEnergy [MeV] (default: 2)\n"
+	    << "  --btl-time-walk p0,p1,p2            BTLTimeWalkParameters (default: 2.21103,-0.933552,0)\n"
+	    << "  --binning DIR/NAME=nx,xlo,xhi[,ny,ylo,yhi]\n"
+	    << "                                      binning of a histogram, can be repeated\n"
+	    << "  --flush-size N                      HistogramFlushSize (default: 1)\n"
+	    << "  --resolution FILE                   resolution table, default regions (default: none)\n"
+	    << "  --threads N                         (default: all cores)\n";
+
+}
+
+
+static std::vector<std::string> split(const std::string& list) {
+
+  std::vector<std::string> items;
+  std::istringstream is(list);
+  for (std::string item; std::getline(is, item, ','); )
+    items.push_back(item);
+
+  return items;
+
+}
+
+
+static std::vector<double> splitNumbers(const std::string& list) {
+
+  std::vector<double> numbers;
+  for (auto const& item: split(list)) {
+    char* end;
+    numbers.push_back(std::strtod(item.c_str(), &end));
+    if ( item.empty() || *end != '\0' )
+      throw cms::Exception("Configuration") << "MTDReplay: " << item << " is not a number";
+  }
+
+  return numbers;
+
+}
+
+
+// --- sets the binning of the definition DIR/NAME from nx,xlo,xhi[,ny,ylo,yhi]
+static void setBinning(std::vector<MTDHistoDef>& defs, const std::string& option) {
+
+  const size_t eq = option.find('=');
+  const std::string key = option.substr(0, eq);
+
+  auto def = std::find_if(defs.begin(), defs.end(), [&](const MTDHistoDef& def) {
+      return key == std::string(def.dir) + "/" + def.name;
+    });
+
+  if ( eq == std::string::npos || def == defs.end() )
+    throw cms::Exception("Configuration") << "MTDReplay: no histogram " << key;
+
+  if ( def->kind == MTDHistoDef::kChannelMap )
+    throw cms::Exception("Configuration") << "MTDReplay: " << key << " is a channel map, with one bin per channel";
+
+  const std::vector<double> binning = splitNumbers(option.substr(eq+1));
+  const size_t nBinning = def->kind == MTDHistoDef::k2D ? 6 : 3;
+
+  if ( binning.size() != nBinning || binning[0] < 1 || (nBinning == 6 && binning[3] < 1) )
+    throw cms::Exception("Configuration") << "MTDReplay: " << key << " needs " << nBinning
+					  << " binning values, with at least one bin";
+
+  def->nx  = binning[0];
+  def->xlo = binning[1];
+  def->xhi = binning[2];
+
+  if ( nBinning == 6 ) {
+    def->ny  = binning[3];
+    def->ylo = binning[4];
+    def->yhi = binning[5];
+  }
+
+}
+
+
+int main(int argc, char* argv[]) {
+
+  std::vector<MTDHistoDef> defs(mtdHistoDefs, mtdHistoDefs+mtdNHistoDefs);
+
+  std::vector<std::string> groups;
+  for (auto const& def: defs) {
+    if ( std::find(groups.begin(), groups.end(), def.group) == groups.end() )
+      groups.push_back(def.group);
+  }
+
+  double btlMinEnergy = 2.;
+  std::vector<double> btlTimeWalk = { 2.21103, -0.933552, 0. };
+  unsigned int flushSize = 1;
+  unsigned int nThreads = std::max(1u, std::thread::hardware_concurrency());
+  std::string resolutionFile;
+
+  std::vector<std::string> files;
+
+  try {
+
+    for (int iarg = 1; iarg < argc; ++iarg) {
+
+      const std::string arg = argv[iarg];
+
+      if ( arg == "-h" || arg == "--help" ) {
+	usage(argv[0]);
+	return 0;
+      }
+
+      if ( arg.compare(0, 2, "--") != 0 ) {
+	files.push_back(arg);
+	continue;
+      }
+
+      if ( iarg+1 == argc )
+	throw cms::Exception("Configuration") << "MTDReplay: " << arg << " needs a value";
+      const std::string value = argv[++iarg];
+
+      if ( arg == "--groups" )
+	groups = split(value);
+      else if ( arg == "--btl-min-energy" )
+	btlMinEnergy = splitNumbers(value).at(0);
+      else if ( arg == "--btl-time-walk" )
+	btlTimeWalk = splitNumbers(value);
+      else if ( arg == "--binning" )
+	setBinning(defs, value);
+      else if ( arg == "--flush-size" )
+	flushSize = std::max(1., splitNumbers(value).at(0));
+      else if ( arg == "--resolution" )
+	resolutionFile = value;
+      else if ( arg == "--threads" )
+	nThreads = std::max(1., splitNumbers(value).at(0));
+      else
+	throw cms::Exception("Configuration") << "MTDReplay: unknown option " << arg;
+
+    }
+
+    if ( files.size() < 2 ) {
+      usage(argv[0]);
+      return 1;
+    }
+
+    const std::string output = files.front();
+    files.erase(files.begin());
+
+    const MTDTimeWalk timeWalk(btlTimeWalk);
+
+    // --- chunks of all the files, the largest first
+
+    std::vector<std::unique_ptr<MTDHitCacheReader> > readers;
+    std::vector<std::pair<const MTDHitCacheReader*,size_t> > chunks;
+
+    uint64_t nEvents = 0;
+    uint64_t nHits = 0;
+    uint64_t nBytes = 0;
+
+    for (auto const& file: files) {
+
+      readers.push_back(std::make_unique<MTDHitCacheReader>(file));
+      const MTDHitCacheReader& reader = *readers.back();
+
+      for (size_t ic = 0; ic < reader.nChunks(); ++ic) {
+	chunks.emplace_back(&reader, ic);
+	nHits  += reader.chunk(ic).nHits;
+	nBytes += reader.chunk(ic).size;
+      }
+
+      nEvents += reader.nEvents();
+
+    }
+
+    std::stable_sort(chunks.begin(), chunks.end(), [](const auto& a, const auto& b) {
+	return a.first->chunk(a.second).size > b.first->chunk(b.second).size;
+      });
+
+
+    // --- per-thread histogram sets, booked on the first chunk of a thread
+
+    struct Worker {
+      MTDHistoRegistry histos;
+      MTDTimeWalk::Channels channels;
+      MTDResolution resolution;
+      MTDResolution::Scratch resolutionScratch;
+    };
+
+    MTDHistoRegistry histos;
+    histos.book(defs.data(), defs.size(), groups);
+
+    tbb::enumerable_thread_specific<Worker> workers([&]() {
+	Worker worker;
+	worker.histos.book(defs.data(), defs.size(), groups, flushSize);
+	return worker;
+      });
+
+    const auto start = std::chrono::steady_clock::now();
+
+    {
+      tbb::global_control control(tbb::global_control::max_allowed_parallelism, nThreads);
+
+      tbb::parallel_for(tbb::blocked_range<size_t>(0, chunks.size(), 1), [&](const tbb::blocked_range<size_t>& range) {
+
+	  Worker& worker = workers.local();
+
+	  for (size_t i = range.begin(); i < range.end(); ++i) {
+	    chunks[i].first->forEachEvent(chunks[i].second, [&](const MTDHitCacheReader::Event& event) {
+		mtdFillHistos(worker.histos, event.view, btlMinEnergy, timeWalk, worker.channels);
+		if ( !resolutionFile.empty() )
+		  mtdFillResolution(worker.resolution, event.view, btlMinEnergy, timeWalk, worker.resolutionScratch);
+	      });
+	  }
+
+	}, tbb::simple_partitioner());
+    }
+
+    MTDResolution resolution;
+
+    for (auto& worker: workers) {
+      worker.histos.flush();
+      histos.add(worker.histos);
+      resolution.add(worker.resolution);
+    }
+
+    const double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now()-start).count();
+
+    {
+      fwlite::TFileService fs(output);
+      mtdWriteHistos(histos, fs);
+    }
+
+    if ( !resolutionFile.empty() ) {
+      std::ofstream table(resolutionFile);
+      resolution.write(table);
+      if ( !table )
+	throw cms::Exception("MTDReplay") << "cannot write the resolution table to " << resolutionFile;
+      for (auto det: { MTDResolution::kBTL, MTDResolution::kETL })
+	if ( resolution.outsideAcceptance(det) > 0 )
+	  std::cerr << "MTDReplay: " << resolution.outsideAcceptance(det) << (det == MTDResolution::kBTL ? " BTL" : " ETL")
+		    << " hits out of |eta| [" << MTDResolution::kMinEta[det] << ", " << MTDResolution::kMaxEta[det]
+		    << "] in the resolution table" << std::endl;
+    }
+
+    std::cout << "MTDReplay: " << nEvents << " events, " << nHits << " records, " << nBytes/(1024*1024) << " MB in "
+	      << chunks.size() << " chunks, " << histos.size() << " histograms, " << workers.size() << " threads: "
+	      << seconds << " s" << std::endl;
+
+  } catch (const std::exception& e) {
+
+    std::cerr << e.what() << std::endl;
+    return 1;
+
+  }
+
+  return 0;
+
+}
@@ -0,0 +1,23 @@
+#ifndef MTDAnalyzer_interface_MTDHistoOutput_h
+#define MTDAnalyzer_interface_MTDHistoOutput_h
+
+#include "MTDtools/MTDCore/interface/MTDHistoRegistry.h"
+#include "MTDtools/MTDCore/interface/MTDModuleHistos.h"
+
+class TFileDirectory;
+
+
+// Converts all the histograms of a flushed set to the ROOT ones of the same
+// name (TH1F, TH2F, TProfile, or TH2I for the channel maps), in the
+// subdirectory of their definition of a TFileService, or of a
+// fwlite::TFileService outside the framework. The nested subdirectories are
+// made one level at a time.
+
+void mtdWriteHistos(const MTDHistoRegistry& histos, TFileDirectory& fs);
+
+// Same, for the booked modules of a flushed family, in increasing key order.
+
+void mtdWriteModuleHistos(const MTDModuleHistos& modules, TFileDirectory& fs);
+
+
+#endif
@@ -0,0 +1,51 @@
+#ifndef MTDAnalyzer_interface_MTDHitAssociation_h
+#define MTDAnalyzer_interface_MTDHitAssociation_h
+
+#include <vector>
+
+#include "MTDtools/MTDCore/interface/MTDBunchCrossing.h"
+#include "MTDtools/MTDCore/interface/MTDHistoFill.h"
+#include "MTDtools/MTDCore/interface/MTDJoinedHit.h"
+
+
+// Joined MTD records of an event, one per cell in DetId order, with their
+// positions, the number of cells per tier and optionally their bunch
+// crossing slots and SIM energies per integration window: the event
+// product of MTDHitAssociationProducer, so that the SIM sort and the join
+// of the four tiers are done once per event for all the MTDAnalyzer
+// instances which consume it.
+//
+// MTDAnalyzer without HitAssociation fills one of its own per stream.
+
+struct MTDHitAssociation {
+
+  MTDEventCounts counts;
+  MTDBXWindow window;
+
+  // --- records and their positions: BTL, ETL -Z and ETL +Z
+  std::vector<MTDJoinedHit> btl_hits;
+  std::vector<MTDJoinedHit> etl_hits[2];
+  std::vector<MTDHitPosition> btl_pos;
+  std::vector<MTDHitPosition> etl_pos[2];
+
+  // --- bunch crossing slots, window.size() per record, or none
+  std::vector<MTDBXInfo> btl_bx;
+  std::vector<MTDBXInfo> etl_bx[2];
+
+  // --- SIM energies per integration window, windows.size() per record, or
+  //     none, and the windows [ns] in increasing order
+  std::vector<float> btl_energy;
+  std::vector<float> etl_energy[2];
+  std::vector<float> btlWindows;
+  std::vector<float> etlWindows;
+
+  // --- keeps the capacities
+  void clear();
+
+  // --- view of the records, valid as long as this is not modified
+  MTDEventView view() const;
+
+};
+
+
+#endif
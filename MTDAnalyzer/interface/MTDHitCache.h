@@ -0,0 +1,194 @@
+#ifndef MTDAnalyzer_interface_MTDHitCache_h
+#define MTDAnalyzer_interface_MTDHitCache_h
+
+#include <cstdint>
+#include <cstdio>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "MTDtools/MTDCore/interface/MTDHistoFill.h"
+#include "MTDtools/MTDCore/interface/MTDJoinedHit.h"
+
+
+// Compact binary cache of the joined MTD records and their positions, to
+// refill the histograms without rereading the EDM files (see MTDReplay).
+//
+// The file is made of fixed-width little-endian fields:
+//
+//   header    MTDHitCacheHeader
+//   chunks    events, each an MTDHitCacheEvent followed by the BTL records,
+//             the BTL positions, then the records and positions of ETL -Z
+//             and ETL +Z, as arrays of MTDJoinedHit and MTDHitPosition
+//   index     one MTDHitCacheChunk per chunk
+//   trailer   MTDHitCacheTrailer
+//
+// All the sizes are multiples of 4, so that the records can be read in
+// place from a memory-mapped file. The structures are written as they are
+// in memory: the version changes with any of them, and with the meaning of
+// their fields.
+
+struct MTDHitCacheHeader {
+
+  char magic[8];              // "MTDHITS\0"
+  uint32_t version;
+  uint32_t hitSize;           // sizeof(MTDJoinedHit)
+  uint32_t positionSize;      // sizeof(MTDHitPosition)
+  uint32_t eventSize;         // sizeof(MTDHitCacheEvent)
+
+};
+
+struct MTDHitCacheEvent {
+
+  uint64_t event;
+  uint32_t run;
+  uint32_t lumi;
+
+  MTDEventCounts counts;
+
+  uint32_t nBTL;
+  uint32_t nETL[2];
+  uint32_t reserved;
+
+};
+
+struct MTDHitCacheChunk {
+
+  uint64_t offset;            // from the beginning of the file
+  uint64_t size;              // [bytes]
+  uint32_t nEvents;
+  uint32_t nHits;
+
+};
+
+struct MTDHitCacheTrailer {
+
+  uint64_t indexOffset;
+  uint64_t nChunks;
+  uint64_t nEvents;
+  char magic[8];              // "MTDHITS\0"
+
+};
+
+
+// Writer of a cache file, shared by all the streams. Each stream collects
+// its events in its own Chunk, which is appended to the file under a mutex
+// when it holds chunkEvents events, so that the chunks are in the order in
+// which they are completed. close() writes the index: a file which is not
+// closed cannot be read.
+
+class MTDHitCacheWriter {
+
+public:
+
+  class Chunk {
+
+  public:
+
+    Chunk() : nEvents_(0), nHits_(0) {}
+
+    uint32_t nEvents() const { return nEvents_; }
+
+  private:
+
+    friend class MTDHitCacheWriter;
+
+    std::vector<char> data_;
+    uint32_t nEvents_;
+    uint32_t nHits_;
+
+  };
+
+  MTDHitCacheWriter(const std::string& path, unsigned int chunkEvents);
+  ~MTDHitCacheWriter();
+
+  // --- adds an event to the chunk, written when full; thread-safe
+  void add(Chunk& chunk, uint32_t run, uint32_t lumi, uint64_t event, const MTDEventView& view);
+
+  // --- writes the events of a chunk which is not full; thread-safe
+  void flush(Chunk& chunk);
+
+  // --- writes the index and closes the file; the chunks must be flushed
+  void close();
+
+  uint64_t nEvents() const { return nEvents_; }
+  uint64_t bytes() const { return offset_; }
+
+
+private:
+
+  void write(const void* data, size_t size);
+
+  std::string path_;
+  std::FILE* file_;
+  const unsigned int chunkEvents_;
+
+  std::vector<MTDHitCacheChunk> index_;
+  uint64_t offset_;
+  uint64_t nEvents_;
+
+  std::mutex mutex_;
+
+};
+
+
+// Read-only memory mapping of a cache file. The records of an event are
+// read in place, without copy; the chunks can be read concurrently.
+
+class MTDHitCacheReader {
+
+public:
+
+  struct Event {
+
+    uint32_t run;
+    uint32_t lumi;
+    uint64_t event;
+
+    MTDEventView view;
+
+  };
+
+  // --- maps the file and checks its header, index and trailer
+  explicit MTDHitCacheReader(const std::string& path);
+  ~MTDHitCacheReader();
+
+  MTDHitCacheReader(const MTDHitCacheReader&) = delete;
+  MTDHitCacheReader& operator=(const MTDHitCacheReader&) = delete;
+
+  size_t nChunks() const { return index_.size(); }
+  uint64_t nEvents() const { return nEvents_; }
+  const MTDHitCacheChunk& chunk(size_t ic) const { return index_[ic]; }
+
+  // --- calls f(const Event&) for every event of the chunk ic
+  template<typename F>
+  void forEachEvent(size_t ic, F f) const {
+
+    const MTDHitCacheChunk& chunk = index_[ic];
+    const char* p = base_ + chunk.offset;
+    const char* end = p + chunk.size;
+
+    Event event;
+    for (uint32_t ie = 0; ie < chunk.nEvents; ++ie) {
+      p = decode(p, end, event);
+      f(event);
+    }
+
+  }
+
+
+private:
+
+  const char* decode(const char* p, const char* end, Event& event) const;
+
+  std::string path_;
+  const char* base_;
+  size_t size_;
+
+  std::vector<MTDHitCacheChunk> index_;
+  uint64_t nEvents_;
+
+};
+
+
+#endif
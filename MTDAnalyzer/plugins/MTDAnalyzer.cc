@@ -1,15 +1,29 @@
+#include <algorithm>
 #include <memory>
 #include <iostream>
 #include <vector>
-#include <unordered_map>
-#include <tuple>
+#include <mutex>
+#include <map>
+#include <string>
+#include <limits>
+#include <array>
+#include <numeric>
+#include <functional>
+#include <sstream>
+#include <fstream>
 
 
 #include "FWCore/Framework/interface/Frameworkfwd.h"
-#include "FWCore/Framework/interface/one/EDAnalyzer.h"
+#include "FWCore/Framework/interface/global/EDAnalyzer.h"
 #include "FWCore/Framework/interface/Event.h"
+#include "FWCore/Framework/interface/LuminosityBlock.h"
 #include "FWCore/Framework/interface/MakerMacros.h"
 #include "FWCore/ParameterSet/interface/ParameterSet.h"
+#include "FWCore/ParameterSet/interface/ConfigurationDescriptions.h"
+#include "FWCore/ParameterSet/interface/ParameterSetDescription.h"
+#include "FWCore/MessageLogger/interface/MessageLogger.h"
+#include "FWCore/Utilities/interface/Exception.h"
+#include "FWCore/Utilities/interface/InputTag.h"
 
 #include "SimDataFormats/Track/interface/SimTrackContainer.h"
 #include "SimDataFormats/TrackingAnalysis/interface/TrackingParticle.h"
@@ -17,648 +31,367 @@
 
 #include "DataFormats/ForwardDetId/interface/MTDDetId.h"
 #include "DataFormats/ForwardDetId/interface/BTLDetId.h"
+#include "DataFormats/ForwardDetId/interface/ETLDetId.h"
 #include "DataFormats/FTLDigi/interface/FTLDigiCollections.h"
 #include "DataFormats/FTLRecHit/interface/FTLRecHitCollections.h"
 
 #include "Geometry/Records/interface/MTDDigiGeometryRecord.h"
-#include "Geometry/MTDGeometryBuilder/interface/MTDGeometry.h"
-#include "Geometry/MTDGeometryBuilder/interface/ProxyMTDTopology.h"
-#include "Geometry/MTDGeometryBuilder/interface/RectangularMTDTopology.h"
-#include "Geometry/CommonTopologies/interface/PixelTopology.h"
 
 #include "FWCore/ServiceRegistry/interface/Service.h"
 #include "CommonTools/UtilAlgos/interface/TFileService.h"
 
 #include "CLHEP/Units/GlobalPhysicalConstants.h"
 
-#include "TH1.h"
-#include "TH2.h"
-#include "TProfile.h"
+#include "MTDtools/MTDAnalyzer/interface/MTDHistoOutput.h"
+#include "MTDtools/MTDAnalyzer/interface/MTDHitAssociation.h"
+#include "MTDtools/MTDAnalyzer/interface/MTDHitCache.h"
 
+#include "MTDtools/MTDCore/interface/MTDCalibration.h"
+#include "MTDtools/MTDCore/interface/MTDHistoFill.h"
+#include "MTDtools/MTDCore/interface/MTDHistoRegistry.h"
+#include "MTDtools/MTDCore/interface/MTDJoinedHit.h"
+#include "MTDtools/MTDCore/interface/MTDModuleHistos.h"
+#include "MTDtools/MTDCore/interface/MTDResolution.h"
+#include "MTDtools/MTDCore/interface/MTDTimeWalk.h"
 
+#include "tbb/task_group.h"
 
-struct MTDinfo {
+#include "MTDGeometryCache.h"
+#include "MTDHitAssociator.h"
+#include "MTDInstrumentation.h"
+#include "MTDNtuple.h"
 
-  float sim_energy;
-  float sim_time;
-  float sim_x;
-  float sim_y;
-  float sim_z;
 
-  uint32_t digi_row[2];
-  uint32_t digi_col[2];
-  uint32_t digi_charge[2];
-  uint32_t digi_time1[2];
-  uint32_t digi_time2[2];
+// Per-stream state: the stream histogram set, the scratch stores used to
+// join the MTD hits of one event and the joined records, without
+// HitAssociation.
+struct MTDStreamCache {
 
-  float ureco_charge[2];
-  float ureco_time[2];
+  MTDHistoRegistry histos;
 
-  float reco_energy;
-  float reco_time;
+  // --- with IntraEventTasks, sets of the BTL hit chunks but the first,
+  //     booked with the BTL hit groups of histos and added to it in
+  //     endStream()
+  std::vector<MTDHistoRegistry> btlPartials;
 
-};
-
-
-
-bool orderByDetIdThenTime(const std::tuple<PSimHit,uint32_t,float> &a,
-			  const std::tuple<PSimHit,uint32_t,float> &b) {
-
-  unsigned int detId_a(std::get<1>(a)), detId_b(std::get<1>(b));
-      
-  if(detId_a<detId_b) return true;
-  if(detId_a>detId_b) return false;
-      
-  double time_a(std::get<2>(a)), time_b(std::get<2>(b));
-  if(time_a<time_b) return true;
-  
-  return false;
-
-}
-
-
-class MTDAnalyzer : public edm::one::EDAnalyzer<edm::one::SharedResources>  {
+  MTDHitAssociator::Scratch join;
+  MTDHitAssociation association;
 
-public:
-  explicit MTDAnalyzer(const edm::ParameterSet&);
-  ~MTDAnalyzer();
-
-  static void fillDescriptions(edm::ConfigurationDescriptions& descriptions);
+  // --- uncalibrated RECO amplitudes and times of the BTL records, side 0
+  //     then side 1
+  MTDTimeWalk::Channels btlTimeWalk;
 
+  // --- ntuple records of the event
+  MTDNtuple::Columns ntupleColumns;
 
-private:
-  virtual void beginJob() override;
-  virtual void analyze(const edm::Event&, const edm::EventSetup&) override;
-  virtual void endJob() override;
-
-  // ----------member data ---------------------------
-
-  const MTDGeometry* geom_;
-
-  const float btlIntegrationWindow_;
-  const float btlMinEnergy_;
-
-
-  //edm::EDGetTokenT<reco::GenParticleCollection> tok_genPart; 
-  //edm::EDGetTokenT<edm::SimTrackContainer> tok_simTrack; 
-
-
-  // --- Tracking Particles
-  //edm::EDGetTokenT<TrackingParticleCollection> tok_trkPart; 
-
-  // --- MTD SIM hits
-  edm::EDGetTokenT<edm::PSimHitContainer> tok_BTL_sim; 
-  edm::EDGetTokenT<edm::PSimHitContainer> tok_ETL_sim; 
-
-  // --- MTD DIGI hits
-  edm::EDGetTokenT<BTLDigiCollection> tok_BTL_digi; 
-  edm::EDGetTokenT<ETLDigiCollection> tok_ETL_digi; 
-  
-  // --- MTD uncalibrated RECO hits 
-  edm::EDGetTokenT<FTLUncalibratedRecHitCollection> tok_BTL_ureco; 
-  edm::EDGetTokenT<FTLUncalibratedRecHitCollection> tok_ETL_ureco; 
-  
-  // --- MTD RECO hits 
-  edm::EDGetTokenT<FTLRecHitCollection> tok_BTL_reco; 
-  edm::EDGetTokenT<FTLRecHitCollection> tok_ETL_reco; 
-
-  
-  std::unordered_map<uint32_t, std::set<int> > n_btl_simHits;
-  std::unordered_map<uint32_t, std::set<int> > n_etl_simHits[2];
-  std::unordered_map<uint32_t, MTDinfo> btl_hits;
-  std::unordered_map<uint32_t, MTDinfo> etl_hits[2];
-  
-
-  ///////////////////////////////////////////////////////////////////////////////////////////////
-  //
-  //  Histograms declaration
-  //
-  ///////////////////////////////////////////////////////////////////////////////////////////////
-
-  // --- BTL -------------------------------------------------------
+  // --- hit cache events not yet written
+  MTDHitCacheWriter::Chunk hitCacheChunk;
 
-  // SIM
-
-  TH1F *hb_n_sim_trk;
-  TH1F *hb_n_sim_cell;
-  TH1F *hb_t_sim;
-  TH1F *hb_e_sim;
-  TH1F *hb_xloc_sim;
-  TH1F *hb_yloc_sim;
-  TH1F *hb_zloc_sim;
-  TH2F *hb_occupancy_sim;
-  TH1F *hb_phi_sim;
-  TH1F *hb_z_sim;
-  TH1F *hb_eta_sim;
- 
-  TH2F *hb_t_e_sim;
-  TH2F *hb_e_eta_sim;
-  TH2F *hb_t_eta_sim;
-  TH2F *hb_e_phi_sim;
-  TH2F *hb_t_phi_sim;
-
-  TProfile *pb_t_e_sim;
-  TProfile *pb_e_eta_sim;
-  TProfile *pb_t_eta_sim;
-  TProfile *pb_e_phi_sim;
-  TProfile *pb_t_phi_sim;
+  // --- per-channel calibration sums
+  MTDCalibration btlCalibration;
+  MTDCalibration etlCalibration;
+  MTDCalibration::Scratch calibrationScratch;
 
+  // --- resolution sketches
+  MTDResolution resolution;
+  MTDResolution::Scratch resolutionScratch;
 
-  // DIGI
-
-  TH1F *hb_n_digi[2];
-  TH1F *hb_t1_digi[2];
-  TH1F *hb_t2_digi[2];
-  TH1F *hb_e_digi[2];
-  TH2F *hb_occupancy_digi[2];
-  TH1F *hb_phi_digi[2];
-  TH1F *hb_eta_digi[2];
-  TH1F *hb_z_digi[2];
-
-  TH2F *hb_t1_e_digi[2];
-  TH2F *hb_t2_e_digi[2];
-  TH2F *hb_e_eta_digi[2];
-  TH2F *hb_t1_eta_digi[2];
-  TH2F *hb_t2_eta_digi[2];
-  TH2F *hb_e_phi_digi[2];
-  TH2F *hb_t1_phi_digi[2];
-  TH2F *hb_t2_phi_digi[2];
+  // --- per-module histograms
+  MTDModuleHistos btlModules;
+  MTDModuleHistos etlModules;
 
-  TProfile *pb_t1_e_digi[2];
-  TProfile *pb_t2_e_digi[2];
-  TProfile *pb_e_eta_digi[2];
-  TProfile *pb_t1_eta_digi[2];
-  TProfile *pb_t2_eta_digi[2];
-  TProfile *pb_e_phi_digi[2];
-  TProfile *pb_t1_phi_digi[2];
-  TProfile *pb_t2_phi_digi[2];
+#ifdef MTD_INSTRUMENTATION
+  MTDEventStats stats;
 
+  // --- number of record and position stores reallocated since capacities()
+  size_t grown(const std::array<size_t,6>& capacity) const {
+    const auto now = capacities();
+    return std::inner_product(now.begin(), now.end(), capacity.begin(), size_t(0), std::plus<size_t>(),
+			      std::not_equal_to<size_t>());
+  }
 
-  // Uncalibrated RECO
-
-  TH1F *hb_n_ureco[2];
-  TH1F *hb_t_ureco[2];
-  TH1F *hb_t_ureco_uncorr[2];
-  TH1F *hb_e_ureco[2];
-  TH2F *hb_occupancy_ureco[2];
-
-  TH2F *hb_t_amp_ureco[2];
-  TProfile *pb_t_amp_ureco[2];
-
-
-  // RECO
-
-  TH1F *hb_n_reco;
-  TH2F *hb_occupancy_reco;
-  TH1F *hb_t_reco;
-  TH1F *hb_t_reco_uncorr;
-  TH1F *hb_e_reco;
+  std::array<size_t,6> capacities() const {
+    const MTDHitAssociation& a = association;
+    return { a.btl_hits.capacity(), a.etl_hits[0].capacity(), a.etl_hits[1].capacity(),
+	     a.btl_pos.capacity(), a.etl_pos[0].capacity(), a.etl_pos[1].capacity() };
+  }
+#endif
 
-  TH1F *hb_t_res;
-  TH1F *hb_t_res_uncorr;
-  TH1F *hb_e_res;
+};
 
-  TH2F *hb_t_reco_sim;
-  TH2F *hb_e_reco_sim;
 
+// Keys and output directories of the per-module histograms: the geometry
+// module of a BTL crystal, the ring of an ETL module.
 
-  // --- ETL -------------------------------------------------------
+static uint32_t btlModuleKey(uint32_t rawId) {
+  return MTDCellIndex::btlGeoId(BTLDetId(rawId)).rawId();
+}
 
-  // SIM
+static std::string btlModuleDir(uint32_t key) {
+  const BTLDetId id(key);
+  return "BTL/Modules/Side" + std::to_string(id.mtdSide()) + "/Tray" + std::to_string(id.mtdRR()) +
+    "/Module" + std::to_string(id.module());
+}
 
-  TH1F *he_n_sim_trk[2];
-  TH1F *he_n_sim_cell[2];
+static uint32_t etlRingKey(uint32_t rawId) {
+  const ETLDetId id(rawId);
+  return ETLDetId(id.mtdSide(),id.mtdRR(),0,0).rawId();
+}
 
-  TH1F *he_t_sim[2];
-  TH1F *he_e_sim[2];
+static std::string etlRingDir(uint32_t key) {
+  const ETLDetId id(key);
+  return "ETL/Rings/Side" + std::to_string(id.mtdSide()) + "/Ring" + std::to_string(id.mtdRR());
+}
 
-  TH1F *he_xloc_sim[2];
-  TH1F *he_yloc_sim[2];
-  TH1F *he_zloc_sim[2];
 
-  TH2F *he_occupancy_sim[2];
-  TH1F *he_x_sim[2];
-  TH1F *he_y_sim[2];
-  TH1F *he_z_sim[2];
-  TH1F *he_phi_sim[2];
-  TH1F *he_eta_sim[2];
+// Check of the axes of the channel maps of the groups against the cell
+// coordinates of the geometry, the BTL crystal indices and the ETL modules
+// and rings: a warning for each axis not covering all the cells, whose
+// fills would go to the underflow or overflow bins.
 
-  TH2F *he_t_e_sim[2];
-  TH2F *he_e_eta_sim[2];
-  TH2F *he_t_eta_sim[2];
-  TH2F *he_e_phi_sim[2];
-  TH2F *he_t_phi_sim[2];
+static void checkChannelMaps(const MTDGeometryCache& geoCache, const std::vector<std::string>& groups) {
 
-  TProfile *pe_t_e_sim[2];
-  TProfile *pe_e_eta_sim[2];
-  TProfile *pe_t_eta_sim[2];
-  TProfile *pe_e_phi_sim[2];
-  TProfile *pe_t_phi_sim[2];
+  // --- coordinate ranges, indexed by the MTDHistoDef variables
+  std::map<int,std::pair<int,int> > ranges;
+  auto extend = [&ranges](int var, int value) {
+    auto r = ranges.emplace(var, std::make_pair(value, value)).first;
+    r->second.first = std::min(r->second.first, value);
+    r->second.second = std::max(r->second.second, value);
+  };
 
+  const MTDCellIndex& cells = geoCache.cells();
 
-  // DIGI
+  for (uint32_t ic = 0; ic < cells.nBTLCells(); ++ic) {
+    const MTDGeometryCache::BTLCell& cell = geoCache.btl(ic);
+    if ( cell.det == nullptr ) continue;
+    extend(kCellIPhi, cell.coords.iphi);
+    extend(kCellIEta, cell.coords.ieta);
+  }
 
-  TH1F *he_n_digi[2];
+  for (uint32_t ic = 0; ic < cells.nETLCells(); ++ic) {
+    const MTDGeometryCache::ETLCell& cell = geoCache.etl(ic);
+    if ( cell.det == nullptr ) continue;
+    extend(kCellModule, cell.coords.module);
+    extend(kCellRing, cell.coords.ring);
+  }
 
-  TH1F *he_t_digi[2];
-  TH1F *he_e_digi[2];
+  for (size_t id = 0; id < mtdNHistoDefs; ++id) {
+
+    const MTDHistoDef& def = mtdHistoDefs[id];
+    if ( def.kind != MTDHistoDef::kChannelMap ||
+	 std::find(groups.begin(), groups.end(), def.group) == groups.end() ) continue;
+
+    const int axes[2][2] = { { def.x, def.nx }, { def.y, def.ny } };
+    const double first[2] = { def.xlo, def.ylo };
+
+    for (int ia = 0; ia < 2; ++ia) {
+      auto r = ranges.find(axes[ia][0]);
+      if ( r == ranges.end() ) continue;
+      const int lo = int(first[ia]);
+      const int hi = lo + axes[ia][1] - 1;
+      if ( r->second.first < lo || r->second.second > hi )
+	edm::LogWarning("MTDAnalyzer") << "Channel map " << def.dir << "/" << def.name << ": the "
+				       << (ia == 0 ? "x" : "y") << " axis covers [" << lo << ", " << hi
+				       << "], the geometry [" << r->second.first << ", " << r->second.second
+				       << "]";
+    }
 
-  TH2F *he_occupancy_digi[2];
-  TH1F *he_x_digi[2];
-  TH1F *he_y_digi[2];
-  TH1F *he_phi_digi[2];
-  TH1F *he_eta_digi[2];
+  }
 
-  TH2F *he_t_e_digi[2];
-  TH2F *he_e_eta_digi[2];
-  TH2F *he_t_eta_digi[2];
-  TH2F *he_e_phi_digi[2];
-  TH2F *he_t_phi_digi[2];
+}
 
-  TProfile *pe_t_e_digi[2];
-  TProfile *pe_e_eta_digi[2];
-  TProfile *pe_t_eta_digi[2];
-  TProfile *pe_e_phi_digi[2];
-  TProfile *pe_t_phi_digi[2];
 
+class MTDAnalyzer : public edm::global::EDAnalyzer<edm::StreamCache<MTDStreamCache>,
+						    edm::LuminosityBlockCache<MTDGeometryCache> >  {
 
+public:
+  explicit MTDAnalyzer(const edm::ParameterSet&);
+  ~MTDAnalyzer();
 
-  // Uncalibrated RECO
+  static void fillDescriptions(edm::ConfigurationDescriptions& descriptions);
 
-  TH1F *he_n_ureco[2];
 
-  // RECO
+private:
+  virtual void beginJob() override;
+  virtual std::unique_ptr<MTDStreamCache> beginStream(edm::StreamID) const override;
+  virtual std::shared_ptr<MTDGeometryCache> globalBeginLuminosityBlock(const edm::LuminosityBlock&,
+								       const edm::EventSetup&) const override;
+  virtual void analyze(edm::StreamID, const edm::Event&, const edm::EventSetup&) const override;
+  virtual void globalEndLuminosityBlock(const edm::LuminosityBlock&, const edm::EventSetup&) const override;
+  virtual void endStream(edm::StreamID) const override;
+  virtual void endJob() override;
 
-  TH1F *he_n_reco[2];
+  // ----------member data ---------------------------
 
+  const float btlMinEnergy_;
+  const unsigned int histoFlushSize_;
+  const std::vector<std::string> histoGroups_;
+  const std::vector<std::string> moduleGroups_;
+
+  // --- groups of histoGroups_ filled per BTL hit, those of the BTL chunk sets
+  const std::vector<std::string> btlHitGroups_;
+
+  const MTDTimeWalk btlTimeWalk_;
+
+  // --- BTL and ETL filled in concurrent tasks, the BTL hits in chunks
+  const bool intraEventTasks_;
+  const unsigned int btlFillChunks_;
+
+
+  // --- Join of the MTD hits of the event, without HitAssociation (see
+  //     MTDHitAssociator), or the MTDHitAssociationProducer product
+  std::unique_ptr<MTDHitAssociator> associator_;
+  edm::EDGetTokenT<MTDHitAssociation> tok_association;
+
+
+  // --- Job-level histograms. The stream histograms are added to them in
+  //     endStream(), under mergeMutex_, and they are written to the
+  //     TFileService in endJob().
+  mutable MTDHistoRegistry histos_;
+  mutable std::mutex mergeMutex_;
+
+  // --- Last geometry whose cells were checked against the channel maps,
+  //     under mergeMutex_
+  mutable std::shared_ptr<const MTDGeometryCache> checkedGeometry_;
+
+  // --- Optional per-module histograms (ModuleHistogramGroups), booked per
+  //     module on its first fill and added and written as histos_ (see
+  //     MTDModuleHistos)
+  mutable MTDModuleHistos btlModules_;
+  mutable MTDModuleHistos etlModules_;
+
+  // --- Optional columnar output of the joined records, filled by all the
+  //     streams (see MTDNtuple)
+  std::unique_ptr<MTDNtuple> ntuple_;
+
+  // --- Optional binary cache of the joined records and their positions,
+  //     written by all the streams and closed in endJob() (see MTDHitCache)
+  std::unique_ptr<MTDHitCacheWriter> hitCache_;
+
+  // --- Optional per-channel time-walk and energy scale calibration: the
+  //     stream sums are added to these in endStream(), under mergeMutex_,
+  //     fitted and written to calibrationFile_ in endJob() (see
+  //     MTDCalibration)
+  const std::string calibrationFile_;
+  MTDCalibration::Binning calibrationBinning_;
+  const unsigned int calibrationMinEntries_;
+  std::unique_ptr<MTDCalibration> btlCalibration_;
+  std::unique_ptr<MTDCalibration> etlCalibration_;
+
+  // --- Optional resolution sketches, added in endStream() under
+  //     mergeMutex_ and reported to resolutionFile_ in endJob() (see
+  //     MTDResolution)
+  const std::string resolutionFile_;
+  MTDResolution::Binning resolutionBinning_;
+  std::unique_ptr<MTDResolution> resolution_;
+
+#ifdef MTD_INSTRUMENTATION
+  // --- Stage timing and counters of all the streams, added in endStream()
+  //     under mergeMutex_ (see MTDInstrumentation)
+  mutable MTDEventStats stats_;
+  const std::string instrumentationFile_;
+#endif
 
 };
 
 
 MTDAnalyzer::MTDAnalyzer(const edm::ParameterSet& iConfig) :
-  geom_(nullptr),
-  btlIntegrationWindow_( iConfig.getParameter<double>("BTLIntegrationWindow") ),
-  btlMinEnergy_( iConfig.getParameter<double>("BTLMinimumEnergy") ) {
-
-  tok_BTL_sim = consumes<edm::PSimHitContainer>(edm::InputTag("g4SimHits","FastTimerHitsBarrel"));
-  tok_ETL_sim = consumes<edm::PSimHitContainer>(edm::InputTag("g4SimHits","FastTimerHitsEndcap"));
-
-  tok_BTL_digi = consumes<BTLDigiCollection>(edm::InputTag("mix","FTLBarrel"));
-  tok_ETL_digi = consumes<ETLDigiCollection>(edm::InputTag("mix","FTLEndcap"));
+  btlMinEnergy_( iConfig.getParameter<double>("BTLMinimumEnergy") ),
+  histoFlushSize_( iConfig.getParameter<unsigned int>("HistogramFlushSize") ),
+  histoGroups_( iConfig.getParameter<std::vector<std::string> >("HistogramGroups") ),
+  moduleGroups_( iConfig.getParameter<std::vector<std::string> >("ModuleHistogramGroups") ),
+  btlHitGroups_( mtdBTLHitGroups(histoGroups_) ),
+  btlTimeWalk_( iConfig.getParameter<std::vector<double> >("BTLTimeWalkParameters") ),
+  intraEventTasks_( iConfig.getParameter<bool>("IntraEventTasks") ),
+  btlFillChunks_( iConfig.getParameter<unsigned int>("BTLFillChunks") ),
+  associator_(nullptr),
+  calibrationFile_( iConfig.getParameter<std::string>("CalibrationFile") ),
+  calibrationMinEntries_( iConfig.getParameter<unsigned int>("CalibrationMinEntries") ),
+  resolutionFile_( iConfig.getParameter<std::string>("ResolutionFile") )
+#ifdef MTD_INSTRUMENTATION
+  , instrumentationFile_( iConfig.getParameter<std::string>("InstrumentationFile") )
+#endif
+{
 
-  tok_BTL_ureco = consumes<FTLUncalibratedRecHitCollection>(edm::InputTag("mtdUncalibratedRecHits","FTLBarrel"));
-  tok_ETL_ureco = consumes<FTLUncalibratedRecHitCollection>(edm::InputTag("mtdUncalibratedRecHits","FTLEndcap"));
+  // --- The MTD hits are joined by an MTDHitAssociationProducer when
+  //     HitAssociation is set, shared by all the analyzers which consume
+  //     its product, otherwise here: only then are the tiers and windows
+  //     read, and the histogram groups checked against them
 
-  tok_BTL_reco = consumes<FTLRecHitCollection>(edm::InputTag("mtdRecHits","FTLBarrel"));
-  tok_ETL_reco = consumes<FTLRecHitCollection>(edm::InputTag("mtdRecHits","FTLEndcap"));
+  const edm::InputTag associationTag = iConfig.getParameter<edm::InputTag>("HitAssociation");
 
-  edm::Service<TFileService> fs;
+  if ( associationTag.label().empty() ) {
+    associator_ = std::make_unique<MTDHitAssociator>(iConfig, consumesCollector());
+    associator_->checkGroups(histoGroups_);
+    associator_->checkGroups(moduleGroups_);
+  }
+  else
+    tok_association = consumes<MTDHitAssociation>(associationTag);
+
+  if ( intraEventTasks_ && btlFillChunks_ == 0 )
+    throw cms::Exception("Configuration") << "BTLFillChunks must be at least 1";
+
+  histos_.book(mtdHistoDefs, mtdNHistoDefs, histoGroups_);
+
+  for (auto const& group: moduleGroups_) {
+    if ( group == "BTLModule" )
+      btlModules_.book(mtdModuleHistoDefs, mtdNModuleHistoDefs, group, btlModuleDir);
+    else if ( group == "ETLModule" )
+      etlModules_.book(mtdModuleHistoDefs, mtdNModuleHistoDefs, group, etlRingDir);
+    else
+      throw cms::Exception("Configuration") << "Unknown module histogram group " << group
+					    << ", must be BTLModule or ETLModule";
+  }
 
+  if ( iConfig.getParameter<bool>("WriteNtuple") ) {
+    edm::Service<TFileService> fs;
+    ntuple_ = std::make_unique<MTDNtuple>(*fs, iConfig.getParameter<std::string>("NtupleCompression"),
+					  iConfig.getParameter<unsigned int>("NtupleCompressionLevel"));
+  }
 
-  ///////////////////////////////////////////////////////////////////////////////////////////////
-  //
-  //  Histograms definition
-  //
-  ///////////////////////////////////////////////////////////////////////////////////////////////
+  const std::string hitCacheFile = iConfig.getParameter<std::string>("HitCacheFile");
+  if ( !hitCacheFile.empty() )
+    hitCache_ = std::make_unique<MTDHitCacheWriter>(hitCacheFile, iConfig.getParameter<unsigned int>("HitCacheChunkSize"));
+
+  if ( !calibrationFile_.empty() ) {
+    const auto range = iConfig.getParameter<std::vector<double> >("CalibrationAmplitudeRange");
+    if ( range.size() != 2 )
+      throw cms::Exception("Configuration") << "CalibrationAmplitudeRange must be [min, max] in pC";
+    calibrationBinning_.minAmplitude = range[0];
+    calibrationBinning_.maxAmplitude = range[1];
+    calibrationBinning_.nBins = iConfig.getParameter<unsigned int>("CalibrationAmplitudeBins");
+    btlCalibration_ = std::make_unique<MTDCalibration>(2, calibrationBinning_);
+    etlCalibration_ = std::make_unique<MTDCalibration>(1, calibrationBinning_);
+  }
 
-  TFileDirectory btl = fs->mkdir( "BTL" );
-  TFileDirectory etl = fs->mkdir( "ETL" );
-
-  // ==============================================================================
-  //  BTL
-  // ==============================================================================
-
-  // --- SIM
-
-  hb_n_sim_trk  = btl.make<TH1F>("h_n_sim_trk", "Number of tracks per BTL cell;N_{trk}", 10, 0., 10.);
-  hb_n_sim_cell = btl.make<TH1F>("h_n_sim_cell", "Number of BTL cells with SIM hits;N_{BTL cells}", 250, 0., 5000.);
-
-  hb_t_sim = btl.make<TH1F>("h_t_sim", "BTL SIM hits ToA;ToA_{SIM} [ns]", 250, 0., 25.);
-  hb_e_sim = btl.make<TH1F>("h_e_sim", "BTL SIM hits energy;E_{SIM} [MeV]", 200, 0., 20.);
-  hb_xloc_sim = btl.make<TH1F>("h_xloc_sim", "BTL SIM local x;x_{SIM} [mm]", 290, -1.45, 1.45);
-  hb_yloc_sim = btl.make<TH1F>("h_yloc_sim", "BTL SIM local y;y_{SIM} [mm]", 600, -30., 30.);
-  hb_zloc_sim = btl.make<TH1F>("h_zloc_sim", "BTL SIM local z;z_{SIM} [mm]", 400, -2., 2.);
-
-  hb_occupancy_sim = btl.make<TH2F>("h_occupancy_sim", "BTL SIM hits occupancy;z_{SIM} [cm];#phi_{SIM} [rad]",
-				    520, -260., 260., 315, -3.15, 3.15 );
-  hb_phi_sim = btl.make<TH1F>("h_phi_sim", "BTL SIM hits #phi;#phi_{SIM} [rad]", 315, -3.15, 3.15);
-  hb_z_sim   = btl.make<TH1F>("h_z_sim", "BTL SIM hits z;z_{SIM} [cm]", 520, -260., 260.);
-  hb_eta_sim = btl.make<TH1F>("h_eta_sim", "BTL SIM hits #eta;#eta_{SIM}", 200, -1.6, 1.6);
-  hb_t_e_sim   = btl.make<TH2F>("h_t_e_sim", "BTL SIM time vs energy;E_{SIM} [MeV];T_{SIM} [ns]",
-				100, 0., 20., 100, 0., 25.);
-  hb_e_eta_sim = btl.make<TH2F>("h_e_eta_sim", "BTL SIM energy vs |#eta|;|#eta_{SIM}|;E_{SIM} [MeV]",
-				100, 0., 1.6, 100, 0., 20.);
-  hb_t_eta_sim = btl.make<TH2F>("h_t_eta_sim", "BTL SIM time vs |#eta|;|#eta_{SIM}|;T_{SIM} [ns]",
-				100, 0., 1.6, 100, 0., 25.);
-  hb_e_phi_sim = btl.make<TH2F>("h_e_phi_sim", "BTL SIM energy vs #phi;#phi_{SIM} [rad];E_{SIM} [MeV]",
-				100, -3.15, 3.15, 100, 0., 20.);
-  hb_t_phi_sim = btl.make<TH2F>("h_t_phi_sim", "BTL SIM time vs #phi;#phi_{SIM} [rad];T_{SIM} [ns]",
-				100, -3.15, 3.15, 100, 0., 25.);
-
-  pb_t_e_sim   = btl.make<TProfile>("p_t_e_sim", "BTL SIM time vs energy;E_{SIM} [MeV];T_{SIM} [ns]",
-				    100, 0., 20.);
-  pb_e_eta_sim = btl.make<TProfile>("p_e_eta_sim", "BTL SIM energy vs |#eta|;|#eta_{SIM}|;E_{SIM} [MeV]",
-				    100, 0., 1.6);
-  pb_t_eta_sim = btl.make<TProfile>("p_t_eta_sim", "BTL SIM time vs |#eta|;|#eta_{SIM}|;T_{SIM} [ns]",
-				    100, 0., 1.6);
-  pb_e_phi_sim = btl.make<TProfile>("p_e_phi_sim", "BTL SIM energy vs #phi;#phi_{SIM} [rad];E_{SIM} [MeV]",
-				    100, -3.15, 3.15);
-  pb_t_phi_sim = btl.make<TProfile>("p_t_phi_sim", "BTL SIM time vs #phi;#phi_{SIM} [rad];T_{SIM} [ns]",
-				    100, -3.15, 3.15);
-
-
-  // --- DIGI
-
-  hb_n_digi[0]  = btl.make<TH1F>("h_n_digi_0", "Number of BTL DIGI hits (L);N_{DIGI hits}", 100, 0., 100.);
-  hb_n_digi[1]  = btl.make<TH1F>("h_n_digi_1", "Number of BTL DIGI hits (R);N_{DIGI hits}", 100, 0., 100.);
-  hb_t1_digi[0] = btl.make<TH1F>("h_t1_digi_0", "BTL DIGI hits ToA1 (L);ToA [TDC counts]", 1024, 0., 1024.);
-  hb_t1_digi[1] = btl.make<TH1F>("h_t1_digi_1", "BTL DIGI hits ToA1 (R);ToA [TDC counts]", 1024, 0., 1024.);
-  hb_t2_digi[0] = btl.make<TH1F>("h_t2_digi_0", "BTL DIGI hits ToA2 (L);ToA [TDC counts]", 1024, 0., 1024.);
-  hb_t2_digi[1] = btl.make<TH1F>("h_t2_digi_1", "BTL DIGI hits ToA2 (R);ToA [TDC counts]", 1024, 0., 1024.);
-  hb_e_digi[0]  = btl.make<TH1F>("h_e_digi_0", "BTL DIGI hits energy (L);amplitude [ADC counts]", 1024, 0., 1024.);
-  hb_e_digi[1]  = btl.make<TH1F>("h_e_digi_1", "BTL DIGI hits energy (R);amplitude [ADC counts]", 1024, 0., 1024.);
-
-  hb_occupancy_digi[0] = btl.make<TH2F>("h_occupancy_digi_0", "BTL DIGI hits occupancy (L);z [cm]; #phi [rad]",
-					65, -260., 260., 315, -3.15, 3.15 );
-  hb_occupancy_digi[1] = btl.make<TH2F>("h_occupancy_digi_1", "BTL DIGI hits occupancy (R);z [cm]; #phi [rad]",
-					65, -260., 260., 315, -3.15, 3.15 );
-  hb_phi_digi[0] = btl.make<TH1F>("h_phi_digi_0", "BTL DIGI hits #phi (L);#phi [rad]", 2520, -3.15, 3.15);
-  hb_phi_digi[1] = btl.make<TH1F>("h_phi_digi_1", "BTL DIGI hits #phi (R);#phi [rad]", 2520, -3.15, 3.15);
-  hb_eta_digi[0] = btl.make<TH1F>("h_eta_digi_0", "BTL DIGI hits #eta (L);#eta", 200, -1.6, 1.6);
-  hb_eta_digi[1] = btl.make<TH1F>("h_eta_digi_1", "BTL DIGI hits #eta (R);#eta", 200, -1.6, 1.6);
-  hb_z_digi[0]   = btl.make<TH1F>("h_z_digi_0", "BTL DIGI hits z (L);z [cm]", 260, -260., 260.);
-  hb_z_digi[1]   = btl.make<TH1F>("h_z_digi_1", "BTL DIGI hits z (R);z [cm]", 260, -260., 260.);
-
-  hb_t1_e_digi[0]   = btl.make<TH2F>("h_t1_e_digi_0", "BTL DIGI time1 vs charge (L);ADC counts;TDC counts",
-				     128, 0., 1024., 128, 0., 1024.);
-  hb_t1_e_digi[1]   = btl.make<TH2F>("h_t1_e_digi_1", "BTL DIGI time1 vs charge (R);ADC counts;TDC counts",
-				     128, 0., 1024., 128, 0., 1024.);
-  hb_t2_e_digi[0]   = btl.make<TH2F>("h_t2_e_digi_0", "BTL DIGI time2 vs charge (L);ADC counts;TDC counts",
-				     128, 0., 1024., 128, 0., 1024.);
-  hb_t2_e_digi[1]   = btl.make<TH2F>("h_t2_e_digi_1", "BTL DIGI time2 vs charge (R);ADC counts;TDC counts",
-				     128, 0., 1024., 128, 0., 1024.);
-  hb_e_eta_digi[0]  = btl.make<TH2F>("h_e_eta_digi_0", "BTL DIGI charge vs |#eta| (L);cell |#eta|;ADC counts",
-				     43, 0., 43., 128, 0., 1024.);
-  hb_e_eta_digi[1]  = btl.make<TH2F>("h_e_eta_digi_1", "BTL DIGI charge vs |#eta| (R);cell |#eta|;ADC counts",
-				     43, 0., 43., 128, 0., 1024.);
-  hb_t1_eta_digi[0] = btl.make<TH2F>("h_t1_eta_digi_0", "BTL DIGI time1 vs |#eta| (L);cell |#eta|;TDC counts",
-				     43, 0., 43., 128, 0., 1024.);
-  hb_t1_eta_digi[1] = btl.make<TH2F>("h_t1_eta_digi_1", "BTL DIGI time1 vs |#eta| (R);cell |#eta|;TDC counts",
-				     43, 0., 43., 128, 0., 1024.);
-  hb_t2_eta_digi[0] = btl.make<TH2F>("h_t2_eta_digi_0", "BTL DIGI time2 vs |#eta| (L);cell |#eta|;TDC counts",
-				     43, 0., 43., 128, 0., 1024.);
-  hb_t2_eta_digi[1] = btl.make<TH2F>("h_t2_eta_digi_1", "BTL DIGI time2 vs |#eta| (R);cell |#eta|;TDC counts",
-				     43, 0., 43., 128, 0., 1024.);
-  hb_e_phi_digi[0]  = btl.make<TH2F>("h_e_phi_digi_0", "BTL DIGI charge vs #phi (L);cell #phi;ADC counts",
-				     145, 0., 2305., 128, 0., 1024.);
-  hb_e_phi_digi[1]  = btl.make<TH2F>("h_e_phi_digi_1", "BTL DIGI charge vs #phi (R);cell #phi;ADC counts",
-				     145, 0., 2305., 128, 0., 1024.);
-  hb_t1_phi_digi[0] = btl.make<TH2F>("h_t1_phi_digi_0", "BTL DIGI time1 vs #phi (L);cell #phi;TDC counts",
-				     145, 0., 2305., 128, 0., 1024.);
-  hb_t1_phi_digi[1] = btl.make<TH2F>("h_t1_phi_digi_1", "BTL DIGI time1 vs #phi (R);cell #phi;TDC counts",
-				     145, 0., 2305., 128, 0., 1024.);
-  hb_t2_phi_digi[0] = btl.make<TH2F>("h_t2_phi_digi_0", "BTL DIGI time2 vs #phi (L);cell #phi;TDC counts",
-				     145, 0., 2305., 128, 0., 1024.);
-  hb_t2_phi_digi[1] = btl.make<TH2F>("h_t2_phi_digi_1", "BTL DIGI time2 vs #phi (R);cell #phi;TDC counts",
-				     145, 0., 2305., 128, 0., 1024.);
-
-  pb_t1_e_digi[0]   = btl.make<TProfile>("p_t1_e_digi_0", "BTL DIGI time1 vs charge (L);ADC counts;TDC counts",
-					 128, 0., 1024.);
-  pb_t1_e_digi[1]   = btl.make<TProfile>("p_t1_e_digi_1", "BTL DIGI time1 vs charge (R);ADC counts;TDC counts",
-					 128, 0., 1024.);
-  pb_t2_e_digi[0]   = btl.make<TProfile>("p_t2_e_digi_0", "BTL DIGI time2 vs charge (L);ADC counts;TDC counts",
-					 128, 0., 1024.);
-  pb_t2_e_digi[1]   = btl.make<TProfile>("p_t2_e_digi_1", "BTL DIGI time2 vs charge (R);ADC counts;TDC counts",
-					 128, 0., 1024.);
-  pb_e_eta_digi[0]  = btl.make<TProfile>("p_e_eta_digi_0", "BTL DIGI charge vs |#eta| (L);cell |#eta|;ADC counts",
-					 43, 0., 43.);
-  pb_e_eta_digi[1]  = btl.make<TProfile>("p_e_eta_digi_1", "BTL DIGI charge vs |#eta| (R);cell |#eta|;ADC counts",
-					 43, 0., 43.);
-  pb_t1_eta_digi[0] = btl.make<TProfile>("p_t1_eta_digi_0", "BTL DIGI time1 vs |#eta| (L);cell |#eta|;TDC counts",
-					 43, 0., 43.);
-  pb_t1_eta_digi[1] = btl.make<TProfile>("p_t1_eta_digi_1", "BTL DIGI time1 vs |#eta| (R);cell |#eta|;TDC counts",
-					 43, 0., 43.);
-  pb_t2_eta_digi[0] = btl.make<TProfile>("p_t2_eta_digi_0", "BTL DIGI time2 vs |#eta| (L);cell |#eta|;TDC counts",
-					 43, 0., 43.);
-  pb_t2_eta_digi[1] = btl.make<TProfile>("p_t2_eta_digi_1", "BTL DIGI time2 vs |#eta| (R);cell |#eta|;TDC counts",
-					 43, 0., 43.);
-  pb_e_phi_digi[0]  = btl.make<TProfile>("p_e_phi_digi_0", "BTL DIGI charge vs #phi (L);cell #phi;ADC counts",
-					 145, 0., 2305.);
-  pb_e_phi_digi[1]  = btl.make<TProfile>("p_e_phi_digi_1", "BTL DIGI charge vs #phi (R);cell #phi;ADC counts",
-					 145, 0., 2305.);
-  pb_t1_phi_digi[0] = btl.make<TProfile>("p_t1_phi_digi_0", "BTL DIGI time1 vs #phi (L);cell #phi;TDC counts",
-					 145, 0., 2305.);
-  pb_t1_phi_digi[1] = btl.make<TProfile>("p_t1_phi_digi_1", "BTL DIGI time1 vs #phi (R);cell #phi;TDC counts",
-					 145, 0., 2305.);
-  pb_t2_phi_digi[0] = btl.make<TProfile>("p_t2_phi_digi_0", "BTL DIGI time2 vs #phi (L);cell #phi;TDC counts",
-					 145, 0., 2305.);
-  pb_t2_phi_digi[1] = btl.make<TProfile>("p_t2_phi_digi_1", "BTL DIGI time2 vs #phi (R);cell #phi;TDC counts",
-					 145, 0., 2305.);
-
-
-  // --- Uncalibrated RECO
-
-  hb_n_ureco[0]  = btl.make<TH1F>("h_n_ureco_0", "Number of BTL URECO hits (L);N_{URECO hits}", 100, 0., 100.);
-  hb_n_ureco[1]  = btl.make<TH1F>("h_n_ureco_1", "Number of BTL URECO hits (R);N_{URECO hits}", 100, 0., 100.);
-  hb_occupancy_ureco[0] = btl.make<TH2F>("h_occupancy_ureco_0", "BTL URECO hits occupancy (L);cell #phi;cell #eta",
-					 145, 0., 2305., 86, -43., 43.);
-  hb_occupancy_ureco[1] = btl.make<TH2F>("h_occupancy_ureco_1", "BTL URECO hits occupancy (R);cell #phi;cell #eta",
-					 145, 0., 2305., 86, -43., 43.);
-  hb_t_ureco[0] = btl.make<TH1F>("h_t_ureco_0", "BTL URECO hits ToA (L);ToA [ns]", 250, 0., 25.);
-  hb_t_ureco[1] = btl.make<TH1F>("h_t_ureco_1", "BTL URECO hits ToA (R);ToA [ns]", 250, 0., 25.);
-  hb_t_ureco_uncorr[0] = btl.make<TH1F>("h_t_ureco_uncorr_0", "BTL URECO hits ToA (L);ToA [ns]", 250, 0., 25.);
-  hb_t_ureco_uncorr[1] = btl.make<TH1F>("h_t_ureco_uncorr_1", "BTL URECO hits ToA (R);ToA [ns]", 250, 0., 25.);
-  hb_e_ureco[0] = btl.make<TH1F>("h_e_ureco_0", "BTL URECO hits energy (L);Q [pC]", 300, 0., 600.);
-  hb_e_ureco[1] = btl.make<TH1F>("h_e_ureco_1", "BTL URECO hits energy (R);Q [pC]", 300, 0., 600.);
-
-  hb_t_amp_ureco[0] = btl.make<TH2F>("h_t_amp_ureco_0", "time vs amplitude (L);amplitude [pC];time [ns]",
-				     100, 0., 600., 400, 0., 20.);
-  hb_t_amp_ureco[1] = btl.make<TH2F>("h_t_amp_ureco_1", "time vs amplitude (R);amplitude [pC];time [ns]",
-				     100, 0., 600., 400, 0., 20.);
-  pb_t_amp_ureco[0] = btl.make<TProfile>("p_t_amp_ureco_0", "time vs amplitude (L);amplitude [pC];time [ns]",
-					 100, 0., 600.);
-  pb_t_amp_ureco[1] = btl.make<TProfile>("p_t_amp_ureco_1", "time vs amplitude (R);amplitude [pC];time [ns]",
-					 100, 0., 600.);
-
-
-  // --- RECO
-
-  hb_n_reco  = btl.make<TH1F>("h_n_reco", "Number of BTL RECO hits;N_{RECO hits}", 100, 0., 100.);
-  hb_occupancy_reco = btl.make<TH2F>("h_occupancy_reco", "BTL RECO hits occupancy;cell #phi;cell #eta",
-				     145, 0., 2305., 86, -43., 43.);
-  hb_t_reco  = btl.make<TH1F>("h_t_reco", "BTL RECO hits ToA;ToA [ns]", 250, 0., 25.);
-  hb_t_reco_uncorr = btl.make<TH1F>("h_t_reco_uncorr", "BTL RECO hits ToA;ToA [ns]", 250, 0., 25.);
-  hb_e_reco  = btl.make<TH1F>("h_e_reco", "BTL RECO hits energy;E [MeV]", 200, 0., 20.);
-
-  hb_t_res  = btl.make<TH1F>("h_t_res", "ToA resolution;ToA [ns]", 700, -2., 5.);
-  hb_t_res_uncorr = btl.make<TH1F>("h_t_res_uncorr", "ToA resolution;ToA [ns]", 700, -2., 5.);
-  hb_e_res  = btl.make<TH1F>("h_e_res", "Energy resolution;E [MeV]", 200, -1., 1.);
-
-  hb_t_reco_sim = btl.make<TH2F>("h_t_reco_sim", "ToA reco vs sim;SIM ToA [ns];BTL RECO ToA [ns]",
-				 100, -1., 25., 100, 0., 25.);
-  hb_e_reco_sim = btl.make<TH2F>("h_e_reco_sim", "E reco vs sim;SIM E [MeV];BTL RECO E [MeV]",
-				 100, 0., 20., 100, 0., 20.);
-
-
-  // ==============================================================================
-  //  ETL
-  // ==============================================================================
-
-  // --- SIM
-
-  he_n_sim_trk[0]  = etl.make<TH1F>("h_n_sim_trk_0", "Number of tracks per ETL cell (-Z);N_{trk}", 10, 0., 10.);
-  he_n_sim_trk[1]  = etl.make<TH1F>("h_n_sim_trk_1", "Number of tracks per ETL cell (+Z);N_{trk}", 10, 0., 10.);
-  he_n_sim_cell[0] = etl.make<TH1F>("h_n_sim_cell_0", "Number of ETL cells with SIM hits (-Z);N_{ETL cells}", 500, 0., 1000.);
-  he_n_sim_cell[1] = etl.make<TH1F>("h_n_sim_cell_1", "Number of ETL cells with SIM hits (+Z);N_{ETL cells}", 500, 0., 1000.);
-  he_t_sim[0]   = etl.make<TH1F>("h_t_sim_0", "ETL SIM hits ToA (-Z);ToA_{SIM} [ns]", 250, 0., 25.);
-  he_t_sim[1]   = etl.make<TH1F>("h_t_sim_1", "ETL SIM hits ToA (+Z);ToA_{SIM} [ns]", 250, 0., 25.);
-  he_e_sim[0]   = etl.make<TH1F>("h_e_sim_0", "ETL SIM hits energy (-Z);E_{SIM} [MIP]", 200, 0., 1.);
-  he_e_sim[1]   = etl.make<TH1F>("h_e_sim_1", "ETL SIM hits energy (+Z);E_{SIM} [MIP]", 200, 0., 1.);
-
-  he_xloc_sim[0] = etl.make<TH1F>("h_xloc_sim_0", "ETL SIM local x (-Z);x_{SIM} [mm]", 100, -25., 25.);
-  he_xloc_sim[1] = etl.make<TH1F>("h_xloc_sim_1", "ETL SIM local x (+Z);x_{SIM} [mm]", 100, -25., 25.);
-  he_yloc_sim[0] = etl.make<TH1F>("h_yloc_sim_0", "ETL SIM local y (-Z);y_{SIM} [mm]", 200, -50., 50.);
-  he_yloc_sim[1] = etl.make<TH1F>("h_yloc_sim_1", "ETL SIM local y (+Z);y_{SIM} [mm]", 200, -50., 50.);
-  he_zloc_sim[0] = etl.make<TH1F>("h_zloc_sim_0", "ETL SIM local z (-Z);z_{SIM} [mm]", 80, -0.2, 0.2);
-  he_zloc_sim[1] = etl.make<TH1F>("h_zloc_sim_1", "ETL SIM local z (+Z);z_{SIM} [mm]", 80, -0.2, 0.2);
-
-  he_occupancy_sim[0] = etl.make<TH2F>("h_occupancy_sim_0", "ETL SIM hits occupancy (-Z);x_{SIM} [cm];y_{SIM} [cm]",
-				       135, -135., 135.,  135, -135., 135.);
-  he_occupancy_sim[1] = etl.make<TH2F>("h_occupancy_sim_1", "ETL SIM hits occupancy (+Z);x_{SIM} [cm];y_{SIM} [cm]",
-				       135, -135., 135.,  135, -135., 135.);
-  he_x_sim[0] = etl.make<TH1F>("h_x_sim_0", "ETL SIM hits x (-Z);x_{SIM} [cm]", 135, -135., 135.);
-  he_x_sim[1] = etl.make<TH1F>("h_x_sim_1", "ETL SIM hits x (+Z);x_{SIM} [cm]", 135, -135., 135.);
-  he_y_sim[0] = etl.make<TH1F>("h_y_sim_0", "ETL SIM hits y (-Z);y_{SIM} [cm]", 135, -135., 135.);
-  he_y_sim[1] = etl.make<TH1F>("h_y_sim_1", "ETL SIM hits y (+Z);y_{SIM} [cm]", 135, -135., 135.);
-  he_z_sim[0] = etl.make<TH1F>("h_z_sim_0", "ETL SIM hits z (-Z);z_{SIM} [cm]", 100, -304.5, -303.);
-  he_z_sim[1] = etl.make<TH1F>("h_z_sim_1", "ETL SIM hits z (+Z);z_{SIM} [cm]", 100,  303., 304.5);
-  he_phi_sim[0] = etl.make<TH1F>("h_phi_sim_0", "ETL SIM hits #phi (-Z);#phi_{SIM} [rad]", 315, -3.15, 3.15);
-  he_phi_sim[1] = etl.make<TH1F>("h_phi_sim_1", "ETL SIM hits #phi (+Z);#phi_{SIM} [rad]", 315, -3.15, 3.15);
-  he_eta_sim[0] = etl.make<TH1F>("h_eta_sim_0", "ETL SIM hits #eta (-Z);#eta_{SIM}", 200, -3.05, -1.55);
-  he_eta_sim[1] = etl.make<TH1F>("h_eta_sim_1", "ETL SIM hits #eta (+Z);#eta_{SIM}", 200,  1.55, 3.05);
-
-  he_t_e_sim[0]   = etl.make<TH2F>("h_t_e_sim_0", "ETL SIM time vs energy (-Z);E_{SIM} [MIP];T_{SIM} [ns]",
-				   100, 0., 2., 100, 0., 25.);
-  he_t_e_sim[1]   = etl.make<TH2F>("h_t_e_sim_1", "ETL SIM time vs energy (+Z);E_{SIM} [MIP];T_{SIM} [ns]",
-				   100, 0., 2., 100, 0., 25.);
-  he_e_eta_sim[0] = etl.make<TH2F>("h_e_eta_sim_0", "ETL SIM energy vs #eta (-Z);#eta_{SIM};E_{SIM} [MIP]",
-				   100, -3.05, -1.55, 100, 0., 2.);
-  he_e_eta_sim[1] = etl.make<TH2F>("h_e_eta_sim_1", "ETL SIM energy vs #eta (+Z);#eta_{SIM};E_{SIM} [MIP]",
-				   100, 1.55, 3.05, 100, 0., 2.);
-  he_t_eta_sim[0] = etl.make<TH2F>("h_t_eta_sim_0", "ETL SIM time vs #eta (-Z);#eta_{SIM};T_{SIM} [ns]",
-				   100, -3.05, -1.55, 100, 0., 25.);
-  he_t_eta_sim[1] = etl.make<TH2F>("h_t_eta_sim_1", "ETL SIM time vs #eta (+Z);#eta_{SIM};T_{SIM} [ns]",
-				   100, 1.55, 3.05, 100, 0., 25.);
-  he_e_phi_sim[0] = etl.make<TH2F>("h_e_phi_sim_0", "ETL SIM energy vs #phi (-Z);#phi_{SIM} [rad];E_{SIM} [MIP]",
-				   100, -3.15, 3.15, 100, 0., 2.);
-  he_e_phi_sim[1] = etl.make<TH2F>("h_e_phi_sim_1", "ETL SIM energy vs #phi (+Z);#phi_{SIM} [rad];E_{SIM} [MIP]",
-				   100, -3.15, 3.15, 100, 0., 2.);
-  he_t_phi_sim[0] = etl.make<TH2F>("h_t_phi_sim_0", "ETL SIM time vs #phi (-Z);#phi_{SIM} [rad];T_{SIM} [ns]",
-				   100, -3.15, 3.15, 100, 0., 25.);
-  he_t_phi_sim[1] = etl.make<TH2F>("h_t_phi_sim_1", "ETL SIM time vs #phi (+Z);#phi_{SIM} [rad];T_{SIM} [ns]",
-				   100, -3.15, 3.15, 100, 0., 25.);
-  pe_t_e_sim[0]   = etl.make<TProfile>("p_t_e_sim_0", "ETL SIM time vs energy (-Z);E_{SIM} [MIP];T_{SIM} [ns]",
-				       100, 0., 2.);
-  pe_t_e_sim[1]   = etl.make<TProfile>("p_t_e_sim_1", "ETL SIM time vs energy (+Z);E_{SIM} [MIP];T_{SIM} [ns]",
-				       100, 0., 2.);
-  pe_e_eta_sim[0] = etl.make<TProfile>("p_e_eta_sim_0", "ETL SIM energy vs #eta (-Z);#eta_{SIM};E_{SIM} [MIP]",
-				       100, -3.05, -1.55);
-  pe_e_eta_sim[1] = etl.make<TProfile>("p_e_eta_sim_1", "ETL SIM energy vs #eta (+Z);#eta_{SIM};E_{SIM} [MIP]",
-				       100, 1.55, 3.05);
-  pe_t_eta_sim[0] = etl.make<TProfile>("p_t_eta_sim_0", "ETL SIM time vs #eta (-Z);#eta_{SIM};T_{SIM} [ns]",
-				       100, -3.05, -1.55);
-  pe_t_eta_sim[1] = etl.make<TProfile>("p_t_eta_sim_0", "ETL SIM time vs #eta (+Z);#eta_{SIM};T_{SIM} [ns]",
-				       100, 1.55, 3.05);
-  pe_e_phi_sim[0] = etl.make<TProfile>("p_e_phi_sim_0", "ETL SIM energy vs #phi (-Z);#phi_{SIM} [rad];E_{SIM} [MIP]",
-				       100, -3.15, 3.15);
-  pe_e_phi_sim[1] = etl.make<TProfile>("p_e_phi_sim_1", "ETL SIM energy vs #phi (+Z);#phi_{SIM} [rad];E_{SIM} [MIP]",
-				       100, -3.15, 3.15);
-  pe_t_phi_sim[0] = etl.make<TProfile>("p_t_phi_sim_0", "ETL SIM time vs #phi (-Z);#phi_{SIM} [rad];T_{SIM} [ns]",
-				       100, -3.15, 3.15);
-  pe_t_phi_sim[1] = etl.make<TProfile>("p_t_phi_sim_1", "ETL SIM time vs #phi (+Z);#phi_{SIM} [rad];T_{SIM} [ns]",
-				       100, -3.15, 3.15);
-
-
-
-  // --- DIGI
-
-  he_n_digi[0]  = etl.make<TH1F>("h_n_digi_0", "Number of ETL DIGI hits (-Z);N_{DIGI hits}", 100, 0., 100.);
-  he_n_digi[1]  = etl.make<TH1F>("h_n_digi_1", "Number of ETL DIGI hits (+Z);N_{DIGI hits}", 100, 0., 100.);
-
-  he_t_digi[0]  = etl.make<TH1F>("h_t_digi_0", "ETL DIGI hits ToA (-Z);ToA [TDC counts]", 1000, 0., 2000.);
-  he_t_digi[1]  = etl.make<TH1F>("h_t_digi_1", "ETL DIGI hits ToA (+Z);ToA [TDC counts]", 1000, 0., 2000.);
-  he_e_digi[0]  = etl.make<TH1F>("h_e_digi_0", "ETL DIGI hits energy (-Z);amplitude [ADC counts]", 256, 0., 256.);
-  he_e_digi[1]  = etl.make<TH1F>("h_e_digi_1", "ETL DIGI hits energy (+Z);amplitude [ADC counts]", 256, 0., 256.);
-
-  he_occupancy_digi[0] = etl.make<TH2F>("h_occupancy_digi_0", "ETL DIGI hits occupancy (-Z);x [cm];y [cm]",
-					135, -135., 135.,  135, -135., 135.);
-  he_occupancy_digi[1] = etl.make<TH2F>("h_occupancy_digi_1", "ETL DIGI hits occupancy (+Z);x [cm];y [cm]",
-					135, -135., 135.,  135, -135., 135.);
-
-  he_x_digi[0] = etl.make<TH1F>("h_x_digi_0", "ETL DIGI hits x (-Z);x [cm]", 135, -135., 135.);
-  he_x_digi[1] = etl.make<TH1F>("h_x_digi_1", "ETL DIGI hits x (+Z);x [cm]", 135, -135., 135.);
-  he_y_digi[0] = etl.make<TH1F>("h_y_digi_0", "ETL DIGI hits y (-Z);y [cm]", 135, -135., 135.);
-  he_y_digi[1] = etl.make<TH1F>("h_y_digi_1", "ETL DIGI hits y (+Z);y [cm]", 135, -135., 135.);
-  he_phi_digi[0] = etl.make<TH1F>("h_phi_digi_0", "ETL DIGI hits #phi (-Z);#phi [rad]", 315, -3.15, 3.15);
-  he_phi_digi[1] = etl.make<TH1F>("h_phi_digi_1", "ETL DIGI hits #phi (+Z);#phi [rad]", 315, -3.15, 3.15);
-  he_eta_digi[0] = etl.make<TH1F>("h_eta_digi_0", "ETL DIGI hits #eta (-Z);#eta", 200, -3.05, -1.55);
-  he_eta_digi[1] = etl.make<TH1F>("h_eta_digi_1", "ETL DIGI hits #eta (+Z);#eta", 200,  1.55, 3.05);
-
-  he_t_e_digi[0]   = etl.make<TH2F>("h_t_e_digi_0", "ETL DIGI time vs energy (-Z);ADC counts;TDC counts",
-				    256, 0., 256., 500, 0., 2000.);
-  he_t_e_digi[1]   = etl.make<TH2F>("h_t_e_digi_1", "ETL DIGI time vs energy (+Z);ADC counts;TDC counts",
-				    256, 0., 256., 500, 0., 2000.);
-  he_e_eta_digi[0] = etl.make<TH2F>("h_e_eta_digi_0", "ETL DIGI energy vs #eta (-Z);#eta;ADC counts",
-				    100, -3.05, -1.55, 256, 0., 256.);
-  he_e_eta_digi[1] = etl.make<TH2F>("h_e_eta_digi_1", "ETL DIGI energy vs #eta (+Z);#eta;ADC counts",
-				    100, 1.55, 3.05, 256, 0., 256.);
-  he_t_eta_digi[0] = etl.make<TH2F>("h_t_eta_digi_0", "ETL DIGI time vs #eta (-Z);#eta;TDC counts",
-				    100, -3.05, -1.55, 500, 0., 2000.);
-  he_t_eta_digi[1] = etl.make<TH2F>("h_t_eta_digi_1", "ETL DIGI time vs #eta (+Z);#eta;TDC counts",
-				   100, 1.55, 3.05, 500, 0., 2000.);
-  he_e_phi_digi[0] = etl.make<TH2F>("h_e_phi_digi_0", "ETL DIGI energy vs #phi (-Z);#phi [rad];ADC counts",
-				   100, -3.15, 3.15, 256, 0., 256.);
-  he_e_phi_digi[1] = etl.make<TH2F>("h_e_phi_digi_1", "ETL DIGI energy vs #phi (+Z);#phi [rad];ADC counts",
-				   100, -3.15, 3.15, 256, 0., 256.);
-  he_t_phi_digi[0] = etl.make<TH2F>("h_t_phi_digi_0", "ETL DIGI time vs #phi (-Z);#phi [rad];TDC counts",
-				   100, -3.15, 3.15, 500, 0., 2000.);
-  he_t_phi_digi[1] = etl.make<TH2F>("h_t_phi_digi_1", "ETL DIGI time vs #phi (+Z);#phi [rad];TDC counts",
-				   100, -3.15, 3.15, 500, 0., 2000.);
-  pe_t_e_digi[0]   = etl.make<TProfile>("p_t_e_digi_0", "ETL DIGI time vs energy (-Z);ADC counts;TDC counts",
-					256, 0., 256.);
-  pe_t_e_digi[1]   = etl.make<TProfile>("p_t_e_digi_1", "ETL DIGI time vs energy (+Z);ADC counts;TDC counts",
-					256, 0., 256.);
-  pe_e_eta_digi[0] = etl.make<TProfile>("p_e_eta_digi_0", "ETL DIGI energy vs #eta (-Z);#eta;ADC counts",
-					100, -3.05, -1.55);
-  pe_e_eta_digi[1] = etl.make<TProfile>("p_e_eta_digi_1", "ETL DIGI energy vs #eta (+Z);#eta;ADC counts",
-					100, 1.55, 3.05);
-  pe_t_eta_digi[0] = etl.make<TProfile>("p_t_eta_digi_0", "ETL DIGI time vs #eta (-Z);#eta;TDC counts",
-					100, -3.05, -1.55);
-  pe_t_eta_digi[1] = etl.make<TProfile>("p_t_eta_digi_1", "ETL DIGI time vs #eta (+Z);#eta;TDC counts",
-					100, 1.55, 3.05);
-  pe_e_phi_digi[0] = etl.make<TProfile>("p_e_phi_digi_0", "ETL DIGI energy vs #phi (-Z);#phi [rad];ADC counts",
-					100, -3.15, 3.15);
-  pe_e_phi_digi[1] = etl.make<TProfile>("p_e_phi_digi_1", "ETL DIGI energy vs #phi (+Z);#phi [rad];ADC counts",
-					100, -3.15, 3.15);
-  pe_t_phi_digi[0] = etl.make<TProfile>("p_t_phi_digi_0", "ETL DIGI time vs #phi (-Z);#phi [rad];TDC counts",
-					100, -3.15, 3.15);
-  pe_t_phi_digi[1] = etl.make<TProfile>("p_t_phi_digi_1", "ETL DIGI time vs #phi (+Z);#phi [rad];TDC counts",
-					100, -3.15, 3.15);
-
-
-  // --- Uncalibrated RECO
-
-  he_n_ureco[0]  = etl.make<TH1F>("h_n_ureco_0", "Number of ETL URECO hits (-Z);N_{URECO hits}", 100, 0., 100.);
-  he_n_ureco[1]  = etl.make<TH1F>("h_n_ureco_1", "Number of ETL URECO hits (+Z);N_{URECO hits}", 100, 0., 100.);
-
-
-  // --- RECO
-
-  he_n_reco[0]  = etl.make<TH1F>("h_n_reco_0", "Number of ETL RECO hits (-Z);N_{RECO hits}", 100, 0., 100.);
-  he_n_reco[1]  = etl.make<TH1F>("h_n_reco_1", "Number of ETL RECO hits (+Z);N_{RECO hits}", 100, 0., 100.);
+  if ( !resolutionFile_.empty() ) {
+    const auto range = iConfig.getParameter<std::vector<double> >("ResolutionAmplitudeRange");
+    if ( range.size() != 2 )
+      throw cms::Exception("Configuration") << "ResolutionAmplitudeRange must be [min, max] in pC";
+    resolutionBinning_.nEta = iConfig.getParameter<unsigned int>("ResolutionEtaBins");
+    resolutionBinning_.nPhi = iConfig.getParameter<unsigned int>("ResolutionPhiBins");
+    resolutionBinning_.nAmplitude = iConfig.getParameter<unsigned int>("ResolutionAmplitudeBins");
+    resolutionBinning_.minAmplitude = range[0];
+    resolutionBinning_.maxAmplitude = range[1];
+    resolution_ = std::make_unique<MTDResolution>(resolutionBinning_);
+  }
 
+  edm::LogInfo("MTDAnalyzer") << "Booked " << histos_.size() << " of " << histos_.nDefs() << " histograms, "
+			      << histos_.bytes()/1024 << " kB per stream and for the job";
 
+  if ( intraEventTasks_ ) {
+    MTDHistoRegistry partial;
+    partial.book(mtdHistoDefs, mtdNHistoDefs, btlHitGroups_);
+    edm::LogInfo("MTDAnalyzer") << "Intra-event tasks: BTL and ETL -Z/+Z filled concurrently, the BTL hits in "
+				<< btlFillChunks_ << " chunks, " << (btlFillChunks_-1)*partial.bytes()/1024
+				<< " kB more per stream";
+  }
 
+  if ( associator_ && associator_->bxWindow().size() > 1 )
+    edm::LogInfo("MTDAnalyzer") << "Out-of-time pileup: SIM hits and ETL DIGI samples of BX "
+				<< associator_->bxWindow().first << " to " << associator_->bxWindow().last;
+  else if ( !associator_ )
+    edm::LogInfo("MTDAnalyzer") << "Joined MTD hits read from " << associationTag.encode();
 
 }
 
@@ -670,342 +403,191 @@ MTDAnalyzer::~MTDAnalyzer() {}
 // member functions
 //
 
-void
-MTDAnalyzer::analyze(const edm::Event& iEvent, const edm::EventSetup& iSetup) {
+std::unique_ptr<MTDStreamCache>
+MTDAnalyzer::beginStream(edm::StreamID) const {
 
-  using namespace std;
+  auto cache = std::make_unique<MTDStreamCache>();
+  (cache->histos).book(mtdHistoDefs, mtdNHistoDefs, histoGroups_, histoFlushSize_);
 
-  edm::ESHandle<MTDGeometry> geom;
-  if( geom_ == nullptr ) {
-    iSetup.get<MTDDigiGeometryRecord>().get(geom);
-    geom_ = geom.product();
+  if ( intraEventTasks_ ) {
+    cache->btlPartials.resize(btlFillChunks_-1);
+    for (auto& partial: cache->btlPartials)
+      partial.book(mtdHistoDefs, mtdNHistoDefs, btlHitGroups_, histoFlushSize_);
   }
 
-  edm::Handle<edm::PSimHitContainer>  h_BTL_sim;
-  iEvent.getByToken( tok_BTL_sim, h_BTL_sim );
-  edm::Handle<edm::PSimHitContainer>  h_ETL_sim;
-  iEvent.getByToken( tok_ETL_sim, h_ETL_sim );
-
-  edm::Handle<BTLDigiCollection>   h_BTL_digi;
-  iEvent.getByToken( tok_BTL_digi, h_BTL_digi );
-  edm::Handle<ETLDigiCollection>   h_ETL_digi;
-  iEvent.getByToken( tok_ETL_digi, h_ETL_digi );
-
-  edm::Handle<FTLUncalibratedRecHitCollection> h_BTL_ureco;
-  iEvent.getByToken( tok_BTL_ureco, h_BTL_ureco );
-  edm::Handle<FTLUncalibratedRecHitCollection> h_ETL_ureco;
-  iEvent.getByToken( tok_ETL_ureco, h_ETL_ureco );
-
-  edm::Handle<FTLRecHitCollection> h_BTL_reco;
-  iEvent.getByToken( tok_BTL_reco, h_BTL_reco );
-  edm::Handle<FTLRecHitCollection> h_ETL_reco;
-  iEvent.getByToken( tok_ETL_reco, h_ETL_reco );
-
-
-  ///////////////////////////////////////////////////////////////////////////////////////////////
-  //
-  //  Get MTD hits
-  //
-  ///////////////////////////////////////////////////////////////////////////////////////////////
+  if ( btlCalibration_ ) {
+    cache->btlCalibration = MTDCalibration(2, calibrationBinning_);
+    cache->etlCalibration = MTDCalibration(1, calibrationBinning_);
+  }
 
-  // ==============================================================================
-  //  SIM hits
-  // ==============================================================================
+  if ( resolution_ )
+    cache->resolution = MTDResolution(resolutionBinning_);
 
-  // --- BTL
+  if ( btlModules_.enabled() )
+    cache->btlModules.book(mtdModuleHistoDefs, mtdNModuleHistoDefs, "BTLModule", btlModuleDir, histoFlushSize_);
+  if ( etlModules_.enabled() )
+    cache->etlModules.book(mtdModuleHistoDefs, mtdNModuleHistoDefs, "ETLModule", etlRingDir, histoFlushSize_);
 
-  std::set<uint32_t> unique_simHit;
+#ifdef MTD_INSTRUMENTATION
+  cache->join.stats = &cache->stats;
+#endif
 
-  if ( h_BTL_sim->size() > 0 ) {
-  
-    std::vector< std::tuple<PSimHit,uint32_t,float> > hitRefs;
-    hitRefs.reserve(h_BTL_sim->size());
+  return cache;
 
-    // Sort the SimHits per detector id and time 
-    for (auto const& simHit: *h_BTL_sim) {
+}
 
-      // Consider only the in-time BX
-      if ( simHit.tof()<0. ||  simHit.tof()>25. ) continue;
 
-      DetId id = simHit.detUnitId();
-      if (id.rawId() != 0)
-	hitRefs.emplace_back( simHit, id.rawId(), simHit.tof() );
+// Geometry lookup tables, only to join the hits here, checked against the
+// channel maps once per geometry.
+std::shared_ptr<MTDGeometryCache>
+MTDAnalyzer::globalBeginLuminosityBlock(const edm::LuminosityBlock&, const edm::EventSetup& iSetup) const {
 
-    } // simHit loop 
-    std::sort(hitRefs.begin(),hitRefs.end(), orderByDetIdThenTime);
-    
-    // Accumulate the SimHits in the same detector cell
-    for (auto const& hitRef: hitRefs) {
-    
-      const PSimHit &hit = std::get<0>(hitRef);
-      DetId id = hit.detUnitId();
+  if ( !associator_ ) return nullptr;
 
-      unique_simHit.insert(id.rawId());
+  std::shared_ptr<MTDGeometryCache> geoCache = associator_->geometry(iSetup);
 
-      auto simHitIt = btl_hits.emplace(id.rawId(),MTDinfo()).first;
+  std::lock_guard<std::mutex> guard(mergeMutex_);
+  if ( geoCache != checkedGeometry_ ) {
+    checkChannelMaps(*geoCache, histoGroups_);
+    checkedGeometry_ = geoCache;
+  }
 
-      if ( hit.tof() < btlIntegrationWindow_ ) // This is to emulate the time integration
-	                                       // window in the readout electronics.
-	(simHitIt->second).sim_energy += 1000.*hit.energyLoss();
+  return geoCache;
 
-      n_btl_simHits[id.rawId()].insert(hit.trackId());
+}
 
-      // Get the time of the first SimHit in the cell
-      if( (simHitIt->second).sim_time==0 ) {
 
-	//auto hit_pos = hit.localPosition();
-	auto hit_pos = hit.entryPoint();
+void
+MTDAnalyzer::globalEndLuminosityBlock(const edm::LuminosityBlock&, const edm::EventSetup&) const {
+}
 
-	(simHitIt->second).sim_x = hit_pos.x();
-	(simHitIt->second).sim_y = hit_pos.y();
-	(simHitIt->second).sim_z = hit_pos.z();
 
-	(simHitIt->second).sim_time = hit.tof();
+void
+MTDAnalyzer::analyze(edm::StreamID streamID, const edm::Event& iEvent, const edm::EventSetup& iSetup) const {
 
-      }
+  using namespace std;
 
+  MTDStreamCache& cache = *streamCache(streamID);
+  MTDHistoRegistry& h = cache.histos;
 
-    } // hitRef loop
+  MTD_EVENT(cache.stats);
+#ifdef MTD_INSTRUMENTATION
+  const auto capacity = cache.capacities();
+#endif
 
-  } // if ( h_BTL_sim->size() > 0 )
+  ///////////////////////////////////////////////////////////////////////////////////////////////
+  //
+  //  Get MTD hits
+  //
+  ///////////////////////////////////////////////////////////////////////////////////////////////
 
+  // The records of all the cells, joined here (see MTDHitAssociator) or
+  // read from the MTDHitAssociationProducer product. Here, the BX slots
+  // and the window energies are accumulated for their histograms only, and
+  // the SIM hit and ETL hit positions are transformed only when some
+  // output uses them: the hit cache needs all of them, the ntuple and the
+  // resolution regions the ETL hit ones, the histograms only those of the
+  // BTL hits above the energy threshold at their active fill points.
 
-  // --- ETL
+  const MTDHitAssociation* association = &cache.association;
 
-  std::set<uint32_t> unique_etl_simHit[2];
+  if ( associator_ ) {
 
-  if ( h_ETL_sim->size() > 0 ) {
+    MTDHitAssociator::Outputs outputs;
 
-    std::vector< std::tuple<PSimHit,uint32_t,float> > hitRefs;
-    hitRefs.reserve(h_ETL_sim->size());
+    outputs.btlBX      = h.active(kBTLSimBX);
+    outputs.etlBX      = h.active(kETLSimBX) || h.active(kETLDigiBX);
+    outputs.btlWindows = h.active(kBTLSimWindow) || h.active(kBTLRecoSimWindow);
+    outputs.etlWindows = h.active(kETLSimWindow) || h.active(kETLRecoSimWindow);
 
-    // Sort the SimHits per detector id and time
-    for (auto const& simHit: *h_ETL_sim) {
+    outputs.btlSimPositions = hitCache_ || h.active(kBTLSimHit);
+    outputs.btlSimMinEnergy = hitCache_ ? -std::numeric_limits<float>::max() : btlMinEnergy_;
+    outputs.etlSimPositions = hitCache_ || h.active(kETLSimHit);
+    outputs.etlPositions    = hitCache_ || ntuple_ || resolution_ || h.active(kETLDigiHit);
 
-      if ( simHit.tof()<0. ||  simHit.tof()>25. ) continue;
+    const MTDGeometryCache& geoCache = *luminosityBlockCache(iEvent.getLuminosityBlock().index());
+    associator_->associate(iEvent, geoCache, outputs, cache.join, cache.association);
 
-      DetId id = simHit.detUnitId();
-      if (id.rawId() != 0)
-	hitRefs.emplace_back( simHit, id.rawId(), simHit.tof() );
+    // module directories sized for all the modules of the geometry, before
+    // the first one is booked
+    if ( cache.btlModules.enabled() && cache.btlModules.size() == 0 )
+      cache.btlModules.reserve(geoCache.cells().nBTLModules());
+    if ( cache.etlModules.enabled() && cache.etlModules.size() == 0 )
+      cache.etlModules.reserve(geoCache.cells().nETLRings());
 
-    } // simHit loop
-    std::sort(hitRefs.begin(),hitRefs.end(), orderByDetIdThenTime);
+  }
+  else {
 
-    // Accumulate the SimHits in the same detector cell
-    for (auto const& hitRef: hitRefs) {
+    edm::Handle<MTDHitAssociation> handle;
+    iEvent.getByToken(tok_association, handle);
+    association = handle.product();
 
-      const PSimHit &hit = std::get<0>(hitRef);
-      ETLDetId id = hit.detUnitId();
+  }
 
-      int idet = (id.zside()+1)/2;
+  MTD_COUNT(cache.stats, kCountStoreGrowth, cache.grown(capacity));
 
-      unique_etl_simHit[idet].insert(id.rawId());
+  const MTDEventView event = association->view();
 
-      auto simHitIt = etl_hits[idet].emplace(id.rawId(),MTDinfo()).first;
+  const auto& btl_hits = association->btl_hits;
+  const auto& etl_hits = association->etl_hits;
+  const auto& btl_pos = association->btl_pos;
+  const auto& etl_pos = association->etl_pos;
 
-      (simHitIt->second).sim_energy += 1000.*hit.energyLoss();
 
-      n_etl_simHits[idet][id.rawId()].insert(hit.trackId());
+  ///////////////////////////////////////////////////////////////////////////////////////////////
+  //
+  //  Ntuple and hit cache filling
+  //
+  ///////////////////////////////////////////////////////////////////////////////////////////////
 
-      // Get the time of the first SimHit in the cell
-      if( (simHitIt->second).sim_time==0 ) {
+  if ( ntuple_ ) {
 
-	(simHitIt->second).sim_time = hit.tof();
+    MTD_STAGE(cache.stats, kStageNtuple);
 
-	//auto hit_pos = hit.localPosition();
-	auto hit_pos = hit.entryPoint();
+    auto& columns = cache.ntupleColumns;
+    columns.clear();
 
-	(simHitIt->second).sim_x = hit_pos.x();
-	(simHitIt->second).sim_y = hit_pos.y();
-	(simHitIt->second).sim_z = hit_pos.z();
+    for (size_t ih=0; ih<btl_hits.size(); ++ih) {
+      const MTDHitPosition& pos = btl_pos[ih];
+      columns.push_back(MTDNtuple::kBTL, pos.z > 0., btl_hits[ih], pos.x, pos.y, pos.z);
+    }
 
+    for (int idet=0; idet<2; ++idet){
+      for (size_t ih=0; ih<etl_hits[idet].size(); ++ih) {
+	const MTDHitPosition& pos = etl_pos[idet][ih];
+	columns.push_back(MTDNtuple::kETL, idet, etl_hits[idet][ih], pos.x, pos.y, pos.z);
       }
+    }
 
-    } // hitRef loop
-
-  } // if ( h_ETL_sim->size() > 0 )
-
-
-  // ==============================================================================
-  //  DIGI hits
-  // ==============================================================================
-
-  // --- BTL
-
-  unsigned int n_digi_btl[2] = {0,0};
-
-  if ( h_BTL_digi->size() > 0 ) {
-
-    for (const auto& dataFrame: *h_BTL_digi) {
-
-      DetId id =  dataFrame.id();
-      
-      const auto& sample_L = dataFrame.sample(0);
-      const auto& sample_R = dataFrame.sample(1);
-
-      btl_hits[id.rawId()].digi_row[0] = sample_L.row();
-      btl_hits[id.rawId()].digi_row[1] = sample_R.row();
-      btl_hits[id.rawId()].digi_col[0] = sample_L.column();
-      btl_hits[id.rawId()].digi_col[1] = sample_R.column();
-
-      btl_hits[id.rawId()].digi_charge[0] = sample_L.data();
-      btl_hits[id.rawId()].digi_charge[1] = sample_R.data();
-      btl_hits[id.rawId()].digi_time1[0]  = sample_L.toa();
-      btl_hits[id.rawId()].digi_time1[1]  = sample_R.toa();
-      btl_hits[id.rawId()].digi_time2[0]  = sample_L.toa2();
-      btl_hits[id.rawId()].digi_time2[1]  = sample_R.toa2();
-
-      if ( sample_L.data() > 0 )
-	n_digi_btl[0]++;
-
-      if ( sample_R.data() > 0 )
-	n_digi_btl[1]++;
-
-    } // dataFrame loop
-
-  } // if ( h_BTL_digi->size() > 0 )
-
-
-  // --- ETL
-
-  unsigned int n_digi_etl[2] = {0,0};
-
-  if ( h_ETL_digi->size() > 0 ) {
-
-    for (const auto& dataFrame: *h_ETL_digi) {
-
-      ETLDetId id =  dataFrame.id();
-      int idet = (id.zside()+1)/2;
-
-      // --- loop over the dataFrame samples
-      for (int isample = 0; isample<dataFrame.size(); ++isample){
-
-	const auto& sample = dataFrame.sample(isample);
-
-	if ( sample.data()!=0 && sample.toa()!=0 ) {
-
-	  // on-time sample
-	  if ( isample == 2 ) {
-
-	    etl_hits[idet][id.rawId()].digi_row[0] = sample.row();
-	    etl_hits[idet][id.rawId()].digi_col[0] = sample.column();
-
-	    etl_hits[idet][id.rawId()].digi_charge[0] = sample.data();
-	    etl_hits[idet][id.rawId()].digi_time1[0]  = sample.toa();
-
-	    n_digi_etl[idet]++;
-
-	  }
-
-	}
-
-      } // isaple loop
-
-    } // dataFrame loop
-
-  } // if ( h_ETL_digi->size() > 0 )
-
-
-  // ==============================================================================
-  //  Uncalibrated RECO hits
-  // ==============================================================================
-
-  // --- BTL
-
-  unsigned int n_ureco_btl[2] = {0,0};
-
-  if ( h_BTL_ureco->size() > 0 ) {
-
-    for (const auto& urecHit: *h_BTL_ureco) {
-
-      DetId id = urecHit.id();
-
-      btl_hits[id.rawId()].ureco_charge[0] = urecHit.amplitude().first;
-      btl_hits[id.rawId()].ureco_charge[1] = urecHit.amplitude().second;
-      btl_hits[id.rawId()].ureco_time[0]   = urecHit.time().first;
-      btl_hits[id.rawId()].ureco_time[1]   = urecHit.time().second;
-
-      if ( urecHit.amplitude().first > 0. )
-	n_ureco_btl[0]++;
-
-      if ( urecHit.amplitude().second > 0. )
-	n_ureco_btl[1]++;
-
-    } // recHit loop
-
-  } // if ( h_BTL_reco->size() > 0 )
-
-
-  // --- ETL
-
-  unsigned int n_ureco_etl[2] = {0,0};
-
-  if ( h_ETL_ureco->size() > 0 ) {
-
-    for (const auto& urecHit: *h_ETL_ureco) {
-
-      ETLDetId id = urecHit.id();
-      int idet = (id.zside()+1)/2;
-
-      etl_hits[idet][id.rawId()].ureco_charge[0] = urecHit.amplitude().first;
-      etl_hits[idet][id.rawId()].ureco_time[0]   = urecHit.time().first;
-
-      if ( urecHit.amplitude().first > 0. )
-	n_ureco_etl[idet]++;
-      
-
-    } // recHit loop
-
-  } // if ( h_ETL_ureco->size() > 0 )
-
-
-  // ==============================================================================
-  //  RECO hits
-  // ==============================================================================
-
-  // --- BTL
-
-  unsigned int n_reco_btl = 0;
-
-  if ( h_BTL_reco->size() > 0 ) {
-
-    for (const auto& recHit: *h_BTL_reco) {
-
-      DetId id = recHit.id();
-
-      btl_hits[id.rawId()].reco_energy = recHit.energy();
-      btl_hits[id.rawId()].reco_time   = recHit.time();
-
-      if ( recHit.energy() > 0. )
-	n_reco_btl++;
-
-
-    } // recHit loop
-
-  } // if ( h_BTL_reco->size() > 0 )
-
-
-  // --- ETL
-
-  unsigned int n_reco_etl[2] = {0,0};
-
-  if ( h_ETL_reco->size() > 0 ) {
-
-    for (const auto& recHit: *h_ETL_reco) {
+    ntuple_->fill(iEvent.id(), columns);
 
-      ETLDetId id = recHit.id();
-      int idet = (id.zside()+1)/2;
+  }
 
-      etl_hits[idet][id.rawId()].reco_energy = recHit.energy();
-      etl_hits[idet][id.rawId()].reco_time   = recHit.time();
+  if ( hitCache_ ) {
+    MTD_STAGE(cache.stats, kStageHitCache);
+    hitCache_->add(cache.hitCacheChunk, iEvent.id().run(), iEvent.id().luminosityBlock(), iEvent.id().event(), event);
+  }
 
-      if ( recHit.energy() > 0. )
-	n_reco_etl[idet]++;
+  if ( btlCalibration_ ) {
+    MTD_STAGE(cache.stats, kStageCalibration);
+    mtdFillCalibration(cache.btlCalibration, cache.etlCalibration, event, btlMinEnergy_, btlTimeWalk_,
+		       cache.calibrationScratch);
+  }
 
+  if ( resolution_ ) {
+    MTD_STAGE(cache.stats, kStageResolution);
+    mtdFillResolution(cache.resolution, event, btlMinEnergy_, btlTimeWalk_, cache.resolutionScratch);
+  }
 
-    } // recHit loop
+  if ( cache.btlModules.enabled() || cache.etlModules.enabled() ) {
+    MTD_STAGE(cache.stats, kStageModules);
+    if ( cache.btlModules.enabled() ) mtdFillBTLModuleHistos(cache.btlModules, event, btlMinEnergy_, btlModuleKey);
+    if ( cache.etlModules.enabled() ) mtdFillETLModuleHistos(cache.etlModules, event, etlRingKey);
+  }
 
-  } // if ( h_ETL_reco->size() > 0 )
+  // Pure ntuple, hit cache, calibration, resolution or module histograms
+  // extraction
+  if ( h.size() == 0 ) return;
 
 
   ///////////////////////////////////////////////////////////////////////////////////////////////
@@ -1014,312 +596,214 @@ MTDAnalyzer::analyze(const edm::Event& iEvent, const edm::EventSetup& iSetup) {
   //
   ///////////////////////////////////////////////////////////////////////////////////////////////
 
+  MTD_STAGE(cache.stats, kStageFill);
 
-  // ==============================================================================
-  //  BTL
-  // ==============================================================================
-
-  for (auto const& hit: n_btl_simHits) {
-    hb_n_sim_trk->Fill((hit.second).size());
+  if ( !intraEventTasks_ ) {
+    mtdFillHistos(h, event, btlMinEnergy_, btlTimeWalk_, cache.btlTimeWalk);
+    return;
   }
-  hb_n_sim_cell->Fill(unique_simHit.size());
-  for (int iside=0; iside<2; ++iside){
-    hb_n_digi[iside]->Fill(n_digi_btl[iside]);
-    hb_n_ureco[iside]->Fill(n_ureco_btl[iside]);
-  }
-  hb_n_reco->Fill(n_reco_btl);
-
-  for (auto const& hit: btl_hits) {
-
-    BTLDetId detId(hit.first); 
-
-    DetId geoId = BTLDetId(detId.mtdSide(),detId.mtdRR(),detId.module()+14*(detId.modType()-1),0,1);
-    const MTDGeomDet* thedet = geom_->idToDet(geoId);
-    const ProxyMTDTopology& topoproxy = static_cast<const ProxyMTDTopology&>(thedet->topology());
-    const RectangularMTDTopology& topo = static_cast<const RectangularMTDTopology&>(topoproxy.specificTopology());
-
-    if ( (hit.second).reco_energy < btlMinEnergy_ ) continue;
-    
-
-    // --- SIM
-
-    if ( (hit.second).sim_time != 0. ) {
-
-      hb_e_sim->Fill((hit.second).sim_energy);
-      hb_t_sim->Fill((hit.second).sim_time);
-
-      hb_xloc_sim->Fill((hit.second).sim_x);
-      hb_yloc_sim->Fill((hit.second).sim_y);
-      hb_zloc_sim->Fill((hit.second).sim_z);
-
-
-      // Get the SIM hit global position
-      Local3DPoint simscaled(0.1*(hit.second).sim_x,0.1*(hit.second).sim_y,0.1*(hit.second).sim_z);
-      simscaled = topo.pixelToModuleLocalPoint(simscaled,detId.row(topo.nrows()),detId.column(topo.nrows()));
-      const auto& global_pos = thedet->toGlobal(simscaled);
-
-      hb_occupancy_sim->Fill(global_pos.z(),global_pos.phi());
-      hb_phi_sim->Fill(global_pos.phi());
-      hb_eta_sim->Fill(global_pos.eta());
-      hb_z_sim->Fill(global_pos.z());
-
-      hb_t_e_sim->Fill((hit.second).sim_energy,(hit.second).sim_time);
-      hb_e_eta_sim->Fill(fabs(global_pos.eta()),(hit.second).sim_energy);
-      hb_t_eta_sim->Fill(fabs(global_pos.eta()),(hit.second).sim_time);
-      hb_e_phi_sim->Fill(global_pos.phi(),(hit.second).sim_energy);
-      hb_t_phi_sim->Fill(global_pos.phi(),(hit.second).sim_time);
-
-      pb_t_e_sim->Fill((hit.second).sim_energy,(hit.second).sim_time);
-      pb_e_eta_sim->Fill(fabs(global_pos.eta()),(hit.second).sim_energy);
-      pb_t_eta_sim->Fill(fabs(global_pos.eta()),(hit.second).sim_time);
-      pb_e_phi_sim->Fill(global_pos.phi(),(hit.second).sim_energy);
-      pb_t_phi_sim->Fill(global_pos.phi(),(hit.second).sim_time);
-
-    }
-
-
-    int hit_iphi = detId.iphi(BTLDetId::CrysLayout::barzflat);
-    int hit_ieta = detId.ieta(BTLDetId::CrysLayout::barzflat);
-
-    // Get the DIGI hit global position
-    Local3DPoint crystal_center(0., 0., 0.);
-    Local3DPoint loc_pos_digi = topo.pixelToModuleLocalPoint(crystal_center, (hit.second).digi_row[0], (hit.second).digi_col[0]);
-    const auto& global_pos_digi = thedet->toGlobal(loc_pos_digi);
 
-    float hit_phi = global_pos_digi.phi();
-    float hit_eta = global_pos_digi.eta();
-    float hit_z   = global_pos_digi.z();
+  // The ETL sides and the BTL parts fill disjoint histograms of h, in tasks
+  // of the framework arena. The BTL hit chunks, once the time-walk
+  // correction is done, fill h and the partial sets: the histograms of a
+  // chunk do not depend on the scheduling, and they are added in the chunk
+  // order at the end of the stream, so that the result is reproducible.
 
+  tbb::task_group tasks;
+  tasks.run([&]() { mtdFillETLHistos(h, event, 0); });
+  tasks.run([&]() { mtdFillETLHistos(h, event, 1); });
 
-    // Time-walk correction:
-    const float p0 =  2.21103;
-    const float p1 = -0.933552;
-    const float p2 =  0.;
-    float time_corr[2];
+  mtdFillBTLEventHistos(h, event, btlTimeWalk_, cache.btlTimeWalk);
 
+  const size_t nBTL = event.btl.size;
+  for (unsigned int ic = 1; ic < btlFillChunks_; ++ic)
+    tasks.run([&, ic]() {
+	mtdFillBTLHitHistos(cache.btlPartials[ic-1], event, nBTL*ic/btlFillChunks_, nBTL*(ic+1)/btlFillChunks_,
+			    btlMinEnergy_, cache.btlTimeWalk);
+      });
+  mtdFillBTLHitHistos(h, event, 0, nBTL/btlFillChunks_, btlMinEnergy_, cache.btlTimeWalk);
 
-    for (int iside=0; iside<2; ++iside){
+  tasks.wait();
 
-      // --- DIGI
-
-      if ( (hit.second).digi_charge[iside] == 0 ) continue;
-
-      hb_e_digi[iside] ->Fill((hit.second).digi_charge[iside]);
-      hb_t1_digi[iside]->Fill((hit.second).digi_time1[iside]);
-      hb_t2_digi[iside]->Fill((hit.second).digi_time2[iside]);
-
-      hb_occupancy_digi[iside]->Fill(hit_z,hit_phi);
-      hb_phi_digi[iside]->Fill(hit_phi);
-      hb_eta_digi[iside]->Fill(hit_eta);
-      hb_z_digi[iside]->Fill(hit_z);
-
-      hb_t1_e_digi[iside]->Fill((hit.second).digi_charge[iside], (hit.second).digi_time1[iside]);
-      hb_t2_e_digi[iside]->Fill((hit.second).digi_charge[iside], (hit.second).digi_time2[iside]);
-      hb_e_eta_digi[iside]->Fill(fabs(hit_ieta),(hit.second).digi_charge[iside]);
-      hb_t1_eta_digi[iside]->Fill(fabs(hit_ieta),(hit.second).digi_time1[iside]);
-      hb_t2_eta_digi[iside]->Fill(fabs(hit_ieta),(hit.second).digi_time2[iside]);
-      hb_e_phi_digi[iside]->Fill(hit_iphi,(hit.second).digi_charge[iside]);
-      hb_t1_phi_digi[iside]->Fill(hit_iphi,(hit.second).digi_time1[iside]);
-      hb_t2_phi_digi[iside]->Fill(hit_iphi,(hit.second).digi_time2[iside]);
-
-      pb_t1_e_digi[iside]->Fill((hit.second).digi_charge[iside], (hit.second).digi_time1[iside]);
-      pb_t2_e_digi[iside]->Fill((hit.second).digi_charge[iside], (hit.second).digi_time2[iside]);
-      pb_e_eta_digi[iside]->Fill(fabs(hit_ieta),(hit.second).digi_charge[iside]);
-      pb_t1_eta_digi[iside]->Fill(fabs(hit_ieta),(hit.second).digi_time1[iside]);
-      pb_t2_eta_digi[iside]->Fill(fabs(hit_ieta),(hit.second).digi_time2[iside]);
-      pb_e_phi_digi[iside]->Fill(hit_iphi,(hit.second).digi_charge[iside]);
-      pb_t1_phi_digi[iside]->Fill(hit_iphi,(hit.second).digi_time1[iside]);
-      pb_t2_phi_digi[iside]->Fill(hit_iphi,(hit.second).digi_time2[iside]);
-
-
-      // --- Uncalibrated RECO
-
-      if ( (hit.second).ureco_charge[iside] == 0. ) continue;
-
-      hb_e_ureco[iside]->Fill((hit.second).ureco_charge[iside]);
-      hb_t_ureco[iside]->Fill((hit.second).ureco_time[iside]);
-
-      hb_occupancy_ureco[iside]->Fill(hit_iphi,hit_ieta);
-
-      hb_t_amp_ureco[iside]->Fill((hit.second).ureco_charge[iside],(hit.second).ureco_time[iside]);
-      pb_t_amp_ureco[iside]->Fill((hit.second).ureco_charge[iside],(hit.second).ureco_time[iside]);
-    
-
-      // Reverse the time-walk correction
-
-      time_corr[iside] = p0*pow((hit.second).ureco_charge[iside],p1) + p2;
-
-      float ureco_time_uncorr = (hit.second).ureco_time[iside] + time_corr[iside];
-
-      hb_t_ureco_uncorr[iside]->Fill(ureco_time_uncorr);
-
-
-    } // for iside
-
-
-    // --- RECO
-
-    if ( (hit.second).reco_energy == 0. ) continue;
-
-    hb_occupancy_reco->Fill(hit_iphi,hit_ieta);
-
-    hb_e_reco->Fill((hit.second).reco_energy);
-    hb_t_reco->Fill((hit.second).reco_time);
-    
-    float reco_time_uncorr = (hit.second).reco_time + 0.5*(time_corr[0]+time_corr[1]); 
-
-    hb_t_reco_uncorr->Fill(reco_time_uncorr);
-
-    if ( (hit.second).sim_time != 0. ) {
-
-      hb_e_res->Fill((hit.second).reco_energy-(hit.second).sim_energy);
-      hb_t_res->Fill((hit.second).reco_time-(hit.second).sim_time);
-
-      hb_t_reco_sim->Fill((hit.second).sim_time,(hit.second).reco_time);
-      hb_e_reco_sim->Fill((hit.second).sim_energy,(hit.second).reco_energy);
-
-      hb_t_res_uncorr->Fill(reco_time_uncorr-(hit.second).sim_time);
-
-    }
-
-  } // BTL hit loop
-
-
-  // ==============================================================================
-  //  ETL
-  // ==============================================================================
-
-  for (int idet=0; idet<2; ++idet){
+}
 
-    for (auto const& hit: n_etl_simHits[idet]) {
-      he_n_sim_trk[idet]->Fill((hit.second).size());
-    }
 
-    he_n_sim_cell[idet]->Fill(unique_etl_simHit[idet].size());
-    he_n_digi[idet]->Fill(n_digi_etl[idet]);
-    he_n_ureco[idet]->Fill(n_ureco_etl[idet]);
-    he_n_reco[idet]->Fill(n_reco_etl[idet]);
+// ------------ method called once each job just before starting event loop  ------------
+void 
+MTDAnalyzer::beginJob()
+{
+}
 
+// ------------ method called once each stream just after ending the event loop  ------------
+void
+MTDAnalyzer::endStream(edm::StreamID streamID) const
+{
 
-    for (auto const& hit: etl_hits[idet]) {
+  if ( hitCache_ )
+    hitCache_->flush(streamCache(streamID)->hitCacheChunk);
 
-      ETLDetId detId(hit.first);
-      DetId geoId = ETLDetId(detId.mtdSide(),detId.mtdRR(),detId.module(),0);
-      const MTDGeomDet* thedet = geom_->idToDet(geoId);
-      const PixelTopology& topo = static_cast<const PixelTopology&>(thedet->topology());
+  std::lock_guard<std::mutex> guard(mergeMutex_);
+  MTDHistoRegistry& streamHistos = streamCache(streamID)->histos;
+  streamHistos.flush();
 
-      // --- SIM
+  for (auto& partial: streamCache(streamID)->btlPartials) {
+    partial.flush();
+    streamHistos.add(partial);
+  }
 
-      if ( (hit.second).sim_time != 0. ) {
+  histos_.add(streamHistos);
 
-	he_e_sim[idet]->Fill((hit.second).sim_energy);
-	he_t_sim[idet]->Fill((hit.second).sim_time);
-      
-	he_xloc_sim[idet]->Fill((hit.second).sim_x);
-	he_yloc_sim[idet]->Fill((hit.second).sim_y);
-	he_zloc_sim[idet]->Fill((hit.second).sim_z);
+  streamCache(streamID)->btlModules.flush();
+  streamCache(streamID)->etlModules.flush();
+  btlModules_.add(streamCache(streamID)->btlModules);
+  etlModules_.add(streamCache(streamID)->etlModules);
 
+  if ( btlCalibration_ ) {
+    btlCalibration_->add(streamCache(streamID)->btlCalibration);
+    etlCalibration_->add(streamCache(streamID)->etlCalibration);
+  }
 
-	// Get the SIM hit global position
-	Local3DPoint simscaled(0.1*(hit.second).sim_x,0.1*(hit.second).sim_y,0.1*(hit.second).sim_z);
-	const auto& global_pos = thedet->toGlobal(simscaled);
+  if ( resolution_ )
+    resolution_->add(streamCache(streamID)->resolution);
 
-	he_occupancy_sim[idet]->Fill(global_pos.x(),global_pos.y());
-	he_x_sim[idet]->Fill(global_pos.x());
-	he_y_sim[idet]->Fill(global_pos.y());
-	he_z_sim[idet]->Fill(global_pos.z());
-	he_phi_sim[idet]->Fill(global_pos.phi());
-	he_eta_sim[idet]->Fill(global_pos.eta());
+#ifdef MTD_INSTRUMENTATION
+  stats_.add(streamCache(streamID)->stats);
+#endif
 
-	he_t_e_sim[idet]->Fill((hit.second).sim_energy,(hit.second).sim_time);
-	he_e_eta_sim[idet]->Fill(global_pos.eta(),(hit.second).sim_energy);
-	he_t_eta_sim[idet]->Fill(global_pos.eta(),(hit.second).sim_time);
-	he_e_phi_sim[idet]->Fill(global_pos.phi(),(hit.second).sim_energy);
-	he_t_phi_sim[idet]->Fill(global_pos.phi(),(hit.second).sim_time);
+}
 
-	pe_t_e_sim[idet]->Fill((hit.second).sim_energy,(hit.second).sim_time);
-	pe_e_eta_sim[idet]->Fill(global_pos.eta(),(hit.second).sim_energy);
-	pe_t_eta_sim[idet]->Fill(global_pos.eta(),(hit.second).sim_time);
-	pe_e_phi_sim[idet]->Fill(global_pos.phi(),(hit.second).sim_energy);
-	pe_t_phi_sim[idet]->Fill(global_pos.phi(),(hit.second).sim_time);
+// ------------ method called once each job just after ending the event loop  ------------
+void 
+MTDAnalyzer::endJob() 
+{
 
-      }
+  edm::Service<TFileService> fs;
+  mtdWriteHistos(histos_, *fs);
 
-      // --- DIGI
+  for (size_t ih = 0; ih < histos_.size(); ++ih) {
+    const MTDChannelMap* m = dynamic_cast<const MTDChannelMap*>(&histos_.histo(ih));
+    if ( m != nullptr && m->outside() > 0 )
+      edm::LogWarning("MTDAnalyzer") << "Channel map " << m->dir() << "/" << m->name() << ": " << m->outside()
+				     << " of " << m->entries() << " fills out of range, in the underflow and overflow bins";
+  }
 
-      if ( (hit.second).digi_charge[0] == 0 ) continue;
+  if ( btlModules_.enabled() || etlModules_.enabled() ) {
+    mtdWriteModuleHistos(btlModules_, *fs);
+    mtdWriteModuleHistos(etlModules_, *fs);
+    edm::LogInfo("MTDAnalyzer") << "Module histograms of " << btlModules_.size() << " BTL modules and "
+				<< etlModules_.size() << " ETL rings with hits, "
+				<< (btlModules_.bytes() + etlModules_.bytes())/1024 << " kB";
+  }
 
-      he_e_digi[idet]->Fill((hit.second).digi_charge[0]);
-      he_t_digi[idet]->Fill((hit.second).digi_time1[0]);
+  if ( hitCache_ ) {
+    hitCache_->close();
+    edm::LogInfo("MTDAnalyzer") << "Wrote " << hitCache_->nEvents() << " events to the hit cache, "
+				<< hitCache_->bytes()/1024 << " kB";
+  }
 
-      // Get the DIGI hit global position
-      Local3DPoint loc_pos_digi(((hit.second).digi_row[0]+0.5)*topo.pitch().first,
-				((hit.second).digi_col[0]+0.5)*topo.pitch().second,
-				0.);
-      const auto& global_pos_digi = thedet->toGlobal(loc_pos_digi);
+  if ( associator_ )
+    edm::LogInfo("MTDAnalyzer") << "MTD geometry lookup tables built " << associator_->nGeometryBuilds() << " time(s)";
 
-      float hit_x   = global_pos_digi.x();
-      float hit_y   = global_pos_digi.y();
-      float hit_phi = global_pos_digi.phi();
-      float hit_eta = global_pos_digi.eta();
+  if ( btlCalibration_ ) {
 
+    const MTDCalibration::Constants btl = btlCalibration_->fit(calibrationMinEntries_);
+    const MTDCalibration::Constants etl = etlCalibration_->fit(calibrationMinEntries_);
 
-      he_occupancy_digi[idet]->Fill(hit_x,hit_y);
+    std::ofstream table(calibrationFile_);
+    table << "# MTD calibration: time walk t - t_sim = p0*q^p1 + p2 [ns] with q [pC], energy scale E_sim/E_reco\n"
+	  << "# status: 0 no data, 1 constants of all the channels, 2 fitted\n"
+	  << "# detector rawId side twEntries p0 p1 p2 twStatus energyEntries energyScale energyStatus\n";
+    btlCalibration_->write(table, "BTL", btl);
+    etlCalibration_->write(table, "ETL", etl);
+    if ( !table )
+      edm::LogWarning("MTDAnalyzer") << "Cannot write the calibration table to " << calibrationFile_;
 
-      he_x_digi[idet]->Fill(hit_x);
-      he_y_digi[idet]->Fill(hit_y);
-      he_phi_digi[idet]->Fill(hit_phi);
-      he_eta_digi[idet]->Fill(hit_eta);
+    auto nFitted = [](const std::vector<MTDCalibration::TimeWalk>& channels) {
+      return std::count_if(channels.begin(), channels.end(), [](const MTDCalibration::TimeWalk& tw) {
+	  return tw.status == MTDCalibration::kFitted; });
+    };
 
-      he_t_e_digi[idet]->Fill((hit.second).digi_charge[0],(hit.second).digi_time1[0]);
-      he_e_eta_digi[idet]->Fill(hit_eta,(hit.second).digi_charge[0]);
-      he_t_eta_digi[idet]->Fill(hit_eta,(hit.second).digi_time1[0]);
-      he_e_phi_digi[idet]->Fill(hit_phi,(hit.second).digi_charge[0]);
-      he_t_phi_digi[idet]->Fill(hit_phi,(hit.second).digi_time1[0]);
+    edm::LogInfo("MTDAnalyzer") << "Calibration: BTL time walk p0 = " << btl.globalTimeWalk.p0 << " ns, p1 = "
+				<< btl.globalTimeWalk.p1 << ", p2 = " << btl.globalTimeWalk.p2 << " ns, fitted for "
+				<< nFitted(btl.timeWalk) << " BTL and " << nFitted(etl.timeWalk)
+				<< " ETL channels; sums of " << (btlCalibration_->bytes() + etlCalibration_->bytes())/1024
+				<< " kB, written to " << calibrationFile_;
 
-      pe_t_e_digi[idet]->Fill((hit.second).digi_charge[0],(hit.second).digi_time1[0]);
-      pe_e_eta_digi[idet]->Fill(hit_eta,(hit.second).digi_charge[0]);
-      pe_t_eta_digi[idet]->Fill(hit_eta,(hit.second).digi_time1[0]);
-      pe_e_phi_digi[idet]->Fill(hit_phi,(hit.second).digi_charge[0]);
-      pe_t_phi_digi[idet]->Fill(hit_phi,(hit.second).digi_time1[0]);
+  }
 
+  if ( resolution_ ) {
 
-    } // ETL hit loop
+    std::ofstream table(resolutionFile_);
+    resolution_->write(table);
+    if ( !table )
+      edm::LogWarning("MTDAnalyzer") << "Cannot write the resolution table to " << resolutionFile_;
 
-  } // idet loop
+    edm::LogInfo("MTDAnalyzer") << "Resolution sketches of " << resolution_->bytes()/1024 << " kB written to "
+				<< resolutionFile_;
 
-  // ---------------------------------------------------------------
+    for (auto det: { MTDResolution::kBTL, MTDResolution::kETL })
+      if ( resolution_->outsideAcceptance(det) > 0 )
+	edm::LogWarning("MTDAnalyzer") << "Resolution: " << resolution_->outsideAcceptance(det)
+				       << (det == MTDResolution::kBTL ? " BTL" : " ETL") << " hits out of |eta| ["
+				       << MTDResolution::kMinEta[det] << ", " << MTDResolution::kMaxEta[det] << "]";
 
-  n_btl_simHits.clear();
-  n_etl_simHits[0].clear();
-  n_etl_simHits[1].clear();
-  btl_hits.clear();
-  etl_hits[0].clear();
-  etl_hits[1].clear();
+  }
 
-}
+#ifdef MTD_INSTRUMENTATION
+  std::ostringstream report;
+  stats_.report(report);
+  edm::LogInfo("MTDAnalyzer") << "Time per event and stage, counts per event:\n" << report.str();
 
+  if ( !instrumentationFile_.empty() ) {
+    std::ofstream json(instrumentationFile_);
+    stats_.writeJSON(json);
+    if ( !json )
+      edm::LogWarning("MTDAnalyzer") << "Cannot write the stage timing to " << instrumentationFile_;
+  }
+#endif
 
-// ------------ method called once each job just before starting event loop  ------------
-void 
-MTDAnalyzer::beginJob()
-{
-}
+  if ( associator_ ) associator_->releaseGeometry();
 
-// ------------ method called once each job just after ending the event loop  ------------
-void 
-MTDAnalyzer::endJob() 
-{
 }
 
 // ------------ method fills 'descriptions' with the allowed parameters for the module  ------------
 void
 MTDAnalyzer::fillDescriptions(edm::ConfigurationDescriptions& descriptions) {
-  //The following says we do not know what parameters are allowed so do no validation
-  // Please change this to state exactly what you do use, even if it is no parameters
   edm::ParameterSetDescription desc;
-  desc.setUnknown();
-  descriptions.addDefault(desc);
+
+  // --- tiers, windows and layout of the join, read only without HitAssociation
+  desc.add<edm::InputTag>("HitAssociation", edm::InputTag(""));
+  MTDHitAssociator::fillPSetDescription(desc);
+
+  desc.add<double>("BTLMinimumEnergy", 2.);
+  desc.add<std::vector<double> >("BTLTimeWalkParameters", { 2.21103, -0.933552, 0. });
+  desc.add<unsigned int>("HistogramFlushSize", 1);
+  desc.add<unsigned int>("BTLFillChunks", 4);
+  desc.add<std::vector<std::string> >("HistogramGroups", { "BTLSim", "BTLDigi", "BTLUReco", "BTLReco",
+							    "ETLSim", "ETLDigi", "ETLUReco", "ETLReco" });
+  desc.add<std::vector<std::string> >("ModuleHistogramGroups", { });
+
+  desc.add<bool>("WriteNtuple", false);
+  desc.add<std::string>("NtupleCompression", "LZ4");
+  desc.add<unsigned int>("NtupleCompressionLevel", 4);
+  desc.add<std::string>("HitCacheFile", "");
+  desc.add<unsigned int>("HitCacheChunkSize", 16);
+
+  desc.add<std::string>("CalibrationFile", "");
+  desc.add<std::vector<double> >("CalibrationAmplitudeRange", { 0.1, 100. });
+  desc.add<unsigned int>("CalibrationAmplitudeBins", 8);
+  desc.add<unsigned int>("CalibrationMinEntries", 50);
+
+  desc.add<std::string>("ResolutionFile", "");
+  desc.add<unsigned int>("ResolutionEtaBins", 6);
+  desc.add<unsigned int>("ResolutionPhiBins", 1);
+  desc.add<std::vector<double> >("ResolutionAmplitudeRange", { 0.1, 100. });
+  desc.add<unsigned int>("ResolutionAmplitudeBins", 4);
+
+  // --- read only with -DMTD_INSTRUMENTATION, allowed in all the builds
+  desc.add<std::string>("InstrumentationFile", "MTDAnalyzer_timing.json");
+
+  descriptions.add("mtdAnalyzer", desc);
 }
 
 //define this as a plug-in
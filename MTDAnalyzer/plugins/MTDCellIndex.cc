@@ -0,0 +1,64 @@
+#include "MTDCellIndex.h"
+
+#include <algorithm>
+
+#include "Geometry/MTDGeometryBuilder/interface/MTDGeometry.h"
+#include "Geometry/MTDGeometryBuilder/interface/ProxyMTDTopology.h"
+#include "Geometry/MTDGeometryBuilder/interface/RectangularMTDTopology.h"
+
+
+void MTDCellIndex::build(const MTDGeometry& geom) {
+
+  // --- BTL: one cell per crystal of each module
+
+  btl_ = ModuleTable();
+
+  for (auto const& det: geom.detsBTL()) {
+    BTLDetId geoId(det->geographicalId());
+    btl_.nRR     = std::max(btl_.nRR, uint32_t(geoId.mtdRR()+1));
+    btl_.nModule = std::max(btl_.nModule, uint32_t(geoId.module()+1));
+  }
+
+  btl_.slot.assign(2*btl_.nRR*btl_.nModule, kInvalid);
+
+  nBTLCells_ = 0;
+
+  for (auto const& det: geom.detsBTL()) {
+
+    BTLDetId geoId(det->geographicalId());
+
+    const ProxyMTDTopology& topoproxy = static_cast<const ProxyMTDTopology&>(det->topology());
+    const RectangularMTDTopology& topo = static_cast<const RectangularMTDTopology&>(topoproxy.specificTopology());
+
+    btl_.slot[btl_.key(geoId.mtdSide(),geoId.mtdRR(),geoId.module())] = btl_.moduleFirstCell.size();
+    btl_.moduleFirstCell.push_back(nBTLCells_);
+    btl_.moduleNCells.push_back(topo.nrows()*topo.ncolumns());
+
+    nBTLCells_ += topo.nrows()*topo.ncolumns();
+
+  }
+
+
+  // --- ETL: one cell per module
+
+  etl_ = ModuleTable();
+
+  for (auto const& det: geom.detsETL()) {
+    ETLDetId geoId(det->geographicalId());
+    etl_.nRR     = std::max(etl_.nRR, uint32_t(geoId.mtdRR()+1));
+    etl_.nModule = std::max(etl_.nModule, uint32_t(geoId.module()+1));
+  }
+
+  etl_.slot.assign(2*etl_.nRR*etl_.nModule, kInvalid);
+
+  for (auto const& det: geom.detsETL()) {
+
+    ETLDetId geoId(det->geographicalId());
+
+    etl_.slot[etl_.key(geoId.mtdSide(),geoId.mtdRR(),geoId.module())] = etl_.moduleFirstCell.size();
+    etl_.moduleFirstCell.push_back(etl_.moduleFirstCell.size());
+    etl_.moduleNCells.push_back(1);
+
+  }
+
+}
@@ -0,0 +1,109 @@
+#ifndef MTDAnalyzer_plugins_MTDCellIndex_h
+#define MTDAnalyzer_plugins_MTDCellIndex_h
+
+#include <cstdint>
+#include <limits>
+#include <vector>
+
+#include "DataFormats/ForwardDetId/interface/BTLDetId.h"
+#include "DataFormats/ForwardDetId/interface/ETLDetId.h"
+
+class MTDGeometry;
+
+
+// Dense, contiguous numbering of the MTD readout cells, built once from the
+// MTDGeometry: BTL cells are single crystals, ETL cells are single modules.
+//
+// The geometry modules are addressed through a direct-address table keyed on
+// (side, rod/ring, module) of the geometry DetId, so a lookup is a couple of
+// bit-field decodes and two array reads, without any hashing.
+
+class MTDCellIndex {
+
+public:
+
+  static constexpr uint32_t kInvalid = std::numeric_limits<uint32_t>::max();
+
+  void build(const MTDGeometry& geom);
+
+  // --- cell of a BTL crystal / ETL module readout DetId, kInvalid if the
+  //     DetId is not part of the geometry
+  uint32_t btlCell(const BTLDetId& id) const;
+  uint32_t etlCell(const ETLDetId& id) const;
+
+  uint32_t nBTLCells() const { return nBTLCells_; }
+  uint32_t nETLCells() const { return etl_.moduleFirstCell.size(); }
+
+  // --- number of BTL geometry modules, upper bound of the ETL rings of
+  //     both sides
+  uint32_t nBTLModules() const { return btl_.moduleFirstCell.size(); }
+  uint32_t nETLRings() const { return 2*etl_.nRR; }
+
+  // --- geometry DetId of the module holding a BTL crystal
+  static BTLDetId btlGeoId(const BTLDetId& id) {
+    return BTLDetId(id.mtdSide(),id.mtdRR(),id.module()+14*(id.modType()-1),0,1);
+  }
+  // --- readout DetId of a crystal (numbered from 1) of a BTL geometry
+  //     module, inverse of btlGeoId() for the 1-based module numbering
+  static BTLDetId btlReadoutId(const BTLDetId& geoId, uint32_t crystal) {
+    return BTLDetId(geoId.mtdSide(),geoId.mtdRR(),(geoId.module()-1)%14+1,(geoId.module()-1)/14+1,crystal);
+  }
+  static ETLDetId etlGeoId(const ETLDetId& id) {
+    return ETLDetId(id.mtdSide(),id.mtdRR(),id.module(),0);
+  }
+
+
+private:
+
+  struct ModuleTable {
+
+    uint32_t nRR = 0;
+    uint32_t nModule = 0;
+    std::vector<uint32_t> slot;              // (side, rr, module) -> module slot
+    std::vector<uint32_t> moduleFirstCell;   // module slot -> first cell
+    std::vector<uint32_t> moduleNCells;      // module slot -> number of cells
+
+    uint32_t key(uint32_t side, uint32_t rr, uint32_t module) const {
+      return (side*nRR + rr)*nModule + module;
+    }
+
+    uint32_t find(uint32_t side, uint32_t rr, uint32_t module) const {
+      if ( side > 1 || rr >= nRR || module >= nModule ) return kInvalid;
+      return slot[key(side,rr,module)];
+    }
+
+  };
+
+  ModuleTable btl_;
+  ModuleTable etl_;
+
+  uint32_t nBTLCells_ = 0;
+
+};
+
+
+inline uint32_t MTDCellIndex::btlCell(const BTLDetId& id) const {
+
+  // same module numbering as btlGeoId(), without re-encoding the DetId
+  const uint32_t slot = btl_.find(id.mtdSide(),id.mtdRR(),id.module()+14*(id.modType()-1));
+  if ( slot == kInvalid ) return kInvalid;
+
+  const uint32_t crystal = id.crystal() - 1;
+  if ( crystal >= btl_.moduleNCells[slot] ) return kInvalid;
+
+  return btl_.moduleFirstCell[slot] + crystal;
+
+}
+
+
+inline uint32_t MTDCellIndex::etlCell(const ETLDetId& id) const {
+
+  const uint32_t slot = etl_.find(id.mtdSide(),id.mtdRR(),id.module());
+  if ( slot == kInvalid ) return kInvalid;
+
+  return etl_.moduleFirstCell[slot];
+
+}
+
+
+#endif
@@ -0,0 +1,72 @@
+#ifndef MTDAnalyzer_plugins_MTDChannelDecoder_h
+#define MTDAnalyzer_plugins_MTDChannelDecoder_h
+
+#include <cstdint>
+
+#include "DataFormats/ForwardDetId/interface/BTLDetId.h"
+#include "DataFormats/ForwardDetId/interface/ETLDetId.h"
+
+
+// All the coordinates derived from the DetId of a readout channel, packed in
+// one struct. They are decoded once per channel when the geometry lookup
+// tables are built (see MTDGeometryCache), so that the per-hit code reads
+// them instead of decoding the bit fields again.
+
+struct MTDBTLCoords {
+
+  int16_t iphi;      // crystal indices, in the crystal layout
+  int16_t ieta;
+  int16_t row;       // crystal position in the module
+  int16_t column;
+
+  uint8_t side;
+  uint8_t tray;      // mtdRR()
+  uint8_t module;    // geometry module (see MTDCellIndex::btlGeoId)
+  uint8_t crystal;
+
+};
+
+
+struct MTDETLCoords {
+
+  uint8_t side;      // 0: -Z, 1: +Z
+  uint8_t ring;      // mtdRR()
+  uint16_t module;
+
+};
+
+
+// Decoder of the channels of a subdetector. The BTL one takes the crystal
+// layout of the geometry as a template parameter, so that it is chosen once
+// for all the channels when the tables are built, not per channel.
+
+template<typename DetId>
+struct MTDChannelDecoder;
+
+
+template<>
+struct MTDChannelDecoder<BTLDetId> {
+
+  // --- nRows: rows of the module topology
+  template<BTLDetId::CrysLayout Layout>
+  static MTDBTLCoords decode(const BTLDetId& id, int nRows) {
+    return { int16_t(id.iphi(Layout)), int16_t(id.ieta(Layout)),
+	     int16_t(id.row(nRows)), int16_t(id.column(nRows)),
+	     uint8_t(id.mtdSide()), uint8_t(id.mtdRR()),
+	     uint8_t(id.module()+14*(id.modType()-1)), uint8_t(id.crystal()) };
+  }
+
+};
+
+
+template<>
+struct MTDChannelDecoder<ETLDetId> {
+
+  static MTDETLCoords decode(const ETLDetId& id) {
+    return { uint8_t((id.zside()+1)/2), uint8_t(id.mtdRR()), uint16_t(id.module()) };
+  }
+
+};
+
+
+#endif
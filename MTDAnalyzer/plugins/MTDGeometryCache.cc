@@ -0,0 +1,92 @@
+#include "MTDGeometryCache.h"
+
+#include "Geometry/MTDGeometryBuilder/interface/MTDGeometry.h"
+#include "Geometry/MTDGeometryBuilder/interface/MTDGeomDet.h"
+#include "Geometry/MTDGeometryBuilder/interface/ProxyMTDTopology.h"
+#include "Geometry/MTDGeometryBuilder/interface/RectangularMTDTopology.h"
+#include "Geometry/CommonTopologies/interface/PixelTopology.h"
+#include "FWCore/Utilities/interface/Exception.h"
+
+
+void MTDGeometryCache::build(const MTDGeometry& geom, BTLDetId::CrysLayout btlLayout) {
+
+  cells_.build(geom);
+
+  switch ( btlLayout ) {
+  case BTLDetId::CrysLayout::tile:       buildBTL<BTLDetId::CrysLayout::tile>(geom);       break;
+  case BTLDetId::CrysLayout::bar:        buildBTL<BTLDetId::CrysLayout::bar>(geom);        break;
+  case BTLDetId::CrysLayout::barzflat:   buildBTL<BTLDetId::CrysLayout::barzflat>(geom);   break;
+  case BTLDetId::CrysLayout::barphiflat: buildBTL<BTLDetId::CrysLayout::barphiflat>(geom); break;
+  default:
+    throw cms::Exception("Configuration") << "MTDGeometryCache: unsupported BTL crystal layout "
+					  << static_cast<int>(btlLayout);
+  }
+
+
+  // --- ETL modules
+
+  etl_.assign(cells_.nETLCells(), ETLCell());
+
+  for (auto const& det: geom.detsETL()) {
+
+    ETLDetId geoId(det->geographicalId());
+
+    const PixelTopology& topo = static_cast<const PixelTopology&>(det->topology());
+
+    ETLCell& cell = etl_[cells_.etlCell(geoId)];
+
+    cell.det  = static_cast<const MTDGeomDet*>(det);
+    cell.topo = &topo;
+
+    cell.pitch_x = topo.pitch().first;
+    cell.pitch_y = topo.pitch().second;
+
+    cell.coords = MTDChannelDecoder<ETLDetId>::decode(geoId);
+
+  }
+
+}
+
+
+template<BTLDetId::CrysLayout Layout>
+void MTDGeometryCache::buildBTL(const MTDGeometry& geom) {
+
+  // --- BTL crystals
+
+  btl_.assign(cells_.nBTLCells(), BTLCell());
+
+  for (auto const& det: geom.detsBTL()) {
+
+    BTLDetId geoId(det->geographicalId());
+
+    const ProxyMTDTopology& topoproxy = static_cast<const ProxyMTDTopology&>(det->topology());
+    const RectangularMTDTopology& topo = static_cast<const RectangularMTDTopology&>(topoproxy.specificTopology());
+
+    const uint32_t nCrystals = topo.nrows()*topo.ncolumns();
+
+    for (uint32_t crystal = 1; crystal <= nCrystals; ++crystal) {
+
+      BTLDetId detId = MTDCellIndex::btlReadoutId(geoId,crystal);
+
+      BTLCell& cell = btl_[cells_.btlCell(detId)];
+
+      cell.det  = static_cast<const MTDGeomDet*>(det);
+      cell.topo = &topo;
+
+      cell.coords = MTDChannelDecoder<BTLDetId>::decode<Layout>(detId, topo.nrows());
+
+      Local3DPoint crystal_center(0., 0., 0.);
+      Local3DPoint loc_pos = topo.pixelToModuleLocalPoint(crystal_center, cell.coords.row, cell.coords.column);
+      const auto& global_pos = det->toGlobal(loc_pos);
+
+      cell.x   = global_pos.x();
+      cell.y   = global_pos.y();
+      cell.z   = global_pos.z();
+      cell.eta = global_pos.eta();
+      cell.phi = global_pos.phi();
+
+    }
+
+  }
+
+}
@@ -0,0 +1,75 @@
+#ifndef MTDAnalyzer_plugins_MTDGeometryCache_h
+#define MTDAnalyzer_plugins_MTDGeometryCache_h
+
+#include <cstdint>
+#include <vector>
+
+#include "MTDCellIndex.h"
+#include "MTDChannelDecoder.h"
+
+class MTDGeometry;
+class MTDGeomDet;
+class PixelTopology;
+class RectangularMTDTopology;
+
+
+// Geometry-derived quantities of every MTD readout cell, computed once for a
+// given MTDGeometry and BTL crystal layout and addressed by the MTDCellIndex
+// cell number, with the coordinates decoded from the DetId of the cell.
+//
+// The pointers refer to the MTDGeometry the cache was built from, and stay
+// valid as long as that geometry does.
+
+class MTDGeometryCache {
+
+public:
+
+  struct BTLCell {
+
+    const MTDGeomDet* det;
+    const RectangularMTDTopology* topo;
+
+    // --- global position of the crystal center
+    float x;
+    float y;
+    float z;
+    float eta;
+    float phi;
+
+    MTDBTLCoords coords;
+
+  };
+
+  struct ETLCell {
+
+    const MTDGeomDet* det;
+    const PixelTopology* topo;
+
+    float pitch_x;
+    float pitch_y;
+
+    MTDETLCoords coords;
+
+  };
+
+  void build(const MTDGeometry& geom, BTLDetId::CrysLayout btlLayout);
+
+  const MTDCellIndex& cells() const { return cells_; }
+
+  const BTLCell& btl(uint32_t cell) const { return btl_[cell]; }
+  const ETLCell& etl(uint32_t cell) const { return etl_[cell]; }
+
+
+private:
+
+  template<BTLDetId::CrysLayout Layout> void buildBTL(const MTDGeometry& geom);
+
+  MTDCellIndex cells_;
+
+  std::vector<BTLCell> btl_;
+  std::vector<ETLCell> etl_;
+
+};
+
+
+#endif
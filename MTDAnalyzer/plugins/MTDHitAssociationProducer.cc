@@ -0,0 +1,174 @@
+#include <memory>
+#include <mutex>
+#include <sstream>
+
+
+#include "FWCore/Framework/interface/Frameworkfwd.h"
+#include "FWCore/Framework/interface/global/EDProducer.h"
+#include "FWCore/Framework/interface/Event.h"
+#include "FWCore/Framework/interface/LuminosityBlock.h"
+#include "FWCore/Framework/interface/MakerMacros.h"
+#include "FWCore/ParameterSet/interface/ParameterSet.h"
+#include "FWCore/ParameterSet/interface/ConfigurationDescriptions.h"
+#include "FWCore/ParameterSet/interface/ParameterSetDescription.h"
+#include "FWCore/MessageLogger/interface/MessageLogger.h"
+
+#include "MTDtools/MTDAnalyzer/interface/MTDHitAssociation.h"
+
+#include "MTDGeometryCache.h"
+#include "MTDHitAssociator.h"
+#include "MTDInstrumentation.h"
+
+
+// Per-stream state: the scratch stores used to join the MTD hits of one
+// event.
+struct MTDAssociationStreamCache {
+
+  MTDHitAssociator::Scratch join;
+
+#ifdef MTD_INSTRUMENTATION
+  MTDEventStats stats;
+#endif
+
+};
+
+
+// Joins the MTD hit collections of every event once into an
+// MTDHitAssociation (see MTDHitAssociator), for several MTDAnalyzer
+// instances with HitAssociation set to this module, e.g. with different
+// BTLMinimumEnergy or histogram groups, in the same path.
+//
+// The product has all the positions, the SIM energies in all the
+// integration windows and, for a bunch crossing window wider than BX 0,
+// the BX slots of the records.
+
+class MTDHitAssociationProducer : public edm::global::EDProducer<edm::StreamCache<MTDAssociationStreamCache>,
+								  edm::LuminosityBlockCache<MTDGeometryCache> > {
+
+public:
+  explicit MTDHitAssociationProducer(const edm::ParameterSet&);
+
+  static void fillDescriptions(edm::ConfigurationDescriptions& descriptions);
+
+
+private:
+  virtual std::unique_ptr<MTDAssociationStreamCache> beginStream(edm::StreamID) const override;
+  virtual std::shared_ptr<MTDGeometryCache> globalBeginLuminosityBlock(const edm::LuminosityBlock&,
+								       const edm::EventSetup&) const override;
+  virtual void produce(edm::StreamID, edm::Event&, const edm::EventSetup&) const override;
+  virtual void globalEndLuminosityBlock(const edm::LuminosityBlock&, const edm::EventSetup&) const override;
+  virtual void endStream(edm::StreamID) const override;
+  virtual void endJob() override;
+
+  // ----------member data ---------------------------
+
+  MTDHitAssociator associator_;
+  MTDHitAssociator::Outputs outputs_;
+
+#ifdef MTD_INSTRUMENTATION
+  // --- Stage timing and counters of all the streams, added in endStream()
+  //     under statsMutex_ (see MTDInstrumentation)
+  mutable MTDEventStats stats_;
+  mutable std::mutex statsMutex_;
+#endif
+
+};
+
+
+MTDHitAssociationProducer::MTDHitAssociationProducer(const edm::ParameterSet& iConfig) :
+  associator_(iConfig, consumesCollector()) {
+
+  outputs_.btlBX = outputs_.etlBX = associator_.bxWindow().size() > 1;
+
+  produces<MTDHitAssociation>();
+
+}
+
+
+std::unique_ptr<MTDAssociationStreamCache>
+MTDHitAssociationProducer::beginStream(edm::StreamID) const {
+
+  auto cache = std::make_unique<MTDAssociationStreamCache>();
+
+#ifdef MTD_INSTRUMENTATION
+  cache->join.stats = &cache->stats;
+#endif
+
+  return cache;
+
+}
+
+
+std::shared_ptr<MTDGeometryCache>
+MTDHitAssociationProducer::globalBeginLuminosityBlock(const edm::LuminosityBlock&, const edm::EventSetup& iSetup) const {
+
+  return associator_.geometry(iSetup);
+
+}
+
+
+void
+MTDHitAssociationProducer::globalEndLuminosityBlock(const edm::LuminosityBlock&, const edm::EventSetup&) const {
+}
+
+
+void
+MTDHitAssociationProducer::produce(edm::StreamID streamID, edm::Event& iEvent, const edm::EventSetup&) const {
+
+  MTDAssociationStreamCache& cache = *streamCache(streamID);
+
+  MTD_EVENT(cache.stats);
+
+  const MTDGeometryCache& geoCache = *luminosityBlockCache(iEvent.getLuminosityBlock().index());
+
+  auto association = std::make_unique<MTDHitAssociation>();
+  associator_.associate(iEvent, geoCache, outputs_, cache.join, *association);
+
+  iEvent.put(std::move(association));
+
+}
+
+
+// ------------ method called once each stream just after ending the event loop  ------------
+void
+MTDHitAssociationProducer::endStream(edm::StreamID streamID) const
+{
+
+#ifdef MTD_INSTRUMENTATION
+  std::lock_guard<std::mutex> guard(statsMutex_);
+  stats_.add(streamCache(streamID)->stats);
+#endif
+
+}
+
+
+// ------------ method called once each job just after ending the event loop  ------------
+void
+MTDHitAssociationProducer::endJob()
+{
+
+  edm::LogInfo("MTDHitAssociationProducer") << "MTD geometry lookup tables built " << associator_.nGeometryBuilds()
+					    << " time(s)";
+
+#ifdef MTD_INSTRUMENTATION
+  std::ostringstream report;
+  stats_.report(report);
+  edm::LogInfo("MTDHitAssociationProducer") << "Time per event and stage, counts per event:\n" << report.str();
+#endif
+
+  associator_.releaseGeometry();
+
+}
+
+// ------------ method fills 'descriptions' with the allowed parameters for the module  ------------
+void
+MTDHitAssociationProducer::fillDescriptions(edm::ConfigurationDescriptions& descriptions) {
+  // --- the join parameters only: the histogram, output and calibration
+  //     parameters of MTDAnalyzer are rejected
+  edm::ParameterSetDescription desc;
+  MTDHitAssociator::fillPSetDescription(desc);
+  descriptions.add("mtdHitAssociationProducer", desc);
+}
+
+//define this as a plug-in
+DEFINE_FWK_MODULE(MTDHitAssociationProducer);
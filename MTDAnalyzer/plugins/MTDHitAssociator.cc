@@ -0,0 +1,548 @@
+#include "MTDHitAssociator.h"
+
+#include <algorithm>
+#include <map>
+
+#include "FWCore/Framework/interface/Event.h"
+#include "FWCore/Framework/interface/EventSetup.h"
+#include "FWCore/Utilities/interface/Exception.h"
+#include "FWCore/Utilities/interface/InputTag.h"
+
+#include "DataFormats/ForwardDetId/interface/BTLDetId.h"
+#include "DataFormats/ForwardDetId/interface/ETLDetId.h"
+
+#include "Geometry/MTDGeometryBuilder/interface/MTDGeometry.h"
+#include "Geometry/MTDGeometryBuilder/interface/ProxyMTDTopology.h"
+#include "Geometry/MTDGeometryBuilder/interface/RectangularMTDTopology.h"
+#include "Geometry/CommonTopologies/interface/PixelTopology.h"
+
+#include "tbb/task_group.h"
+
+
+// SIM energy integration windows [ns] of a parameter, in the configured
+// order.
+static std::vector<float> integrationWindows(const edm::ParameterSet& iConfig, const std::string& name) {
+
+  const auto windows = iConfig.getParameter<std::vector<double> >(name);
+  return std::vector<float>(windows.begin(), windows.end());
+
+}
+
+
+static BTLDetId::CrysLayout crystalLayout(const std::string& name) {
+
+  if ( name == "tile" )       return BTLDetId::CrysLayout::tile;
+  if ( name == "bar" )        return BTLDetId::CrysLayout::bar;
+  if ( name == "barzflat" )   return BTLDetId::CrysLayout::barzflat;
+  if ( name == "barphiflat" ) return BTLDetId::CrysLayout::barphiflat;
+
+  throw cms::Exception("Configuration") << "MTDHitAssociator: unknown BTLCrystalLayout " << name
+					<< " (tile, bar, barzflat or barphiflat)";
+
+}
+
+
+MTDHitAssociator::MTDHitAssociator(const edm::ParameterSet& iConfig, edm::ConsumesCollector&& iC) :
+  bxWindow_( iConfig.getParameter<int>("FirstBX"), iConfig.getParameter<int>("LastBX") ),
+  readBTL_( iConfig.getParameter<bool>("ReadBTL") ),
+  readETL_( iConfig.getParameter<bool>("ReadETL") ),
+  readSim_( iConfig.getParameter<bool>("ReadSimHits") ),
+  readDigi_( iConfig.getParameter<bool>("ReadDigiHits") ),
+  readUReco_( iConfig.getParameter<bool>("ReadUncalibRecHits") ),
+  readReco_( iConfig.getParameter<bool>("ReadRecHits") ),
+  intraEventTasks_( iConfig.getParameter<bool>("IntraEventTasks") ),
+  btlLayout_( crystalLayout(iConfig.getParameter<std::string>("BTLCrystalLayout")) ),
+  nGeometryBuilds_(0) {
+
+  // --- Only the products of the enabled detectors and tiers are consumed,
+  //     the tokens of the others stay uninitialized and are never read
+
+  if ( readBTL_ && readSim_ )
+    tok_BTL_sim = iC.consumes<edm::PSimHitContainer>(iConfig.getParameter<edm::InputTag>("BTLSimHits"));
+  if ( readETL_ && readSim_ )
+    tok_ETL_sim = iC.consumes<edm::PSimHitContainer>(iConfig.getParameter<edm::InputTag>("ETLSimHits"));
+
+  if ( readBTL_ && readDigi_ )
+    tok_BTL_digi = iC.consumes<BTLDigiCollection>(iConfig.getParameter<edm::InputTag>("BTLDigiHits"));
+  if ( readETL_ && readDigi_ )
+    tok_ETL_digi = iC.consumes<ETLDigiCollection>(iConfig.getParameter<edm::InputTag>("ETLDigiHits"));
+
+  if ( readBTL_ && readUReco_ )
+    tok_BTL_ureco = iC.consumes<FTLUncalibratedRecHitCollection>(iConfig.getParameter<edm::InputTag>("BTLUncalibRecHits"));
+  if ( readETL_ && readUReco_ )
+    tok_ETL_ureco = iC.consumes<FTLUncalibratedRecHitCollection>(iConfig.getParameter<edm::InputTag>("ETLUncalibRecHits"));
+
+  if ( readBTL_ && readReco_ )
+    tok_BTL_reco = iC.consumes<FTLRecHitCollection>(iConfig.getParameter<edm::InputTag>("BTLRecHits"));
+  if ( readETL_ && readReco_ )
+    tok_ETL_reco = iC.consumes<FTLRecHitCollection>(iConfig.getParameter<edm::InputTag>("ETLRecHits"));
+
+  tok_geom = iC.esConsumes<MTDGeometry, MTDDigiGeometryRecord, edm::Transition::BeginLuminosityBlock>();
+
+
+  // --- SIM energy integration windows
+
+  btlWindows_ = integrationWindows(iConfig, "BTLIntegrationWindow");
+  etlWindows_ = integrationWindows(iConfig, "ETLIntegrationWindow");
+
+  if ( btlWindows_.empty() )
+    throw cms::Exception("Configuration") << "MTDHitAssociator: BTLIntegrationWindow needs at least one window";
+
+  btlIntegrationWindow_ = btlWindows_.front();
+  etlIntegrationWindow_ = etlWindows_.empty() ? kMTDNoWindow : etlWindows_.front();
+
+  std::sort(btlWindows_.begin(), btlWindows_.end());
+  std::sort(etlWindows_.begin(), etlWindows_.end());
+
+}
+
+
+void MTDHitAssociator::fillPSetDescription(edm::ParameterSetDescription& desc) {
+
+  desc.add<bool>("ReadBTL", true);
+  desc.add<bool>("ReadETL", true);
+  desc.add<bool>("ReadSimHits", true);
+  desc.add<bool>("ReadDigiHits", true);
+  desc.add<bool>("ReadUncalibRecHits", true);
+  desc.add<bool>("ReadRecHits", true);
+  desc.add<edm::InputTag>("BTLSimHits", edm::InputTag("g4SimHits", "FastTimerHitsBarrel"));
+  desc.add<edm::InputTag>("ETLSimHits", edm::InputTag("g4SimHits", "FastTimerHitsEndcap"));
+  desc.add<edm::InputTag>("BTLDigiHits", edm::InputTag("mix", "FTLBarrel"));
+  desc.add<edm::InputTag>("ETLDigiHits", edm::InputTag("mix", "FTLEndcap"));
+  desc.add<edm::InputTag>("BTLUncalibRecHits", edm::InputTag("mtdUncalibratedRecHits", "FTLBarrel"));
+  desc.add<edm::InputTag>("ETLUncalibRecHits", edm::InputTag("mtdUncalibratedRecHits", "FTLEndcap"));
+  desc.add<edm::InputTag>("BTLRecHits", edm::InputTag("mtdRecHits", "FTLBarrel"));
+  desc.add<edm::InputTag>("ETLRecHits", edm::InputTag("mtdRecHits", "FTLEndcap"));
+  desc.add<std::string>("BTLCrystalLayout", "barzflat");
+  desc.add<std::vector<double> >("BTLIntegrationWindow", { 25. });
+  desc.add<std::vector<double> >("ETLIntegrationWindow", { });
+  desc.add<int>("FirstBX", 0);
+  desc.add<int>("LastBX", 0);
+  desc.add<bool>("IntraEventTasks", false);
+
+}
+
+
+void MTDHitAssociator::checkGroups(const std::vector<std::string>& groups) const {
+
+  // --- A histogram group needs the tier it is named after
+  const std::map<std::string,bool> groupRead = {
+    { "BTLSim",   readBTL_ && readSim_   }, { "ETLSim",   readETL_ && readSim_   },
+    { "BTLDigi",  readBTL_ && readDigi_  }, { "ETLDigi",  readETL_ && readDigi_  },
+    { "BTLUReco", readBTL_ && readUReco_ }, { "ETLUReco", readETL_ && readUReco_ },
+    { "BTLReco",  readBTL_ && readReco_  }, { "ETLReco",  readETL_ && readReco_  },
+    { "BTLSimBX", readBTL_ && readSim_   }, { "ETLSimBX", readETL_ && readSim_   },
+    { "ETLDigiBX", readETL_ && readDigi_ },
+    { "BTLSimWindow",  readBTL_ && readSim_ }, { "BTLRecoWindow", readBTL_ && readSim_ && readReco_ },
+    { "ETLSimWindow",  readETL_ && readSim_ }, { "ETLRecoWindow", readETL_ && readSim_ && readReco_ },
+    { "BTLModule", readBTL_ && readReco_ }, { "ETLModule", readETL_ && readReco_ }
+  };
+
+  for (auto const& group: groups) {
+    auto read = groupRead.find(group);
+    if ( read != groupRead.end() && !read->second )
+      throw cms::Exception("Configuration") << "MTDHitAssociator: histogram group " << group
+					    << " enabled, but its hits are not read";
+    if ( etlWindows_.empty() && (group == "ETLSimWindow" || group == "ETLRecoWindow") )
+      throw cms::Exception("Configuration") << "MTDHitAssociator: histogram group " << group
+					    << " enabled, but ETLIntegrationWindow is empty";
+  }
+
+}
+
+
+std::shared_ptr<MTDGeometryCache>
+MTDHitAssociator::geometry(const edm::EventSetup& iSetup) const {
+
+  std::lock_guard<std::mutex> guard(geometryMutex_);
+
+  if ( geometryWatcher_.check(iSetup) || geometryCache_ == nullptr ) {
+
+    geometryCache_ = std::make_shared<MTDGeometryCache>();
+    geometryCache_->build(iSetup.getData(tok_geom), btlLayout_);
+
+    ++nGeometryBuilds_;
+
+  }
+
+  return geometryCache_;
+
+}
+
+
+// Product of the token, or an empty collection if the product is not consumed.
+template<typename T>
+static const T& getProduct(const edm::Event& iEvent, const edm::EDGetTokenT<T>& token) {
+
+  static const T empty;
+  if ( token.isUninitialized() ) return empty;
+
+  edm::Handle<T> handle;
+  iEvent.getByToken(token, handle);
+
+  return *handle;
+
+}
+
+
+// Copies of the EDM products into the MTDHitJoiner input, in their order.
+
+static void fillInput(const edm::PSimHitContainer& hits, std::vector<MTDSimHitInput>& input) {
+
+  input.resize(hits.size());
+
+  for (size_t ih = 0; ih < hits.size(); ++ih) {
+    const PSimHit& hit = hits[ih];
+    const auto& hit_pos = hit.entryPoint();
+    input[ih] = { hit.detUnitId(), int32_t(hit.trackId()), hit.tof(), hit.energyLoss(),
+		  hit_pos.x(), hit_pos.y(), hit_pos.z() };
+  }
+
+}
+
+
+// The ETL DIGI samples of the BXs of window go to samples, if the window
+// has more than the in-time BX; BTL has no samples of other BXs.
+
+static void fillInput(const BTLDigiCollection& digis, std::vector<MTDDigiHitInput>& input,
+		      const MTDBXWindow&, std::vector<MTDDigiSampleInput>& samples) {
+
+  input.resize(digis.size());
+  samples.clear();
+
+  for (size_t id = 0; id < digis.size(); ++id) {
+
+    const auto& dataFrame = digis[id];
+    MTDDigiHitInput& digi = input[id];
+
+    digi.rawId = dataFrame.id().rawId();
+
+    // --- samples 0 and 1: left and right readout sides
+    for (int iside = 0; iside < 2; ++iside) {
+      const auto& sample = dataFrame.sample(iside);
+      digi.row[iside]    = sample.row();
+      digi.column[iside] = sample.column();
+      digi.charge[iside] = sample.data();
+      digi.toa[iside]    = sample.toa();
+      digi.toa2[iside]   = sample.toa2();
+    }
+
+  }
+
+}
+
+
+static void fillInput(const ETLDigiCollection& digis, std::vector<MTDDigiHitInput>& input,
+		      const MTDBXWindow& window, std::vector<MTDDigiSampleInput>& samples) {
+
+  input.resize(digis.size());
+
+  const size_t nBX = window.size() > 1 ? window.size() : 0;
+  samples.clear();
+  samples.resize(nBX*digis.size(), MTDDigiSampleInput());
+
+  for (size_t id = 0; id < digis.size(); ++id) {
+
+    const auto& dataFrame = digis[id];
+    MTDDigiHitInput& digi = input[id];
+
+    digi = MTDDigiHitInput();
+    digi.rawId = dataFrame.id().rawId();
+
+    // --- on-time sample only, no charge if missing
+    if ( dataFrame.size() > 2 ) {
+      const auto& sample = dataFrame.sample(2);
+      digi.row[0]    = sample.row();
+      digi.column[0] = sample.column();
+      digi.charge[0] = sample.data();
+      digi.toa[0]    = sample.toa();
+    }
+
+    // --- sample 2+BX of every BX of the window
+    for (int ibx = window.first; ibx <= window.last && nBX != 0; ++ibx) {
+      const int isample = 2 + ibx;
+      if ( isample < 0 || isample >= int(dataFrame.size()) ) continue;
+      const auto& sample = dataFrame.sample(isample);
+      samples[id*nBX + window.slot(ibx)] = { sample.data(), sample.toa() };
+    }
+
+  }
+
+}
+
+
+static void fillInput(const FTLUncalibratedRecHitCollection& urecHits, std::vector<MTDURecoHitInput>& input) {
+
+  input.resize(urecHits.size());
+
+  for (size_t ih = 0; ih < urecHits.size(); ++ih) {
+    const auto& urecHit = urecHits[ih];
+    input[ih] = { urecHit.id().rawId(),
+		  { urecHit.amplitude().first, urecHit.amplitude().second },
+		  { urecHit.time().first, urecHit.time().second } };
+  }
+
+}
+
+
+static void fillInput(const FTLRecHitCollection& recHits, std::vector<MTDRecoHitInput>& input) {
+
+  input.resize(recHits.size());
+
+  for (size_t ih = 0; ih < recHits.size(); ++ih) {
+    const auto& recHit = recHits[ih];
+    input[ih] = { recHit.id().rawId(), recHit.energy(), recHit.time() };
+  }
+
+}
+
+
+void MTDHitAssociator::associate(const edm::Event& iEvent, const MTDGeometryCache& geoCache, const Outputs& outputs,
+				 Scratch& scratch, MTDHitAssociation& association) const {
+
+#ifdef MTD_INSTRUMENTATION
+  MTDEventStats& stats = *scratch.stats;
+#endif
+
+  association.clear();
+  association.window = bxWindow_;
+
+  const MTDCellIndex& cells = geoCache.cells();
+
+  // The tiers which are not read are empty
+  const edm::PSimHitContainer& BTL_sim = getProduct(iEvent, tok_BTL_sim);
+  const edm::PSimHitContainer& ETL_sim = getProduct(iEvent, tok_ETL_sim);
+
+  const BTLDigiCollection& BTL_digi = getProduct(iEvent, tok_BTL_digi);
+  const ETLDigiCollection& ETL_digi = getProduct(iEvent, tok_ETL_digi);
+
+  const FTLUncalibratedRecHitCollection& BTL_ureco = getProduct(iEvent, tok_BTL_ureco);
+  const FTLUncalibratedRecHitCollection& ETL_ureco = getProduct(iEvent, tok_ETL_ureco);
+
+  const FTLRecHitCollection& BTL_reco = getProduct(iEvent, tok_BTL_reco);
+  const FTLRecHitCollection& ETL_reco = getProduct(iEvent, tok_ETL_reco);
+
+  auto fillInputs = [&](Scratch::Detector& d, const edm::PSimHitContainer& simHits, const auto& digis,
+			const FTLUncalibratedRecHitCollection& urecHits, const FTLRecHitCollection& recHits) {
+    fillInput(simHits, d.simInput);
+    fillInput(digis, d.digiInput, bxWindow_, d.digiBXInput);
+    fillInput(urecHits, d.urecoInput);
+    fillInput(recHits, d.recoInput);
+    return MTDTierInputs{ d.simInput, d.digiInput, d.urecoInput, d.recoInput, d.digiBXInput };
+  };
+
+
+  // ==============================================================================
+  //  BTL
+  // ==============================================================================
+
+  auto associateBTL = [&]() {
+
+    MTDHitJoiner& joiner = scratch.btl.joiner;
+
+    MTD_STAGE_START(stats, kStageBTLInput);
+    const MTDTierInputs in = fillInputs(scratch.btl, BTL_sim, BTL_digi, BTL_ureco, BTL_reco);
+    MTD_STAGE_STOP(stats, kStageBTLInput);
+
+    MTD_STAGE_START(stats, kStageBTLSort);
+    joiner.order(in, bxWindow_);
+    MTD_STAGE_STOP(stats, kStageBTLSort);
+
+    MTDJoinSlots slots;
+    if ( outputs.btlBX ) slots.bx = &association.btl_bx;
+    if ( outputs.btlWindows ) {
+      association.btlWindows = btlWindows_;
+      slots.windows = btlWindows_;
+      slots.windowEnergy = &association.btl_energy;
+    }
+
+    MTD_STAGE_START(stats, kStageBTLJoin);
+    joiner.joinBTL(in, btlIntegrationWindow_, [&](uint32_t rawId, uint32_t& cell) {
+	cell = cells.btlCell(BTLDetId(rawId));
+	return cell == MTDCellIndex::kInvalid ? -1 : 0;
+      }, &association.btl_hits, association.counts, slots);
+    MTD_STAGE_STOP(stats, kStageBTLJoin);
+
+    MTD_COUNT(stats, kCountBTLSimHits, in.sim.size);
+    MTD_COUNT(stats, kCountBTLDigiHits, in.digi.size);
+    MTD_COUNT(stats, kCountBTLURecoHits, in.ureco.size);
+    MTD_COUNT(stats, kCountBTLRecoHits, in.reco.size);
+
+    MTD_STAGE_START(stats, kStageBTLPositions);
+    btlPositions(geoCache, outputs, association);
+    MTD_STAGE_STOP(stats, kStageBTLPositions);
+
+  };
+
+
+  // ==============================================================================
+  //  ETL
+  // ==============================================================================
+
+  auto associateETL = [&]() {
+
+    MTDHitJoiner& joiner = scratch.etl.joiner;
+
+    MTD_STAGE_START(stats, kStageETLInput);
+    const MTDTierInputs in = fillInputs(scratch.etl, ETL_sim, ETL_digi, ETL_ureco, ETL_reco);
+    MTD_STAGE_STOP(stats, kStageETLInput);
+
+    MTD_STAGE_START(stats, kStageETLSort);
+    joiner.order(in, bxWindow_);
+    MTD_STAGE_STOP(stats, kStageETLSort);
+
+    MTDJoinSlots slots;
+    if ( outputs.etlBX ) slots.bx = association.etl_bx;
+    if ( outputs.etlWindows && !etlWindows_.empty() ) {
+      association.etlWindows = etlWindows_;
+      slots.windows = etlWindows_;
+      slots.windowEnergy = association.etl_energy;
+    }
+
+    MTD_STAGE_START(stats, kStageETLJoin);
+    joiner.joinETL(in, etlIntegrationWindow_, [&](uint32_t rawId, uint32_t& cell) {
+	cell = cells.etlCell(ETLDetId(rawId));
+	return cell == MTDCellIndex::kInvalid ? -1 : int(geoCache.etl(cell).coords.side);
+      }, association.etl_hits, association.counts, slots);
+    MTD_STAGE_STOP(stats, kStageETLJoin);
+
+    MTD_COUNT(stats, kCountETLSimHits, in.sim.size);
+    MTD_COUNT(stats, kCountETLDigiHits, in.digi.size);
+    MTD_COUNT(stats, kCountETLURecoHits, in.ureco.size);
+    MTD_COUNT(stats, kCountETLRecoHits, in.reco.size);
+
+    MTD_STAGE_START(stats, kStageETLPositions);
+    etlPositions(geoCache, outputs, association);
+    MTD_STAGE_STOP(stats, kStageETLPositions);
+
+  };
+
+
+  // The two subdetectors have their own scratch stores and outputs, and
+  // count their cells in their own fields of association.counts: with
+  // IntraEventTasks, ETL is associated in a task of the framework arena
+  // while BTL is here, the result being the same.
+
+  if ( intraEventTasks_ ) {
+    tbb::task_group tasks;
+    tasks.run(associateETL);
+    associateBTL();
+    tasks.wait();
+  }
+  else {
+    associateBTL();
+    associateETL();
+  }
+
+  MTD_COUNT(stats, kCountBTLRecords, association.btl_hits.size());
+  MTD_COUNT(stats, kCountETLRecords, association.etl_hits[0].size() + association.etl_hits[1].size());
+
+}
+
+
+// The hit position is the crystal center for BTL, the DIGI pad center for
+// ETL (the module center for the records without DIGI). The transforms of
+// the SIM hit and ETL hit positions are done only for the outputs which
+// need them.
+
+void MTDHitAssociator::btlPositions(const MTDGeometryCache& geoCache, const Outputs& outputs,
+				    MTDHitAssociation& association) const {
+
+  const auto& btl_hits = association.btl_hits;
+  auto& btl_pos = association.btl_pos;
+
+  btl_pos.resize(btl_hits.size());
+
+  for (size_t ih=0; ih<btl_hits.size(); ++ih) {
+
+    const MTDJoinedHit& hit = btl_hits[ih];
+    const MTDGeometryCache::BTLCell& cellGeom = geoCache.btl(hit.cell);
+    MTDHitPosition& pos = btl_pos[ih];
+
+    pos = MTDHitPosition();
+
+    pos.x    = cellGeom.x;
+    pos.y    = cellGeom.y;
+    pos.z    = cellGeom.z;
+    pos.eta  = cellGeom.eta;
+    pos.phi  = cellGeom.phi;
+    pos.iphi = cellGeom.coords.iphi;
+    pos.ieta = cellGeom.coords.ieta;
+
+    if ( outputs.btlSimPositions && hit.info.sim_time != 0. && hit.info.reco_energy >= outputs.btlSimMinEnergy ) {
+
+      // Get the SIM hit global position
+      Local3DPoint simscaled(0.1*hit.info.sim_x,0.1*hit.info.sim_y,0.1*hit.info.sim_z);
+      simscaled = cellGeom.topo->pixelToModuleLocalPoint(simscaled,cellGeom.coords.row,cellGeom.coords.column);
+      const auto& global_pos = cellGeom.det->toGlobal(simscaled);
+
+      pos.sim_x   = global_pos.x();
+      pos.sim_y   = global_pos.y();
+      pos.sim_z   = global_pos.z();
+      pos.sim_eta = global_pos.eta();
+      pos.sim_phi = global_pos.phi();
+
+    }
+
+  }
+
+}
+
+
+void MTDHitAssociator::etlPositions(const MTDGeometryCache& geoCache, const Outputs& outputs,
+				    MTDHitAssociation& association) const {
+
+  const auto& etl_hits = association.etl_hits;
+  auto& etl_pos = association.etl_pos;
+
+  for (int idet=0; idet<2; ++idet){
+
+    etl_pos[idet].resize(etl_hits[idet].size());
+
+    for (size_t ih=0; ih<etl_hits[idet].size(); ++ih) {
+
+      const MTDJoinedHit& hit = etl_hits[idet][ih];
+      const MTDGeometryCache::ETLCell& cellGeom = geoCache.etl(hit.cell);
+      MTDHitPosition& pos = etl_pos[idet][ih];
+
+      pos = MTDHitPosition();
+
+      pos.iphi = cellGeom.coords.module;
+      pos.ieta = cellGeom.coords.ring;
+
+      if ( outputs.etlPositions ) {
+
+	Local3DPoint loc_pos(0., 0., 0.);
+	if ( hit.info.digi_charge[0] != 0 )
+	  loc_pos = Local3DPoint((hit.info.digi_row[0]+0.5)*cellGeom.pitch_x,
+				 (hit.info.digi_col[0]+0.5)*cellGeom.pitch_y,
+				 0.);
+	const auto& global_pos = cellGeom.det->toGlobal(loc_pos);
+
+	pos.x   = global_pos.x();
+	pos.y   = global_pos.y();
+	pos.z   = global_pos.z();
+	pos.eta = global_pos.eta();
+	pos.phi = global_pos.phi();
+
+      }
+
+      if ( outputs.etlSimPositions && hit.info.sim_time != 0. ) {
+
+	// Get the SIM hit global position
+	Local3DPoint simscaled(0.1*hit.info.sim_x,0.1*hit.info.sim_y,0.1*hit.info.sim_z);
+	const auto& global_pos = cellGeom.det->toGlobal(simscaled);
+
+	pos.sim_x   = global_pos.x();
+	pos.sim_y   = global_pos.y();
+	pos.sim_z   = global_pos.z();
+	pos.sim_eta = global_pos.eta();
+	pos.sim_phi = global_pos.phi();
+
+      }
+
+    }
+
+  }
+
+}
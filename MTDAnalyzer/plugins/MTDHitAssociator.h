@@ -0,0 +1,183 @@
+#ifndef MTDAnalyzer_plugins_MTDHitAssociator_h
+#define MTDAnalyzer_plugins_MTDHitAssociator_h
+
+#include <limits>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "FWCore/Framework/interface/ConsumesCollector.h"
+#include "FWCore/Framework/interface/ESWatcher.h"
+#include "FWCore/Framework/interface/Frameworkfwd.h"
+#include "FWCore/ParameterSet/interface/ParameterSet.h"
+#include "FWCore/ParameterSet/interface/ParameterSetDescription.h"
+#include "FWCore/Utilities/interface/EDGetToken.h"
+#include "FWCore/Utilities/interface/ESGetToken.h"
+
+#include "SimDataFormats/TrackingHit/interface/PSimHitContainer.h"
+
+#include "DataFormats/FTLDigi/interface/FTLDigiCollections.h"
+#include "DataFormats/FTLRecHit/interface/FTLRecHitCollections.h"
+
+#include "Geometry/Records/interface/MTDDigiGeometryRecord.h"
+
+#include "MTDtools/MTDAnalyzer/interface/MTDHitAssociation.h"
+
+#include "MTDtools/MTDCore/interface/MTDBunchCrossing.h"
+#include "MTDtools/MTDCore/interface/MTDHitInput.h"
+#include "MTDtools/MTDCore/interface/MTDHitJoiner.h"
+
+#include "MTDGeometryCache.h"
+#include "MTDInstrumentation.h"
+
+
+// Join of the MTD hit collections of an event into an MTDHitAssociation,
+// shared by MTDHitAssociationProducer and by MTDAnalyzer without
+// HitAssociation. It holds their common configuration: the detectors and
+// tiers read (ReadBTL, ..., ReadRecHits) and their tokens, the SIM energy
+// integration windows (BTLIntegrationWindow, ETLIntegrationWindow) and the
+// bunch crossing window (FirstBX, LastBX), and it builds the geometry
+// lookup tables of the luminosity blocks, with the crystal indices of the
+// BTL crystal layout of the geometry (BTLCrystalLayout).
+//
+// The tiers of each subdetector are copied to the joiner input, put in
+// DetId order and merged into one record per cell (see MTDHitJoiner). The
+// SIM hits and ETL DIGI samples of the bunch crossing window, and the SIM
+// energies in all the integration windows, are accumulated in the same
+// pass. With IntraEventTasks, BTL and ETL are associated concurrently.
+
+class MTDHitAssociator {
+
+public:
+
+  // --- per-stream scratch stores, of each subdetector
+  struct Scratch {
+
+    struct Detector {
+
+      // --- hits of the subdetector, as input of the joiner
+      std::vector<MTDSimHitInput> simInput;
+      std::vector<MTDDigiHitInput> digiInput;
+      std::vector<MTDURecoHitInput> urecoInput;
+      std::vector<MTDRecoHitInput> recoInput;
+      std::vector<MTDDigiSampleInput> digiBXInput;
+
+      MTDHitJoiner joiner;
+
+    };
+
+    Detector btl;
+    Detector etl;
+
+#ifdef MTD_INSTRUMENTATION
+    MTDEventStats* stats = nullptr;    // of the stream, set by the module
+#endif
+
+  };
+
+  // --- optional outputs of an event: all of them by default
+  struct Outputs {
+
+    // --- BX slots and SIM energies per integration window
+    bool btlBX = true;
+    bool etlBX = true;
+    bool btlWindows = true;
+    bool etlWindows = true;
+
+    // --- SIM positions of the BTL records with RECO energy from
+    //     btlSimMinEnergy, ETL SIM and hit positions
+    bool btlSimPositions = true;
+    float btlSimMinEnergy = -std::numeric_limits<float>::max();
+    bool etlSimPositions = true;
+    bool etlPositions = true;
+
+  };
+
+  MTDHitAssociator(const edm::ParameterSet& iConfig, edm::ConsumesCollector&& iC);
+
+  // --- parameters of the associator, with their defaults, added to the
+  //     descriptions of the modules which own one
+  static void fillPSetDescription(edm::ParameterSetDescription& desc);
+
+  // --- throws if a histogram group needs a tier which is not read
+  void checkGroups(const std::vector<std::string>& groups) const;
+
+  // --- lookup tables of the MTDDigiGeometryRecord IOV of iSetup, shared by
+  //     its luminosity blocks and rebuilt only when the record changes;
+  //     thread-safe
+  std::shared_ptr<MTDGeometryCache> geometry(const edm::EventSetup& iSetup) const;
+
+  unsigned int nGeometryBuilds() const { return nGeometryBuilds_; }
+
+  // --- releases the lookup tables, at the end of the job
+  void releaseGeometry() { geometryCache_.reset(); }
+
+  // --- records of an event, replacing those of association
+  void associate(const edm::Event& iEvent, const MTDGeometryCache& geoCache, const Outputs& outputs,
+		 Scratch& scratch, MTDHitAssociation& association) const;
+
+  const MTDBXWindow& bxWindow() const { return bxWindow_; }
+
+
+private:
+
+  // --- positions of the records
+  void btlPositions(const MTDGeometryCache& geoCache, const Outputs& outputs, MTDHitAssociation& association) const;
+  void etlPositions(const MTDGeometryCache& geoCache, const Outputs& outputs, MTDHitAssociation& association) const;
+
+  // --- SIM energy integration windows [ns]: the first configured one is
+  //     the window of the joined records (none for ETL if none is
+  //     configured), all of them, in increasing order, make the window
+  //     energies
+  float btlIntegrationWindow_;
+  float etlIntegrationWindow_;
+  std::vector<float> btlWindows_;
+  std::vector<float> etlWindows_;
+
+  const MTDBXWindow bxWindow_;
+
+  bool readBTL_;
+  bool readETL_;
+  bool readSim_;
+  bool readDigi_;
+  bool readUReco_;
+  bool readReco_;
+
+  // --- BTL and ETL associated in concurrent tasks
+  const bool intraEventTasks_;
+
+  // --- crystal layout of the BTL geometry
+  const BTLDetId::CrysLayout btlLayout_;
+
+  // --- MTD SIM hits
+  edm::EDGetTokenT<edm::PSimHitContainer> tok_BTL_sim;
+  edm::EDGetTokenT<edm::PSimHitContainer> tok_ETL_sim;
+
+  // --- MTD DIGI hits
+  edm::EDGetTokenT<BTLDigiCollection> tok_BTL_digi;
+  edm::EDGetTokenT<ETLDigiCollection> tok_ETL_digi;
+
+  // --- MTD uncalibrated RECO hits
+  edm::EDGetTokenT<FTLUncalibratedRecHitCollection> tok_BTL_ureco;
+  edm::EDGetTokenT<FTLUncalibratedRecHitCollection> tok_ETL_ureco;
+
+  // --- MTD RECO hits
+  edm::EDGetTokenT<FTLRecHitCollection> tok_BTL_reco;
+  edm::EDGetTokenT<FTLRecHitCollection> tok_ETL_reco;
+
+  // --- MTD geometry, read at the beginning of the luminosity blocks
+  edm::ESGetToken<MTDGeometry, MTDDigiGeometryRecord> tok_geom;
+
+  // --- Geometry-derived lookup tables, shared by all the luminosity blocks
+  //     of the same MTDDigiGeometryRecord IOV and rebuilt only when the
+  //     record changes. Accessed under geometryMutex_.
+  mutable edm::ESWatcher<MTDDigiGeometryRecord> geometryWatcher_;
+  mutable std::shared_ptr<MTDGeometryCache> geometryCache_;
+  mutable unsigned int nGeometryBuilds_;
+  mutable std::mutex geometryMutex_;
+
+};
+
+
+#endif
@@ -0,0 +1,172 @@
+#include "MTDInstrumentation.h"
+
+#ifdef MTD_INSTRUMENTATION
+
+#include <algorithm>
+#include <cmath>
+#include <iomanip>
+
+
+static const char* const stageNames[kNStages] = {
+  "Event",
+  "BTLInput", "BTLSort", "BTLJoin", "BTLPositions",
+  "ETLInput", "ETLSort", "ETLJoin", "ETLPositions",
+  "Ntuple", "HitCache", "Fill", "Calibration", "Resolution", "Modules"
+};
+
+static const char* const counterNames[kNCounters] = {
+  "BTLSimHits", "BTLDigiHits", "BTLURecoHits", "BTLRecoHits", "BTLRecords",
+  "ETLSimHits", "ETLDigiHits", "ETLURecoHits", "ETLRecoHits", "ETLRecords",
+  "StoreGrowth"
+};
+
+
+// ==============================================================================
+//  MTDDistribution
+// ==============================================================================
+
+void MTDDistribution::add(double x) {
+
+  if ( buckets_.empty() ) buckets_.resize(kNOctaves*kBucketsPerOctave + 1);
+
+  ++n_;
+  sum_ += x;
+  max_ = std::max(max_, x);
+
+  const int bucket = x < 1. ? 0 : 1 + std::min(int(std::log2(x)*kBucketsPerOctave), kNOctaves*kBucketsPerOctave - 1);
+  ++buckets_[bucket];
+
+}
+
+
+void MTDDistribution::add(const MTDDistribution& other) {
+
+  if ( other.n_ == 0 ) return;
+  if ( buckets_.empty() ) buckets_.resize(other.buckets_.size());
+
+  n_ += other.n_;
+  sum_ += other.sum_;
+  max_ = std::max(max_, other.max_);
+
+  for (size_t ib = 0; ib < buckets_.size(); ++ib)
+    buckets_[ib] += other.buckets_[ib];
+
+}
+
+
+double MTDDistribution::quantile(double q) const {
+
+  if ( n_ == 0 ) return 0.;
+
+  // --- bucket of the rank, at the center of its logarithmic range
+  const uint64_t rank = std::min(n_ - 1, uint64_t(q*n_));
+
+  uint64_t below = 0;
+  for (size_t ib = 0; ib < buckets_.size(); ++ib) {
+    below += buckets_[ib];
+    if ( below > rank )
+      return ib == 0 ? 0. : std::min(max_, std::exp2((ib - 0.5)/kBucketsPerOctave));
+  }
+
+  return max_;
+
+}
+
+
+// ==============================================================================
+//  MTDEventStats
+// ==============================================================================
+
+MTDEventStats::MTDEventStats() {
+
+  beginEvent();
+
+}
+
+
+void MTDEventStats::beginEvent() {
+
+  std::fill(elapsed_, elapsed_+kNStages, std::chrono::steady_clock::duration::zero());
+  std::fill(counts_, counts_+kNCounters, 0);
+  std::fill(ran_, ran_+kNStages, false);
+
+}
+
+
+void MTDEventStats::endEvent() {
+
+  for (int is = 0; is < kNStages; ++is) {
+    if ( ran_[is] )
+      times_[is].add(std::chrono::duration<double,std::nano>(elapsed_[is]).count());
+  }
+
+  for (int ic = 0; ic < kNCounters; ++ic)
+    counters_[ic].add(counts_[ic]);
+
+}
+
+
+void MTDEventStats::add(const MTDEventStats& other) {
+
+  for (int is = 0; is < kNStages; ++is)
+    times_[is].add(other.times_[is]);
+
+  for (int ic = 0; ic < kNCounters; ++ic)
+    counters_[ic].add(other.counters_[ic]);
+
+}
+
+
+void MTDEventStats::report(std::ostream& os) const {
+
+  os << std::fixed << std::setprecision(1)
+     << std::setw(14) << "stage [us]" << std::setw(10) << "events" << std::setw(10) << "mean"
+     << std::setw(10) << "p50" << std::setw(10) << "p90" << std::setw(10) << "p99" << std::setw(10) << "max" << "\n";
+
+  for (int is = 0; is < kNStages; ++is) {
+    const MTDDistribution& t = times_[is];
+    os << std::setw(14) << stageNames[is] << std::setw(10) << t.n() << std::setw(10) << 1e-3*t.mean()
+       << std::setw(10) << 1e-3*t.quantile(0.5) << std::setw(10) << 1e-3*t.quantile(0.9)
+       << std::setw(10) << 1e-3*t.quantile(0.99) << std::setw(10) << 1e-3*t.max() << "\n";
+  }
+
+  os << std::setw(14) << "per event" << std::setw(10) << "" << std::setw(10) << "mean"
+     << std::setw(10) << "p50" << std::setw(10) << "p90" << std::setw(10) << "p99" << std::setw(10) << "max" << "\n";
+
+  for (int ic = 0; ic < kNCounters; ++ic) {
+    const MTDDistribution& c = counters_[ic];
+    os << std::setw(14) << counterNames[ic] << std::setw(10) << "" << std::setw(10) << c.mean()
+       << std::setw(10) << c.quantile(0.5) << std::setw(10) << c.quantile(0.9)
+       << std::setw(10) << c.quantile(0.99) << std::setw(10) << c.max() << "\n";
+  }
+
+}
+
+
+void MTDEventStats::writeJSON(std::ostream& os) const {
+
+  auto distribution = [&](const MTDDistribution& d, double scale) {
+    os << "{\"events\": " << d.n() << ", \"mean\": " << scale*d.mean()
+       << ", \"p50\": " << scale*d.quantile(0.5) << ", \"p90\": " << scale*d.quantile(0.9)
+       << ", \"p99\": " << scale*d.quantile(0.99) << ", \"max\": " << scale*d.max() << "}";
+  };
+
+  os << std::setprecision(6) << "{\n  \"stages_us\": {\n";
+  for (int is = 0; is < kNStages; ++is) {
+    os << "    \"" << stageNames[is] << "\": ";
+    distribution(times_[is], 1e-3);
+    os << (is+1 < kNStages ? ",\n" : "\n");
+  }
+
+  os << "  },\n  \"counters_per_event\": {\n";
+  for (int ic = 0; ic < kNCounters; ++ic) {
+    os << "    \"" << counterNames[ic] << "\": ";
+    distribution(counters_[ic], 1.);
+    os << (ic+1 < kNCounters ? ",\n" : "\n");
+  }
+
+  os << "  }\n}\n";
+
+}
+
+#endif
@@ -0,0 +1,196 @@
+#ifndef MTDAnalyzer_plugins_MTDInstrumentation_h
+#define MTDAnalyzer_plugins_MTDInstrumentation_h
+
+#include <chrono>
+#include <cstdint>
+#include <ostream>
+#include <vector>
+
+
+// Per-stage timing and counters of MTDAnalyzer::analyze(), compiled only
+// with -DMTD_INSTRUMENTATION (see plugins/BuildFile.xml). Without it the
+// MTD_EVENT, MTD_STAGE* and MTD_COUNT macros expand to nothing and no state
+// is kept.
+//
+// Each stream times the stages of its events with the steady clock and
+// adds the per-event times and counts to distributions, which are added
+// at the end of the stream and reported at the end of the job. Different
+// stages and counters of an event can be timed and counted by concurrent
+// tasks; the time of a stage is then its own, not the event time it
+// takes.
+
+enum MTDStage {
+
+  kStageEvent,
+
+  kStageBTLInput,       // copy of the EDM products to the joiner input
+  kStageBTLSort,        // SIM hits radix sort, DetId order of the other tiers
+  kStageBTLJoin,        // SIM accumulation and merge-join of the four tiers
+  kStageBTLPositions,   // geometry transforms
+
+  kStageETLInput,
+  kStageETLSort,
+  kStageETLJoin,
+  kStageETLPositions,
+
+  kStageNtuple,
+  kStageHitCache,
+  kStageFill,           // histograms, BTL and ETL
+  kStageCalibration,    // per-channel calibration sums
+  kStageResolution,     // resolution sketches
+  kStageModules,        // per-module histograms
+
+  kNStages
+
+};
+
+enum MTDCounter {
+
+  kCountBTLSimHits,
+  kCountBTLDigiHits,
+  kCountBTLURecoHits,
+  kCountBTLRecoHits,
+  kCountBTLRecords,
+
+  kCountETLSimHits,
+  kCountETLDigiHits,
+  kCountETLURecoHits,
+  kCountETLRecoHits,
+  kCountETLRecords,
+
+  kCountStoreGrowth,    // reallocations of the stream record and position stores
+
+  kNCounters
+
+};
+
+
+#ifdef MTD_INSTRUMENTATION
+
+// Distribution of a per-event quantity: number of events, sum, maximum and
+// a histogram of logarithmic buckets, 1/32 of a factor 2 wide (2%), for the
+// quantiles.
+
+class MTDDistribution {
+
+public:
+
+  MTDDistribution() : n_(0), sum_(0.), max_(0.) {}
+
+  void add(double x);
+  void add(const MTDDistribution& other);
+
+  uint64_t n() const { return n_; }
+  double mean() const { return n_ > 0 ? sum_/n_ : 0.; }
+  double max() const { return max_; }
+
+  // --- q-quantile, within 2%
+  double quantile(double q) const;
+
+
+private:
+
+  static constexpr int kBucketsPerOctave = 32;
+  static constexpr int kNOctaves = 48;
+
+  uint64_t n_;
+  double sum_;
+  double max_;
+
+  std::vector<uint64_t> buckets_;   // [0] for x < 1, allocated on the first add()
+
+};
+
+
+class MTDEventStats {
+
+public:
+
+  MTDEventStats();
+
+  void beginEvent();
+  void endEvent();
+
+  void start(MTDStage stage) { start_[stage] = std::chrono::steady_clock::now(); }
+
+  void stop(MTDStage stage) {
+    elapsed_[stage] += std::chrono::steady_clock::now() - start_[stage];
+    ran_[stage] = true;
+  }
+
+  void count(MTDCounter counter, uint64_t n) { counts_[counter] += n; }
+
+  // --- adds the distributions of another stream
+  void add(const MTDEventStats& other);
+
+  // --- table of the stage times [us] and of the counters per event
+  void report(std::ostream& os) const;
+  void writeJSON(std::ostream& os) const;
+
+
+private:
+
+  std::chrono::steady_clock::time_point start_[kNStages];
+  std::chrono::steady_clock::duration elapsed_[kNStages];
+  bool ran_[kNStages];                   // per stage: stages of concurrent tasks
+  uint64_t counts_[kNCounters];
+
+  MTDDistribution times_[kNStages];      // [ns], events in which the stage ran
+  MTDDistribution counters_[kNCounters];
+
+};
+
+
+// Scoped timer of a stage.
+class MTDStageTimer {
+
+public:
+
+  MTDStageTimer(MTDEventStats& stats, MTDStage stage) : stats_(stats), stage_(stage) { stats_.start(stage_); }
+  ~MTDStageTimer() { stats_.stop(stage_); }
+
+private:
+
+  MTDEventStats& stats_;
+  const MTDStage stage_;
+
+};
+
+
+// Scoped event: whole-event timer, statistics recorded at the end of the
+// scope, whichever way analyze() returns.
+class MTDEventScope {
+
+public:
+
+  explicit MTDEventScope(MTDEventStats& stats) : stats_(stats) { stats_.beginEvent(); stats_.start(kStageEvent); }
+  ~MTDEventScope() { stats_.stop(kStageEvent); stats_.endEvent(); }
+
+private:
+
+  MTDEventStats& stats_;
+
+};
+
+
+#define MTD_INSTRUMENTATION_CAT2(a, b) a##b
+#define MTD_INSTRUMENTATION_CAT(a, b) MTD_INSTRUMENTATION_CAT2(a, b)
+
+#define MTD_EVENT(stats)              MTDEventScope MTD_INSTRUMENTATION_CAT(mtdEvent_, __LINE__)(stats)
+#define MTD_STAGE(stats, stage)       MTDStageTimer MTD_INSTRUMENTATION_CAT(mtdStage_, __LINE__)((stats), (stage))
+#define MTD_STAGE_START(stats, stage) (stats).start(stage)
+#define MTD_STAGE_STOP(stats, stage)  (stats).stop(stage)
+#define MTD_COUNT(stats, counter, n)  (stats).count((counter), (n))
+
+#else
+
+#define MTD_EVENT(stats)
+#define MTD_STAGE(stats, stage)
+#define MTD_STAGE_START(stats, stage)
+#define MTD_STAGE_STOP(stats, stage)
+#define MTD_COUNT(stats, counter, n)
+
+#endif
+
+
+#endif
@@ -0,0 +1,207 @@
+#include "MTDNtuple.h"
+
+#include "CommonTools/UtilAlgos/interface/TFileService.h"
+#include "DataFormats/Provenance/interface/EventID.h"
+#include "FWCore/Utilities/interface/Exception.h"
+
+#include "TTree.h"
+
+
+// ==============================================================================
+//  MTDNtuple::Columns
+// ==============================================================================
+
+// The vectors keep some capacity even when empty, so that data() always
+// gives a valid branch address.
+
+MTDNtuple::Columns::Columns() {
+
+  const size_t capacity = 64;
+
+  subdet.reserve(capacity);
+  side.reserve(capacity);
+  rawId.reserve(capacity);
+  x.reserve(capacity);
+  y.reserve(capacity);
+  z.reserve(capacity);
+
+  sim_energy.reserve(capacity);
+  sim_time.reserve(capacity);
+  sim_x.reserve(capacity);
+  sim_y.reserve(capacity);
+  sim_z.reserve(capacity);
+  sim_ntrk.reserve(capacity);
+
+  for (int is = 0; is < 2; ++is) {
+    digi_row[is].reserve(capacity);
+    digi_col[is].reserve(capacity);
+    digi_charge[is].reserve(capacity);
+    digi_time1[is].reserve(capacity);
+    digi_time2[is].reserve(capacity);
+    ureco_charge[is].reserve(capacity);
+    ureco_time[is].reserve(capacity);
+  }
+
+  reco_energy.reserve(capacity);
+  reco_time.reserve(capacity);
+
+}
+
+
+void MTDNtuple::Columns::clear() {
+
+  subdet.clear();
+  side.clear();
+  rawId.clear();
+  x.clear();
+  y.clear();
+  z.clear();
+
+  sim_energy.clear();
+  sim_time.clear();
+  sim_x.clear();
+  sim_y.clear();
+  sim_z.clear();
+  sim_ntrk.clear();
+
+  for (int is = 0; is < 2; ++is) {
+    digi_row[is].clear();
+    digi_col[is].clear();
+    digi_charge[is].clear();
+    digi_time1[is].clear();
+    digi_time2[is].clear();
+    ureco_charge[is].clear();
+    ureco_time[is].clear();
+  }
+
+  reco_energy.clear();
+  reco_time.clear();
+
+}
+
+
+void MTDNtuple::Columns::push_back(Subdet sd, int sd_side, const MTDJoinedHit& hit, float gx, float gy, float gz) {
+
+  const MTDinfo& info = hit.info;
+
+  subdet.push_back(sd);
+  side.push_back(sd_side);
+  rawId.push_back(hit.rawId);
+  x.push_back(gx);
+  y.push_back(gy);
+  z.push_back(gz);
+
+  sim_energy.push_back(info.sim_energy);
+  sim_time.push_back(info.sim_time);
+  sim_x.push_back(info.sim_x);
+  sim_y.push_back(info.sim_y);
+  sim_z.push_back(info.sim_z);
+  sim_ntrk.push_back(info.sim_ntrk);
+
+  // the DIGI rows, columns, ADC and TDC counts fit in 16 bits
+  for (int is = 0; is < 2; ++is) {
+    digi_row[is].push_back(info.digi_row[is]);
+    digi_col[is].push_back(info.digi_col[is]);
+    digi_charge[is].push_back(info.digi_charge[is]);
+    digi_time1[is].push_back(info.digi_time1[is]);
+    digi_time2[is].push_back(info.digi_time2[is]);
+    ureco_charge[is].push_back(info.ureco_charge[is]);
+    ureco_time[is].push_back(info.ureco_time[is]);
+  }
+
+  reco_energy.push_back(info.reco_energy);
+  reco_time.push_back(info.reco_time);
+
+}
+
+
+// ==============================================================================
+//  MTDNtuple
+// ==============================================================================
+
+template<typename F>
+void MTDNtuple::forEachColumn(Columns& c, F f) {
+
+  f("subdet", -1, 'b', c.subdet.data());
+  f("side",   -1, 'b', c.side.data());
+  f("rawId",  -1, 'i', c.rawId.data());
+  f("x",      -1, 'F', c.x.data());
+  f("y",      -1, 'F', c.y.data());
+  f("z",      -1, 'F', c.z.data());
+
+  f("sim_energy", -1, 'F', c.sim_energy.data());
+  f("sim_time",   -1, 'F', c.sim_time.data());
+  f("sim_x",      -1, 'F', c.sim_x.data());
+  f("sim_y",      -1, 'F', c.sim_y.data());
+  f("sim_z",      -1, 'F', c.sim_z.data());
+  f("sim_ntrk",   -1, 's', c.sim_ntrk.data());
+
+  for (int is = 0; is < 2; ++is) {
+    f("digi_row",     is, 's', c.digi_row[is].data());
+    f("digi_col",     is, 's', c.digi_col[is].data());
+    f("digi_charge",  is, 's', c.digi_charge[is].data());
+    f("digi_time1",   is, 's', c.digi_time1[is].data());
+    f("digi_time2",   is, 's', c.digi_time2[is].data());
+    f("ureco_charge", is, 'F', c.ureco_charge[is].data());
+    f("ureco_time",   is, 'F', c.ureco_time[is].data());
+  }
+
+  f("reco_energy", -1, 'F', c.reco_energy.data());
+  f("reco_time",   -1, 'F', c.reco_time.data());
+
+}
+
+
+MTDNtuple::MTDNtuple(TFileService& fs, const std::string& compression, int level) :
+  run_(0), lumi_(0), event_(0), n_(0) {
+
+  // ROOT::RCompressionSetting::EAlgorithm values
+  int algorithm = 0;
+  if ( compression == "ZLIB" ) algorithm = 1;
+  else if ( compression == "LZMA" ) algorithm = 2;
+  else if ( compression == "LZ4" ) algorithm = 4;
+  else if ( compression == "ZSTD" ) algorithm = 5;
+  else
+    throw cms::Exception("Configuration") << "MTDNtuple: unknown compression algorithm " << compression;
+
+  if ( level < 0 || level > 9 )
+    throw cms::Exception("Configuration") << "MTDNtuple: compression level " << level << " not in [0,9]";
+
+  const int settings = 100*algorithm + level;
+
+  tree_ = fs.make<TTree>("MTDHits", "MTD joined hits");
+
+  std::vector<TBranch*> scalars;
+  scalars.push_back(tree_->Branch("run", &run_, "run/i"));
+  scalars.push_back(tree_->Branch("lumi", &lumi_, "lumi/i"));
+  scalars.push_back(tree_->Branch("event", &event_, "event/l"));
+  scalars.push_back(tree_->Branch("n", &n_, "n/I"));
+
+  forEachColumn(empty_, [&](const char* column, int side, char type, void* data) {
+      const std::string name = side < 0 ? column : column + std::string(side == 0 ? "_0" : "_1");
+      branches_.push_back(tree_->Branch(name.c_str(), data, (name + "[n]/" + type).c_str()));
+    });
+
+  for (auto branch: scalars)
+    branch->SetCompressionSettings(settings);
+  for (auto branch: branches_)
+    branch->SetCompressionSettings(settings);
+
+}
+
+
+void MTDNtuple::fill(const edm::EventID& id, Columns& columns) {
+
+  std::lock_guard<std::mutex> guard(mutex_);
+
+  run_   = id.run();
+  lumi_  = id.luminosityBlock();
+  event_ = id.event();
+  n_     = columns.size();
+
+  size_t ib = 0;
+  forEachColumn(columns, [&](const char*, int, char, void* data) { branches_[ib++]->SetAddress(data); });
+
+  tree_->Fill();
+
+}
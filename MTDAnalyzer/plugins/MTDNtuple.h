@@ -0,0 +1,105 @@
+#ifndef MTDAnalyzer_plugins_MTDNtuple_h
+#define MTDAnalyzer_plugins_MTDNtuple_h
+
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "MTDtools/MTDCore/interface/MTDJoinedHit.h"
+
+class TBranch;
+class TFileService;
+class TTree;
+
+namespace edm {
+  class EventID;
+}
+
+
+// Columnar output of the joined MTD records.
+//
+// The TTree has one entry per event: the run, luminosity block and event
+// numbers, the number of records n and one array of n values per column,
+// i.e. per MTDinfo field (the BTL per-side fields as _0/_1 columns) plus the
+// subdetector, the side and a global position. The columns use the
+// smallest type which holds the readout values, and all the branches are
+// compressed with the configured algorithm and level.
+//
+// Each stream collects the records of its event in a Columns buffer; fill()
+// points the branches to the buffer and fills the tree under a mutex, so
+// that the entries are in the order in which the streams complete.
+
+class MTDNtuple {
+
+public:
+
+  enum Subdet { kBTL = 0, kETL = 1 };
+
+  // --- records of one event, one vector per column
+  struct Columns {
+
+    Columns();
+
+    void clear();
+    size_t size() const { return rawId.size(); }
+
+    // --- side: 0 for z < 0, 1 for z > 0; x, y, z: global position [cm]
+    void push_back(Subdet subdet, int side, const MTDJoinedHit& hit, float x, float y, float z);
+
+    std::vector<uint8_t> subdet;
+    std::vector<uint8_t> side;
+    std::vector<uint32_t> rawId;
+    std::vector<float> x;
+    std::vector<float> y;
+    std::vector<float> z;
+
+    std::vector<float> sim_energy;
+    std::vector<float> sim_time;
+    std::vector<float> sim_x;
+    std::vector<float> sim_y;
+    std::vector<float> sim_z;
+    std::vector<uint16_t> sim_ntrk;
+
+    std::vector<uint16_t> digi_row[2];
+    std::vector<uint16_t> digi_col[2];
+    std::vector<uint16_t> digi_charge[2];
+    std::vector<uint16_t> digi_time1[2];
+    std::vector<uint16_t> digi_time2[2];
+
+    std::vector<float> ureco_charge[2];
+    std::vector<float> ureco_time[2];
+
+    std::vector<float> reco_energy;
+    std::vector<float> reco_time;
+
+  };
+
+  // --- books the tree in the TFileService file; compression is one of
+  //     ZLIB, LZMA, LZ4 or ZSTD
+  MTDNtuple(TFileService& fs, const std::string& compression, int level);
+
+  // --- fills the entry of an event, thread-safe
+  void fill(const edm::EventID& id, Columns& columns);
+
+
+private:
+
+  // --- calls f(name, side or -1, ROOT type code, data) for every array column
+  template<typename F> static void forEachColumn(Columns& columns, F f);
+
+  TTree* tree_;
+  std::vector<TBranch*> branches_;   // array columns, in forEachColumn() order
+  Columns empty_;                    // branch addresses until the first fill
+
+  uint32_t run_;
+  uint32_t lumi_;
+  uint64_t event_;
+  int32_t n_;
+
+  std::mutex mutex_;
+
+};
+
+
+#endif
@@ -0,0 +1,159 @@
+#include "MTDtools/MTDAnalyzer/interface/MTDHistoOutput.h"
+
+#include <algorithm>
+#include <map>
+#include <numeric>
+#include <string>
+#include <vector>
+
+#include "CommonTools/UtilAlgos/interface/TFileDirectory.h"
+
+#include "TH1.h"
+#include "TH2.h"
+#include "TProfile.h"
+
+
+// --- bin contents, sums of w^2 and statistics of a TH1F or TH2F
+template<typename H, typename T>
+static void copyTo(const H& h, T& histo, int nStats) {
+
+  std::copy(h.contents().begin(), h.contents().end(), histo.GetArray());
+
+  // unit weights: without a dedicated array the sum of w^2 is the content
+  if ( !h.sumw2().empty() ) {
+    if ( histo.GetSumw2N() == 0 ) histo.Sumw2();
+    std::copy(h.sumw2().begin(), h.sumw2().end(), histo.GetSumw2()->GetArray());
+  }
+  else if ( histo.GetSumw2N() > 0 )
+    std::copy(h.contents().begin(), h.contents().end(), histo.GetSumw2()->GetArray());
+
+  double stats[7];
+  std::copy(h.stats(), h.stats()+nStats, stats);
+  histo.PutStats(stats);
+
+  histo.SetEntries(h.entries());
+
+}
+
+
+static void copyTo(const MTDProfile& p, TProfile& profile) {
+
+  std::copy(p.sumy().begin(), p.sumy().end(), profile.GetArray());
+  std::copy(p.sumy2().begin(), p.sumy2().end(), profile.GetSumw2()->GetArray());
+
+  const std::vector<double>& binEntries = p.binEntries();
+  for (size_t ib = 0; ib < binEntries.size(); ++ib)
+    profile.SetBinEntries(ib, binEntries[ib]);
+
+  if ( profile.GetBinSumw2()->fN > 0 )
+    std::copy(binEntries.begin(), binEntries.end(), profile.GetBinSumw2()->GetArray());
+
+  double stats[6];
+  std::copy(p.stats(), p.stats()+6, stats);
+  profile.PutStats(stats);
+
+  profile.SetEntries(p.entries());
+
+}
+
+
+// --- counts in the TH2I layout, one bin per channel with the fills out of
+//     range in the underflow and overflow bins, and the statistics of the
+//     channels in range
+static void copyTo(const MTDChannelMap& m, TH2I& histo) {
+
+  double stats[7] = {};
+
+  for (int by = 0; by < m.ny()+2; ++by) {
+    for (int bx = 0; bx < m.nx()+2; ++bx) {
+      const uint32_t n = m.counts()[by*(m.nx()+2) + bx];
+      if ( n == 0 ) continue;
+      histo.SetBinContent(bx, by, n);
+      if ( bx == 0 || bx > m.nx() || by == 0 || by > m.ny() ) continue;
+      const double x = m.xFirst() + bx-1;
+      const double y = m.yFirst() + by-1;
+      stats[0] += n;
+      stats[1] += n;
+      stats[2] += n*x;
+      stats[3] += n*x*x;
+      stats[4] += n*y;
+      stats[5] += n*y*y;
+      stats[6] += n*x*y;
+    }
+  }
+
+  histo.PutStats(stats);
+  histo.SetEntries(m.entries());
+
+}
+
+
+// --- subdirectory path of fs, made one level at a time
+static TFileDirectory& directory(std::map<std::string,TFileDirectory>& dirs, TFileDirectory& fs,
+				 const std::string& path) {
+
+  auto dir = dirs.find(path);
+  if ( dir != dirs.end() ) return dir->second;
+
+  const size_t slash = path.rfind('/');
+  TFileDirectory& parent = slash == std::string::npos ? fs : directory(dirs, fs, path.substr(0, slash));
+
+  return dirs.emplace(path, parent.mkdir(path.substr(slash+1))).first->second;
+
+}
+
+
+static void writeHistos(const MTDHistoRegistry& histos, TFileDirectory& fs,
+			std::map<std::string,TFileDirectory>& dirs) {
+
+  for (size_t ih = 0; ih < histos.size(); ++ih) {
+
+    const MTDHisto& histo = histos.histo(ih);
+
+    TFileDirectory& dir = directory(dirs, fs, histo.dir());
+
+    const char* name  = histo.name().c_str();
+    const char* title = histo.title().c_str();
+
+    if ( auto h = dynamic_cast<const MTDHisto1D*>(&histo) ) {
+      const MTDAxis& x = h->xAxis();
+      copyTo(*h, *dir.make<TH1F>(name, title, x.n(), x.lo(), x.hi()), 4);
+    }
+    else if ( auto h = dynamic_cast<const MTDHisto2D*>(&histo) ) {
+      const MTDAxis& x = h->xAxis();
+      const MTDAxis& y = h->yAxis();
+      copyTo(*h, *dir.make<TH2F>(name, title, x.n(), x.lo(), x.hi(), y.n(), y.lo(), y.hi()), 7);
+    }
+    else if ( auto p = dynamic_cast<const MTDProfile*>(&histo) ) {
+      const MTDAxis& x = p->xAxis();
+      copyTo(*p, *dir.make<TProfile>(name, title, x.n(), x.lo(), x.hi()));
+    }
+    else if ( auto m = dynamic_cast<const MTDChannelMap*>(&histo) ) {
+      copyTo(*m, *dir.make<TH2I>(name, title, m->nx(), m->xFirst() - 0.5, m->xFirst() + m->nx() - 0.5,
+				  m->ny(), m->yFirst() - 0.5, m->yFirst() + m->ny() - 0.5));
+    }
+
+  }
+
+}
+
+
+void mtdWriteHistos(const MTDHistoRegistry& histos, TFileDirectory& fs) {
+
+  std::map<std::string,TFileDirectory> dirs;
+  writeHistos(histos, fs, dirs);
+
+}
+
+
+void mtdWriteModuleHistos(const MTDModuleHistos& modules, TFileDirectory& fs) {
+
+  std::vector<size_t> order(modules.size());
+  std::iota(order.begin(), order.end(), 0);
+  std::sort(order.begin(), order.end(), [&](size_t i, size_t j) { return modules[i].key < modules[j].key; });
+
+  std::map<std::string,TFileDirectory> dirs;
+  for (size_t im: order)
+    writeHistos(modules[im].histos, fs, dirs);
+
+}
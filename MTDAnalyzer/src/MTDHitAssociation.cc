@@ -0,0 +1,43 @@
+#include "MTDtools/MTDAnalyzer/interface/MTDHitAssociation.h"
+
+
+void MTDHitAssociation::clear() {
+
+  counts = MTDEventCounts();
+
+  btl_hits.clear();
+  btl_pos.clear();
+  btl_bx.clear();
+  btl_energy.clear();
+  btlWindows.clear();
+
+  for (int idet=0; idet<2; ++idet) {
+    etl_hits[idet].clear();
+    etl_pos[idet].clear();
+    etl_bx[idet].clear();
+    etl_energy[idet].clear();
+  }
+  etlWindows.clear();
+
+}
+
+
+MTDEventView MTDHitAssociation::view() const {
+
+  MTDEventView view;
+
+  view.counts = counts;
+  view.window = window;
+
+  view.btl = { btl_hits.data(), btl_pos.data(), btl_hits.size(),
+	       btl_bx.empty() ? nullptr : btl_bx.data(),
+	       btl_energy.empty() ? nullptr : btl_energy.data(), btlWindows };
+
+  for (int idet=0; idet<2; ++idet)
+    view.etl[idet] = { etl_hits[idet].data(), etl_pos[idet].data(), etl_hits[idet].size(),
+		       etl_bx[idet].empty() ? nullptr : etl_bx[idet].data(),
+		       etl_energy[idet].empty() ? nullptr : etl_energy[idet].data(), etlWindows };
+
+  return view;
+
+}
@@ -0,0 +1,268 @@
+#include "MTDtools/MTDAnalyzer/interface/MTDHitCache.h"
+
+#include <cerrno>
+#include <cstring>
+#include <type_traits>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "FWCore/Utilities/interface/Exception.h"
+
+
+// The on-disk format is the in-memory one of a little-endian host, without
+// padding in the structures.
+
+static_assert(__BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__, "MTDHitCache: little-endian host required");
+
+static_assert(std::is_trivially_copyable<MTDJoinedHit>::value && sizeof(MTDJoinedHit) == 96,
+	      "MTDHitCache: MTDJoinedHit layout changed, update kVersion");
+static_assert(std::is_trivially_copyable<MTDHitPosition>::value && sizeof(MTDHitPosition) == 44,
+	      "MTDHitCache: MTDHitPosition layout changed, update kVersion");
+static_assert(sizeof(MTDEventCounts) == 56 && sizeof(MTDHitCacheEvent) == 88,
+	      "MTDHitCache: MTDHitCacheEvent layout changed, update kVersion");
+static_assert(sizeof(MTDHitCacheHeader) == 24 && sizeof(MTDHitCacheChunk) == 24 && sizeof(MTDHitCacheTrailer) == 32,
+	      "MTDHitCache: header, index or trailer layout changed, update kVersion");
+
+static const char kMagic[8] = "MTDHITS";
+
+// --- 2: ETL module and ring in MTDHitPosition iphi and ieta, 0 in version 1
+static const uint32_t kVersion = 2;
+
+
+// ==============================================================================
+//  MTDHitCacheWriter
+// ==============================================================================
+
+MTDHitCacheWriter::MTDHitCacheWriter(const std::string& path, unsigned int chunkEvents) :
+  path_(path), file_(nullptr), chunkEvents_(chunkEvents > 0 ? chunkEvents : 1), offset_(0), nEvents_(0) {
+
+  file_ = std::fopen(path.c_str(), "wb");
+  if ( file_ == nullptr )
+    throw cms::Exception("FileOpenError") << "MTDHitCacheWriter: cannot open " << path << ": " << std::strerror(errno);
+
+  MTDHitCacheHeader header;
+  std::memcpy(header.magic, kMagic, sizeof(kMagic));
+  header.version      = kVersion;
+  header.hitSize      = sizeof(MTDJoinedHit);
+  header.positionSize = sizeof(MTDHitPosition);
+  header.eventSize    = sizeof(MTDHitCacheEvent);
+
+  write(&header, sizeof(header));
+
+}
+
+
+MTDHitCacheWriter::~MTDHitCacheWriter() {
+
+  if ( file_ != nullptr ) std::fclose(file_);
+
+}
+
+
+void MTDHitCacheWriter::write(const void* data, size_t size) {
+
+  if ( std::fwrite(data, 1, size, file_) != size )
+    throw cms::Exception("FileWriteError") << "MTDHitCacheWriter: cannot write " << path_ << ": " << std::strerror(errno);
+
+  offset_ += size;
+
+}
+
+
+void MTDHitCacheWriter::add(Chunk& chunk, uint32_t run, uint32_t lumi, uint64_t event, const MTDEventView& view) {
+
+  MTDHitCacheEvent header;
+  header.event    = event;
+  header.run      = run;
+  header.lumi     = lumi;
+  header.counts   = view.counts;
+  header.nBTL     = view.btl.size;
+  header.nETL[0]  = view.etl[0].size;
+  header.nETL[1]  = view.etl[1].size;
+  header.reserved = 0;
+
+  const size_t nHits = view.btl.size + view.etl[0].size + view.etl[1].size;
+
+  std::vector<char>& data = chunk.data_;
+  size_t pos = data.size();
+  data.resize(pos + sizeof(header) + nHits*(sizeof(MTDJoinedHit)+sizeof(MTDHitPosition)));
+
+  auto append = [&](const void* src, size_t size) {
+    if ( size == 0 ) return;
+    std::memcpy(data.data()+pos, src, size);
+    pos += size;
+  };
+
+  append(&header, sizeof(header));
+  for (const MTDEventView::Hits* hits: { &view.btl, &view.etl[0], &view.etl[1] }) {
+    append(hits->hits, hits->size*sizeof(MTDJoinedHit));
+    append(hits->positions, hits->size*sizeof(MTDHitPosition));
+  }
+
+  ++chunk.nEvents_;
+  chunk.nHits_ += nHits;
+
+  if ( chunk.nEvents_ >= chunkEvents_ ) flush(chunk);
+
+}
+
+
+void MTDHitCacheWriter::flush(Chunk& chunk) {
+
+  if ( chunk.nEvents_ == 0 ) return;
+
+  {
+    std::lock_guard<std::mutex> guard(mutex_);
+
+    index_.push_back( {offset_, chunk.data_.size(), chunk.nEvents_, chunk.nHits_} );
+    nEvents_ += chunk.nEvents_;
+
+    write(chunk.data_.data(), chunk.data_.size());
+  }
+
+  chunk.data_.clear();
+  chunk.nEvents_ = 0;
+  chunk.nHits_ = 0;
+
+}
+
+
+void MTDHitCacheWriter::close() {
+
+  std::lock_guard<std::mutex> guard(mutex_);
+
+  if ( file_ == nullptr ) return;
+
+  MTDHitCacheTrailer trailer;
+  trailer.indexOffset = offset_;
+  trailer.nChunks     = index_.size();
+  trailer.nEvents     = nEvents_;
+  std::memcpy(trailer.magic, kMagic, sizeof(kMagic));
+
+  write(index_.data(), index_.size()*sizeof(MTDHitCacheChunk));
+  write(&trailer, sizeof(trailer));
+
+  const bool closed = std::fclose(file_) == 0;
+  file_ = nullptr;
+
+  if ( !closed )
+    throw cms::Exception("FileWriteError") << "MTDHitCacheWriter: cannot close " << path_ << ": " << std::strerror(errno);
+
+}
+
+
+// ==============================================================================
+//  MTDHitCacheReader
+// ==============================================================================
+
+MTDHitCacheReader::MTDHitCacheReader(const std::string& path) :
+  path_(path), base_(nullptr), size_(0), nEvents_(0) {
+
+  const int fd = ::open(path.c_str(), O_RDONLY);
+  if ( fd < 0 )
+    throw cms::Exception("FileOpenError") << "MTDHitCacheReader: cannot open " << path << ": " << std::strerror(errno);
+
+  struct stat st;
+  if ( ::fstat(fd, &st) != 0 || st.st_size < off_t(sizeof(MTDHitCacheHeader)+sizeof(MTDHitCacheTrailer)) ) {
+    ::close(fd);
+    throw cms::Exception("FileReadError") << "MTDHitCacheReader: " << path << " is not an MTD hit cache";
+  }
+
+  size_ = st.st_size;
+  void* base = ::mmap(nullptr, size_, PROT_READ, MAP_PRIVATE, fd, 0);
+  ::close(fd);
+
+  if ( base == MAP_FAILED )
+    throw cms::Exception("FileReadError") << "MTDHitCacheReader: cannot map " << path << ": " << std::strerror(errno);
+  base_ = static_cast<const char*>(base);
+
+  MTDHitCacheHeader header;
+  MTDHitCacheTrailer trailer;
+  std::memcpy(&header, base_, sizeof(header));
+  std::memcpy(&trailer, base_+size_-sizeof(trailer), sizeof(trailer));
+
+  std::string error;
+  if ( std::memcmp(header.magic, kMagic, sizeof(kMagic)) != 0 )
+    error = "is not an MTD hit cache";
+  else if ( header.version != kVersion )
+    error = "has format version " + std::to_string(header.version) + ", not " + std::to_string(kVersion) +
+      ": write it again with this release";
+  else if ( header.hitSize != sizeof(MTDJoinedHit) ||
+	    header.positionSize != sizeof(MTDHitPosition) || header.eventSize != sizeof(MTDHitCacheEvent) )
+    error = "has an unsupported record layout";
+  else if ( std::memcmp(trailer.magic, kMagic, sizeof(kMagic)) != 0 )
+    error = "was not closed";
+  else if ( trailer.indexOffset < sizeof(header) || trailer.indexOffset > size_ - sizeof(trailer) ||
+	    (size_ - sizeof(trailer) - trailer.indexOffset) % sizeof(MTDHitCacheChunk) != 0 ||
+	    (size_ - sizeof(trailer) - trailer.indexOffset) / sizeof(MTDHitCacheChunk) != trailer.nChunks )
+    error = "has a corrupted index";
+
+  if ( error.empty() ) {
+
+    index_.resize(trailer.nChunks);
+    std::memcpy(index_.data(), base_+trailer.indexOffset, index_.size()*sizeof(MTDHitCacheChunk));
+
+    for (auto const& chunk: index_) {
+      if ( chunk.offset < sizeof(header) || chunk.offset % 4 != 0 ||
+	   chunk.size > trailer.indexOffset || chunk.offset > trailer.indexOffset - chunk.size )
+	error = "has a corrupted index";
+      nEvents_ += chunk.nEvents;
+    }
+
+    if ( nEvents_ != trailer.nEvents )
+      error = "has a corrupted index";
+
+  }
+
+  if ( !error.empty() ) {
+    ::munmap(const_cast<char*>(base_), size_);
+    throw cms::Exception("FileReadError") << "MTDHitCacheReader: " << path << " " << error;
+  }
+
+}
+
+
+MTDHitCacheReader::~MTDHitCacheReader() {
+
+  ::munmap(const_cast<char*>(base_), size_);
+
+}
+
+
+const char* MTDHitCacheReader::decode(const char* p, const char* end, Event& event) const {
+
+  MTDHitCacheEvent header;
+  if ( end - p < ptrdiff_t(sizeof(header)) )
+    throw cms::Exception("FileReadError") << "MTDHitCacheReader: " << path_ << " has a truncated chunk";
+
+  std::memcpy(&header, p, sizeof(header));
+  p += sizeof(header);
+
+  event.run   = header.run;
+  event.lumi  = header.lumi;
+  event.event = header.event;
+  event.view.counts = header.counts;
+
+  auto hits = [&](uint32_t n, MTDEventView::Hits& hits) {
+
+    if ( uint64_t(end - p) < uint64_t(n)*(sizeof(MTDJoinedHit)+sizeof(MTDHitPosition)) )
+      throw cms::Exception("FileReadError") << "MTDHitCacheReader: " << path_ << " has a truncated chunk";
+
+    hits.size = n;
+    hits.hits = reinterpret_cast<const MTDJoinedHit*>(p);
+    p += n*sizeof(MTDJoinedHit);
+    hits.positions = reinterpret_cast<const MTDHitPosition*>(p);
+    p += n*sizeof(MTDHitPosition);
+
+  };
+
+  hits(header.nBTL, event.view.btl);
+  hits(header.nETL[0], event.view.etl[0]);
+  hits(header.nETL[1], event.view.etl[1]);
+
+  return p;
+
+}
@@ -0,0 +1,5 @@
+#include <vector>
+
+#include "DataFormats/Common/interface/Wrapper.h"
+
+#include "MTDtools/MTDAnalyzer/interface/MTDHitAssociation.h"
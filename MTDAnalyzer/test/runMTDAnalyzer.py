@@ -1,4 +1,36 @@
 import FWCore.ParameterSet.Config as cms
+from FWCore.ParameterSet.VarParsing import VarParsing
+
+options = VarParsing('python')
+options.register('nThreads', 1,
+                 VarParsing.multiplicity.singleton,
+                 VarParsing.varType.int,
+                 "Number of threads (one stream per thread)")
+options.register('recoOnly', False,
+                 VarParsing.multiplicity.singleton,
+                 VarParsing.varType.bool,
+                 "Read only the SIM and RECO hits and fill only the RECO histograms")
+options.register('ioStats', False,
+                 VarParsing.multiplicity.singleton,
+                 VarParsing.varType.bool,
+                 "Report the bytes read from the input file and the time per event, e.g. to compare recoOnly with all the tiers")
+options.register('ntuple', False,
+                 VarParsing.multiplicity.singleton,
+                 VarParsing.varType.bool,
+                 "Write the joined MTD records to the MTDHits tree")
+options.register('histograms', True,
+                 VarParsing.multiplicity.singleton,
+                 VarParsing.varType.bool,
+                 "Book and fill the histograms (False: pure ntuple or hit cache extraction)")
+options.register('hitCache', '',
+                 VarParsing.multiplicity.singleton,
+                 VarParsing.varType.string,
+                 "Write the joined MTD records to this hit cache file, for MTDReplay")
+options.register('analyzers', 1,
+                 VarParsing.multiplicity.singleton,
+                 VarParsing.varType.int,
+                 "Number of MTDAnalyzer instances, with BTLMinimumEnergy 2, 3, ... MeV: more than one share the join of MTDHitAssociationProducer")
+options.parseArguments()
 
 process = cms.Process("MTDAnalyzer")
 
@@ -15,10 +47,21 @@ process.load("Geometry.MTDGeometryBuilder.mtdParameters_cfi")
 
 process.maxEvents = cms.untracked.PSet( input = cms.untracked.int32(-1) )
 
+process.options = cms.untracked.PSet(
+    numberOfThreads = cms.untracked.uint32(options.nThreads),
+    numberOfStreams = cms.untracked.uint32(0),
+    wantSummary     = cms.untracked.bool(True)
+)
+
 process.MessageLogger.cerr.FwkReport  = cms.untracked.PSet(
     reportEvery = cms.untracked.int32(100),
 )
 
+if options.ioStats:
+    # storage statistics (bytes and reads of the input file) and event timing, in the end-of-job summary
+    process.add_(cms.Service("AdaptorConfig", stats = cms.untracked.bool(True)))
+    process.add_(cms.Service("Timing", summaryOnly = cms.untracked.bool(True)))
+
 process.source = cms.Source("PoolSource",
     fileNames = cms.untracked.vstring(
         'file:step3.root',
@@ -35,12 +78,97 @@ process.mtdGeometry = cms.ESProducer("MTDDigiGeometryESModule",
 
 
 process.MTDAnalyzer = cms.EDAnalyzer('MTDAnalyzer',
-                                     BTLIntegrationWindow = cms.double(25.), # [ns]
-                                     BTLMinimumEnergy     = cms.double(2.)   # [MeV]
+                                     # label of an MTDHitAssociationProducer to read the joined hits from, whose
+                                     # parameters replace those of the tiers and windows below ('': join them here)
+                                     HitAssociation        = cms.InputTag(''),
+                                     # detectors and tiers to read: the products of the others are not consumed
+                                     ReadBTL               = cms.bool(True),
+                                     ReadETL               = cms.bool(True),
+                                     ReadSimHits           = cms.bool(True),
+                                     ReadDigiHits          = cms.bool(True),
+                                     ReadUncalibRecHits    = cms.bool(True),
+                                     ReadRecHits           = cms.bool(True),
+                                     BTLSimHits            = cms.InputTag("g4SimHits","FastTimerHitsBarrel"),
+                                     ETLSimHits            = cms.InputTag("g4SimHits","FastTimerHitsEndcap"),
+                                     BTLDigiHits           = cms.InputTag("mix","FTLBarrel"),
+                                     ETLDigiHits           = cms.InputTag("mix","FTLEndcap"),
+                                     BTLUncalibRecHits     = cms.InputTag("mtdUncalibratedRecHits","FTLBarrel"),
+                                     ETLUncalibRecHits     = cms.InputTag("mtdUncalibratedRecHits","FTLEndcap"),
+                                     BTLRecHits            = cms.InputTag("mtdRecHits","FTLBarrel"),
+                                     ETLRecHits            = cms.InputTag("mtdRecHits","FTLEndcap"),
+                                     # crystal layout of the BTL geometry, for the crystal indices: tile, bar, barzflat or barphiflat
+                                     BTLCrystalLayout      = cms.string('barzflat'),
+                                     # SIM energy integration windows [ns]: the first one for the
+                                     # joined records, all of them in the groups 'BTLSimWindow', 'BTLRecoWindow',
+                                     # 'ETLSimWindow' and 'ETLRecoWindow', e.g. cms.vdouble(25., 5., 10., 15., 20.)
+                                     BTLIntegrationWindow  = cms.vdouble(25.),
+                                     ETLIntegrationWindow  = cms.vdouble(),     # none: all the energy
+                                     # out-of-time pileup: SIM hits and ETL DIGI samples of the BXs FirstBX to LastBX
+                                     # (within -8 to 8, around BX 0), per BX in the groups 'BTLSimBX', 'ETLSimBX' and 'ETLDigiBX'
+                                     FirstBX               = cms.int32(0),
+                                     LastBX                = cms.int32(0),
+                                     BTLMinimumEnergy      = cms.double(2.),    # [MeV]
+                                     BTLTimeWalkParameters = cms.vdouble(2.21103, -0.933552, 0.), # p0*q^p1 + p2 [ns], q in [pC]
+                                     HistogramFlushSize    = cms.uint32(1),     # buffered fills per histogram (1: no buffering)
+                                     # BTL and ETL joined and filled in concurrent tasks, the BTL hits in BTLFillChunks
+                                     # chunks with their own BTL hit histogram sets (BTLFillChunks-1 more sets per stream)
+                                     IntraEventTasks       = cms.bool(False),
+                                     BTLFillChunks         = cms.uint32(4),
+                                     # histogram groups to book and fill, e.g. cms.vstring('BTLReco','ETLReco') for monitoring
+                                     HistogramGroups       = cms.vstring('BTLSim', 'BTLDigi', 'BTLUReco', 'BTLReco',
+                                                                         'ETLSim', 'ETLDigi', 'ETLUReco', 'ETLReco'),
+                                     # per-module histograms, booked for the modules with hits: 'BTLModule', 'ETLModule' (per ring)
+                                     ModuleHistogramGroups = cms.vstring(),
+                                     WriteNtuple            = cms.bool(options.ntuple),
+                                     NtupleCompression      = cms.string('LZ4'),  # ZLIB, LZMA, LZ4 or ZSTD
+                                     NtupleCompressionLevel = cms.uint32(4),
+                                     HitCacheFile           = cms.string(options.hitCache),  # '': no hit cache
+                                     HitCacheChunkSize      = cms.uint32(16),  # events per chunk
+                                     # per-channel time-walk and energy scale constants, fitted at the end of the job
+                                     CalibrationFile           = cms.string(''),  # '': no calibration
+                                     CalibrationAmplitudeRange = cms.vdouble(0.1, 100.),  # [pC], logarithmic bins
+                                     CalibrationAmplitudeBins  = cms.uint32(8),
+                                     CalibrationMinEntries     = cms.uint32(50),  # fewer: constants of all the channels
+                                     # RECO - SIM time and energy resolution per |eta| (0 to 3), phi and amplitude region
+                                     ResolutionFile            = cms.string(''),  # '': no resolution table
+                                     ResolutionEtaBins         = cms.uint32(6),
+                                     ResolutionPhiBins         = cms.uint32(1),
+                                     ResolutionAmplitudeRange  = cms.vdouble(0.1, 100.),  # [pC], logarithmic bins
+                                     ResolutionAmplitudeBins   = cms.uint32(4),
+                                     # stage timing, with the plugin built with -DMTD_INSTRUMENTATION
+                                     InstrumentationFile    = cms.string('MTDAnalyzer_timing.json')  # '': log only
                                      )
 
+if options.recoOnly:
+    process.MTDAnalyzer.ReadDigiHits       = False
+    process.MTDAnalyzer.ReadUncalibRecHits = False
+    process.MTDAnalyzer.HistogramGroups    = cms.vstring('BTLReco', 'ETLReco')
+
+if not options.histograms:
+    process.MTDAnalyzer.HistogramGroups = cms.vstring()
+
 process.TFileService = cms.Service("TFileService",
                                    fileName = cms.string('MTDAnalyzer_histo.root')
                                    )
 
 process.p = cms.Path(process.MTDAnalyzer)
+
+if options.analyzers > 1:
+    # the hits are joined once per event, with the tiers and windows of MTDAnalyzer
+    analyzerParameters = process.MTDAnalyzer.parameters_()
+    associationParameters = ('ReadBTL', 'ReadETL', 'ReadSimHits', 'ReadDigiHits', 'ReadUncalibRecHits', 'ReadRecHits',
+                             'BTLSimHits', 'ETLSimHits', 'BTLDigiHits', 'ETLDigiHits',
+                             'BTLUncalibRecHits', 'ETLUncalibRecHits', 'BTLRecHits', 'ETLRecHits',
+                             'BTLCrystalLayout', 'BTLIntegrationWindow', 'ETLIntegrationWindow',
+                             'FirstBX', 'LastBX', 'IntraEventTasks')
+    process.mtdHitAssociation = cms.EDProducer('MTDHitAssociationProducer',
+                                               **{name: analyzerParameters[name] for name in associationParameters})
+    process.MTDAnalyzer.HitAssociation = cms.InputTag('mtdHitAssociation')
+    process.p = cms.Path(process.mtdHitAssociation + process.MTDAnalyzer)
+    for i in range(1, options.analyzers):
+        analyzer = process.MTDAnalyzer.clone(BTLMinimumEnergy = 2. + i,
+                                             WriteNtuple = False,
+                                             HitCacheFile = '',
+                                             InstrumentationFile = 'MTDAnalyzer%d_timing.json' % i)
+        setattr(process, 'MTDAnalyzer%d' % i, analyzer)
+        process.p += analyzer
@@ -0,0 +1,231 @@
+// Write and read back of an MTD hit cache (see MTDHitCache): synthetic BTL
+// and ETL events (see MTDSyntheticHits), with empty ones, are written by
+// two interleaved chunks as by two streams, some chunks being flushed
+// before they are full. Every event must be read back once, with its run,
+// luminosity block, counts, records and positions bitwise equal. A cache
+// which is not closed, or is truncated, must be rejected.
+//
+// Exits with a non-zero status on failure.
+
+#include <cstdio>
+#include <cstring>
+#include <map>
+#include <string>
+#include <vector>
+
+#include <unistd.h>
+
+#include "FWCore/Utilities/interface/Exception.h"
+
+#include "MTDtools/MTDCore/interface/MTDHitJoiner.h"
+#include "MTDtools/MTDCore/interface/MTDSyntheticHits.h"
+
+#include "MTDtools/MTDAnalyzer/interface/MTDHitCache.h"
+
+
+static constexpr unsigned int kNEvents = 23;
+static constexpr unsigned int kChunkEvents = 4;
+
+
+// --- joined records and positions of an event, owning the arrays of its
+//     view
+struct Event {
+
+  uint32_t run;
+  uint32_t lumi;
+  uint64_t event;
+
+  MTDEventCounts counts;
+  std::vector<MTDJoinedHit> hits[3];          // BTL, ETL -Z, ETL +Z
+  std::vector<MTDHitPosition> positions[3];
+
+  MTDEventView view() const {
+    MTDEventView view;
+    view.counts = counts;
+    MTDEventView::Hits* out[3] = { &view.btl, &view.etl[0], &view.etl[1] };
+    for (int i = 0; i < 3; ++i) {
+      out[i]->hits = hits[i].data();
+      out[i]->positions = positions[i].data();
+      out[i]->size = hits[i].size();
+    }
+    return view;
+  }
+
+};
+
+
+static std::vector<Event> makeEvents() {
+
+  MTDSyntheticHits btl(MTDSyntheticHits::kBTL, 50, 1);
+  MTDSyntheticHits etl(MTDSyntheticHits::kETL, 50, 2);
+  MTDHitJoiner joiner;
+
+  std::vector<Event> events(kNEvents);
+
+  for (unsigned int ie = 0; ie < kNEvents; ++ie) {
+
+    Event& event = events[ie];
+    event.run = 1 + ie/10;
+    event.lumi = 1 + ie/3;
+    event.event = 1000 + ie;
+    event.counts = MTDEventCounts();
+
+    // --- every fifth event without any record
+    if ( ie % 5 == 2 ) continue;
+
+    btl.generate();
+    etl.generate();
+
+    joiner.order(btl.inputs());
+    joiner.joinBTL(btl.inputs(), 25., [&](uint32_t rawId, uint32_t& cell) { return btl.route(rawId, cell); },
+		   &event.hits[0], event.counts);
+    joiner.order(etl.inputs());
+    joiner.joinETL(etl.inputs(), kMTDNoWindow, [&](uint32_t rawId, uint32_t& cell) { return etl.route(rawId, cell); },
+		   &event.hits[1], event.counts);
+
+    btl.positions(event.hits[0], event.positions[0]);
+    etl.positions(event.hits[1], event.positions[1]);
+    etl.positions(event.hits[2], event.positions[2]);
+
+  }
+
+  return events;
+
+}
+
+
+static int checkRoundTrip(const std::vector<Event>& events, const std::string& path) {
+
+  // --- even events to the first chunk and odd ones to the second, the
+  //     second being flushed after every 7 events
+  {
+    MTDHitCacheWriter writer(path, kChunkEvents);
+    MTDHitCacheWriter::Chunk chunks[2];
+    for (unsigned int ie = 0; ie < events.size(); ++ie) {
+      const Event& event = events[ie];
+      writer.add(chunks[ie % 2], event.run, event.lumi, event.event, event.view());
+      if ( ie % 7 == 6 ) writer.flush(chunks[1]);
+    }
+    writer.flush(chunks[0]);
+    writer.flush(chunks[1]);
+    writer.close();
+  }
+
+  MTDHitCacheReader reader(path);
+
+  int failures = 0;
+  std::map<uint64_t, unsigned int> seen;
+  size_t nHits = 0;
+
+  for (size_t ic = 0; ic < reader.nChunks(); ++ic)
+    reader.forEachEvent(ic, [&](const MTDHitCacheReader::Event& read) {
+
+	const unsigned int ie = read.event - events.front().event;
+	if ( read.event < events.front().event || ie >= events.size() || seen[read.event]++ > 0 ) {
+	  std::printf("FAIL event %lu read which was not written once\n", (unsigned long)read.event);
+	  ++failures;
+	  return;
+	}
+
+	const Event& event = events[ie];
+	bool same = read.run == event.run && read.lumi == event.lumi &&
+	  std::memcmp(&read.view.counts, &event.counts, sizeof(MTDEventCounts)) == 0;
+
+	const MTDEventView::Hits* hits[3] = { &read.view.btl, &read.view.etl[0], &read.view.etl[1] };
+	for (int i = 0; i < 3; ++i) {
+	  const size_t n = event.hits[i].size();
+	  nHits += hits[i]->size;
+	  same = same && hits[i]->size == n &&
+	    (n == 0 || (std::memcmp(hits[i]->hits, event.hits[i].data(), n*sizeof(MTDJoinedHit)) == 0 &&
+			std::memcmp(hits[i]->positions, event.positions[i].data(), n*sizeof(MTDHitPosition)) == 0));
+	}
+
+	if ( !same ) {
+	  std::printf("FAIL event %lu differs after the round trip\n", (unsigned long)read.event);
+	  ++failures;
+	}
+
+      });
+
+  if ( seen.size() != events.size() || reader.nEvents() != events.size() ) {
+    std::printf("FAIL %zu events read, %lu in the trailer, %zu written\n", seen.size(), (unsigned long)reader.nEvents(),
+		events.size());
+    ++failures;
+  }
+
+  std::printf("%s %zu events, %zu records in %zu chunks read back\n", failures == 0 ? "ok  " : "FAIL", seen.size(),
+	      nHits, reader.nChunks());
+
+  return failures;
+
+}
+
+
+static int checkRejected(const std::vector<Event>& events, const std::string& path) {
+
+  int failures = 0;
+
+  auto rejected = [&](const char* what) {
+    try {
+      MTDHitCacheReader reader(path);
+      std::printf("FAIL %s cache accepted\n", what);
+      ++failures;
+    }
+    catch (cms::Exception&) {}
+  };
+
+  // --- not closed: no index nor trailer
+  {
+    MTDHitCacheWriter writer(path, kChunkEvents);
+    MTDHitCacheWriter::Chunk chunk;
+    for (auto const& event: events)
+      writer.add(chunk, event.run, event.lumi, event.event, event.view());
+    writer.flush(chunk);
+  }
+  rejected("not closed");
+
+  // --- closed, then truncated in the middle of the chunks
+  {
+    MTDHitCacheWriter writer(path, kChunkEvents);
+    MTDHitCacheWriter::Chunk chunk;
+    for (auto const& event: events)
+      writer.add(chunk, event.run, event.lumi, event.event, event.view());
+    writer.flush(chunk);
+    writer.close();
+    if ( ::truncate(path.c_str(), writer.bytes()/2) != 0 ) {
+      std::printf("FAIL cannot truncate %s\n", path.c_str());
+      ++failures;
+    }
+  }
+  rejected("truncated");
+
+  std::printf("%s caches not closed or truncated rejected\n", failures == 0 ? "ok  " : "FAIL");
+
+  return failures;
+
+}
+
+
+int main() {
+
+  const std::vector<Event> events = makeEvents();
+  const std::string path = "testMTDHitCache_" + std::to_string(::getpid()) + ".bin";
+
+  int failures = 0;
+
+  try {
+    failures += checkRoundTrip(events, path);
+    failures += checkRejected(events, path);
+  }
+  catch (cms::Exception& e) {
+    std::printf("FAIL %s\n", e.what());
+    ++failures;
+  }
+
+  std::remove(path.c_str());
+
+  std::printf("%s\n", failures == 0 ? "All the hit cache checks passed" : "Hit cache checks FAILED");
+
+  return failures == 0 ? 0 : 1;
+
+}
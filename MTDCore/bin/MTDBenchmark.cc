@@ -0,0 +1,459 @@
+// Per-stage benchmarks of the MTD hit processing on synthetic BTL and ETL
+// events at pileup 0, 140 and 200 (see MTDSyntheticHits), without input
+// files: the DetId order of the tiers (Sort), their join into records
+// (Join), the BTL time-walk correction (TimeWalk), the histogram fill of
+// all the groups (Fill) and the whole event (Event).
+//
+// Every benchmark processes the same event repeatedly, the number of
+// iterations growing until the run lasts --min-time seconds, and reports
+// the wall and CPU time per iteration and the input hits per second, as
+// Google Benchmark does; --json writes the results in the Google Benchmark
+// JSON format, for its comparison tools.
+//
+// --bx-window runs the out-of-time pileup mode: SIM hits and ETL DIGI
+// samples of the bunch crossing window, accumulated in per-record BX slots.
+// --windows adds the SIM energies of the records in several integration
+// windows, as the window histograms do.
+//
+// --configs N compares N analyzer configurations (BTLMinimumEnergy 2, 3,
+// ... MeV, each with its own histograms) run as N jobs, each joining the
+// hits (Jobs), with the same configurations sharing one join, as with
+// MTDHitAssociationProducer (Shared).
+
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <ctime>
+#include <exception>
+#include <fstream>
+#include <functional>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <regex>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "MTDtools/MTDCore/interface/MTDBunchCrossing.h"
+#include "MTDtools/MTDCore/interface/MTDHistoFill.h"
+#include "MTDtools/MTDCore/interface/MTDHistoRegistry.h"
+#include "MTDtools/MTDCore/interface/MTDHitJoiner.h"
+#include "MTDtools/MTDCore/interface/MTDSyntheticHits.h"
+#include "MTDtools/MTDCore/interface/MTDTimeWalk.h"
+
+
+static void usage(const char* program) {
+
+  std::cerr << "Usage: " << program << " [options]\n"
+	    << "\n"
+	    << "  --filter REGEX        benchmarks to run, e.g. 'Join/PU200' (default: all)\n"
+	    << "  --min-time S          minimum time of a benchmark [s] (default: 0.5)\n"
+	    << "  --flush-size N        HistogramFlushSize (default: 1)\n"
+	    << "  --seed N              seed of the synthetic events (default: 1)\n"
+	    << "  --bx-window F:L       bunch crossings F to L, with BX slots (default: 0:0, no slots)\n"
+	    << "  --windows W1,W2,...   SIM energy integration windows [ns] (default: none)\n"
+	    << "  --configs N           Jobs and Shared benchmarks of N analyzer configurations (default: 1, none)\n"
+	    << "  --json FILE           results in the Google Benchmark JSON format\n"
+	    << "  --list                lists the benchmarks\n";
+
+}
+
+
+// --- CPU time of the thread
+static double cpuSeconds() {
+
+  timespec ts;
+  clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts);
+  return ts.tv_sec + 1e-9*ts.tv_nsec;
+
+}
+
+
+// Benchmark: run() does one iteration and returns the number of input hits
+// it processed.
+
+struct MTDBenchmark {
+
+  std::string name;
+  std::function<size_t()> run;
+
+  // --- results
+  size_t iterations = 0;
+  double realTime = 0.;    // [ns] per iteration
+  double cpuTime = 0.;
+  double itemsPerSecond = 0.;
+
+};
+
+
+static void runBenchmark(MTDBenchmark& b, double minTime) {
+
+  for (size_t n = 1; ; ) {
+
+    size_t items = 0;
+    const auto start = std::chrono::steady_clock::now();
+    const double cpuStart = cpuSeconds();
+
+    for (size_t i = 0; i < n; ++i)
+      items += b.run();
+
+    const double cpu = cpuSeconds() - cpuStart;
+    const double real = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    // --- as Google Benchmark: at most 10 times more iterations, aiming at
+    //     1.4 times the minimum time
+    if ( real < minTime && n < 1000000000 ) {
+      const double multiplier = real > 0. ? std::min(10., 1.4*minTime/real) : 10.;
+      n = std::max(n+1, size_t(n*multiplier));
+      continue;
+    }
+
+    b.iterations = n;
+    b.realTime = 1e9*real/n;
+    b.cpuTime = 1e9*cpu/n;
+    b.itemsPerSecond = cpu > 0. ? items/cpu : 0.;
+    return;
+
+  }
+
+}
+
+
+// Inputs of the benchmarks at one pileup: one BTL and one ETL event, their
+// joined records and positions, and the histograms of all the groups.
+
+struct MTDBenchmarkEvent {
+
+  MTDBenchmarkEvent(unsigned int pileup, uint64_t seed, unsigned int flushSize, const MTDBXWindow& bxWindow,
+		    const std::vector<float>& integrationWindows, unsigned int nConfigs) :
+    btl(MTDSyntheticHits::kBTL, pileup, seed), etl(MTDSyntheticHits::kETL, pileup, seed+1),
+    window(bxWindow), slots(bxWindow.size() > 1), windows(integrationWindows),
+    timeWalk({ 2.21103, -0.933552, 0. }) {
+
+    btl.generate(window);
+    etl.generate(window);
+
+    std::vector<std::string> groups;
+    for (size_t id = 0; id < mtdNHistoDefs; ++id) {
+      if ( std::find(groups.begin(), groups.end(), mtdHistoDefs[id].group) == groups.end() )
+	groups.push_back(mtdHistoDefs[id].group);
+    }
+
+    histos.book(mtdHistoDefs, mtdNHistoDefs, groups, flushSize);
+
+    configHistos.resize(nConfigs > 1 ? nConfigs : 0);
+    for (auto& configHisto: configHistos)
+      configHisto.book(mtdHistoDefs, mtdNHistoDefs, groups, flushSize);
+
+    process();
+
+  }
+
+  size_t joinBTL() {
+    btl_hits.clear();
+    btl_bx.clear();
+    btl_energy.clear();
+    btlJoiner.joinBTL(btl.inputs(), 25., [&](uint32_t rawId, uint32_t& cell) { return btl.route(rawId, cell); },
+		   &btl_hits, counts, joinSlots(&btl_bx, &btl_energy));
+    return nHits(btl);
+  }
+
+  size_t joinETL() {
+    etl_hits[0].clear();
+    etl_hits[1].clear();
+    etl_bx[0].clear();
+    etl_bx[1].clear();
+    etl_energy[0].clear();
+    etl_energy[1].clear();
+    etlJoiner.joinETL(etl.inputs(), kMTDNoWindow, [&](uint32_t rawId, uint32_t& cell) { return etl.route(rawId, cell); },
+		   etl_hits, counts, joinSlots(etl_bx, etl_energy));
+    return nHits(etl);
+  }
+
+  MTDJoinSlots joinSlots(std::vector<MTDBXInfo>* bx, std::vector<float>* energy) const {
+    MTDJoinSlots s;
+    if ( slots ) s.bx = bx;
+    if ( !windows.empty() ) {
+      s.windows = windows;
+      s.windowEnergy = energy;
+    }
+    return s;
+  }
+
+  size_t correct() {
+    channels.resize(2*btl_hits.size());
+    for (size_t ih = 0; ih < btl_hits.size(); ++ih) {
+      for (int iside = 0; iside < 2; ++iside) {
+	channels.amplitude[iside*btl_hits.size()+ih] = btl_hits[ih].info.ureco_charge[iside];
+	channels.time[iside*btl_hits.size()+ih]      = btl_hits[ih].info.ureco_time[iside];
+      }
+    }
+    timeWalk.correct(channels);
+    return channels.size();
+  }
+
+  size_t fill() { return fill(histos, 2.); }
+
+  size_t fill(MTDHistoRegistry& h, float btlMinEnergy) {
+    mtdFillHistos(h, view, btlMinEnergy, timeWalk, channels);
+    return btl_hits.size() + etl_hits[0].size() + etl_hits[1].size();
+  }
+
+  // --- whole event, returns the number of input hits
+  size_t process() {
+    const size_t n = associate();
+    fill();
+    return n;
+  }
+
+  // --- configurations as separate jobs, each joining the hits
+  size_t jobs() {
+    size_t n = 0;
+    for (size_t ic = 0; ic < configHistos.size(); ++ic) {
+      n += associate();
+      fill(configHistos[ic], 2. + ic);
+    }
+    return n;
+  }
+
+  // --- configurations sharing one join
+  size_t shared() {
+    const size_t n = associate();
+    for (size_t ic = 0; ic < configHistos.size(); ++ic)
+      fill(configHistos[ic], 2. + ic);
+    return configHistos.size()*n;
+  }
+
+  // --- joined records, their positions and the view of an event, returns
+  //     the number of input hits
+  size_t associate() {
+
+    counts = MTDEventCounts();
+
+    btlJoiner.order(btl.inputs(), window);
+    joinBTL();
+    etlJoiner.order(etl.inputs(), window);
+    joinETL();
+
+    btl.positions(btl_hits, btl_pos);
+    etl.positions(etl_hits[0], etl_pos[0]);
+    etl.positions(etl_hits[1], etl_pos[1]);
+
+    view.counts = counts;
+    view.window = window;
+    view.btl = { btl_hits.data(), btl_pos.data(), btl_hits.size(), slots ? btl_bx.data() : nullptr,
+		 windows.empty() ? nullptr : btl_energy.data(), windows };
+    for (int idet = 0; idet < 2; ++idet)
+      view.etl[idet] = { etl_hits[idet].data(), etl_pos[idet].data(), etl_hits[idet].size(),
+			 slots ? etl_bx[idet].data() : nullptr,
+			 windows.empty() ? nullptr : etl_energy[idet].data(), windows };
+
+    return nHits(btl) + nHits(etl);
+
+  }
+
+  static size_t nHits(const MTDSyntheticHits& hits) {
+    const MTDTierInputs in = hits.inputs();
+    return in.sim.size + in.digi.size + in.ureco.size + in.reco.size;
+  }
+
+  MTDSyntheticHits btl;
+  MTDSyntheticHits etl;
+
+  const MTDBXWindow window;
+  const bool slots;     // BX slots, for a window wider than BX 0
+  const std::vector<float> windows;
+
+  // --- one joiner per subdetector, so that the join can be run alone
+  MTDHitJoiner btlJoiner;
+  MTDHitJoiner etlJoiner;
+  MTDEventCounts counts;
+
+  std::vector<MTDJoinedHit> btl_hits;
+  std::vector<MTDJoinedHit> etl_hits[2];
+  std::vector<MTDHitPosition> btl_pos;
+  std::vector<MTDHitPosition> etl_pos[2];
+  std::vector<MTDBXInfo> btl_bx;
+  std::vector<MTDBXInfo> etl_bx[2];
+  std::vector<float> btl_energy;
+  std::vector<float> etl_energy[2];
+  MTDEventView view;
+
+  const MTDTimeWalk timeWalk;
+  MTDTimeWalk::Channels channels;
+
+  MTDHistoRegistry histos;
+  std::vector<MTDHistoRegistry> configHistos;    // --configs
+
+};
+
+
+int main(int argc, char* argv[]) {
+
+  std::string filter = ".*";
+  double minTime = 0.5;
+  unsigned int flushSize = 1;
+  uint64_t seed = 1;
+  MTDBXWindow window;
+  std::vector<float> windows;
+  unsigned int nConfigs = 1;
+  std::string json;
+  bool list = false;
+
+  try {
+
+    for (int iarg = 1; iarg < argc; ++iarg) {
+
+      const std::string arg = argv[iarg];
+
+      if ( arg == "-h" || arg == "--help" ) {
+	usage(argv[0]);
+	return 0;
+      }
+
+      if ( arg == "--list" ) {
+	list = true;
+	continue;
+      }
+
+      if ( iarg+1 == argc )
+	throw std::invalid_argument("MTDBenchmark: " + arg + " needs a value");
+      const std::string value = argv[++iarg];
+
+      if ( arg == "--filter" )
+	filter = value;
+      else if ( arg == "--min-time" )
+	minTime = std::stod(value);
+      else if ( arg == "--flush-size" )
+	flushSize = std::max(1, std::stoi(value));
+      else if ( arg == "--seed" )
+	seed = std::stoull(value);
+      else if ( arg == "--bx-window" ) {
+	const size_t colon = value.find(':');
+	if ( colon == std::string::npos )
+	  throw std::invalid_argument("MTDBenchmark: --bx-window needs FIRST:LAST");
+	window = MTDBXWindow(std::stoi(value.substr(0, colon)), std::stoi(value.substr(colon+1)));
+      }
+      else if ( arg == "--windows" ) {
+	std::istringstream is(value);
+	std::string w;
+	while ( std::getline(is, w, ',') ) windows.push_back(std::stof(w));
+	std::sort(windows.begin(), windows.end());
+      }
+      else if ( arg == "--configs" )
+	nConfigs = std::max(1, std::stoi(value));
+      else if ( arg == "--json" )
+	json = value;
+      else
+	throw std::invalid_argument("MTDBenchmark: unknown option " + arg);
+
+    }
+
+    const std::regex selected(filter);
+
+    // --- benchmarks of every pileup, the events being generated only if
+    //     one of their benchmarks is selected
+
+    std::vector<std::unique_ptr<MTDBenchmarkEvent> > events;
+    std::vector<MTDBenchmark> benchmarks;
+
+    for (unsigned int pileup: { 0, 140, 200 }) {
+
+      const std::string suffix = "/PU" + std::to_string(pileup);
+      std::vector<MTDBenchmark> stages;
+
+      auto add = [&](const std::string& stage, std::function<size_t(MTDBenchmarkEvent&)> run) {
+	MTDBenchmark b;
+	b.name = stage + suffix;
+	if ( !std::regex_search(b.name, selected) ) return;
+	const size_t ie = events.size();
+	b.run = [&events, ie, run]() { return run(*events[ie]); };
+	stages.push_back(b);
+      };
+
+      add("BTLSort", [](MTDBenchmarkEvent& e) {
+	  e.btlJoiner.order(e.btl.inputs(), e.window);
+	  return e.nHits(e.btl);
+	});
+      add("BTLJoin", [](MTDBenchmarkEvent& e) { return e.joinBTL(); });
+      add("ETLSort", [](MTDBenchmarkEvent& e) {
+	  e.etlJoiner.order(e.etl.inputs(), e.window);
+	  return e.nHits(e.etl);
+	});
+      add("ETLJoin", [](MTDBenchmarkEvent& e) { return e.joinETL(); });
+      add("TimeWalk", [](MTDBenchmarkEvent& e) { return e.correct(); });
+      add("Fill",     [](MTDBenchmarkEvent& e) { return e.fill(); });
+      add("Event",    [](MTDBenchmarkEvent& e) { return e.process(); });
+      if ( nConfigs > 1 ) {
+	add("Jobs",   [](MTDBenchmarkEvent& e) { return e.jobs(); });
+	add("Shared", [](MTDBenchmarkEvent& e) { return e.shared(); });
+      }
+
+      if ( stages.empty() ) continue;
+
+      if ( !list ) events.push_back(std::make_unique<MTDBenchmarkEvent>(pileup, seed + 2*pileup, flushSize, window,
+									 windows, nConfigs));
+      else events.push_back(nullptr);
+
+      benchmarks.insert(benchmarks.end(), stages.begin(), stages.end());
+
+    }
+
+    if ( list ) {
+      for (auto const& b: benchmarks) std::cout << b.name << "\n";
+      return 0;
+    }
+
+    // --- run
+
+    std::cout << std::left << std::setw(20) << "Benchmark" << std::right << std::setw(14) << "Time"
+	      << std::setw(14) << "CPU" << std::setw(12) << "Iterations" << std::setw(16) << "Items/s" << "\n"
+	      << std::string(76, '-') << std::endl;
+
+    for (auto& b: benchmarks) {
+
+      runBenchmark(b, minTime);
+
+      std::cout << std::left << std::setw(20) << b.name << std::right << std::fixed << std::setprecision(0)
+		<< std::setw(11) << b.realTime << " ns" << std::setw(11) << b.cpuTime << " ns"
+		<< std::setw(12) << b.iterations << std::setprecision(2) << std::setw(15)
+		<< 1e-6*b.itemsPerSecond << "M" << std::endl;
+
+    }
+
+    if ( !json.empty() ) {
+
+      std::ofstream os(json);
+
+      os << "{\n  \"context\": {\n    \"executable\": \"" << argv[0] << "\",\n    \"seed\": " << seed
+	 << ",\n    \"flush_size\": " << flushSize << ",\n    \"bx_window\": \"" << window.first << ":" << window.last
+	 << "\",\n    \"windows\": " << windows.size() << ",\n    \"configs\": " << nConfigs << "\n  },\n  \"benchmarks\": [\n";
+
+      for (size_t ib = 0; ib < benchmarks.size(); ++ib) {
+	const MTDBenchmark& b = benchmarks[ib];
+	os << std::setprecision(6) << std::defaultfloat
+	   << "    {\"name\": \"" << b.name << "\", \"run_type\": \"iteration\", \"iterations\": " << b.iterations
+	   << ", \"real_time\": " << b.realTime << ", \"cpu_time\": " << b.cpuTime
+	   << ", \"time_unit\": \"ns\", \"items_per_second\": " << b.itemsPerSecond << "}"
+	   << (ib+1 < benchmarks.size() ? ",\n" : "\n");
+      }
+
+      os << "  ]\n}\n";
+
+      if ( !os )
+	throw std::runtime_error("MTDBenchmark: cannot write " + json);
+
+    }
+
+  } catch (const std::exception& e) {
+
+    std::cerr << e.what() << std::endl;
+    return 1;
+
+  }
+
+  return 0;
+
+}
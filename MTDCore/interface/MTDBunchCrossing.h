@@ -0,0 +1,73 @@
+#ifndef MTDCore_interface_MTDBunchCrossing_h
+#define MTDCore_interface_MTDBunchCrossing_h
+
+#include <cmath>
+#include <cstdint>
+#include <limits>
+#include <stdexcept>
+#include <string>
+
+
+constexpr float kMTDBXLength = 25.;   // [ns]
+
+// SIM energy integration window [ns] keeping all the energy.
+constexpr float kMTDNoWindow = std::numeric_limits<float>::infinity();
+
+// Largest |BX| of a window: bounds the slots per cell to 2*kMTDMaxBX+1.
+constexpr int kMTDMaxBX = 8;
+
+
+// Window of bunch crossings [first, last] around the in-time one (BX 0).
+// BX 0 is the ToF range [0, 25] ns, BX k > 0 is (25k, 25k+25] and BX k < 0
+// is [25k, 25k+25): the default window [0, 0] is the in-time selection of
+// the SIM hits.
+
+struct MTDBXWindow {
+
+  int first = 0;
+  int last = 0;
+
+  MTDBXWindow() {}
+
+  MTDBXWindow(int f, int l) : first(f), last(l) {
+    if ( first > 0 || last < 0 || first < -kMTDMaxBX || last > kMTDMaxBX )
+      throw std::invalid_argument("MTDBXWindow: BX window [" + std::to_string(first) + ", " + std::to_string(last) +
+				  "] must contain BX 0 and be within +-" + std::to_string(kMTDMaxBX));
+  }
+
+  // --- number of slots
+  int size() const { return last - first + 1; }
+
+  // --- slot of a BX of the window
+  int slot(int bx) const { return bx - first; }
+
+  bool contains(float tof) const {
+    return tof >= kMTDBXLength*first && tof <= kMTDBXLength*(last+1);
+  }
+
+  // --- BX of a ToF [ns] of the window
+  static int bx(float tof) {
+    if ( tof >= 0.f && tof <= kMTDBXLength ) return 0;
+    return tof > 0.f ? int(std::ceil(tof/kMTDBXLength)) - 1 : int(std::floor(tof/kMTDBXLength));
+  }
+
+};
+
+
+// Accumulation of one cell in one bunch crossing: SIM energy and first SIM
+// hit time of the hits of the BX, and the ETL DIGI sample of the BX (2+BX).
+// Zero when the cell has no hit of the tier in the BX.
+
+struct MTDBXInfo {
+
+  float sim_energy;       // [MeV]
+  float sim_time;         // [ns], ToF of the first SIM hit
+  uint32_t sim_nhits;
+
+  uint32_t digi_charge;
+  uint32_t digi_time1;
+
+};
+
+
+#endif
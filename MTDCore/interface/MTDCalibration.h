@@ -0,0 +1,143 @@
+#ifndef MTDCore_interface_MTDCalibration_h
+#define MTDCore_interface_MTDCalibration_h
+
+#include <cmath>
+#include <cstdint>
+#include <ostream>
+#include <string>
+#include <vector>
+
+#include "MTDtools/MTDCore/interface/MTDHistoFill.h"
+#include "MTDtools/MTDCore/interface/MTDTimeWalk.h"
+
+
+// Per-channel calibration sums of one subdetector, filled in one pass over
+// the events and fitted at the end of the job, without any per-channel
+// histogram. The stores are dense arrays indexed by MTDCellIndex cell (and
+// side, for the time channels), which grow up to the largest cell filled.
+//
+// Time walk: the residuals dt = t - t_sim [ns] of a channel are summed in
+// nBins logarithmic bins of the amplitude q [pC] (those out of the range go
+// to the first or last bin) as the number of entries and the sums of log q
+// and dt, 12 bytes per bin. fit() fits dt = p0*q^p1 + p2 to the bin means,
+// weighted by their entries: p1 is common to all the channels, p0 and p2
+// are fitted per channel by linear least squares in q^p1.
+//
+// Energy scale: the SIM and RECO energies of a cell are summed, the scale
+// being sum(E_sim)/sum(E_reco).
+//
+// The channels with less than minEntries entries, or with less than two
+// amplitude bins for the time walk, get the constants of all the channels
+// together.
+
+class MTDCalibration {
+
+public:
+
+  struct Binning {
+    float minAmplitude = 0.1;   // [pC]
+    float maxAmplitude = 100.;  // [pC]
+    unsigned int nBins = 8;
+  };
+
+  enum Status : uint32_t { kNoData, kGlobal, kFitted };
+
+  struct TimeWalk {
+    float p0, p1, p2;           // [ns]
+    uint32_t entries;
+    Status status;
+  };
+
+  struct EnergyScale {
+    float scale;
+    uint32_t entries;
+    Status status;
+  };
+
+  // --- constants of all the channels together and per channel
+  struct Constants {
+    TimeWalk globalTimeWalk;
+    EnergyScale globalEnergyScale;
+    std::vector<TimeWalk> timeWalk;        // at cell*nSides + side
+    std::vector<EnergyScale> energyScale;  // at cell
+  };
+
+  // --- per-stream scratch store of mtdFillCalibration()
+  struct Scratch {
+    MTDTimeWalk::Channels channels;
+    std::vector<uint32_t> hits;            // record index*2 + side
+  };
+
+  // --- nSides time channels per cell; throws std::invalid_argument on an
+  //     empty or not positive amplitude range or no bin
+  MTDCalibration(unsigned int nSides, const Binning& binning);
+  MTDCalibration() : MTDCalibration(1, Binning()) {}
+
+  void addTime(uint32_t cell, uint32_t rawId, int side, float amplitude, float dt) {
+    if ( cell >= rawId_.size() ) grow(cell+1);
+    rawId_[cell] = rawId;
+    const float logq = std::log(amplitude);
+    const size_t ib = (size_t(cell)*nSides_ + side)*binning_.nBins + bin(logq);
+    n_[ib]++;
+    sumLogAmplitude_[ib] += logq;
+    sumTime_[ib] += dt;
+  }
+
+  void addEnergy(uint32_t cell, uint32_t rawId, float simEnergy, float recoEnergy) {
+    if ( cell >= rawId_.size() ) grow(cell+1);
+    rawId_[cell] = rawId;
+    nEnergy_[cell]++;
+    sumSimEnergy_[cell] += simEnergy;
+    sumRecoEnergy_[cell] += recoEnergy;
+  }
+
+  // --- adds the sums of other, with the same sides and binning
+  void add(const MTDCalibration& other);
+
+  Constants fit(unsigned int minEntries) const;
+
+  // --- text table of the constants, one line per channel with entries
+  void write(std::ostream& os, const std::string& detector, const Constants& constants) const;
+
+  size_t nCells() const { return rawId_.size(); }
+  size_t bytes() const;
+
+private:
+
+  int bin(float logq) const {
+    // NaN and amplitudes below the range go to the first bin
+    const float x = (logq - logMin_)*invLogWidth_;
+    return x >= float(binning_.nBins) ? binning_.nBins-1 : x > 0.f ? int(x) : 0;
+  }
+
+  void grow(size_t nCells);
+
+  unsigned int nSides_;
+  Binning binning_;
+  float logMin_;
+  float invLogWidth_;
+
+  // --- per cell
+  std::vector<uint32_t> rawId_;
+  std::vector<uint32_t> nEnergy_;
+  std::vector<float> sumSimEnergy_;
+  std::vector<float> sumRecoEnergy_;
+
+  // --- per time channel and amplitude bin, at (cell*nSides + side)*nBins + bin
+  std::vector<uint32_t> n_;
+  std::vector<float> sumLogAmplitude_;
+  std::vector<float> sumTime_;
+
+};
+
+
+// Adds the records of an event to the BTL and ETL sums: the BTL records
+// with RECO energy from btlMinEnergy and the ETL records, with a SIM hit.
+// The BTL times are those before the time-walk correction of
+// btlTimeWalkModel, the ETL ones are the uncalibrated RECO times.
+
+void mtdFillCalibration(MTDCalibration& btl, MTDCalibration& etl, const MTDEventView& event, float btlMinEnergy,
+			const MTDTimeWalk& btlTimeWalkModel, MTDCalibration::Scratch& scratch);
+
+
+#endif
@@ -0,0 +1,392 @@
+#ifndef MTDCore_interface_MTDHisto_h
+#define MTDCore_interface_MTDHisto_h
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+
+// Light-weight histograms filled in the event loop and converted to ROOT at
+// the end of the job (see mtdWriteHistos() of MTDAnalyzer), without any ROOT
+// dependency.
+//
+// They only support the fixed uniform binning and unit-weight fills used by
+// the analyzer, but reproduce exactly what the corresponding ROOT class
+// would store: the same bin search as TAxis::FindBin, single precision bin
+// contents for MTDHisto1D/MTDHisto2D (as TH1F/TH2F) and statistics summed
+// in double precision over the in-range fills only.
+//
+// With a flush size above 1, Fill() only appends the values to a buffer;
+// every flushSize values the buffer is binned at once with MTDAxis::find(),
+// a branch-free loop the compiler vectorizes, and then scattered and summed
+// in fill order, so that the result is the same as with the per-call path
+// (flush size 1). Buffers must be flushed before add() and the conversion.
+
+
+// Fixed uniform binning, bin 0 and n+1 being underflow and overflow.
+
+class MTDAxis {
+
+public:
+
+  MTDAxis(int n, double lo, double hi) : n_(n), lo_(lo), hi_(hi) {}
+
+  // --- same arithmetic as TAxis::FindBin; NaN goes to the overflow
+  int find(double x) const {
+    if ( x < lo_ ) return 0;
+    if ( !(x < hi_) ) return n_+1;
+    return 1 + int(n_*(x-lo_)/(hi_-lo_));
+  }
+
+  // --- bins of n values, same result as find() on each of them
+  void find(const double* x, int* bin, size_t n) const;
+
+  bool inRange(int bin) const { return bin > 0 && bin <= n_; }
+
+  int n() const { return n_; }
+  double lo() const { return lo_; }
+  double hi() const { return hi_; }
+
+
+private:
+
+  int n_;
+  double lo_;
+  double hi_;
+
+};
+
+
+// Common part: name, title and output directory, merging and conversion.
+
+class MTDHisto {
+
+public:
+
+  MTDHisto(const std::string& dir, const char* name, const char* title) :
+    dir_(dir), name_(name), title_(title), entries_(0.), flushSize_(1) {}
+
+  virtual ~MTDHisto() {}
+
+  // --- number of buffered values which triggers a flush
+  void setFlushSize(size_t n) { flushSize_ = n > 0 ? n : 1; }
+
+  // --- fills the buffered values
+  virtual void flush() = 0;
+
+  // --- adds the content of another histogram booked identically
+  virtual void add(const MTDHisto& other) = 0;
+
+  // --- number of bins, including underflow and overflow
+  virtual size_t nCells() const = 0;
+
+  // --- memory of the bin arrays
+  virtual size_t bytes() const = 0;
+
+  const std::string& dir() const { return dir_; }
+  const std::string& name() const { return name_; }
+  const std::string& title() const { return title_; }
+
+  double entries() const { return entries_; }
+
+
+protected:
+
+  std::string dir_;
+  std::string name_;
+  std::string title_;
+
+  double entries_;
+
+  size_t flushSize_;
+  std::vector<int> bins_;   // scratch of flush()
+
+};
+
+
+// Counterpart of TH1F.
+
+class MTDHisto1D : public MTDHisto {
+
+public:
+
+  MTDHisto1D(const std::string& dir, const char* name, const char* title, int nx, double xlo, double xhi,
+	     bool sumw2 = false);
+
+  void Fill(double x) {
+
+    if ( flushSize_ == 1 ) {
+      fill(x);
+      return;
+    }
+
+    xbuf_.push_back(x);
+    if ( xbuf_.size() >= flushSize_ ) flush();
+
+  }
+
+  virtual void flush() override;
+  virtual void add(const MTDHisto& other) override;
+  virtual size_t nCells() const override { return counts_.size(); }
+  virtual size_t bytes() const override {
+    return counts_.size()*sizeof(float) + sumw2_.size()*sizeof(double);
+  }
+
+  const MTDAxis& xAxis() const { return x_; }
+  float content(int bin) const { return counts_[bin]; }
+
+  // --- bin contents and sums of w^2 (empty unless requested), in the TH1F
+  //     layout, and sum(w), sum(w^2), sum(w*x), sum(w*x^2)
+  const std::vector<float>& contents() const { return counts_; }
+  const std::vector<double>& sumw2() const { return sumw2_; }
+  const double* stats() const { return stats_; }
+
+
+private:
+
+  void fill(double x) {
+
+    entries_ += 1.;
+
+    const int bin = x_.find(x);
+    counts_[bin] += 1.f;
+    if ( !sumw2_.empty() ) sumw2_[bin] += 1.;
+
+    if ( !x_.inRange(bin) ) return;
+
+    stats_[0] += 1.;
+    stats_[1] += 1.;
+    stats_[2] += x;
+    stats_[3] += x*x;
+
+  }
+
+  MTDAxis x_;
+
+  std::vector<float> counts_;
+  std::vector<double> sumw2_;   // empty unless requested
+
+  // --- sum(w), sum(w^2), sum(w*x), sum(w*x^2)
+  double stats_[4];
+
+  std::vector<double> xbuf_;
+
+};
+
+
+// Counterpart of TH2F.
+
+class MTDHisto2D : public MTDHisto {
+
+public:
+
+  MTDHisto2D(const std::string& dir, const char* name, const char* title,
+	     int nx, double xlo, double xhi, int ny, double ylo, double yhi, bool sumw2 = false);
+
+  void Fill(double x, double y) {
+
+    if ( flushSize_ == 1 ) {
+      fill(x, y);
+      return;
+    }
+
+    xbuf_.push_back(x);
+    ybuf_.push_back(y);
+    if ( xbuf_.size() >= flushSize_ ) flush();
+
+  }
+
+  virtual void flush() override;
+  virtual void add(const MTDHisto& other) override;
+  virtual size_t nCells() const override { return counts_.size(); }
+  virtual size_t bytes() const override {
+    return counts_.size()*sizeof(float) + sumw2_.size()*sizeof(double);
+  }
+
+  const MTDAxis& xAxis() const { return x_; }
+  const MTDAxis& yAxis() const { return y_; }
+
+  // --- as MTDHisto1D, in the TH2F layout, with sum(w*y), sum(w*y^2) and
+  //     sum(w*x*y) in the statistics
+  const std::vector<float>& contents() const { return counts_; }
+  const std::vector<double>& sumw2() const { return sumw2_; }
+  const double* stats() const { return stats_; }
+
+
+private:
+
+  void fill(double x, double y) {
+
+    entries_ += 1.;
+
+    const int binx = x_.find(x);
+    const int biny = y_.find(y);
+    const int bin = biny*(x_.n()+2) + binx;
+
+    counts_[bin] += 1.f;
+    if ( !sumw2_.empty() ) sumw2_[bin] += 1.;
+
+    if ( !x_.inRange(binx) || !y_.inRange(biny) ) return;
+
+    stats_[0] += 1.;
+    stats_[1] += 1.;
+    stats_[2] += x;
+    stats_[3] += x*x;
+    stats_[4] += y;
+    stats_[5] += y*y;
+    stats_[6] += x*y;
+
+  }
+
+  MTDAxis x_;
+  MTDAxis y_;
+
+  std::vector<float> counts_;
+  std::vector<double> sumw2_;   // empty unless requested
+
+  // --- sum(w), sum(w^2), sum(w*x), sum(w*x^2), sum(w*y), sum(w*y^2), sum(w*x*y)
+  double stats_[7];
+
+  std::vector<double> xbuf_;
+  std::vector<double> ybuf_;
+  std::vector<int> ybins_;
+
+};
+
+
+// Counterpart of TProfile (without y range).
+
+class MTDProfile : public MTDHisto {
+
+public:
+
+  MTDProfile(const std::string& dir, const char* name, const char* title, int nx, double xlo, double xhi);
+
+  void Fill(double x, double y) {
+
+    if ( flushSize_ == 1 ) {
+      fill(x, y);
+      return;
+    }
+
+    xbuf_.push_back(x);
+    ybuf_.push_back(y);
+    if ( xbuf_.size() >= flushSize_ ) flush();
+
+  }
+
+  virtual void flush() override;
+  virtual void add(const MTDHisto& other) override;
+  virtual size_t nCells() const override { return sumy_.size(); }
+  virtual size_t bytes() const override { return 3*sumy_.size()*sizeof(double); }
+
+  const MTDAxis& xAxis() const { return x_; }
+
+  // --- per bin sum(y), sum(y^2) and entries, in the TProfile layout, and
+  //     sum(w), sum(w^2), sum(w*x), sum(w*x^2), sum(w*y), sum(w*y^2)
+  const std::vector<double>& sumy() const { return sumy_; }
+  const std::vector<double>& sumy2() const { return sumy2_; }
+  const std::vector<double>& binEntries() const { return binEntries_; }
+  const double* stats() const { return stats_; }
+
+
+private:
+
+  void fill(double x, double y) {
+
+    entries_ += 1.;
+
+    const int bin = x_.find(x);
+    sumy_[bin]    += y;
+    sumy2_[bin]   += y*y;
+    binEntries_[bin] += 1.;
+
+    if ( !x_.inRange(bin) ) return;
+
+    stats_[0] += 1.;
+    stats_[1] += 1.;
+    stats_[2] += x;
+    stats_[3] += x*x;
+    stats_[4] += y;
+    stats_[5] += y*y;
+
+  }
+
+  MTDAxis x_;
+
+  std::vector<double> sumy_;
+  std::vector<double> sumy2_;
+  std::vector<double> binEntries_;
+
+  // --- sum(w), sum(w^2), sum(w*x), sum(w*x^2), sum(w*y), sum(w*y^2)
+  double stats_[6];
+
+  std::vector<double> xbuf_;
+  std::vector<double> ybuf_;
+
+};
+
+
+// Occupancy map of detector channels, indexed directly by their native
+// integer coordinates (e.g. the BTL crystal iphi and ieta): one 32-bit
+// counter per coordinate pair, x in [xFirst, xFirst+nx) and y in [yFirst,
+// yFirst+ny), so that a fill is a range check and an increment. The fills
+// out of range go to the underflow and overflow cells around them, as in a
+// TH2. Converted to a TH2I with one bin per channel, centered on its
+// coordinates.
+
+class MTDChannelMap : public MTDHisto {
+
+public:
+
+  MTDChannelMap(const std::string& dir, const char* name, const char* title, int xFirst, int nx, int yFirst, int ny);
+
+  void Fill(int x, int y) {
+
+    entries_ += 1.;
+
+    int ix = x - xFirst_ + 1;
+    int iy = y - yFirst_ + 1;
+
+    if ( ix < 1 || ix > nx_ || iy < 1 || iy > ny_ ) {
+      ++outside_;
+      ix = ix < 0 ? 0 : ix > nx_ ? nx_+1 : ix;
+      iy = iy < 0 ? 0 : iy > ny_ ? ny_+1 : iy;
+    }
+
+    ++counts_[iy*(nx_+2) + ix];
+
+  }
+
+  // --- nothing is buffered
+  virtual void flush() override {}
+  virtual void add(const MTDHisto& other) override;
+  virtual size_t nCells() const override { return counts_.size(); }
+  virtual size_t bytes() const override { return counts_.size()*sizeof(uint32_t); }
+
+  int xFirst() const { return xFirst_; }
+  int yFirst() const { return yFirst_; }
+  int nx() const { return nx_; }
+  int ny() const { return ny_; }
+
+  // --- counts in the TH2 bin layout, at bx + by*(nx+2) with bx = x - xFirst
+  //     + 1 (0 and nx+1: underflow and overflow) and likewise by, and number
+  //     of the fills out of range
+  const std::vector<uint32_t>& counts() const { return counts_; }
+  uint64_t outside() const { return outside_; }
+
+
+private:
+
+  int xFirst_;
+  int yFirst_;
+  int nx_;
+  int ny_;
+
+  std::vector<uint32_t> counts_;
+  uint64_t outside_;
+
+};
+
+
+#endif
@@ -0,0 +1,177 @@
+#ifndef MTDCore_interface_MTDHistoFill_h
+#define MTDCore_interface_MTDHistoFill_h
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "MTDtools/MTDCore/interface/MTDBunchCrossing.h"
+#include "MTDtools/MTDCore/interface/MTDHistoRegistry.h"
+#include "MTDtools/MTDCore/interface/MTDHitInput.h"
+#include "MTDtools/MTDCore/interface/MTDJoinedHit.h"
+#include "MTDtools/MTDCore/interface/MTDTimeWalk.h"
+
+
+// Fill points of the histograms, the places in mtdFillHistos() where a set
+// of variables is known. The side of the BTL DIGI and uncalibrated RECO points
+// is the readout side, the side of the ETL points is the zside. The BX
+// points are visited per record and bunch crossing slot, the window points
+// per record and integration window.
+enum MTDFillPoint {
+
+  kBTLEvent,
+  kBTLEventSide,
+  kBTLSimCell,
+  kBTLSimHit,
+  kBTLDigiHit,
+  kBTLURecoHit,
+  kBTLRecoHit,
+  kBTLRecoSimHit,
+  kBTLSimBX,
+  kBTLSimWindow,
+  kBTLRecoSimWindow,
+
+  kETLEvent,
+  kETLSimCell,
+  kETLSimHit,
+  kETLDigiHit,
+  kETLSimBX,
+  kETLDigiBX,
+  kETLSimWindow,
+  kETLRecoSimWindow,
+
+  kNFillPoints
+
+};
+
+
+// Variables of the fill points, as indices of the array passed to
+// MTDHistoRegistry::fill().
+enum MTDFillVariable {
+
+  // --- per event
+  kNSimCell, kNDigi, kNUReco, kNReco,
+
+  // --- SIM
+  kSimNTrk, kSimEnergy, kSimTime,
+  kSimXLocal, kSimYLocal, kSimZLocal,
+  kSimX, kSimY, kSimZ, kSimPhi, kSimEta, kSimAbsEta,
+
+  // --- cell geometry, the ETL module and ring
+  kCellIPhi, kCellIEta, kCellAbsIEta, kCellPhi, kCellEta, kCellZ,
+  kCellModule, kCellRing,
+
+  // --- DIGI, the ETL pad
+  kDigiCharge, kDigiTime1, kDigiTime2, kDigiRow, kDigiCol,
+  kDigiX, kDigiY, kDigiPhi, kDigiEta,
+
+  // --- uncalibrated RECO
+  kURecoCharge, kURecoTime, kURecoTimeUncorr,
+
+  // --- RECO
+  kRecoEnergy, kRecoTime, kRecoTimeUncorr,
+  kEnergyRes, kTimeRes, kTimeResUncorr,
+
+  // --- per bunch crossing, the SIM time from the start of the BX
+  kBX, kBXSimEnergy, kBXSimTime, kBXDigiCharge, kBXDigiTime,
+
+  // --- per SIM energy integration window
+  kWindow, kWindowSimEnergy, kWindowEnergyRes,
+
+  kNFillVariables
+
+};
+
+
+// Complete table of the BTL and ETL histograms, of mtdNHistoDefs entries.
+extern const MTDHistoDef mtdHistoDefs[];
+extern const size_t mtdNHistoDefs;
+
+
+// Geometry-derived quantities of a joined record, in global coordinates
+// [cm]: the hit position is the crystal center for BTL and the DIGI pad
+// center for ETL (the module center for the records without DIGI); the SIM
+// position is the one of the first SIM hit of the cell, 0 for the records
+// without SIM hits. iphi and ieta are the BTL crystal indices, and the
+// module and ring of the ETLDetId for ETL.
+
+struct MTDHitPosition {
+
+  float x;
+  float y;
+  float z;
+  float eta;
+  float phi;
+
+  float sim_x;
+  float sim_y;
+  float sim_z;
+  float sim_eta;
+  float sim_phi;
+
+  int16_t iphi;
+  int16_t ieta;
+
+};
+
+
+// Joined records of an event with their positions: BTL, ETL -Z and ETL +Z,
+// and optionally their bunch crossing slots, window.size() per record, and
+// their SIM energies in the integration windows, windows.size per record
+// (see MTDHitJoiner).
+
+struct MTDEventView {
+
+  struct Hits {
+    const MTDJoinedHit* hits;
+    const MTDHitPosition* positions;
+    size_t size;
+    const MTDBXInfo* bx = nullptr;
+    const float* windowEnergy = nullptr;
+    MTDSpan<float> windows;
+  };
+
+  MTDEventCounts counts;
+  MTDBXWindow window;
+
+  Hits btl;
+  Hits etl[2];
+
+};
+
+
+// Fills the histograms of an event, shared by MTDAnalyzer and the MTDReplay
+// executable. Only the BTL records with RECO energy above btlMinEnergy make
+// hit histograms. The positions are read only at the active fill points:
+// the BTL SIM positions for kBTLSimHit, the ETL ones for kETLSimHit and the
+// ETL hit positions for kETLDigiHit; the BX and window points are filled
+// only for the hits with BX slots and window energies. timeWalk is a scratch store for the
+// correction with btlTimeWalkModel, done only when the uncalibrated RECO or
+// RECO hit histograms are booked.
+
+void mtdFillHistos(MTDHistoRegistry& h, const MTDEventView& event, float btlMinEnergy,
+		   const MTDTimeWalk& btlTimeWalkModel, MTDTimeWalk::Channels& timeWalk);
+
+
+// Parts of mtdFillHistos, in its order: the BTL event, cell and BX
+// histograms with the time-walk correction, the BTL hit histograms of the
+// records [begin, end), and the ETL histograms of one side. The BTL parts
+// and each ETL side fill disjoint histograms, so that they can run
+// concurrently on the same set; the BTL hit ranges can be filled
+// concurrently into other sets, after mtdFillBTLEventHistos, which only
+// need the groups of mtdBTLHitGroups().
+
+void mtdFillBTLEventHistos(MTDHistoRegistry& h, const MTDEventView& event,
+			   const MTDTimeWalk& btlTimeWalkModel, MTDTimeWalk::Channels& timeWalk);
+
+void mtdFillBTLHitHistos(MTDHistoRegistry& h, const MTDEventView& event, size_t begin, size_t end,
+			 float btlMinEnergy, const MTDTimeWalk::Channels& timeWalk);
+
+void mtdFillETLHistos(MTDHistoRegistry& h, const MTDEventView& event, int idet);
+
+// --- the groups of the list with histograms filled by mtdFillBTLHitHistos
+std::vector<std::string> mtdBTLHitGroups(const std::vector<std::string>& groups);
+
+
+#endif
@@ -0,0 +1,129 @@
+#ifndef MTDCore_interface_MTDHistoRegistry_h
+#define MTDCore_interface_MTDHistoRegistry_h
+
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "MTDtools/MTDCore/interface/MTDHisto.h"
+
+
+// Declarative definition of a histogram: the group which enables it, the
+// output directory, where it is filled (fill point and side) and the
+// variables it is filled with, as indices into the array of values passed
+// to MTDHistoRegistry::fill(). Profiles have no y binning. Channel maps
+// have one bin per integer coordinate, nx from xlo and ny from ylo, xhi and
+// yhi being the ends of the ranges.
+
+struct MTDHistoDef {
+
+  enum Kind { k1D, k2D, kProfile, kChannelMap };
+
+  const char* group;
+  const char* dir;
+  int point;
+  int side;
+  Kind kind;
+  const char* name;
+  const char* title;
+
+  int x;
+  int nx;
+  double xlo;
+  double xhi;
+
+  int y = -1;
+  int ny = 0;
+  double ylo = 0.;
+  double yhi = 0.;
+
+};
+
+
+// Set of histograms booked from a table of MTDHistoDef, keeping only the
+// enabled groups.
+//
+// The booked histograms are listed per fill point and side (0 or 1), so
+// that fill() only visits those filled there: the histograms of a disabled
+// group are never booked nor visited, and a fill point whose groups are all
+// disabled is empty (see active()).
+
+class MTDHistoRegistry {
+
+public:
+
+  MTDHistoRegistry() : nDefs_(0), flushSize_(1) {}
+
+  // --- books the histograms of the groups in the list, buffering flushSize
+  //     fills (see MTDHisto); throws std::invalid_argument on a group
+  //     not used by any definition
+  void book(const MTDHistoDef* defs, size_t nDefs, const std::vector<std::string>& groups,
+	    unsigned int flushSize = 1);
+
+  // --- true if some histogram is filled at the fill point, on either side
+  bool active(int point) const {
+    return point < int(points_.size()/2) && !(points_[2*point].empty() && points_[2*point+1].empty());
+  }
+
+  // --- fills the histograms of the fill point and side with the values v,
+  //     indexed by the MTDHistoDef variables
+  void fill(int point, int side, const double* v) {
+
+    if ( 2*point+side >= int(points_.size()) ) return;
+    Point& p = points_[2*point+side];
+
+    for (auto const& f: p.h1) f.histo->Fill(v[f.x]);
+    for (auto const& f: p.h2) f.histo->Fill(v[f.x], v[f.y]);
+    for (auto const& f: p.prof) f.histo->Fill(v[f.x], v[f.y]);
+    for (auto const& f: p.maps) f.histo->Fill(int(v[f.x]), int(v[f.y]));
+
+  }
+
+  // --- fills the buffered values of all histograms
+  void flush();
+
+  // --- adds the content of a flushed set booked from the same definitions,
+  //     with the same groups or some of them; throws std::invalid_argument
+  //     on a histogram of other not booked here
+  void add(const MTDHistoRegistry& other);
+
+  // --- number of booked histograms, of definitions and memory of the
+  //     booked histograms
+  size_t size() const { return all_.size(); }
+  size_t nDefs() const { return nDefs_; }
+  size_t bytes() const;
+
+  // --- booked histogram ih, in the order of the definitions
+  const MTDHisto& histo(size_t ih) const { return *all_[ih]; }
+
+
+private:
+
+  template<typename T> struct Fill {
+    T* histo;
+    int x;
+    int y;
+  };
+
+  struct Point {
+
+    std::vector<Fill<MTDHisto1D> > h1;
+    std::vector<Fill<MTDHisto2D> > h2;
+    std::vector<Fill<MTDProfile> > prof;
+    std::vector<Fill<MTDChannelMap> > maps;
+
+    bool empty() const { return h1.empty() && h2.empty() && prof.empty() && maps.empty(); }
+
+  };
+
+  std::vector<std::unique_ptr<MTDHisto> > all_;
+  std::vector<size_t> defIndex_;   // definition of each of all_
+  std::vector<Point> points_;      // at 2*point + side
+
+  size_t nDefs_;
+  unsigned int flushSize_;
+
+};
+
+
+#endif
@@ -0,0 +1,121 @@
+#ifndef MTDCore_interface_MTDHitInput_h
+#define MTDCore_interface_MTDHitInput_h
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+
+// Framework-independent input of MTDHitJoiner: the hits of one subdetector
+// and data tier as plain structures, filled from the EDM collections by
+// MTDAnalyzer or by a synthetic generator (see MTDSyntheticHits).
+
+
+// Read-only view of n contiguous elements.
+
+template<typename T>
+struct MTDSpan {
+
+  const T* data = nullptr;
+  size_t size = 0;
+
+  MTDSpan() {}
+  MTDSpan(const T* d, size_t n) : data(d), size(n) {}
+  MTDSpan(const std::vector<T>& v) : data(v.data()), size(v.size()) {}
+
+  const T& operator[](size_t i) const { return data[i]; }
+
+  const T* begin() const { return data; }
+  const T* end() const { return data + size; }
+
+};
+
+
+// SIM hit, as the PSimHit of the same quantities. All the hits are given,
+// the joiner selects those of its bunch crossing window.
+
+struct MTDSimHitInput {
+
+  uint32_t rawId;       // detUnitId()
+  int32_t trackId;
+  float tof;            // [ns]
+  float energyLoss;     // [GeV]
+
+  // --- entryPoint(), local
+  float x;
+  float y;
+  float z;
+
+};
+
+
+// DIGI hit: the two readout sides (samples 0 and 1) of a BTL crystal, the
+// on-time sample (sample 2, in [0]) of an ETL module.
+
+struct MTDDigiHitInput {
+
+  uint32_t rawId;
+
+  uint32_t row[2];
+  uint32_t column[2];
+  uint32_t charge[2];   // data()
+  uint32_t toa[2];
+  uint32_t toa2[2];
+
+};
+
+
+// ETL DIGI sample of one bunch crossing (sample 2+BX of the data frame),
+// zero if the data frame has no such sample.
+
+struct MTDDigiSampleInput {
+
+  uint32_t charge;
+  uint32_t toa;
+
+};
+
+
+// Uncalibrated RECO hit: amplitudes and times of the two readout sides of
+// BTL, of the only side in [0] for ETL.
+
+struct MTDURecoHitInput {
+
+  uint32_t rawId;
+
+  float amplitude[2];   // [pC]
+  float time[2];        // [ns]
+
+};
+
+
+// RECO hit.
+
+struct MTDRecoHitInput {
+
+  uint32_t rawId;
+
+  float energy;         // [MeV]
+  float time;           // [ns]
+
+};
+
+
+// All the tiers of one subdetector. The tiers which are not read are empty.
+// digiBX has the ETL DIGI samples of the bunch crossing window of the
+// joiner, window size samples per element of digi, in the same order; it
+// is empty when only the in-time sample is used.
+
+struct MTDTierInputs {
+
+  MTDSpan<MTDSimHitInput> sim;
+  MTDSpan<MTDDigiHitInput> digi;
+  MTDSpan<MTDURecoHitInput> ureco;
+  MTDSpan<MTDRecoHitInput> reco;
+
+  MTDSpan<MTDDigiSampleInput> digiBX;
+
+};
+
+
+#endif
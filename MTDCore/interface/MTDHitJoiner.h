@@ -0,0 +1,444 @@
+#ifndef MTDCore_interface_MTDHitJoiner_h
+#define MTDCore_interface_MTDHitJoiner_h
+
+#include <cstdint>
+#include <vector>
+
+#include "MTDtools/MTDCore/interface/MTDBunchCrossing.h"
+#include "MTDtools/MTDCore/interface/MTDHitInput.h"
+#include "MTDtools/MTDCore/interface/MTDJoinedHit.h"
+#include "MTDtools/MTDCore/interface/MTDMergeJoin.h"
+#include "MTDtools/MTDCore/interface/MTDSimHitSorter.h"
+#include "MTDtools/MTDCore/interface/MTDSmallSet.h"
+
+
+// Optional per-record outputs of a join, each bx[i] and windowEnergy[i]
+// being parallel to the records of out[i]: the BX slots (window().size() per
+// record) and the SIM energies [MeV] of the in-time hits integrated up to
+// each of the increasing windows [ns] (windows.size per record).
+
+struct MTDJoinSlots {
+
+  std::vector<MTDBXInfo>* bx = nullptr;
+
+  MTDSpan<float> windows;
+  std::vector<float>* windowEnergy = nullptr;
+
+};
+
+
+// Accumulation and join of the tiers of one subdetector into one joined
+// record per cell: order() puts every tier in DetId order (the SIM hits
+// through the radix-sorted references, the other tiers as they are when
+// already ordered, see MTDSortedIndex), then joinBTL() or joinETL() merges
+// them (see mtdMergeJoin) and counts the cells of every tier.
+//
+// The cell and the output of a DetId are given by route(rawId, cell), which
+// sets the cell number and returns the index in out of the vector the record
+// is appended to (0 for BTL, the zside (0 for -Z, 1 for +Z) for ETL), or -1
+// to drop the DetId; the ETL counts are per output.
+//
+// Out-of-time pileup: the SIM hits of the bunch crossing window given to
+// order() are joined, the MTDinfo of the records and the counts keeping only
+// the in-time BX. With bx set, the records of out[i] also get window size
+// MTDBXInfo slots each in bx[i], in the same order, accumulated in the same
+// pass: the SIM hits of every BX of the window and, for ETL, the DIGI
+// samples of every BX (digiBX input). A cell with hits in an out-of-time BX
+// only makes a record without in-time information.
+//
+// Integration windows: the in-time SIM hits of a cell being time-ordered,
+// the energies in all the windows of MTDJoinSlots are read off one running
+// sum at the first hit of the cell, the window of MTDinfo::sim_energy
+// (integrationWindow) being applied as before.
+//
+// The scratch stores are kept across events: one joiner per stream, the
+// tiers of a subdetector being ordered right before they are joined.
+
+class MTDHitJoiner {
+
+public:
+
+  // --- DetId order of all the tiers, SIM hits of the window only
+  void order(const MTDTierInputs& in, const MTDBXWindow& window = MTDBXWindow());
+
+  // --- SIM energy integrated up to integrationWindow [ns] from the start of
+  //     the BX, as the readout electronics; DIGI and uncalibrated RECO of
+  //     both readout sides, the BTL DIGI having no samples of other BXs
+  template<typename Route>
+  void joinBTL(const MTDTierInputs& in, float integrationWindow, Route route,
+	       std::vector<MTDJoinedHit>* out, MTDEventCounts& counts,
+	       const MTDJoinSlots& slots = MTDJoinSlots());
+
+  // --- SIM energy as for BTL (kMTDNoWindow: all the energy); DIGI records
+  //     made only by the samples with charge and time, the on-time one for
+  //     MTDinfo
+  template<typename Route>
+  void joinETL(const MTDTierInputs& in, float integrationWindow, Route route,
+	       std::vector<MTDJoinedHit>* out, MTDEventCounts& counts,
+	       const MTDJoinSlots& slots = MTDJoinSlots());
+
+  const MTDBXWindow& window() const { return window_; }
+
+
+private:
+
+  // --- first SIM hit of the cell: time and local entry point
+  static void setFirstSimHit(const MTDSimHitInput& hit, MTDinfo& info) {
+    if( info.sim_time==0 ) {
+      info.sim_time = hit.tof;
+      info.sim_x = hit.x;
+      info.sim_y = hit.y;
+      info.sim_z = hit.z;
+    }
+  }
+
+  // --- SIM hit of energy [MeV] in the slot of its BX
+  static void addSimHit(const MTDSimHitInput& hit, double energy, MTDBXInfo& slot) {
+    slot.sim_energy += energy;
+    if ( slot.sim_nhits++ == 0 ) slot.sim_time = hit.tof;
+  }
+
+  // --- energies of the in-time SIM hits of the cell of the reference
+  //     hitRefs[i] and the following ones in the increasing windows
+  void integrate(const MTDSpan<MTDSimHitInput>& sim, size_t i, const MTDSpan<float>& windows,
+		 float* energy) const;
+
+  // --- sink of mtdMergeJoin: appends the records to out[route(rawId, cell)]
+  //     and their zeroed slots to the MTDJoinSlots outputs
+  template<typename Route>
+  class Sink {
+
+  public:
+
+    Sink(Route& route, std::vector<MTDJoinedHit>* out, const MTDJoinSlots& slots, int nBX) :
+      route_(route), out_(out), bx_(slots.bx), energy_(slots.windowEnergy),
+      nBX_(nBX), nWindows_(slots.windows.size), iout_(-1), bxSlots_(nullptr), energySlots_(nullptr) {}
+
+    MTDinfo* open(uint32_t rawId) {
+      uint32_t cell;
+      iout_ = route_(rawId, cell);
+      if ( iout_ < 0 ) return nullptr;
+      out_[iout_].push_back( {rawId, cell, MTDinfo()} );
+      if ( bx_ != nullptr )
+	bxSlots_ = append(bx_[iout_], nBX_);
+      if ( energy_ != nullptr )
+	energySlots_ = append(energy_[iout_], nWindows_);
+      return &out_[iout_].back().info;
+    }
+
+    void close(bool keep) {
+      if ( keep ) return;
+      out_[iout_].pop_back();
+      if ( bx_ != nullptr ) bx_[iout_].resize(bx_[iout_].size() - nBX_);
+      if ( energy_ != nullptr ) energy_[iout_].resize(energy_[iout_].size() - nWindows_);
+    }
+
+    // --- output, BX slots and window energies (nullptr without the
+    //     corresponding output) of the current record
+    int output() const { return iout_; }
+    MTDBXInfo* slots() const { return bxSlots_; }
+    float* windowEnergies() const { return energySlots_; }
+
+  private:
+
+    template<typename T>
+    static T* append(std::vector<T>& v, size_t n) {
+      v.resize(v.size() + n, T());
+      return v.data() + v.size() - n;
+    }
+
+    Route& route_;
+    std::vector<MTDJoinedHit>* out_;
+    std::vector<MTDBXInfo>* bx_;
+    std::vector<float>* energy_;
+    const size_t nBX_;
+    const size_t nWindows_;
+    int iout_;
+    MTDBXInfo* bxSlots_;
+    float* energySlots_;
+
+  };
+
+  MTDBXWindow window_;
+
+  MTDSimHitSorter simHitSorter_;
+
+  MTDSortedIndex digiOrder_;
+  MTDSortedIndex urecoOrder_;
+  MTDSortedIndex recoOrder_;
+
+  // --- distinct SIM tracks of the current cell: the hits are sorted by
+  //     DetId, so the hits of a cell are contiguous
+  MTDSmallSet<int,8> simTrackIds_;
+
+};
+
+
+template<typename Route>
+void MTDHitJoiner::joinBTL(const MTDTierInputs& in, float integrationWindow, Route route,
+			   std::vector<MTDJoinedHit>* out, MTDEventCounts& counts,
+			   const MTDJoinSlots& slots) {
+
+  Sink<Route> sink(route, out, slots, window_.size());
+
+  // --- SIM hits: SimHits of the window sorted per detector id and time,
+  //     accumulated in the same detector cell
+
+  const auto& hitRefs = simHitSorter_.refs();
+  uint32_t lastId = 0;
+
+  auto simTier = makeMTDJoinTier(hitRefs.size(),
+    [&](size_t i) { return hitRefs[i].rawId(); },
+    [&](size_t i, MTDinfo& info) {
+
+      const MTDSimHitInput& hit = in.sim[hitRefs[i].index];
+      const int ibx = MTDBXWindow::bx(hit.tof);
+
+      if ( hitRefs[i].rawId() != lastId ) {
+	lastId = hitRefs[i].rawId();
+	simTrackIds_.clear();
+	if ( float* energy = sink.windowEnergies() )
+	  integrate(in.sim, i, slots.windows, energy);
+      }
+
+      // This is to emulate the time integration window in the readout
+      // electronics.
+      const double energy = hit.tof - kMTDBXLength*ibx < integrationWindow ? 1000.*hit.energyLoss : 0.;
+
+      if ( MTDBXInfo* slots = sink.slots() )
+	addSimHit(hit, energy, slots[window_.slot(ibx)]);
+
+      if ( ibx != 0 ) return true;
+
+      if ( simTrackIds_.empty() )
+	counts.n_sim_btl++;
+
+      info.sim_energy += energy;
+
+      simTrackIds_.insert(hit.trackId);
+      info.sim_ntrk = simTrackIds_.size();
+
+      // Get the time of the first SimHit in the cell
+      setFirstSimHit(hit, info);
+
+      return true;
+
+    });
+
+
+  // --- DIGI hits
+
+  auto digiTier = makeMTDJoinTier(in.digi.size,
+    [&](size_t i) { return in.digi[digiOrder_[i]].rawId; },
+    [&](size_t i, MTDinfo& info) {
+
+      const MTDDigiHitInput& digi = in.digi[digiOrder_[i]];
+
+      for (int iside = 0; iside < 2; ++iside) {
+
+	info.digi_row[iside]    = digi.row[iside];
+	info.digi_col[iside]    = digi.column[iside];
+	info.digi_charge[iside] = digi.charge[iside];
+	info.digi_time1[iside]  = digi.toa[iside];
+	info.digi_time2[iside]  = digi.toa2[iside];
+
+	if ( digi.charge[iside] > 0 )
+	  counts.n_digi_btl[iside]++;
+
+      }
+
+      return true;
+
+    });
+
+
+  // --- Uncalibrated RECO hits
+
+  auto urecoTier = makeMTDJoinTier(in.ureco.size,
+    [&](size_t i) { return in.ureco[urecoOrder_[i]].rawId; },
+    [&](size_t i, MTDinfo& info) {
+
+      const MTDURecoHitInput& urecHit = in.ureco[urecoOrder_[i]];
+
+      for (int iside = 0; iside < 2; ++iside) {
+
+	info.ureco_charge[iside] = urecHit.amplitude[iside];
+	info.ureco_time[iside]   = urecHit.time[iside];
+
+	if ( urecHit.amplitude[iside] > 0. )
+	  counts.n_ureco_btl[iside]++;
+
+      }
+
+      return true;
+
+    });
+
+
+  // --- RECO hits
+
+  auto recoTier = makeMTDJoinTier(in.reco.size,
+    [&](size_t i) { return in.reco[recoOrder_[i]].rawId; },
+    [&](size_t i, MTDinfo& info) {
+
+      const MTDRecoHitInput& recHit = in.reco[recoOrder_[i]];
+
+      info.reco_energy = recHit.energy;
+      info.reco_time   = recHit.time;
+
+      if ( recHit.energy > 0. )
+	counts.n_reco_btl++;
+
+      return true;
+
+    });
+
+
+  mtdMergeJoin(sink, simTier, digiTier, urecoTier, recoTier);
+
+}
+
+
+template<typename Route>
+void MTDHitJoiner::joinETL(const MTDTierInputs& in, float integrationWindow, Route route,
+			   std::vector<MTDJoinedHit>* out, MTDEventCounts& counts,
+			   const MTDJoinSlots& slots) {
+
+  // --- the zside of the current record is the sink output, set before the
+  //     tiers are consumed
+  Sink<Route> sink(route, out, slots, window_.size());
+
+  // --- SIM hits
+
+  const auto& hitRefs = simHitSorter_.refs();
+  uint32_t lastId = 0;
+
+  auto simTier = makeMTDJoinTier(hitRefs.size(),
+    [&](size_t i) { return hitRefs[i].rawId(); },
+    [&](size_t i, MTDinfo& info) {
+
+      const MTDSimHitInput& hit = in.sim[hitRefs[i].index];
+      const int ibx = MTDBXWindow::bx(hit.tof);
+
+      if ( hitRefs[i].rawId() != lastId ) {
+	lastId = hitRefs[i].rawId();
+	simTrackIds_.clear();
+	if ( float* energy = sink.windowEnergies() )
+	  integrate(in.sim, i, slots.windows, energy);
+      }
+
+      const double energy = hit.tof - kMTDBXLength*ibx < integrationWindow ? 1000.*hit.energyLoss : 0.;
+
+      if ( MTDBXInfo* slots = sink.slots() )
+	addSimHit(hit, energy, slots[window_.slot(ibx)]);
+
+      if ( ibx != 0 ) return true;
+
+      if ( simTrackIds_.empty() )
+	counts.n_sim_etl[sink.output()]++;
+
+      info.sim_energy += energy;
+
+      simTrackIds_.insert(hit.trackId);
+      info.sim_ntrk = simTrackIds_.size();
+
+      // Get the time of the first SimHit in the cell
+      setFirstSimHit(hit, info);
+
+      return true;
+
+    });
+
+
+  // --- DIGI hits: only the samples of the window make a record, the
+  //     on-time one being read from digi and the others from digiBX
+
+  const int nBX = window_.size();
+  const int inTime = window_.slot(0);
+
+  auto digiTier = makeMTDJoinTier(in.digi.size,
+    [&](size_t i) { return in.digi[digiOrder_[i]].rawId; },
+    [&](size_t i, MTDinfo& info) {
+
+      const uint32_t id = digiOrder_[i];
+      const MTDDigiHitInput& digi = in.digi[id];
+
+      bool touched = false;
+      MTDBXInfo* slots = sink.slots();
+
+      if ( in.digiBX.size != 0 ) {
+	for (int islot = 0; islot < nBX; ++islot) {
+	  const MTDDigiSampleInput& sample = in.digiBX[size_t(id)*nBX + islot];
+	  if ( islot == inTime || sample.charge==0 || sample.toa==0 ) continue;
+	  if ( slots != nullptr ) {
+	    slots[islot].digi_charge = sample.charge;
+	    slots[islot].digi_time1  = sample.toa;
+	  }
+	  touched = true;
+	}
+      }
+
+      if ( digi.charge[0]==0 || digi.toa[0]==0 ) return touched;
+
+      if ( slots != nullptr ) {
+	slots[inTime].digi_charge = digi.charge[0];
+	slots[inTime].digi_time1  = digi.toa[0];
+      }
+
+      info.digi_row[0] = digi.row[0];
+      info.digi_col[0] = digi.column[0];
+
+      info.digi_charge[0] = digi.charge[0];
+      info.digi_time1[0]  = digi.toa[0];
+
+      counts.n_digi_etl[sink.output()]++;
+
+      return true;
+
+    });
+
+
+  // --- Uncalibrated RECO hits
+
+  auto urecoTier = makeMTDJoinTier(in.ureco.size,
+    [&](size_t i) { return in.ureco[urecoOrder_[i]].rawId; },
+    [&](size_t i, MTDinfo& info) {
+
+      const MTDURecoHitInput& urecHit = in.ureco[urecoOrder_[i]];
+
+      info.ureco_charge[0] = urecHit.amplitude[0];
+      info.ureco_time[0]   = urecHit.time[0];
+
+      if ( urecHit.amplitude[0] > 0. )
+	counts.n_ureco_etl[sink.output()]++;
+
+      return true;
+
+    });
+
+
+  // --- RECO hits
+
+  auto recoTier = makeMTDJoinTier(in.reco.size,
+    [&](size_t i) { return in.reco[recoOrder_[i]].rawId; },
+    [&](size_t i, MTDinfo& info) {
+
+      const MTDRecoHitInput& recHit = in.reco[recoOrder_[i]];
+
+      info.reco_energy = recHit.energy;
+      info.reco_time   = recHit.time;
+
+      if ( recHit.energy > 0. )
+	counts.n_reco_etl[sink.output()]++;
+
+      return true;
+
+    });
+
+
+  mtdMergeJoin(sink, simTier, digiTier, urecoTier, recoTier);
+
+}
+
+
+#endif
@@ -0,0 +1,66 @@
+#ifndef MTDCore_interface_MTDJoinedHit_h
+#define MTDCore_interface_MTDJoinedHit_h
+
+#include <cstdint>
+
+
+// SIM, DIGI, uncalibrated RECO and RECO information of one MTD cell.
+
+struct MTDinfo {
+
+  float sim_energy;
+  float sim_time;
+  float sim_x;
+  float sim_y;
+  float sim_z;
+
+  uint32_t digi_row[2];
+  uint32_t digi_col[2];
+  uint32_t digi_charge[2];
+  uint32_t digi_time1[2];
+  uint32_t digi_time2[2];
+
+  float ureco_charge[2];
+  float ureco_time[2];
+
+  float reco_energy;
+  float reco_time;
+
+  uint32_t sim_ntrk;
+
+};
+
+
+// Joined record of a cell: readout DetId, MTDCellIndex cell and the
+// information of all the data tiers.
+
+struct MTDJoinedHit {
+
+  uint32_t rawId;
+  uint32_t cell;
+
+  MTDinfo info;
+
+};
+
+
+// Number of cells of an event per subdetector and tier, counted while
+// joining the tiers (BTL DIGI and uncalibrated RECO per readout side, ETL
+// per zside).
+
+struct MTDEventCounts {
+
+  uint32_t n_sim_btl;
+  uint32_t n_digi_btl[2];
+  uint32_t n_ureco_btl[2];
+  uint32_t n_reco_btl;
+
+  uint32_t n_sim_etl[2];
+  uint32_t n_digi_etl[2];
+  uint32_t n_ureco_etl[2];
+  uint32_t n_reco_etl[2];
+
+};
+
+
+#endif
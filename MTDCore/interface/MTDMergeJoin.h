@@ -0,0 +1,138 @@
+#ifndef MTDCore_interface_MTDMergeJoin_h
+#define MTDCore_interface_MTDMergeJoin_h
+
+#include <algorithm>
+#include <cstdint>
+#include <limits>
+#include <vector>
+
+#include "MTDtools/MTDCore/interface/MTDJoinedHit.h"
+#include "MTDtools/MTDCore/interface/MTDSimHitSorter.h"
+
+
+// Streaming k-way merge-join of DetId-ordered data tiers into one joined
+// record per cell, without any lookup table.
+//
+// A tier is any object providing
+//
+//   uint64_t head() const                    raw DetId of the next element,
+//                                            kMTDJoinEnd when exhausted
+//   bool consume(uint64_t id, MTDinfo& info) adds all the elements of DetId id
+//                                            to info, true if info was set
+//   void skip(uint64_t id)                   drops all the elements of DetId id
+//
+// and a sink provides
+//
+//   MTDinfo* open(uint32_t rawId)            new record, nullptr to drop the DetId
+//   void close(bool keep)                    keeps or discards the last record
+//
+// The cells are visited in increasing DetId order.
+
+constexpr uint64_t kMTDJoinEnd = std::numeric_limits<uint64_t>::max();
+
+template <typename Sink, typename... Tiers>
+void mtdMergeJoin(Sink& sink, Tiers&... tiers) {
+
+  for (;;) {
+
+    const uint64_t id = std::min({tiers.head()...});
+    if ( id == kMTDJoinEnd ) return;
+
+    MTDinfo* info = sink.open(id);
+
+    if ( info == nullptr ) {
+      (tiers.skip(id), ...);
+      continue;
+    }
+
+    bool touched = false;
+    ((touched |= tiers.consume(id, *info)), ...);
+
+    sink.close(touched);
+
+  }
+
+}
+
+
+// Tier over n DetId-ordered elements: key(i) returns the raw DetId of the
+// i-th element, fill(i, info) adds it to a record and returns true if it
+// did set anything.
+
+template <typename Key, typename Fill>
+class MTDJoinTier {
+
+public:
+
+  MTDJoinTier(size_t n, Key key, Fill fill) : n_(n), pos_(0), key_(key), fill_(fill) {}
+
+  uint64_t head() const { return pos_ < n_ ? uint64_t(key_(pos_)) : kMTDJoinEnd; }
+
+  bool consume(uint64_t id, MTDinfo& info) {
+    bool touched = false;
+    for ( ; pos_ < n_ && key_(pos_) == id; ++pos_)
+      touched |= fill_(pos_, info);
+    return touched;
+  }
+
+  void skip(uint64_t id) {
+    while ( pos_ < n_ && key_(pos_) == id ) ++pos_;
+  }
+
+
+private:
+
+  const size_t n_;
+  size_t pos_;
+  Key key_;
+  Fill fill_;
+
+};
+
+template <typename Key, typename Fill>
+MTDJoinTier<Key,Fill> makeMTDJoinTier(size_t n, Key key, Fill fill) {
+  return MTDJoinTier<Key,Fill>(n, key, fill);
+}
+
+
+// DetId order of the elements of an input array. Arrays which are already
+// ordered (the usual case for those of edm::SortedCollection products) are
+// visited as they are; otherwise a stable radix sort of the positions is
+// done, so that duplicated DetIds keep their input order.
+
+class MTDSortedIndex {
+
+public:
+
+  template <typename T>
+  void build(const MTDSpan<T>& hits) {
+
+    const size_t n = hits.size;
+
+    sorted_ = true;
+    for (size_t i = 1; i < n && sorted_; ++i)
+      sorted_ = hits[i-1].rawId <= hits[i].rawId;
+
+    if ( sorted_ ) return;
+
+    refs_.clear();
+    for (uint32_t i = 0; i < n; ++i)
+      refs_.push_back( {(uint64_t(hits[i].rawId) << 32) | i, i} );
+
+    MTDSimHitSorter::sortRefs(refs_, buffer_);
+
+  }
+
+  uint32_t operator[](size_t i) const { return sorted_ ? i : refs_[i].index; }
+
+
+private:
+
+  bool sorted_ = true;
+  std::vector<MTDSimHitRef> refs_;
+  std::vector<MTDSimHitRef> buffer_;
+
+};
+
+
+#endif
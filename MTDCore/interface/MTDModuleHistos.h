@@ -0,0 +1,124 @@
+#ifndef MTDCore_interface_MTDModuleHistos_h
+#define MTDCore_interface_MTDModuleHistos_h
+
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "MTDtools/MTDCore/interface/MTDHistoFill.h"
+#include "MTDtools/MTDCore/interface/MTDHistoRegistry.h"
+
+
+// Fill points of the module histograms, with the MTDFillVariable
+// variables: per module with RECO cells in the event (kNReco is their
+// number), per RECO record and per RECO record with a SIM hit.
+enum MTDModuleFillPoint {
+
+  kModuleEvent,
+  kModuleRecoHit,
+  kModuleRecoSimHit,
+
+  kNModuleFillPoints
+
+};
+
+
+// Table of the module histograms, of mtdNModuleHistoDefs entries: the
+// BTLModule and ETLModule groups. Their directory is the one of the module.
+extern const MTDHistoDef mtdModuleHistoDefs[];
+extern const size_t mtdNModuleHistoDefs;
+
+
+// Family of histogram sets of one group, one per module: the set of a
+// module is booked on its first fill, in the directory named by the
+// directory function, so that the modules without hits take neither memory
+// nor space in the output. The modules are found by key, through a hash
+// directory which reserve() can pre-size to the number of modules of the
+// geometry, the last one found being looked up first.
+
+class MTDModuleHistos {
+
+public:
+
+  struct Module {
+    uint32_t key;
+    MTDHistoRegistry histos;
+    uint32_t nCells = 0;      // cells counted in the current event
+  };
+
+  using Directory = std::function<std::string(uint32_t key)>;
+
+  MTDModuleHistos() : flushSize_(1), last_(nullptr) {}
+
+  // --- enables the family with the definitions of group, buffering
+  //     flushSize fills; throws std::invalid_argument on a group not used by
+  //     any definition
+  void book(const MTDHistoDef* defs, size_t nDefs, const std::string& group, Directory directory,
+	    unsigned int flushSize = 1);
+
+  bool enabled() const { return !defs_.empty(); }
+
+  void reserve(size_t nModules) { index_.reserve(nModules); modules_.reserve(nModules); }
+
+  // --- module of key, booked on the first call
+  Module& module(uint32_t key) {
+    if ( last_ != nullptr && last_->key == key ) return *last_;
+    auto im = index_.find(key);
+    last_ = im != index_.end() ? modules_[im->second].get() : bookModule(key);
+    return *last_;
+  }
+
+  // --- counts a cell of module m in the current event; endEvent() calls
+  //     f(module) for each module with cells, and resets their counts
+  void countCell(Module& m) { if ( m.nCells++ == 0 ) touched_.push_back(&m); }
+
+  template<typename F> void endEvent(F f) {
+    for (Module* m: touched_) { f(*m); m->nCells = 0; }
+    touched_.clear();
+  }
+
+  void flush();
+
+  // --- adds the content of a flushed family of the same group, booking the
+  //     modules missing here
+  void add(const MTDModuleHistos& other);
+
+  // --- booked modules, in booking order
+  size_t size() const { return modules_.size(); }
+  const Module& operator[](size_t im) const { return *modules_[im]; }
+
+  size_t bytes() const;
+
+
+private:
+
+  Module* bookModule(uint32_t key);
+
+  std::string group_;
+  std::vector<MTDHistoDef> defs_;   // of group_
+  Directory directory_;
+  unsigned int flushSize_;
+
+  std::vector<std::unique_ptr<Module> > modules_;
+  std::unordered_map<uint32_t,uint32_t> index_;   // key -> modules_ index
+  Module* last_;
+  std::vector<Module*> touched_;
+
+};
+
+
+// Fills the module histograms of an event: the BTL records with RECO energy
+// from btlMinEnergy, and the ETL records with RECO energy of both sides.
+// moduleKey maps the rawId of a record to the key of its module.
+
+void mtdFillBTLModuleHistos(MTDModuleHistos& h, const MTDEventView& event, float btlMinEnergy,
+			    const std::function<uint32_t(uint32_t)>& moduleKey);
+
+void mtdFillETLModuleHistos(MTDModuleHistos& h, const MTDEventView& event,
+			    const std::function<uint32_t(uint32_t)>& moduleKey);
+
+
+#endif
@@ -0,0 +1,154 @@
+#ifndef MTDCore_interface_MTDResolution_h
+#define MTDCore_interface_MTDResolution_h
+
+#include <cmath>
+#include <cstdint>
+#include <ostream>
+#include <vector>
+
+#include "MTDtools/MTDCore/interface/MTDHistoFill.h"
+#include "MTDtools/MTDCore/interface/MTDTimeWalk.h"
+
+
+// Streaming estimator of the distribution of a signed quantity, in fixed
+// memory: the entries are counted in logarithmic buckets of |x|, 1/64 of a
+// factor 2 wide, from 2^-12 to 2^12 for each sign (the smaller ones count
+// as zero, the larger ones in the last bucket). The quantiles are within
+// 0.55% of |x|, or 2^-12, whatever the number of entries, and two sketches
+// are merged by adding their buckets.
+//
+// 12 kB, allocated on the first add().
+
+class MTDSketch {
+
+public:
+
+  MTDSketch() : n_(0), zero_(0), sum_(0.), min_(0.), max_(0.) {}
+
+  void add(double x);
+  void add(const MTDSketch& other);
+
+  uint64_t n() const { return n_; }
+  double mean() const { return n_ > 0 ? sum_/n_ : 0.; }
+  double min() const { return min_; }
+  double max() const { return max_; }
+
+  // --- q-quantile
+  double quantile(double q) const;
+
+  // --- half width of the shortest interval holding a fraction coverage of
+  //     the entries
+  double effectiveSigma(double coverage = 0.6827) const;
+
+  // --- fraction of the entries out of [lo, hi]
+  double outside(double lo, double hi) const;
+
+  size_t bytes() const { return buckets_.size()*sizeof(uint32_t); }
+
+
+private:
+
+  static constexpr int kBucketsPerOctave = 64;
+  static constexpr int kMinExponent = -12;
+  static constexpr int kNBuckets = 24*kBucketsPerOctave;   // per sign
+
+  // --- buckets in increasing order of x: negative ones from the largest
+  //     |x|, zero, positive ones
+  int position(double x) const;
+  double value(int position) const;
+  uint64_t count(int position) const {
+    return position == kNBuckets ? zero_ : buckets_[position < kNBuckets ? position : position-1];
+  }
+
+  uint64_t n_;
+  uint64_t zero_;
+  double sum_;
+  double min_;
+  double max_;
+
+  std::vector<uint32_t> buckets_;   // negative, from the largest |x|, then positive
+
+};
+
+
+// Resolution sketches of the RECO - SIM time and energy residuals, per
+// subdetector and per region of |eta|, phi and uncalibrated RECO amplitude:
+// the sketches of a region are only allocated once filled, so that an
+// (eta, phi) grid common to BTL and ETL costs nothing where a subdetector
+// has no cell.
+//
+// write() reports, for all the regions together and per region, the
+// entries, mean, median, core sigma (interquartile range / 1.349), effective
+// sigma and the fraction of entries more than 3 core sigmas away from the
+// median.
+//
+// The hits out of the |eta| acceptance of their subdetector (e.g. ETL hits
+// without position, at eta 0) are counted, and reported by write().
+
+class MTDResolution {
+
+public:
+
+  enum Detector { kBTL, kETL, kNDetectors };
+  enum Quantity { kTime, kTimeUncorr, kEnergy, kNQuantities };
+
+  struct Binning {
+    unsigned int nEta = 6;          // |eta| in [0, 3]
+    unsigned int nPhi = 1;
+    unsigned int nAmplitude = 4;    // logarithmic
+    float minAmplitude = 0.1;       // [pC]
+    float maxAmplitude = 100.;      // [pC]
+  };
+
+  struct Scratch {
+    MTDTimeWalk::Channels channels;
+    std::vector<uint32_t> hits;
+  };
+
+  // --- throws std::invalid_argument on an empty grid or amplitude range
+  explicit MTDResolution(const Binning& binning);
+  MTDResolution() : MTDResolution(Binning()) {}
+
+  void add(Detector det, Quantity quantity, float eta, float phi, float amplitude, float residual) {
+    sketches_[(det*kNQuantities + quantity)*nRegions_ + region(eta, phi, amplitude)].add(residual);
+    if ( quantity == kTime && !(std::fabs(eta) >= kMinEta[det] && std::fabs(eta) <= kMaxEta[det]) ) ++outside_[det];
+  }
+
+  // --- adds the sketches of other, with the same binning
+  void add(const MTDResolution& other);
+
+  void write(std::ostream& os) const;
+
+  // --- hits of the subdetector out of its |eta| acceptance
+  uint64_t outsideAcceptance(Detector det) const { return outside_[det]; }
+
+  size_t bytes() const;
+
+  // --- |eta| acceptance of the subdetectors, with a margin
+  static constexpr float kMinEta[kNDetectors] = { 0.f, 1.5f };
+  static constexpr float kMaxEta[kNDetectors] = { 1.5f, 3.1f };
+
+private:
+
+  unsigned int region(float eta, float phi, float amplitude) const;
+
+  Binning binning_;
+  unsigned int nRegions_;
+
+  std::vector<MTDSketch> sketches_;   // at (det*kNQuantities + quantity)*nRegions + region
+  uint64_t outside_[kNDetectors];
+
+};
+
+
+// Adds the residuals of the RECO records with a SIM hit of an event: the
+// BTL ones with RECO energy from btlMinEnergy, the time residuals also
+// before the time-walk correction of btlTimeWalkModel, and the ETL ones.
+// The amplitude is the mean of the BTL sides with uncalibrated RECO, the
+// ETL one.
+
+void mtdFillResolution(MTDResolution& resolution, const MTDEventView& event, float btlMinEnergy,
+		       const MTDTimeWalk& btlTimeWalkModel, MTDResolution::Scratch& scratch);
+
+
+#endif
@@ -0,0 +1,137 @@
+#ifndef MTDCore_interface_MTDSimHitSorter_h
+#define MTDCore_interface_MTDSimHitSorter_h
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+#include "MTDtools/MTDCore/interface/MTDBunchCrossing.h"
+#include "MTDtools/MTDCore/interface/MTDHitInput.h"
+
+
+// Reference to a SIM hit of an MTDSimHitInput array, with the packed sort key
+// (raw DetId in the upper 32 bits, ToF in the lower 32 bits as a bit pattern
+// which orders like the ToF itself).
+
+struct MTDSimHitRef {
+
+  uint64_t key;
+  uint32_t index;
+
+  uint32_t rawId() const { return key >> 32; }
+
+};
+
+
+// Orders the SIM hits of a bunch crossing window of an array by DetId and
+// then by time, without copying them: the (key, index) pairs are sorted with
+// a stable LSD radix sort on the 64-bit key, skipping the byte passes in
+// which all the keys agree (typically the subdetector bits of the DetId and
+// the exponent of the ToF). The buffers are kept across events.
+
+class MTDSimHitSorter {
+
+public:
+
+  // --- SIM hits of the window (by default the in-time ones, 0 <= ToF <=
+  //     25 ns) with non-null DetId, sorted by DetId and time
+  const std::vector<MTDSimHitRef>& sort(const MTDSpan<MTDSimHitInput>& hits,
+					const MTDBXWindow& window = MTDBXWindow()) {
+
+    refs_.clear();
+    refs_.reserve(hits.size);
+
+    for (uint32_t ih = 0; ih < hits.size; ++ih) {
+
+      const MTDSimHitInput& simHit = hits[ih];
+
+      // Consider only the BXs of the window
+      if ( !window.contains(simHit.tof) ) continue;
+
+      if ( simHit.rawId == 0 ) continue;
+
+      refs_.push_back( {(uint64_t(simHit.rawId) << 32) | timeBits(simHit.tof), ih} );
+
+    }
+
+    sortRefs(refs_, buffer_);
+
+    return refs_;
+
+  }
+
+  // --- result of the last sort()
+  const std::vector<MTDSimHitRef>& refs() const { return refs_; }
+
+  // --- stable sort of refs by key, buffer is used as scratch space
+  static void sortRefs(std::vector<MTDSimHitRef>& refs, std::vector<MTDSimHitRef>& buffer) {
+
+    const size_t n = refs.size();
+
+    if ( n < kMinRadixSize ) {
+      std::stable_sort(refs.begin(), refs.end(),
+		       [](const MTDSimHitRef& a, const MTDSimHitRef& b) { return a.key < b.key; });
+      return;
+    }
+
+    // one pass to histogram all the key bytes
+    uint32_t counts[8][256];
+    std::memset(counts, 0, sizeof(counts));
+
+    for (auto const& ref: refs)
+      for (int ib = 0; ib < 8; ++ib)
+	++counts[ib][(ref.key >> (8*ib)) & 0xff];
+
+    buffer.resize(n);
+    MTDSimHitRef* src = refs.data();
+    MTDSimHitRef* dst = buffer.data();
+
+    for (int ib = 0; ib < 8; ++ib) {
+
+      uint32_t* count = counts[ib];
+
+      // all keys share this byte: the pass would not change the order
+      if ( count[(src[0].key >> (8*ib)) & 0xff] == n ) continue;
+
+      uint32_t offset = 0;
+      for (int ibin = 0; ibin < 256; ++ibin) {
+	uint32_t c = count[ibin];
+	count[ibin] = offset;
+	offset += c;
+      }
+
+      for (size_t ir = 0; ir < n; ++ir)
+	dst[count[(src[ir].key >> (8*ib)) & 0xff]++] = src[ir];
+
+      std::swap(src, dst);
+
+    }
+
+    if ( src != refs.data() )
+      refs.swap(buffer);
+
+  }
+
+
+private:
+
+  static constexpr size_t kMinRadixSize = 256;
+
+  // --- IEEE bit pattern with the sign bit set for the non-negative values
+  //     and all the bits flipped for the negative ones, so that it orders
+  //     like the value
+  static uint32_t timeBits(float tof) {
+    if ( tof == 0.f ) return 0x80000000u;   // -0 sorts as +0
+    uint32_t bits;
+    std::memcpy(&bits, &tof, sizeof(bits));
+    return (bits & 0x80000000u) ? ~bits : bits | 0x80000000u;
+  }
+
+  std::vector<MTDSimHitRef> refs_;
+  std::vector<MTDSimHitRef> buffer_;
+
+};
+
+
+#endif
@@ -0,0 +1,56 @@
+#ifndef MTDCore_interface_MTDSmallSet_h
+#define MTDCore_interface_MTDSmallSet_h
+
+#include <algorithm>
+#include <vector>
+
+
+// Set of distinct values with inline storage for the first N of them. Meant
+// for the few SIM tracks crossing a cell: inserts are linear searches and
+// the heap is only used beyond N values.
+
+template <typename T, unsigned int N>
+class MTDSmallSet {
+
+public:
+
+  // --- returns true if the value was not in the set yet
+  bool insert(const T& value) {
+
+    const T* begin = inline_;
+    const T* end = inline_ + std::min(size_, N);
+    if ( std::find(begin, end, value) != end ) return false;
+
+    if ( size_ < N ) {
+      inline_[size_++] = value;
+      return true;
+    }
+
+    if ( std::find(overflow_.begin(), overflow_.end(), value) != overflow_.end() ) return false;
+
+    overflow_.push_back(value);
+    ++size_;
+
+    return true;
+
+  }
+
+  void clear() {
+    size_ = 0;
+    overflow_.clear();
+  }
+
+  unsigned int size() const { return size_; }
+  bool empty() const { return size_ == 0; }
+
+
+private:
+
+  unsigned int size_ = 0;
+  T inline_[N];
+  std::vector<T> overflow_;
+
+};
+
+
+#endif
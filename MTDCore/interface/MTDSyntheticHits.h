@@ -0,0 +1,78 @@
+#ifndef MTDCore_interface_MTDSyntheticHits_h
+#define MTDCore_interface_MTDSyntheticHits_h
+
+#include <cstdint>
+#include <random>
+#include <vector>
+
+#include "MTDtools/MTDCore/interface/MTDBunchCrossing.h"
+#include "MTDtools/MTDCore/interface/MTDHistoFill.h"
+#include "MTDtools/MTDCore/interface/MTDHitInput.h"
+#include "MTDtools/MTDCore/interface/MTDJoinedHit.h"
+
+
+// Generator of synthetic BTL or ETL events, to exercise MTDHitJoiner and
+// mtdFillHistos() without input files (see the MTDBenchmark executable).
+//
+// The number of hit cells grows linearly with the pileup, with orders of
+// magnitude of the Phase-2 occupancies: about 9000 BTL crystals and 2 x 2500
+// ETL modules at pileup 200. Every hit cell has several SIM hits, a fraction
+// of them out of time, in random order; most of them have a DIGI, an
+// uncalibrated RECO and a RECO hit, in DetId order as in the EDM
+// collections, and a few of those are noise without SIM hit. There is no
+// physics in the values, only plausible ranges. With a bunch crossing
+// window wider than BX 0, 10% of the ETL DIGI hits also get a sample in
+// each out-of-time BX of the window.
+//
+// The DetIds are synthetic: route() gives their cell and output, with the
+// conventions of MTDHitJoiner, and positions() a simple cylindrical (BTL)
+// or disk (ETL) geometry of the cells.
+
+class MTDSyntheticHits {
+
+public:
+
+  enum Detector { kBTL, kETL };
+
+  MTDSyntheticHits(Detector detector, unsigned int pileup, uint64_t seed = 1);
+
+  // --- generates the next event, with the ETL DIGI samples of window
+  void generate(const MTDBXWindow& window = MTDBXWindow());
+
+  // --- hits of the last event
+  MTDTierInputs inputs() const { return { sim_, digi_, ureco_, reco_, digiBX_ }; }
+
+  // --- cell and output of a DetId of the generator, -1 if it is not one
+  int route(uint32_t rawId, uint32_t& cell) const;
+
+  // --- positions of joined records of the generator
+  void positions(const std::vector<MTDJoinedHit>& hits, std::vector<MTDHitPosition>& pos) const;
+
+  Detector detector() const { return detector_; }
+  unsigned int pileup() const { return pileup_; }
+
+  // --- number of cells, per side for ETL
+  uint32_t nCells() const;
+
+
+private:
+
+  uint32_t rawId(int side, uint32_t cell) const;
+
+  const Detector detector_;
+  const unsigned int pileup_;
+
+  std::mt19937_64 rng_;
+
+  std::vector<MTDSimHitInput> sim_;
+  std::vector<MTDDigiHitInput> digi_;
+  std::vector<MTDURecoHitInput> ureco_;
+  std::vector<MTDRecoHitInput> reco_;
+  std::vector<MTDDigiSampleInput> digiBX_;
+
+  std::vector<uint32_t> cells_;   // scratch of generate()
+
+};
+
+
+#endif
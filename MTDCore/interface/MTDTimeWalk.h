@@ -0,0 +1,60 @@
+#ifndef MTDCore_interface_MTDTimeWalk_h
+#define MTDCore_interface_MTDTimeWalk_h
+
+#include <cstddef>
+#include <vector>
+
+
+// BTL time-walk correction p0*q^p1 + p2 of the uncalibrated RECO times, as
+// a function of the amplitude q [pC].
+//
+// correct() processes whole arrays in one vectorized pass, computing q^p1 as
+// exp(p1*log(q)) with single precision polynomial approximations of log and
+// exp (Cephes logf/expf). The relative deviation of q^p1 from std::pow is
+// below 2e-6 for 1e-3 < q < 1e4 pC and |p1| < 2. Amplitudes which are not
+// positive, finite and normal get no correction.
+
+class MTDTimeWalk {
+
+public:
+
+  // --- Structure of arrays of the amplitudes and times of a set of channels
+  struct Channels {
+
+    std::vector<float> amplitude;
+    std::vector<float> time;
+
+    // --- output of correct()
+    std::vector<float> correction;
+    std::vector<float> timeUncorr;   // time + correction
+
+    void resize(size_t n) {
+      amplitude.resize(n);
+      time.resize(n);
+      correction.resize(n);
+      timeUncorr.resize(n);
+    }
+
+    size_t size() const { return amplitude.size(); }
+
+  };
+
+  // --- parameters (p0, p1, p2), throws std::invalid_argument otherwise
+  explicit MTDTimeWalk(const std::vector<double>& parameters);
+
+  // --- corrections and uncorrected times of all the channels
+  void correct(Channels& channels) const;
+
+  void correct(const float* amplitude, const float* time, float* correction, float* timeUncorr,
+	       size_t n) const;
+
+private:
+
+  float p0_;
+  float p1_;
+  float p2_;
+
+};
+
+
+#endif
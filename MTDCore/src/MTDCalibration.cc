@@ -0,0 +1,343 @@
+#include "MTDtools/MTDCore/interface/MTDCalibration.h"
+
+#include <algorithm>
+#include <cmath>
+#include <iomanip>
+#include <stdexcept>
+
+
+MTDCalibration::MTDCalibration(unsigned int nSides, const Binning& binning) :
+  nSides_(nSides), binning_(binning) {
+
+  if ( nSides_ == 0 || binning_.nBins == 0 || !(binning_.minAmplitude > 0.f) ||
+       !(binning_.maxAmplitude > binning_.minAmplitude) )
+    throw std::invalid_argument("MTDCalibration: amplitude range [" + std::to_string(binning_.minAmplitude) + ", " +
+				std::to_string(binning_.maxAmplitude) + "] pC with " +
+				std::to_string(binning_.nBins) + " bins is not valid");
+
+  logMin_ = std::log(binning_.minAmplitude);
+  invLogWidth_ = binning_.nBins/(std::log(binning_.maxAmplitude) - logMin_);
+
+}
+
+
+void MTDCalibration::grow(size_t nCells) {
+
+  rawId_.resize(nCells, 0);
+  nEnergy_.resize(nCells, 0);
+  sumSimEnergy_.resize(nCells, 0.f);
+  sumRecoEnergy_.resize(nCells, 0.f);
+
+  const size_t nBins = nCells*nSides_*binning_.nBins;
+  n_.resize(nBins, 0);
+  sumLogAmplitude_.resize(nBins, 0.f);
+  sumTime_.resize(nBins, 0.f);
+
+}
+
+
+void MTDCalibration::add(const MTDCalibration& other) {
+
+  if ( other.nSides_ != nSides_ || other.binning_.nBins != binning_.nBins ||
+       other.logMin_ != logMin_ || other.invLogWidth_ != invLogWidth_ )
+    throw std::invalid_argument("MTDCalibration: sums with different sides or binning cannot be added");
+
+  if ( other.nCells() > nCells() ) grow(other.nCells());
+
+  for (size_t ic = 0; ic < other.nCells(); ++ic) {
+    if ( other.rawId_[ic] != 0 ) rawId_[ic] = other.rawId_[ic];
+    nEnergy_[ic] += other.nEnergy_[ic];
+    sumSimEnergy_[ic] += other.sumSimEnergy_[ic];
+    sumRecoEnergy_[ic] += other.sumRecoEnergy_[ic];
+  }
+
+  for (size_t ib = 0; ib < other.n_.size(); ++ib) {
+    n_[ib] += other.n_[ib];
+    sumLogAmplitude_[ib] += other.sumLogAmplitude_[ib];
+    sumTime_[ib] += other.sumTime_[ib];
+  }
+
+}
+
+
+size_t MTDCalibration::bytes() const {
+
+  return rawId_.size()*(sizeof(uint32_t) + sizeof(uint32_t) + 2*sizeof(float)) +
+    n_.size()*(sizeof(uint32_t) + 2*sizeof(float));
+
+}
+
+
+namespace {
+
+  // Bin means of the time channels, in double precision: log q, dt and the
+  // entries as weight.
+  struct Points {
+
+    std::vector<double> logq;
+    std::vector<double> dt;
+    std::vector<double> w;
+    std::vector<uint32_t> first;   // first point of each channel, and the end
+
+  };
+
+  struct LineFit {
+    double p0, p2, chi2;
+    bool ok;
+  };
+
+  // --- weighted least squares of dt = p0*q^p1 + p2 for a fixed p1, over the
+  //     points [begin, end)
+  LineFit fitLine(const Points& points, uint32_t begin, uint32_t end, double p1) {
+
+    double s = 0., sx = 0., sy = 0., sxx = 0., sxy = 0., syy = 0.;
+
+    for (uint32_t ip = begin; ip < end; ++ip) {
+      const double x = std::exp(p1*points.logq[ip]);
+      const double y = points.dt[ip];
+      const double w = points.w[ip];
+      s += w; sx += w*x; sy += w*y;
+      sxx += w*x*x; sxy += w*x*y; syy += w*y*y;
+    }
+
+    const double det = s*sxx - sx*sx;
+    if ( end - begin < 2 || !(det > 1e-12*s*sxx) ) return { 0., 0., 0., false };
+
+    const double p0 = (s*sxy - sx*sy)/det;
+    const double p2 = (sy - p0*sx)/s;
+
+    return { p0, p2, std::max(0., syy - p0*sxy - p2*sy), true };
+
+  }
+
+}
+
+
+// The common exponent p1 minimizes the sum of the chi2 of the channels with
+// enough entries and at least three amplitude bins, or else of all the
+// channels merged: a scan of [-3, 0) in steps of 0.05, then a golden section
+// search around the best step.
+
+MTDCalibration::Constants MTDCalibration::fit(unsigned int minEntries) const {
+
+  const unsigned int nBins = binning_.nBins;
+  const size_t nChannels = nCells()*nSides_;
+
+  Constants constants;
+  constants.timeWalk.resize(nChannels);
+  constants.energyScale.resize(nCells());
+
+  // --- bin means of the channels with enough entries, and of all the
+  //     channels merged
+  Points points, merged;
+  points.first.push_back(0);
+
+  std::vector<uint32_t> entries(nChannels, 0);
+  std::vector<int32_t> channelPoints(nChannels, -1);   // index in points.first
+  std::vector<double> mergedN(nBins, 0.), mergedQ(nBins, 0.), mergedT(nBins, 0.);
+  uint32_t nFitted = 0;
+
+  for (size_t ich = 0; ich < nChannels; ++ich) {
+
+    const size_t ib0 = ich*nBins;
+    uint32_t nBinsFilled = 0;
+
+    for (unsigned int ib = 0; ib < nBins; ++ib) {
+      const uint32_t n = n_[ib0+ib];
+      entries[ich] += n;
+      mergedN[ib] += n;
+      mergedQ[ib] += sumLogAmplitude_[ib0+ib];
+      mergedT[ib] += sumTime_[ib0+ib];
+      if ( n > 0 ) nBinsFilled++;
+    }
+
+    if ( entries[ich] < std::max(minEntries, 1u) || nBinsFilled < 2 ) continue;
+
+    channelPoints[ich] = points.first.size()-1;
+    for (unsigned int ib = 0; ib < nBins; ++ib) {
+      const uint32_t n = n_[ib0+ib];
+      if ( n == 0 ) continue;
+      points.logq.push_back(sumLogAmplitude_[ib0+ib]/n);
+      points.dt.push_back(sumTime_[ib0+ib]/n);
+      points.w.push_back(n);
+    }
+    points.first.push_back(points.logq.size());
+    nFitted += nBinsFilled >= 3;
+
+  }
+
+  merged.first.push_back(0);
+  for (unsigned int ib = 0; ib < nBins; ++ib) {
+    if ( mergedN[ib] == 0. ) continue;
+    merged.logq.push_back(mergedQ[ib]/mergedN[ib]);
+    merged.dt.push_back(mergedT[ib]/mergedN[ib]);
+    merged.w.push_back(mergedN[ib]);
+  }
+  merged.first.push_back(merged.logq.size());
+
+  const Points& shape = nFitted > 0 ? points : merged;
+
+  auto chi2 = [&](double p1) {
+    double sum = 0.;
+    for (size_t ich = 0; ich+1 < shape.first.size(); ++ich) {
+      const LineFit line = fitLine(shape, shape.first[ich], shape.first[ich+1], p1);
+      if ( line.ok ) sum += line.chi2;
+    }
+    return sum;
+  };
+
+  double p1 = -1.;
+  if ( shape.logq.size() >= 3 ) {
+
+    double best = -0.05, bestChi2 = chi2(best);
+    for (double x = -3.; x < -0.05; x += 0.05) {
+      const double c = chi2(x);
+      if ( c < bestChi2 ) { best = x; bestChi2 = c; }
+    }
+
+    const double r = 0.5*(std::sqrt(5.)-1.);
+    double a = best - 0.05, b = std::min(best + 0.05, -0.01);
+    double c = b - r*(b-a), d = a + r*(b-a);
+    double fc = chi2(c), fd = chi2(d);
+    for (int it = 0; it < 30; ++it) {
+      if ( fc < fd ) { b = d; d = c; fd = fc; c = b - r*(b-a); fc = chi2(c); }
+      else           { a = c; c = d; fc = fd; d = a + r*(b-a); fd = chi2(d); }
+    }
+    p1 = 0.5*(a+b);
+
+  }
+
+  // --- time walk, all the channels merged then per channel
+
+  uint32_t mergedEntries = 0;
+  for (double n: mergedN) mergedEntries += n;
+
+  const LineFit global = fitLine(merged, 0, merged.logq.size(), p1);
+  constants.globalTimeWalk = global.ok ?
+    TimeWalk{ float(global.p0), float(p1), float(global.p2), mergedEntries, kFitted } :
+    TimeWalk{ 0.f, 0.f, 0.f, mergedEntries, kNoData };
+
+  for (size_t ich = 0; ich < nChannels; ++ich) {
+
+    TimeWalk& tw = constants.timeWalk[ich];
+    tw = constants.globalTimeWalk;
+    tw.entries = entries[ich];
+    if ( entries[ich] == 0 ) { tw.status = kNoData; continue; }
+    if ( global.ok ) tw.status = kGlobal;
+
+    const int32_t ip = channelPoints[ich];
+    if ( ip < 0 ) continue;
+
+    const LineFit line = fitLine(points, points.first[ip], points.first[ip+1], p1);
+    if ( line.ok ) tw = TimeWalk{ float(line.p0), float(p1), float(line.p2), entries[ich], kFitted };
+
+  }
+
+  // --- energy scale
+
+  double simSum = 0., recoSum = 0.;
+  uint32_t energyEntries = 0;
+  for (size_t ic = 0; ic < nCells(); ++ic) {
+    simSum += sumSimEnergy_[ic];
+    recoSum += sumRecoEnergy_[ic];
+    energyEntries += nEnergy_[ic];
+  }
+
+  constants.globalEnergyScale = recoSum > 0. ?
+    EnergyScale{ float(simSum/recoSum), energyEntries, kFitted } : EnergyScale{ 1.f, energyEntries, kNoData };
+
+  for (size_t ic = 0; ic < nCells(); ++ic) {
+    EnergyScale& es = constants.energyScale[ic];
+    es = constants.globalEnergyScale;
+    es.entries = nEnergy_[ic];
+    if ( nEnergy_[ic] == 0 ) es.status = kNoData;
+    else if ( nEnergy_[ic] >= minEntries && sumRecoEnergy_[ic] > 0.f )
+      es = EnergyScale{ sumSimEnergy_[ic]/sumRecoEnergy_[ic], nEnergy_[ic], kFitted };
+    else if ( es.status == kFitted ) es.status = kGlobal;
+  }
+
+  return constants;
+
+}
+
+
+void MTDCalibration::write(std::ostream& os, const std::string& detector, const Constants& constants) const {
+
+  auto line = [&](const std::string& id, int side, const TimeWalk& tw, const EnergyScale& es) {
+    os << detector << " " << std::setw(10) << id << " " << std::setw(2) << side << " "
+       << std::setw(8) << tw.entries << " " << std::setw(12) << tw.p0 << " " << std::setw(12) << tw.p1 << " "
+       << std::setw(12) << tw.p2 << " " << tw.status << " "
+       << std::setw(8) << es.entries << " " << std::setw(12) << es.scale << " " << es.status << "\n";
+  };
+
+  os << std::setprecision(6);
+  line("all", -1, constants.globalTimeWalk, constants.globalEnergyScale);
+
+  for (size_t ic = 0; ic < nCells(); ++ic) {
+    const EnergyScale& es = constants.energyScale[ic];
+    for (unsigned int is = 0; is < nSides_; ++is) {
+      const TimeWalk& tw = constants.timeWalk[ic*nSides_+is];
+      if ( tw.entries == 0 && es.entries == 0 ) continue;
+      line(std::to_string(rawId_[ic]), is, tw, es);
+    }
+  }
+
+}
+
+
+void mtdFillCalibration(MTDCalibration& btl, MTDCalibration& etl, const MTDEventView& event, float btlMinEnergy,
+			const MTDTimeWalk& btlTimeWalkModel, MTDCalibration::Scratch& scratch) {
+
+  // --- BTL: the uncorrected times of the selected channels, in one pass
+
+  const MTDJoinedHit* btl_hits = event.btl.hits;
+
+  scratch.hits.clear();
+  for (size_t ih=0; ih<event.btl.size; ++ih) {
+
+    const MTDinfo& info = btl_hits[ih].info;
+    if ( info.sim_time == 0. || info.reco_energy < btlMinEnergy ) continue;
+
+    if ( info.reco_energy > 0. )
+      btl.addEnergy(btl_hits[ih].cell, btl_hits[ih].rawId, info.sim_energy, info.reco_energy);
+
+    for (int iside=0; iside<2; ++iside)
+      if ( info.ureco_charge[iside] > 0. ) scratch.hits.push_back(2*ih+iside);
+
+  }
+
+  MTDTimeWalk::Channels& channels = scratch.channels;
+  channels.resize(scratch.hits.size());
+
+  for (size_t ic=0; ic<scratch.hits.size(); ++ic) {
+    const MTDinfo& info = btl_hits[scratch.hits[ic]/2].info;
+    channels.amplitude[ic] = info.ureco_charge[scratch.hits[ic]%2];
+    channels.time[ic]      = info.ureco_time[scratch.hits[ic]%2];
+  }
+
+  btlTimeWalkModel.correct(channels);
+
+  for (size_t ic=0; ic<scratch.hits.size(); ++ic) {
+    const MTDJoinedHit& hit = btl_hits[scratch.hits[ic]/2];
+    btl.addTime(hit.cell, hit.rawId, scratch.hits[ic]%2, channels.amplitude[ic],
+		channels.timeUncorr[ic] - hit.info.sim_time);
+  }
+
+  // --- ETL, one channel per cell
+
+  for (int idet=0; idet<2; ++idet){
+    for (size_t ih=0; ih<event.etl[idet].size; ++ih) {
+
+      const MTDJoinedHit& hit = event.etl[idet].hits[ih];
+      if ( hit.info.sim_time == 0. ) continue;
+
+      if ( hit.info.reco_energy > 0. )
+	etl.addEnergy(hit.cell, hit.rawId, hit.info.sim_energy, hit.info.reco_energy);
+
+      if ( hit.info.ureco_charge[0] > 0. )
+	etl.addTime(hit.cell, hit.rawId, 0, hit.info.ureco_charge[0], hit.info.ureco_time[0] - hit.info.sim_time);
+
+    }
+  }
+
+}
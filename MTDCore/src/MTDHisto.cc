@@ -0,0 +1,281 @@
+#include "MTDtools/MTDCore/interface/MTDHisto.h"
+
+
+// ==============================================================================
+//  MTDAxis
+// ==============================================================================
+
+// The loop is branch-free, so that it is vectorized: out-of-range values are
+// replaced before the conversion to int, and all the comparisons are always
+// evaluated. GCC does not if-convert floating point comparisons when they
+// may trap, which only matters for NaN here and does not change the result.
+
+#if defined(__GNUC__) && !defined(__clang__)
+__attribute__((optimize("no-trapping-math")))
+#endif
+void MTDAxis::find(const double* __restrict__ x, int* __restrict__ bin, size_t n) const {
+
+  const double nb = n_;
+  const double lo = lo_;
+  const double hi = hi_;
+
+  for (size_t i = 0; i < n; ++i) {
+
+    const bool under = x[i] < lo;
+    const bool over  = !(x[i] < hi);
+
+    // in range: 1 + int(n*(x-lo)/(hi-lo)) as in find(x)
+    double t = nb*(x[i]-lo)/(hi-lo);
+    t = under ? -1. : t;
+    t = over  ? nb  : t;
+
+    bin[i] = 1 + int(t);
+
+  }
+
+}
+
+
+// ==============================================================================
+//  MTDHisto1D
+// ==============================================================================
+
+MTDHisto1D::MTDHisto1D(const std::string& dir, const char* name, const char* title, int nx, double xlo, double xhi,
+		       bool sumw2) :
+  MTDHisto(dir, name, title),
+  x_(nx, xlo, xhi),
+  counts_(nx+2, 0.f),
+  stats_() {
+
+  if ( sumw2 ) sumw2_.assign(counts_.size(), 0.);
+
+}
+
+
+void MTDHisto1D::flush() {
+
+  const size_t n = xbuf_.size();
+  if ( n == 0 ) return;
+
+  bins_.resize(n);
+  x_.find(xbuf_.data(), bins_.data(), n);
+
+  for (size_t i = 0; i < n; ++i)
+    counts_[bins_[i]] += 1.f;
+
+  if ( !sumw2_.empty() )
+    for (size_t i = 0; i < n; ++i)
+      sumw2_[bins_[i]] += 1.;
+
+  // statistics in fill order; the out-of-range values add -0., which leaves
+  // any sum unchanged
+  size_t nIn = 0;
+  for (size_t i = 0; i < n; ++i) {
+    const bool in = x_.inRange(bins_[i]);
+    const double x = xbuf_[i];
+    nIn += in;
+    stats_[2] += in ? x   : -0.;
+    stats_[3] += in ? x*x : -0.;
+  }
+
+  stats_[0] += nIn;
+  stats_[1] += nIn;
+  entries_ += n;
+
+  xbuf_.clear();
+
+}
+
+
+void MTDHisto1D::add(const MTDHisto& other) {
+
+  const MTDHisto1D& h = static_cast<const MTDHisto1D&>(other);
+
+  for (size_t ib = 0; ib < counts_.size(); ++ib)
+    counts_[ib] += h.counts_[ib];
+
+  for (size_t ib = 0; ib < sumw2_.size(); ++ib)
+    sumw2_[ib] += h.sumw2_[ib];
+
+  for (int is = 0; is < 4; ++is)
+    stats_[is] += h.stats_[is];
+
+  entries_ += h.entries_;
+
+}
+
+
+
+
+// ==============================================================================
+//  MTDHisto2D
+// ==============================================================================
+
+MTDHisto2D::MTDHisto2D(const std::string& dir, const char* name, const char* title,
+		       int nx, double xlo, double xhi, int ny, double ylo, double yhi, bool sumw2) :
+  MTDHisto(dir, name, title),
+  x_(nx, xlo, xhi),
+  y_(ny, ylo, yhi),
+  counts_((nx+2)*(ny+2), 0.f),
+  stats_() {
+
+  if ( sumw2 ) sumw2_.assign(counts_.size(), 0.);
+
+}
+
+
+void MTDHisto2D::flush() {
+
+  const size_t n = xbuf_.size();
+  if ( n == 0 ) return;
+
+  bins_.resize(n);
+  ybins_.resize(n);
+  x_.find(xbuf_.data(), bins_.data(), n);
+  y_.find(ybuf_.data(), ybins_.data(), n);
+
+  const int nx = x_.n()+2;
+
+  for (size_t i = 0; i < n; ++i)
+    counts_[ybins_[i]*nx + bins_[i]] += 1.f;
+
+  if ( !sumw2_.empty() )
+    for (size_t i = 0; i < n; ++i)
+      sumw2_[ybins_[i]*nx + bins_[i]] += 1.;
+
+  size_t nIn = 0;
+  for (size_t i = 0; i < n; ++i) {
+    const bool in = x_.inRange(bins_[i]) & y_.inRange(ybins_[i]);
+    const double x = xbuf_[i];
+    const double y = ybuf_[i];
+    nIn += in;
+    stats_[2] += in ? x   : -0.;
+    stats_[3] += in ? x*x : -0.;
+    stats_[4] += in ? y   : -0.;
+    stats_[5] += in ? y*y : -0.;
+    stats_[6] += in ? x*y : -0.;
+  }
+
+  stats_[0] += nIn;
+  stats_[1] += nIn;
+  entries_ += n;
+
+  xbuf_.clear();
+  ybuf_.clear();
+
+}
+
+
+void MTDHisto2D::add(const MTDHisto& other) {
+
+  const MTDHisto2D& h = static_cast<const MTDHisto2D&>(other);
+
+  for (size_t ib = 0; ib < counts_.size(); ++ib)
+    counts_[ib] += h.counts_[ib];
+
+  for (size_t ib = 0; ib < sumw2_.size(); ++ib)
+    sumw2_[ib] += h.sumw2_[ib];
+
+  for (int is = 0; is < 7; ++is)
+    stats_[is] += h.stats_[is];
+
+  entries_ += h.entries_;
+
+}
+
+
+
+
+// ==============================================================================
+//  MTDProfile
+// ==============================================================================
+
+MTDProfile::MTDProfile(const std::string& dir, const char* name, const char* title, int nx, double xlo, double xhi) :
+  MTDHisto(dir, name, title),
+  x_(nx, xlo, xhi),
+  sumy_(nx+2, 0.),
+  sumy2_(nx+2, 0.),
+  binEntries_(nx+2, 0.),
+  stats_() {
+}
+
+
+void MTDProfile::flush() {
+
+  const size_t n = xbuf_.size();
+  if ( n == 0 ) return;
+
+  bins_.resize(n);
+  x_.find(xbuf_.data(), bins_.data(), n);
+
+  size_t nIn = 0;
+  for (size_t i = 0; i < n; ++i) {
+    const int bin = bins_[i];
+    const bool in = x_.inRange(bin);
+    const double x = xbuf_[i];
+    const double y = ybuf_[i];
+    sumy_[bin]       += y;
+    sumy2_[bin]      += y*y;
+    binEntries_[bin] += 1.;
+    nIn += in;
+    stats_[2] += in ? x   : -0.;
+    stats_[3] += in ? x*x : -0.;
+    stats_[4] += in ? y   : -0.;
+    stats_[5] += in ? y*y : -0.;
+  }
+
+  stats_[0] += nIn;
+  stats_[1] += nIn;
+  entries_ += n;
+
+  xbuf_.clear();
+  ybuf_.clear();
+
+}
+
+
+void MTDProfile::add(const MTDHisto& other) {
+
+  const MTDProfile& p = static_cast<const MTDProfile&>(other);
+
+  for (size_t ib = 0; ib < sumy_.size(); ++ib) {
+    sumy_[ib]       += p.sumy_[ib];
+    sumy2_[ib]      += p.sumy2_[ib];
+    binEntries_[ib] += p.binEntries_[ib];
+  }
+
+  for (int is = 0; is < 6; ++is)
+    stats_[is] += p.stats_[is];
+
+  entries_ += p.entries_;
+
+}
+
+
+// ==============================================================================
+//  MTDChannelMap
+// ==============================================================================
+
+MTDChannelMap::MTDChannelMap(const std::string& dir, const char* name, const char* title,
+			     int xFirst, int nx, int yFirst, int ny) :
+  MTDHisto(dir, name, title),
+  xFirst_(xFirst),
+  yFirst_(yFirst),
+  nx_(nx),
+  ny_(ny),
+  counts_(size_t(nx+2)*(ny+2), 0),
+  outside_(0) {
+}
+
+
+void MTDChannelMap::add(const MTDHisto& other) {
+
+  const MTDChannelMap& m = static_cast<const MTDChannelMap&>(other);
+
+  for (size_t ic = 0; ic < counts_.size(); ++ic)
+    counts_[ic] += m.counts_[ic];
+
+  outside_ += m.outside_;
+  entries_ += m.entries_;
+
+}
@@ -0,0 +1,1066 @@
+#include "MTDtools/MTDCore/interface/MTDHistoFill.h"
+
+#include <algorithm>
+#include <cmath>
+#include <iterator>
+
+
+///////////////////////////////////////////////////////////////////////////////////////////////
+//
+//  Histograms definition
+//
+///////////////////////////////////////////////////////////////////////////////////////////////
+
+// The groups listed in the MTDAnalyzer HistogramGroups parameter are booked,
+// as MTDHisto objects: each stream fills its own set, which is added to the
+// job-level set at the end of the stream; the job-level set is converted
+// once to ROOT histograms in the BTL/ETL directories at the end of the job.
+const MTDHistoDef mtdHistoDefs[] = {
+
+  // --- BTLSim
+
+  { "BTLSim", "BTL", kBTLSimCell, 0, MTDHistoDef::k1D, "h_n_sim_trk",
+    "Number of tracks per BTL cell;N_{trk}",
+    kSimNTrk, 10, 0., 10. },
+  { "BTLSim", "BTL", kBTLEvent, 0, MTDHistoDef::k1D, "h_n_sim_cell",
+    "Number of BTL cells with SIM hits;N_{BTL cells}",
+    kNSimCell, 250, 0., 5000. },
+  { "BTLSim", "BTL", kBTLSimHit, 0, MTDHistoDef::k1D, "h_t_sim",
+    "BTL SIM hits ToA;ToA_{SIM} [ns]",
+    kSimTime, 250, 0., 25. },
+  { "BTLSim", "BTL", kBTLSimHit, 0, MTDHistoDef::k1D, "h_e_sim",
+    "BTL SIM hits energy;E_{SIM} [MeV]",
+    kSimEnergy, 200, 0., 20. },
+  { "BTLSim", "BTL", kBTLSimHit, 0, MTDHistoDef::k1D, "h_xloc_sim",
+    "BTL SIM local x;x_{SIM} [mm]",
+    kSimXLocal, 290, -1.45, 1.45 },
+  { "BTLSim", "BTL", kBTLSimHit, 0, MTDHistoDef::k1D, "h_yloc_sim",
+    "BTL SIM local y;y_{SIM} [mm]",
+    kSimYLocal, 600, -30., 30. },
+  { "BTLSim", "BTL", kBTLSimHit, 0, MTDHistoDef::k1D, "h_zloc_sim",
+    "BTL SIM local z;z_{SIM} [mm]",
+    kSimZLocal, 400, -2., 2. },
+  { "BTLSim", "BTL", kBTLSimHit, 0, MTDHistoDef::kChannelMap, "h_occupancy_sim",
+    "BTL SIM hits occupancy;cell #phi;cell #eta",
+    kCellIPhi, 2305, 0., 2305.,  kCellIEta, 87, -43., 44. },
+  { "BTLSim", "BTL", kBTLSimHit, 0, MTDHistoDef::k1D, "h_phi_sim",
+    "BTL SIM hits #phi;#phi_{SIM} [rad]",
+    kSimPhi, 315, -3.15, 3.15 },
+  { "BTLSim", "BTL", kBTLSimHit, 0, MTDHistoDef::k1D, "h_z_sim",
+    "BTL SIM hits z;z_{SIM} [cm]",
+    kSimZ, 520, -260., 260. },
+  { "BTLSim", "BTL", kBTLSimHit, 0, MTDHistoDef::k1D, "h_eta_sim",
+    "BTL SIM hits #eta;#eta_{SIM}",
+    kSimEta, 200, -1.6, 1.6 },
+  { "BTLSim", "BTL", kBTLSimHit, 0, MTDHistoDef::k2D, "h_t_e_sim",
+    "BTL SIM time vs energy;E_{SIM} [MeV];T_{SIM} [ns]",
+    kSimEnergy, 100, 0., 20.,  kSimTime, 100, 0., 25. },
+  { "BTLSim", "BTL", kBTLSimHit, 0, MTDHistoDef::k2D, "h_e_eta_sim",
+    "BTL SIM energy vs |#eta|;|#eta_{SIM}|;E_{SIM} [MeV]",
+    kSimAbsEta, 100, 0., 1.6,  kSimEnergy, 100, 0., 20. },
+  { "BTLSim", "BTL", kBTLSimHit, 0, MTDHistoDef::k2D, "h_t_eta_sim",
+    "BTL SIM time vs |#eta|;|#eta_{SIM}|;T_{SIM} [ns]",
+    kSimAbsEta, 100, 0., 1.6,  kSimTime, 100, 0., 25. },
+  { "BTLSim", "BTL", kBTLSimHit, 0, MTDHistoDef::k2D, "h_e_phi_sim",
+    "BTL SIM energy vs #phi;#phi_{SIM} [rad];E_{SIM} [MeV]",
+    kSimPhi, 100, -3.15, 3.15,  kSimEnergy, 100, 0., 20. },
+  { "BTLSim", "BTL", kBTLSimHit, 0, MTDHistoDef::k2D, "h_t_phi_sim",
+    "BTL SIM time vs #phi;#phi_{SIM} [rad];T_{SIM} [ns]",
+    kSimPhi, 100, -3.15, 3.15,  kSimTime, 100, 0., 25. },
+  { "BTLSim", "BTL", kBTLSimHit, 0, MTDHistoDef::kProfile, "p_t_e_sim",
+    "BTL SIM time vs energy;E_{SIM} [MeV];T_{SIM} [ns]",
+    kSimEnergy, 100, 0., 20.,  kSimTime },
+  { "BTLSim", "BTL", kBTLSimHit, 0, MTDHistoDef::kProfile, "p_e_eta_sim",
+    "BTL SIM energy vs |#eta|;|#eta_{SIM}|;E_{SIM} [MeV]",
+    kSimAbsEta, 100, 0., 1.6,  kSimEnergy },
+  { "BTLSim", "BTL", kBTLSimHit, 0, MTDHistoDef::kProfile, "p_t_eta_sim",
+    "BTL SIM time vs |#eta|;|#eta_{SIM}|;T_{SIM} [ns]",
+    kSimAbsEta, 100, 0., 1.6,  kSimTime },
+  { "BTLSim", "BTL", kBTLSimHit, 0, MTDHistoDef::kProfile, "p_e_phi_sim",
+    "BTL SIM energy vs #phi;#phi_{SIM} [rad];E_{SIM} [MeV]",
+    kSimPhi, 100, -3.15, 3.15,  kSimEnergy },
+  { "BTLSim", "BTL", kBTLSimHit, 0, MTDHistoDef::kProfile, "p_t_phi_sim",
+    "BTL SIM time vs #phi;#phi_{SIM} [rad];T_{SIM} [ns]",
+    kSimPhi, 100, -3.15, 3.15,  kSimTime },
+
+  // --- BTLDigi
+
+  { "BTLDigi", "BTL", kBTLEventSide, 0, MTDHistoDef::k1D, "h_n_digi_0",
+    "Number of BTL DIGI hits (L);N_{DIGI hits}",
+    kNDigi, 100, 0., 100. },
+  { "BTLDigi", "BTL", kBTLEventSide, 1, MTDHistoDef::k1D, "h_n_digi_1",
+    "Number of BTL DIGI hits (R);N_{DIGI hits}",
+    kNDigi, 100, 0., 100. },
+  { "BTLDigi", "BTL", kBTLDigiHit, 0, MTDHistoDef::k1D, "h_t1_digi_0",
+    "BTL DIGI hits ToA1 (L);ToA [TDC counts]",
+    kDigiTime1, 1024, 0., 1024. },
+  { "BTLDigi", "BTL", kBTLDigiHit, 1, MTDHistoDef::k1D, "h_t1_digi_1",
+    "BTL DIGI hits ToA1 (R);ToA [TDC counts]",
+    kDigiTime1, 1024, 0., 1024. },
+  { "BTLDigi", "BTL", kBTLDigiHit, 0, MTDHistoDef::k1D, "h_t2_digi_0",
+    "BTL DIGI hits ToA2 (L);ToA [TDC counts]",
+    kDigiTime2, 1024, 0., 1024. },
+  { "BTLDigi", "BTL", kBTLDigiHit, 1, MTDHistoDef::k1D, "h_t2_digi_1",
+    "BTL DIGI hits ToA2 (R);ToA [TDC counts]",
+    kDigiTime2, 1024, 0., 1024. },
+  { "BTLDigi", "BTL", kBTLDigiHit, 0, MTDHistoDef::k1D, "h_e_digi_0",
+    "BTL DIGI hits energy (L);amplitude [ADC counts]",
+    kDigiCharge, 1024, 0., 1024. },
+  { "BTLDigi", "BTL", kBTLDigiHit, 1, MTDHistoDef::k1D, "h_e_digi_1",
+    "BTL DIGI hits energy (R);amplitude [ADC counts]",
+    kDigiCharge, 1024, 0., 1024. },
+  { "BTLDigi", "BTL", kBTLDigiHit, 0, MTDHistoDef::k2D, "h_occupancy_digi_0",
+    "BTL DIGI hits occupancy (L);z [cm]; #phi [rad]",
+    kCellZ, 65, -260., 260.,  kCellPhi, 315, -3.15, 3.15 },
+  { "BTLDigi", "BTL", kBTLDigiHit, 1, MTDHistoDef::k2D, "h_occupancy_digi_1",
+    "BTL DIGI hits occupancy (R);z [cm]; #phi [rad]",
+    kCellZ, 65, -260., 260.,  kCellPhi, 315, -3.15, 3.15 },
+  { "BTLDigi", "BTL", kBTLDigiHit, 0, MTDHistoDef::k1D, "h_phi_digi_0",
+    "BTL DIGI hits #phi (L);#phi [rad]",
+    kCellPhi, 2520, -3.15, 3.15 },
+  { "BTLDigi", "BTL", kBTLDigiHit, 1, MTDHistoDef::k1D, "h_phi_digi_1",
+    "BTL DIGI hits #phi (R);#phi [rad]",
+    kCellPhi, 2520, -3.15, 3.15 },
+  { "BTLDigi", "BTL", kBTLDigiHit, 0, MTDHistoDef::k1D, "h_eta_digi_0",
+    "BTL DIGI hits #eta (L);#eta",
+    kCellEta, 200, -1.6, 1.6 },
+  { "BTLDigi", "BTL", kBTLDigiHit, 1, MTDHistoDef::k1D, "h_eta_digi_1",
+    "BTL DIGI hits #eta (R);#eta",
+    kCellEta, 200, -1.6, 1.6 },
+  { "BTLDigi", "BTL", kBTLDigiHit, 0, MTDHistoDef::k1D, "h_z_digi_0",
+    "BTL DIGI hits z (L);z [cm]",
+    kCellZ, 260, -260., 260. },
+  { "BTLDigi", "BTL", kBTLDigiHit, 1, MTDHistoDef::k1D, "h_z_digi_1",
+    "BTL DIGI hits z (R);z [cm]",
+    kCellZ, 260, -260., 260. },
+  { "BTLDigi", "BTL", kBTLDigiHit, 0, MTDHistoDef::k2D, "h_t1_e_digi_0",
+    "BTL DIGI time1 vs charge (L);ADC counts;TDC counts",
+    kDigiCharge, 128, 0., 1024.,  kDigiTime1, 128, 0., 1024. },
+  { "BTLDigi", "BTL", kBTLDigiHit, 1, MTDHistoDef::k2D, "h_t1_e_digi_1",
+    "BTL DIGI time1 vs charge (R);ADC counts;TDC counts",
+    kDigiCharge, 128, 0., 1024.,  kDigiTime1, 128, 0., 1024. },
+  { "BTLDigi", "BTL", kBTLDigiHit, 0, MTDHistoDef::k2D, "h_t2_e_digi_0",
+    "BTL DIGI time2 vs charge (L);ADC counts;TDC counts",
+    kDigiCharge, 128, 0., 1024.,  kDigiTime2, 128, 0., 1024. },
+  { "BTLDigi", "BTL", kBTLDigiHit, 1, MTDHistoDef::k2D, "h_t2_e_digi_1",
+    "BTL DIGI time2 vs charge (R);ADC counts;TDC counts",
+    kDigiCharge, 128, 0., 1024.,  kDigiTime2, 128, 0., 1024. },
+  { "BTLDigi", "BTL", kBTLDigiHit, 0, MTDHistoDef::k2D, "h_e_eta_digi_0",
+    "BTL DIGI charge vs |#eta| (L);cell |#eta|;ADC counts",
+    kCellAbsIEta, 43, 0., 43.,  kDigiCharge, 128, 0., 1024. },
+  { "BTLDigi", "BTL", kBTLDigiHit, 1, MTDHistoDef::k2D, "h_e_eta_digi_1",
+    "BTL DIGI charge vs |#eta| (R);cell |#eta|;ADC counts",
+    kCellAbsIEta, 43, 0., 43.,  kDigiCharge, 128, 0., 1024. },
+  { "BTLDigi", "BTL", kBTLDigiHit, 0, MTDHistoDef::k2D, "h_t1_eta_digi_0",
+    "BTL DIGI time1 vs |#eta| (L);cell |#eta|;TDC counts",
+    kCellAbsIEta, 43, 0., 43.,  kDigiTime1, 128, 0., 1024. },
+  { "BTLDigi", "BTL", kBTLDigiHit, 1, MTDHistoDef::k2D, "h_t1_eta_digi_1",
+    "BTL DIGI time1 vs |#eta| (R);cell |#eta|;TDC counts",
+    kCellAbsIEta, 43, 0., 43.,  kDigiTime1, 128, 0., 1024. },
+  { "BTLDigi", "BTL", kBTLDigiHit, 0, MTDHistoDef::k2D, "h_t2_eta_digi_0",
+    "BTL DIGI time2 vs |#eta| (L);cell |#eta|;TDC counts",
+    kCellAbsIEta, 43, 0., 43.,  kDigiTime2, 128, 0., 1024. },
+  { "BTLDigi", "BTL", kBTLDigiHit, 1, MTDHistoDef::k2D, "h_t2_eta_digi_1",
+    "BTL DIGI time2 vs |#eta| (R);cell |#eta|;TDC counts",
+    kCellAbsIEta, 43, 0., 43.,  kDigiTime2, 128, 0., 1024. },
+  { "BTLDigi", "BTL", kBTLDigiHit, 0, MTDHistoDef::k2D, "h_e_phi_digi_0",
+    "BTL DIGI charge vs #phi (L);cell #phi;ADC counts",
+    kCellIPhi, 145, 0., 2305.,  kDigiCharge, 128, 0., 1024. },
+  { "BTLDigi", "BTL", kBTLDigiHit, 1, MTDHistoDef::k2D, "h_e_phi_digi_1",
+    "BTL DIGI charge vs #phi (R);cell #phi;ADC counts",
+    kCellIPhi, 145, 0., 2305.,  kDigiCharge, 128, 0., 1024. },
+  { "BTLDigi", "BTL", kBTLDigiHit, 0, MTDHistoDef::k2D, "h_t1_phi_digi_0",
+    "BTL DIGI time1 vs #phi (L);cell #phi;TDC counts",
+    kCellIPhi, 145, 0., 2305.,  kDigiTime1, 128, 0., 1024. },
+  { "BTLDigi", "BTL", kBTLDigiHit, 1, MTDHistoDef::k2D, "h_t1_phi_digi_1",
+    "BTL DIGI time1 vs #phi (R);cell #phi;TDC counts",
+    kCellIPhi, 145, 0., 2305.,  kDigiTime1, 128, 0., 1024. },
+  { "BTLDigi", "BTL", kBTLDigiHit, 0, MTDHistoDef::k2D, "h_t2_phi_digi_0",
+    "BTL DIGI time2 vs #phi (L);cell #phi;TDC counts",
+    kCellIPhi, 145, 0., 2305.,  kDigiTime2, 128, 0., 1024. },
+  { "BTLDigi", "BTL", kBTLDigiHit, 1, MTDHistoDef::k2D, "h_t2_phi_digi_1",
+    "BTL DIGI time2 vs #phi (R);cell #phi;TDC counts",
+    kCellIPhi, 145, 0., 2305.,  kDigiTime2, 128, 0., 1024. },
+  { "BTLDigi", "BTL", kBTLDigiHit, 0, MTDHistoDef::kProfile, "p_t1_e_digi_0",
+    "BTL DIGI time1 vs charge (L);ADC counts;TDC counts",
+    kDigiCharge, 128, 0., 1024.,  kDigiTime1 },
+  { "BTLDigi", "BTL", kBTLDigiHit, 1, MTDHistoDef::kProfile, "p_t1_e_digi_1",
+    "BTL DIGI time1 vs charge (R);ADC counts;TDC counts",
+    kDigiCharge, 128, 0., 1024.,  kDigiTime1 },
+  { "BTLDigi", "BTL", kBTLDigiHit, 0, MTDHistoDef::kProfile, "p_t2_e_digi_0",
+    "BTL DIGI time2 vs charge (L);ADC counts;TDC counts",
+    kDigiCharge, 128, 0., 1024.,  kDigiTime2 },
+  { "BTLDigi", "BTL", kBTLDigiHit, 1, MTDHistoDef::kProfile, "p_t2_e_digi_1",
+    "BTL DIGI time2 vs charge (R);ADC counts;TDC counts",
+    kDigiCharge, 128, 0., 1024.,  kDigiTime2 },
+  { "BTLDigi", "BTL", kBTLDigiHit, 0, MTDHistoDef::kProfile, "p_e_eta_digi_0",
+    "BTL DIGI charge vs |#eta| (L);cell |#eta|;ADC counts",
+    kCellAbsIEta, 43, 0., 43.,  kDigiCharge },
+  { "BTLDigi", "BTL", kBTLDigiHit, 1, MTDHistoDef::kProfile, "p_e_eta_digi_1",
+    "BTL DIGI charge vs |#eta| (R);cell |#eta|;ADC counts",
+    kCellAbsIEta, 43, 0., 43.,  kDigiCharge },
+  { "BTLDigi", "BTL", kBTLDigiHit, 0, MTDHistoDef::kProfile, "p_t1_eta_digi_0",
+    "BTL DIGI time1 vs |#eta| (L);cell |#eta|;TDC counts",
+    kCellAbsIEta, 43, 0., 43.,  kDigiTime1 },
+  { "BTLDigi", "BTL", kBTLDigiHit, 1, MTDHistoDef::kProfile, "p_t1_eta_digi_1",
+    "BTL DIGI time1 vs |#eta| (R);cell |#eta|;TDC counts",
+    kCellAbsIEta, 43, 0., 43.,  kDigiTime1 },
+  { "BTLDigi", "BTL", kBTLDigiHit, 0, MTDHistoDef::kProfile, "p_t2_eta_digi_0",
+    "BTL DIGI time2 vs |#eta| (L);cell |#eta|;TDC counts",
+    kCellAbsIEta, 43, 0., 43.,  kDigiTime2 },
+  { "BTLDigi", "BTL", kBTLDigiHit, 1, MTDHistoDef::kProfile, "p_t2_eta_digi_1",
+    "BTL DIGI time2 vs |#eta| (R);cell |#eta|;TDC counts",
+    kCellAbsIEta, 43, 0., 43.,  kDigiTime2 },
+  { "BTLDigi", "BTL", kBTLDigiHit, 0, MTDHistoDef::kProfile, "p_e_phi_digi_0",
+    "BTL DIGI charge vs #phi (L);cell #phi;ADC counts",
+    kCellIPhi, 145, 0., 2305.,  kDigiCharge },
+  { "BTLDigi", "BTL", kBTLDigiHit, 1, MTDHistoDef::kProfile, "p_e_phi_digi_1",
+    "BTL DIGI charge vs #phi (R);cell #phi;ADC counts",
+    kCellIPhi, 145, 0., 2305.,  kDigiCharge },
+  { "BTLDigi", "BTL", kBTLDigiHit, 0, MTDHistoDef::kProfile, "p_t1_phi_digi_0",
+    "BTL DIGI time1 vs #phi (L);cell #phi;TDC counts",
+    kCellIPhi, 145, 0., 2305.,  kDigiTime1 },
+  { "BTLDigi", "BTL", kBTLDigiHit, 1, MTDHistoDef::kProfile, "p_t1_phi_digi_1",
+    "BTL DIGI time1 vs #phi (R);cell #phi;TDC counts",
+    kCellIPhi, 145, 0., 2305.,  kDigiTime1 },
+  { "BTLDigi", "BTL", kBTLDigiHit, 0, MTDHistoDef::kProfile, "p_t2_phi_digi_0",
+    "BTL DIGI time2 vs #phi (L);cell #phi;TDC counts",
+    kCellIPhi, 145, 0., 2305.,  kDigiTime2 },
+  { "BTLDigi", "BTL", kBTLDigiHit, 1, MTDHistoDef::kProfile, "p_t2_phi_digi_1",
+    "BTL DIGI time2 vs #phi (R);cell #phi;TDC counts",
+    kCellIPhi, 145, 0., 2305.,  kDigiTime2 },
+
+  // --- BTLUReco
+
+  { "BTLUReco", "BTL", kBTLEventSide, 0, MTDHistoDef::k1D, "h_n_ureco_0",
+    "Number of BTL URECO hits (L);N_{URECO hits}",
+    kNUReco, 100, 0., 100. },
+  { "BTLUReco", "BTL", kBTLEventSide, 1, MTDHistoDef::k1D, "h_n_ureco_1",
+    "Number of BTL URECO hits (R);N_{URECO hits}",
+    kNUReco, 100, 0., 100. },
+  { "BTLUReco", "BTL", kBTLURecoHit, 0, MTDHistoDef::kChannelMap, "h_occupancy_ureco_0",
+    "BTL URECO hits occupancy (L);cell #phi;cell #eta",
+    kCellIPhi, 2305, 0., 2305.,  kCellIEta, 87, -43., 44. },
+  { "BTLUReco", "BTL", kBTLURecoHit, 1, MTDHistoDef::kChannelMap, "h_occupancy_ureco_1",
+    "BTL URECO hits occupancy (R);cell #phi;cell #eta",
+    kCellIPhi, 2305, 0., 2305.,  kCellIEta, 87, -43., 44. },
+  { "BTLUReco", "BTL", kBTLURecoHit, 0, MTDHistoDef::k1D, "h_t_ureco_0",
+    "BTL URECO hits ToA (L);ToA [ns]",
+    kURecoTime, 250, 0., 25. },
+  { "BTLUReco", "BTL", kBTLURecoHit, 1, MTDHistoDef::k1D, "h_t_ureco_1",
+    "BTL URECO hits ToA (R);ToA [ns]",
+    kURecoTime, 250, 0., 25. },
+  { "BTLUReco", "BTL", kBTLURecoHit, 0, MTDHistoDef::k1D, "h_t_ureco_uncorr_0",
+    "BTL URECO hits ToA (L);ToA [ns]",
+    kURecoTimeUncorr, 250, 0., 25. },
+  { "BTLUReco", "BTL", kBTLURecoHit, 1, MTDHistoDef::k1D, "h_t_ureco_uncorr_1",
+    "BTL URECO hits ToA (R);ToA [ns]",
+    kURecoTimeUncorr, 250, 0., 25. },
+  { "BTLUReco", "BTL", kBTLURecoHit, 0, MTDHistoDef::k1D, "h_e_ureco_0",
+    "BTL URECO hits energy (L);Q [pC]",
+    kURecoCharge, 300, 0., 600. },
+  { "BTLUReco", "BTL", kBTLURecoHit, 1, MTDHistoDef::k1D, "h_e_ureco_1",
+    "BTL URECO hits energy (R);Q [pC]",
+    kURecoCharge, 300, 0., 600. },
+  { "BTLUReco", "BTL", kBTLURecoHit, 0, MTDHistoDef::k2D, "h_t_amp_ureco_0",
+    "time vs amplitude (L);amplitude [pC];time [ns]",
+    kURecoCharge, 100, 0., 600.,  kURecoTime, 400, 0., 20. },
+  { "BTLUReco", "BTL", kBTLURecoHit, 1, MTDHistoDef::k2D, "h_t_amp_ureco_1",
+    "time vs amplitude (R);amplitude [pC];time [ns]",
+    kURecoCharge, 100, 0., 600.,  kURecoTime, 400, 0., 20. },
+  { "BTLUReco", "BTL", kBTLURecoHit, 0, MTDHistoDef::kProfile, "p_t_amp_ureco_0",
+    "time vs amplitude (L);amplitude [pC];time [ns]",
+    kURecoCharge, 100, 0., 600.,  kURecoTime },
+  { "BTLUReco", "BTL", kBTLURecoHit, 1, MTDHistoDef::kProfile, "p_t_amp_ureco_1",
+    "time vs amplitude (R);amplitude [pC];time [ns]",
+    kURecoCharge, 100, 0., 600.,  kURecoTime },
+
+  // --- BTLReco
+
+  { "BTLReco", "BTL", kBTLEvent, 0, MTDHistoDef::k1D, "h_n_reco",
+    "Number of BTL RECO hits;N_{RECO hits}",
+    kNReco, 100, 0., 100. },
+  { "BTLReco", "BTL", kBTLRecoHit, 0, MTDHistoDef::kChannelMap, "h_occupancy_reco",
+    "BTL RECO hits occupancy;cell #phi;cell #eta",
+    kCellIPhi, 2305, 0., 2305.,  kCellIEta, 87, -43., 44. },
+  { "BTLReco", "BTL", kBTLRecoHit, 0, MTDHistoDef::k1D, "h_t_reco",
+    "BTL RECO hits ToA;ToA [ns]",
+    kRecoTime, 250, 0., 25. },
+  { "BTLReco", "BTL", kBTLRecoHit, 0, MTDHistoDef::k1D, "h_t_reco_uncorr",
+    "BTL RECO hits ToA;ToA [ns]",
+    kRecoTimeUncorr, 250, 0., 25. },
+  { "BTLReco", "BTL", kBTLRecoHit, 0, MTDHistoDef::k1D, "h_e_reco",
+    "BTL RECO hits energy;E [MeV]",
+    kRecoEnergy, 200, 0., 20. },
+  { "BTLReco", "BTL", kBTLRecoSimHit, 0, MTDHistoDef::k1D, "h_t_res",
+    "ToA resolution;ToA [ns]",
+    kTimeRes, 700, -2., 5. },
+  { "BTLReco", "BTL", kBTLRecoSimHit, 0, MTDHistoDef::k1D, "h_t_res_uncorr",
+    "ToA resolution;ToA [ns]",
+    kTimeResUncorr, 700, -2., 5. },
+  { "BTLReco", "BTL", kBTLRecoSimHit, 0, MTDHistoDef::k1D, "h_e_res",
+    "Energy resolution;E [MeV]",
+    kEnergyRes, 200, -1., 1. },
+  { "BTLReco", "BTL", kBTLRecoSimHit, 0, MTDHistoDef::k2D, "h_t_reco_sim",
+    "ToA reco vs sim;SIM ToA [ns];BTL RECO ToA [ns]",
+    kSimTime, 100, -1., 25.,  kRecoTime, 100, 0., 25. },
+  { "BTLReco", "BTL", kBTLRecoSimHit, 0, MTDHistoDef::k2D, "h_e_reco_sim",
+    "E reco vs sim;SIM E [MeV];BTL RECO E [MeV]",
+    kSimEnergy, 100, 0., 20.,  kRecoEnergy, 100, 0., 20. },
+
+  // --- BTLSimBX: one entry per cell and bunch crossing of the window with
+  //     SIM hits (out-of-time pileup mode)
+
+  { "BTLSimBX", "BTL", kBTLSimBX, 0, MTDHistoDef::k1D, "h_bx_sim",
+    "BTL cells with SIM hits per BX;BX",
+    kBX, 17, -8.5, 8.5 },
+  { "BTLSimBX", "BTL", kBTLSimBX, 0, MTDHistoDef::k2D, "h_bx_e_sim",
+    "BTL SIM energy per BX;BX;E_{SIM} [MeV]",
+    kBX, 17, -8.5, 8.5,  kBXSimEnergy, 100, 0., 20. },
+  { "BTLSimBX", "BTL", kBTLSimBX, 0, MTDHistoDef::kProfile, "p_bx_e_sim",
+    "BTL SIM energy vs BX;BX;E_{SIM} [MeV]",
+    kBX, 17, -8.5, 8.5,  kBXSimEnergy },
+  { "BTLSimBX", "BTL", kBTLSimBX, 0, MTDHistoDef::k2D, "h_bx_t_sim",
+    "BTL first SIM hit time in the BX;BX;T_{SIM} - 25 BX [ns]",
+    kBX, 17, -8.5, 8.5,  kBXSimTime, 100, 0., 25. },
+
+  // --- BTLSimWindow, BTLRecoWindow: one entry per hit and SIM energy
+  //     integration window, for the hits of the BTLSim and BTLReco
+  //     resolution histograms
+
+  { "BTLSimWindow", "BTL", kBTLSimWindow, 0, MTDHistoDef::k2D, "h_e_sim_window",
+    "BTL SIM energy vs integration window;window [ns];E_{SIM} [MeV]",
+    kWindow, 100, 0., 50.,  kWindowSimEnergy, 100, 0., 20. },
+  { "BTLSimWindow", "BTL", kBTLSimWindow, 0, MTDHistoDef::kProfile, "p_e_sim_window",
+    "BTL SIM energy vs integration window;window [ns];E_{SIM} [MeV]",
+    kWindow, 100, 0., 50.,  kWindowSimEnergy },
+  { "BTLRecoWindow", "BTL", kBTLRecoSimWindow, 0, MTDHistoDef::k2D, "h_e_res_window",
+    "Energy resolution vs integration window;window [ns];E_{RECO}-E_{SIM} [MeV]",
+    kWindow, 100, 0., 50.,  kWindowEnergyRes, 200, -1., 1. },
+  { "BTLRecoWindow", "BTL", kBTLRecoSimWindow, 0, MTDHistoDef::kProfile, "p_e_res_window",
+    "Energy resolution vs integration window;window [ns];E_{RECO}-E_{SIM} [MeV]",
+    kWindow, 100, 0., 50.,  kWindowEnergyRes },
+
+  // --- ETLSim
+
+  { "ETLSim", "ETL", kETLSimCell, 0, MTDHistoDef::k1D, "h_n_sim_trk_0",
+    "Number of tracks per ETL cell (-Z);N_{trk}",
+    kSimNTrk, 10, 0., 10. },
+  { "ETLSim", "ETL", kETLSimCell, 1, MTDHistoDef::k1D, "h_n_sim_trk_1",
+    "Number of tracks per ETL cell (+Z);N_{trk}",
+    kSimNTrk, 10, 0., 10. },
+  { "ETLSim", "ETL", kETLEvent, 0, MTDHistoDef::k1D, "h_n_sim_cell_0",
+    "Number of ETL cells with SIM hits (-Z);N_{ETL cells}",
+    kNSimCell, 500, 0., 1000. },
+  { "ETLSim", "ETL", kETLEvent, 1, MTDHistoDef::k1D, "h_n_sim_cell_1",
+    "Number of ETL cells with SIM hits (+Z);N_{ETL cells}",
+    kNSimCell, 500, 0., 1000. },
+  { "ETLSim", "ETL", kETLSimHit, 0, MTDHistoDef::k1D, "h_t_sim_0",
+    "ETL SIM hits ToA (-Z);ToA_{SIM} [ns]",
+    kSimTime, 250, 0., 25. },
+  { "ETLSim", "ETL", kETLSimHit, 1, MTDHistoDef::k1D, "h_t_sim_1",
+    "ETL SIM hits ToA (+Z);ToA_{SIM} [ns]",
+    kSimTime, 250, 0., 25. },
+  { "ETLSim", "ETL", kETLSimHit, 0, MTDHistoDef::k1D, "h_e_sim_0",
+    "ETL SIM hits energy (-Z);E_{SIM} [MIP]",
+    kSimEnergy, 200, 0., 1. },
+  { "ETLSim", "ETL", kETLSimHit, 1, MTDHistoDef::k1D, "h_e_sim_1",
+    "ETL SIM hits energy (+Z);E_{SIM} [MIP]",
+    kSimEnergy, 200, 0., 1. },
+  { "ETLSim", "ETL", kETLSimHit, 0, MTDHistoDef::k1D, "h_xloc_sim_0",
+    "ETL SIM local x (-Z);x_{SIM} [mm]",
+    kSimXLocal, 100, -25., 25. },
+  { "ETLSim", "ETL", kETLSimHit, 1, MTDHistoDef::k1D, "h_xloc_sim_1",
+    "ETL SIM local x (+Z);x_{SIM} [mm]",
+    kSimXLocal, 100, -25., 25. },
+  { "ETLSim", "ETL", kETLSimHit, 0, MTDHistoDef::k1D, "h_yloc_sim_0",
+    "ETL SIM local y (-Z);y_{SIM} [mm]",
+    kSimYLocal, 200, -50., 50. },
+  { "ETLSim", "ETL", kETLSimHit, 1, MTDHistoDef::k1D, "h_yloc_sim_1",
+    "ETL SIM local y (+Z);y_{SIM} [mm]",
+    kSimYLocal, 200, -50., 50. },
+  { "ETLSim", "ETL", kETLSimHit, 0, MTDHistoDef::k1D, "h_zloc_sim_0",
+    "ETL SIM local z (-Z);z_{SIM} [mm]",
+    kSimZLocal, 80, -0.2, 0.2 },
+  { "ETLSim", "ETL", kETLSimHit, 1, MTDHistoDef::k1D, "h_zloc_sim_1",
+    "ETL SIM local z (+Z);z_{SIM} [mm]",
+    kSimZLocal, 80, -0.2, 0.2 },
+  { "ETLSim", "ETL", kETLSimHit, 0, MTDHistoDef::k2D, "h_occupancy_sim_0",
+    "ETL SIM hits occupancy (-Z);x_{SIM} [cm];y_{SIM} [cm]",
+    kSimX, 135, -135., 135.,  kSimY, 135, -135., 135. },
+  { "ETLSim", "ETL", kETLSimHit, 1, MTDHistoDef::k2D, "h_occupancy_sim_1",
+    "ETL SIM hits occupancy (+Z);x_{SIM} [cm];y_{SIM} [cm]",
+    kSimX, 135, -135., 135.,  kSimY, 135, -135., 135. },
+  { "ETLSim", "ETL", kETLSimHit, 0, MTDHistoDef::k1D, "h_x_sim_0",
+    "ETL SIM hits x (-Z);x_{SIM} [cm]",
+    kSimX, 135, -135., 135. },
+  { "ETLSim", "ETL", kETLSimHit, 1, MTDHistoDef::k1D, "h_x_sim_1",
+    "ETL SIM hits x (+Z);x_{SIM} [cm]",
+    kSimX, 135, -135., 135. },
+  { "ETLSim", "ETL", kETLSimHit, 0, MTDHistoDef::k1D, "h_y_sim_0",
+    "ETL SIM hits y (-Z);y_{SIM} [cm]",
+    kSimY, 135, -135., 135. },
+  { "ETLSim", "ETL", kETLSimHit, 1, MTDHistoDef::k1D, "h_y_sim_1",
+    "ETL SIM hits y (+Z);y_{SIM} [cm]",
+    kSimY, 135, -135., 135. },
+  { "ETLSim", "ETL", kETLSimHit, 0, MTDHistoDef::k1D, "h_z_sim_0",
+    "ETL SIM hits z (-Z);z_{SIM} [cm]",
+    kSimZ, 100, -304.5, -303. },
+  { "ETLSim", "ETL", kETLSimHit, 1, MTDHistoDef::k1D, "h_z_sim_1",
+    "ETL SIM hits z (+Z);z_{SIM} [cm]",
+    kSimZ, 100, 303., 304.5 },
+  { "ETLSim", "ETL", kETLSimHit, 0, MTDHistoDef::k1D, "h_phi_sim_0",
+    "ETL SIM hits #phi (-Z);#phi_{SIM} [rad]",
+    kSimPhi, 315, -3.15, 3.15 },
+  { "ETLSim", "ETL", kETLSimHit, 1, MTDHistoDef::k1D, "h_phi_sim_1",
+    "ETL SIM hits #phi (+Z);#phi_{SIM} [rad]",
+    kSimPhi, 315, -3.15, 3.15 },
+  { "ETLSim", "ETL", kETLSimHit, 0, MTDHistoDef::k1D, "h_eta_sim_0",
+    "ETL SIM hits #eta (-Z);#eta_{SIM}",
+    kSimEta, 200, -3.05, -1.55 },
+  { "ETLSim", "ETL", kETLSimHit, 1, MTDHistoDef::k1D, "h_eta_sim_1",
+    "ETL SIM hits #eta (+Z);#eta_{SIM}",
+    kSimEta, 200, 1.55, 3.05 },
+  { "ETLSim", "ETL", kETLSimHit, 0, MTDHistoDef::k2D, "h_t_e_sim_0",
+    "ETL SIM time vs energy (-Z);E_{SIM} [MIP];T_{SIM} [ns]",
+    kSimEnergy, 100, 0., 2.,  kSimTime, 100, 0., 25. },
+  { "ETLSim", "ETL", kETLSimHit, 1, MTDHistoDef::k2D, "h_t_e_sim_1",
+    "ETL SIM time vs energy (+Z);E_{SIM} [MIP];T_{SIM} [ns]",
+    kSimEnergy, 100, 0., 2.,  kSimTime, 100, 0., 25. },
+  { "ETLSim", "ETL", kETLSimHit, 0, MTDHistoDef::k2D, "h_e_eta_sim_0",
+    "ETL SIM energy vs #eta (-Z);#eta_{SIM};E_{SIM} [MIP]",
+    kSimEta, 100, -3.05, -1.55,  kSimEnergy, 100, 0., 2. },
+  { "ETLSim", "ETL", kETLSimHit, 1, MTDHistoDef::k2D, "h_e_eta_sim_1",
+    "ETL SIM energy vs #eta (+Z);#eta_{SIM};E_{SIM} [MIP]",
+    kSimEta, 100, 1.55, 3.05,  kSimEnergy, 100, 0., 2. },
+  { "ETLSim", "ETL", kETLSimHit, 0, MTDHistoDef::k2D, "h_t_eta_sim_0",
+    "ETL SIM time vs #eta (-Z);#eta_{SIM};T_{SIM} [ns]",
+    kSimEta, 100, -3.05, -1.55,  kSimTime, 100, 0., 25. },
+  { "ETLSim", "ETL", kETLSimHit, 1, MTDHistoDef::k2D, "h_t_eta_sim_1",
+    "ETL SIM time vs #eta (+Z);#eta_{SIM};T_{SIM} [ns]",
+    kSimEta, 100, 1.55, 3.05,  kSimTime, 100, 0., 25. },
+  { "ETLSim", "ETL", kETLSimHit, 0, MTDHistoDef::k2D, "h_e_phi_sim_0",
+    "ETL SIM energy vs #phi (-Z);#phi_{SIM} [rad];E_{SIM} [MIP]",
+    kSimPhi, 100, -3.15, 3.15,  kSimEnergy, 100, 0., 2. },
+  { "ETLSim", "ETL", kETLSimHit, 1, MTDHistoDef::k2D, "h_e_phi_sim_1",
+    "ETL SIM energy vs #phi (+Z);#phi_{SIM} [rad];E_{SIM} [MIP]",
+    kSimPhi, 100, -3.15, 3.15,  kSimEnergy, 100, 0., 2. },
+  { "ETLSim", "ETL", kETLSimHit, 0, MTDHistoDef::k2D, "h_t_phi_sim_0",
+    "ETL SIM time vs #phi (-Z);#phi_{SIM} [rad];T_{SIM} [ns]",
+    kSimPhi, 100, -3.15, 3.15,  kSimTime, 100, 0., 25. },
+  { "ETLSim", "ETL", kETLSimHit, 1, MTDHistoDef::k2D, "h_t_phi_sim_1",
+    "ETL SIM time vs #phi (+Z);#phi_{SIM} [rad];T_{SIM} [ns]",
+    kSimPhi, 100, -3.15, 3.15,  kSimTime, 100, 0., 25. },
+  { "ETLSim", "ETL", kETLSimHit, 0, MTDHistoDef::kProfile, "p_t_e_sim_0",
+    "ETL SIM time vs energy (-Z);E_{SIM} [MIP];T_{SIM} [ns]",
+    kSimEnergy, 100, 0., 2.,  kSimTime },
+  { "ETLSim", "ETL", kETLSimHit, 1, MTDHistoDef::kProfile, "p_t_e_sim_1",
+    "ETL SIM time vs energy (+Z);E_{SIM} [MIP];T_{SIM} [ns]",
+    kSimEnergy, 100, 0., 2.,  kSimTime },
+  { "ETLSim", "ETL", kETLSimHit, 0, MTDHistoDef::kProfile, "p_e_eta_sim_0",
+    "ETL SIM energy vs #eta (-Z);#eta_{SIM};E_{SIM} [MIP]",
+    kSimEta, 100, -3.05, -1.55,  kSimEnergy },
+  { "ETLSim", "ETL", kETLSimHit, 1, MTDHistoDef::kProfile, "p_e_eta_sim_1",
+    "ETL SIM energy vs #eta (+Z);#eta_{SIM};E_{SIM} [MIP]",
+    kSimEta, 100, 1.55, 3.05,  kSimEnergy },
+  { "ETLSim", "ETL", kETLSimHit, 0, MTDHistoDef::kProfile, "p_t_eta_sim_0",
+    "ETL SIM time vs #eta (-Z);#eta_{SIM};T_{SIM} [ns]",
+    kSimEta, 100, -3.05, -1.55,  kSimTime },
+  { "ETLSim", "ETL", kETLSimHit, 1, MTDHistoDef::kProfile, "p_t_eta_sim_1",
+    "ETL SIM time vs #eta (+Z);#eta_{SIM};T_{SIM} [ns]",
+    kSimEta, 100, 1.55, 3.05,  kSimTime },
+  { "ETLSim", "ETL", kETLSimHit, 0, MTDHistoDef::kProfile, "p_e_phi_sim_0",
+    "ETL SIM energy vs #phi (-Z);#phi_{SIM} [rad];E_{SIM} [MIP]",
+    kSimPhi, 100, -3.15, 3.15,  kSimEnergy },
+  { "ETLSim", "ETL", kETLSimHit, 1, MTDHistoDef::kProfile, "p_e_phi_sim_1",
+    "ETL SIM energy vs #phi (+Z);#phi_{SIM} [rad];E_{SIM} [MIP]",
+    kSimPhi, 100, -3.15, 3.15,  kSimEnergy },
+  { "ETLSim", "ETL", kETLSimHit, 0, MTDHistoDef::kProfile, "p_t_phi_sim_0",
+    "ETL SIM time vs #phi (-Z);#phi_{SIM} [rad];T_{SIM} [ns]",
+    kSimPhi, 100, -3.15, 3.15,  kSimTime },
+  { "ETLSim", "ETL", kETLSimHit, 1, MTDHistoDef::kProfile, "p_t_phi_sim_1",
+    "ETL SIM time vs #phi (+Z);#phi_{SIM} [rad];T_{SIM} [ns]",
+    kSimPhi, 100, -3.15, 3.15,  kSimTime },
+
+  // --- ETLDigi
+
+  { "ETLDigi", "ETL", kETLEvent, 0, MTDHistoDef::k1D, "h_n_digi_0",
+    "Number of ETL DIGI hits (-Z);N_{DIGI hits}",
+    kNDigi, 100, 0., 100. },
+  { "ETLDigi", "ETL", kETLEvent, 1, MTDHistoDef::k1D, "h_n_digi_1",
+    "Number of ETL DIGI hits (+Z);N_{DIGI hits}",
+    kNDigi, 100, 0., 100. },
+  { "ETLDigi", "ETL", kETLDigiHit, 0, MTDHistoDef::k1D, "h_t_digi_0",
+    "ETL DIGI hits ToA (-Z);ToA [TDC counts]",
+    kDigiTime1, 1000, 0., 2000. },
+  { "ETLDigi", "ETL", kETLDigiHit, 1, MTDHistoDef::k1D, "h_t_digi_1",
+    "ETL DIGI hits ToA (+Z);ToA [TDC counts]",
+    kDigiTime1, 1000, 0., 2000. },
+  { "ETLDigi", "ETL", kETLDigiHit, 0, MTDHistoDef::k1D, "h_e_digi_0",
+    "ETL DIGI hits energy (-Z);amplitude [ADC counts]",
+    kDigiCharge, 256, 0., 256. },
+  { "ETLDigi", "ETL", kETLDigiHit, 1, MTDHistoDef::k1D, "h_e_digi_1",
+    "ETL DIGI hits energy (+Z);amplitude [ADC counts]",
+    kDigiCharge, 256, 0., 256. },
+  { "ETLDigi", "ETL", kETLDigiHit, 0, MTDHistoDef::k2D, "h_occupancy_digi_0",
+    "ETL DIGI hits occupancy (-Z);x [cm];y [cm]",
+    kDigiX, 135, -135., 135.,  kDigiY, 135, -135., 135. },
+  { "ETLDigi", "ETL", kETLDigiHit, 0, MTDHistoDef::kChannelMap, "h_occupancy_module_digi_0",
+    "ETL DIGI hits module occupancy (-Z);module;ring",
+    kCellModule, 256, 1., 257.,  kCellRing, 20, 1., 21. },
+  { "ETLDigi", "ETL", kETLDigiHit, 0, MTDHistoDef::kChannelMap, "h_occupancy_pad_digi_0",
+    "ETL DIGI hits pad occupancy (-Z);row;column",
+    kDigiRow, 16, 0., 16.,  kDigiCol, 16, 0., 16. },
+  { "ETLDigi", "ETL", kETLDigiHit, 1, MTDHistoDef::k2D, "h_occupancy_digi_1",
+    "ETL DIGI hits occupancy (+Z);x [cm];y [cm]",
+    kDigiX, 135, -135., 135.,  kDigiY, 135, -135., 135. },
+  { "ETLDigi", "ETL", kETLDigiHit, 1, MTDHistoDef::kChannelMap, "h_occupancy_module_digi_1",
+    "ETL DIGI hits module occupancy (+Z);module;ring",
+    kCellModule, 256, 1., 257.,  kCellRing, 20, 1., 21. },
+  { "ETLDigi", "ETL", kETLDigiHit, 1, MTDHistoDef::kChannelMap, "h_occupancy_pad_digi_1",
+    "ETL DIGI hits pad occupancy (+Z);row;column",
+    kDigiRow, 16, 0., 16.,  kDigiCol, 16, 0., 16. },
+  { "ETLDigi", "ETL", kETLDigiHit, 0, MTDHistoDef::k1D, "h_x_digi_0",
+    "ETL DIGI hits x (-Z);x [cm]",
+    kDigiX, 135, -135., 135. },
+  { "ETLDigi", "ETL", kETLDigiHit, 1, MTDHistoDef::k1D, "h_x_digi_1",
+    "ETL DIGI hits x (+Z);x [cm]",
+    kDigiX, 135, -135., 135. },
+  { "ETLDigi", "ETL", kETLDigiHit, 0, MTDHistoDef::k1D, "h_y_digi_0",
+    "ETL DIGI hits y (-Z);y [cm]",
+    kDigiY, 135, -135., 135. },
+  { "ETLDigi", "ETL", kETLDigiHit, 1, MTDHistoDef::k1D, "h_y_digi_1",
+    "ETL DIGI hits y (+Z);y [cm]",
+    kDigiY, 135, -135., 135. },
+  { "ETLDigi", "ETL", kETLDigiHit, 0, MTDHistoDef::k1D, "h_phi_digi_0",
+    "ETL DIGI hits #phi (-Z);#phi [rad]",
+    kDigiPhi, 315, -3.15, 3.15 },
+  { "ETLDigi", "ETL", kETLDigiHit, 1, MTDHistoDef::k1D, "h_phi_digi_1",
+    "ETL DIGI hits #phi (+Z);#phi [rad]",
+    kDigiPhi, 315, -3.15, 3.15 },
+  { "ETLDigi", "ETL", kETLDigiHit, 0, MTDHistoDef::k1D, "h_eta_digi_0",
+    "ETL DIGI hits #eta (-Z);#eta",
+    kDigiEta, 200, -3.05, -1.55 },
+  { "ETLDigi", "ETL", kETLDigiHit, 1, MTDHistoDef::k1D, "h_eta_digi_1",
+    "ETL DIGI hits #eta (+Z);#eta",
+    kDigiEta, 200, 1.55, 3.05 },
+  { "ETLDigi", "ETL", kETLDigiHit, 0, MTDHistoDef::k2D, "h_t_e_digi_0",
+    "ETL DIGI time vs energy (-Z);ADC counts;TDC counts",
+    kDigiCharge, 256, 0., 256.,  kDigiTime1, 500, 0., 2000. },
+  { "ETLDigi", "ETL", kETLDigiHit, 1, MTDHistoDef::k2D, "h_t_e_digi_1",
+    "ETL DIGI time vs energy (+Z);ADC counts;TDC counts",
+    kDigiCharge, 256, 0., 256.,  kDigiTime1, 500, 0., 2000. },
+  { "ETLDigi", "ETL", kETLDigiHit, 0, MTDHistoDef::k2D, "h_e_eta_digi_0",
+    "ETL DIGI energy vs #eta (-Z);#eta;ADC counts",
+    kDigiEta, 100, -3.05, -1.55,  kDigiCharge, 256, 0., 256. },
+  { "ETLDigi", "ETL", kETLDigiHit, 1, MTDHistoDef::k2D, "h_e_eta_digi_1",
+    "ETL DIGI energy vs #eta (+Z);#eta;ADC counts",
+    kDigiEta, 100, 1.55, 3.05,  kDigiCharge, 256, 0., 256. },
+  { "ETLDigi", "ETL", kETLDigiHit, 0, MTDHistoDef::k2D, "h_t_eta_digi_0",
+    "ETL DIGI time vs #eta (-Z);#eta;TDC counts",
+    kDigiEta, 100, -3.05, -1.55,  kDigiTime1, 500, 0., 2000. },
+  { "ETLDigi", "ETL", kETLDigiHit, 1, MTDHistoDef::k2D, "h_t_eta_digi_1",
+    "ETL DIGI time vs #eta (+Z);#eta;TDC counts",
+    kDigiEta, 100, 1.55, 3.05,  kDigiTime1, 500, 0., 2000. },
+  { "ETLDigi", "ETL", kETLDigiHit, 0, MTDHistoDef::k2D, "h_e_phi_digi_0",
+    "ETL DIGI energy vs #phi (-Z);#phi [rad];ADC counts",
+    kDigiPhi, 100, -3.15, 3.15,  kDigiCharge, 256, 0., 256. },
+  { "ETLDigi", "ETL", kETLDigiHit, 1, MTDHistoDef::k2D, "h_e_phi_digi_1",
+    "ETL DIGI energy vs #phi (+Z);#phi [rad];ADC counts",
+    kDigiPhi, 100, -3.15, 3.15,  kDigiCharge, 256, 0., 256. },
+  { "ETLDigi", "ETL", kETLDigiHit, 0, MTDHistoDef::k2D, "h_t_phi_digi_0",
+    "ETL DIGI time vs #phi (-Z);#phi [rad];TDC counts",
+    kDigiPhi, 100, -3.15, 3.15,  kDigiTime1, 500, 0., 2000. },
+  { "ETLDigi", "ETL", kETLDigiHit, 1, MTDHistoDef::k2D, "h_t_phi_digi_1",
+    "ETL DIGI time vs #phi (+Z);#phi [rad];TDC counts",
+    kDigiPhi, 100, -3.15, 3.15,  kDigiTime1, 500, 0., 2000. },
+  { "ETLDigi", "ETL", kETLDigiHit, 0, MTDHistoDef::kProfile, "p_t_e_digi_0",
+    "ETL DIGI time vs energy (-Z);ADC counts;TDC counts",
+    kDigiCharge, 256, 0., 256.,  kDigiTime1 },
+  { "ETLDigi", "ETL", kETLDigiHit, 1, MTDHistoDef::kProfile, "p_t_e_digi_1",
+    "ETL DIGI time vs energy (+Z);ADC counts;TDC counts",
+    kDigiCharge, 256, 0., 256.,  kDigiTime1 },
+  { "ETLDigi", "ETL", kETLDigiHit, 0, MTDHistoDef::kProfile, "p_e_eta_digi_0",
+    "ETL DIGI energy vs #eta (-Z);#eta;ADC counts",
+    kDigiEta, 100, -3.05, -1.55,  kDigiCharge },
+  { "ETLDigi", "ETL", kETLDigiHit, 1, MTDHistoDef::kProfile, "p_e_eta_digi_1",
+    "ETL DIGI energy vs #eta (+Z);#eta;ADC counts",
+    kDigiEta, 100, 1.55, 3.05,  kDigiCharge },
+  { "ETLDigi", "ETL", kETLDigiHit, 0, MTDHistoDef::kProfile, "p_t_eta_digi_0",
+    "ETL DIGI time vs #eta (-Z);#eta;TDC counts",
+    kDigiEta, 100, -3.05, -1.55,  kDigiTime1 },
+  { "ETLDigi", "ETL", kETLDigiHit, 1, MTDHistoDef::kProfile, "p_t_eta_digi_1",
+    "ETL DIGI time vs #eta (+Z);#eta;TDC counts",
+    kDigiEta, 100, 1.55, 3.05,  kDigiTime1 },
+  { "ETLDigi", "ETL", kETLDigiHit, 0, MTDHistoDef::kProfile, "p_e_phi_digi_0",
+    "ETL DIGI energy vs #phi (-Z);#phi [rad];ADC counts",
+    kDigiPhi, 100, -3.15, 3.15,  kDigiCharge },
+  { "ETLDigi", "ETL", kETLDigiHit, 1, MTDHistoDef::kProfile, "p_e_phi_digi_1",
+    "ETL DIGI energy vs #phi (+Z);#phi [rad];ADC counts",
+    kDigiPhi, 100, -3.15, 3.15,  kDigiCharge },
+  { "ETLDigi", "ETL", kETLDigiHit, 0, MTDHistoDef::kProfile, "p_t_phi_digi_0",
+    "ETL DIGI time vs #phi (-Z);#phi [rad];TDC counts",
+    kDigiPhi, 100, -3.15, 3.15,  kDigiTime1 },
+  { "ETLDigi", "ETL", kETLDigiHit, 1, MTDHistoDef::kProfile, "p_t_phi_digi_1",
+    "ETL DIGI time vs #phi (+Z);#phi [rad];TDC counts",
+    kDigiPhi, 100, -3.15, 3.15,  kDigiTime1 },
+
+  // --- ETLSimBX
+
+  { "ETLSimBX", "ETL", kETLSimBX, 0, MTDHistoDef::k1D, "h_bx_sim_0",
+    "ETL cells with SIM hits per BX (-Z);BX",
+    kBX, 17, -8.5, 8.5 },
+  { "ETLSimBX", "ETL", kETLSimBX, 0, MTDHistoDef::kProfile, "p_bx_e_sim_0",
+    "ETL SIM energy vs BX (-Z);BX;E_{SIM} [MeV]",
+    kBX, 17, -8.5, 8.5,  kBXSimEnergy },
+  { "ETLSimBX", "ETL", kETLSimBX, 0, MTDHistoDef::k2D, "h_bx_t_sim_0",
+    "ETL first SIM hit time in the BX (-Z);BX;T_{SIM} - 25 BX [ns]",
+    kBX, 17, -8.5, 8.5,  kBXSimTime, 100, 0., 25. },
+  { "ETLSimBX", "ETL", kETLSimBX, 1, MTDHistoDef::k1D, "h_bx_sim_1",
+    "ETL cells with SIM hits per BX (+Z);BX",
+    kBX, 17, -8.5, 8.5 },
+  { "ETLSimBX", "ETL", kETLSimBX, 1, MTDHistoDef::kProfile, "p_bx_e_sim_1",
+    "ETL SIM energy vs BX (+Z);BX;E_{SIM} [MeV]",
+    kBX, 17, -8.5, 8.5,  kBXSimEnergy },
+  { "ETLSimBX", "ETL", kETLSimBX, 1, MTDHistoDef::k2D, "h_bx_t_sim_1",
+    "ETL first SIM hit time in the BX (+Z);BX;T_{SIM} - 25 BX [ns]",
+    kBX, 17, -8.5, 8.5,  kBXSimTime, 100, 0., 25. },
+
+  // --- ETLDigiBX
+
+  { "ETLDigiBX", "ETL", kETLDigiBX, 0, MTDHistoDef::k1D, "h_bx_digi_0",
+    "ETL DIGI samples per BX (-Z);BX",
+    kBX, 17, -8.5, 8.5 },
+  { "ETLDigiBX", "ETL", kETLDigiBX, 0, MTDHistoDef::k2D, "h_bx_e_digi_0",
+    "ETL DIGI amplitude per BX (-Z);BX;amplitude [ADC counts]",
+    kBX, 17, -8.5, 8.5,  kBXDigiCharge, 256, 0., 256. },
+  { "ETLDigiBX", "ETL", kETLDigiBX, 0, MTDHistoDef::kProfile, "p_bx_t_digi_0",
+    "ETL DIGI ToA vs BX (-Z);BX;ToA [TDC counts]",
+    kBX, 17, -8.5, 8.5,  kBXDigiTime },
+  { "ETLDigiBX", "ETL", kETLDigiBX, 1, MTDHistoDef::k1D, "h_bx_digi_1",
+    "ETL DIGI samples per BX (+Z);BX",
+    kBX, 17, -8.5, 8.5 },
+  { "ETLDigiBX", "ETL", kETLDigiBX, 1, MTDHistoDef::k2D, "h_bx_e_digi_1",
+    "ETL DIGI amplitude per BX (+Z);BX;amplitude [ADC counts]",
+    kBX, 17, -8.5, 8.5,  kBXDigiCharge, 256, 0., 256. },
+  { "ETLDigiBX", "ETL", kETLDigiBX, 1, MTDHistoDef::kProfile, "p_bx_t_digi_1",
+    "ETL DIGI ToA vs BX (+Z);BX;ToA [TDC counts]",
+    kBX, 17, -8.5, 8.5,  kBXDigiTime },
+
+  // --- ETLSimWindow, ETLRecoWindow
+
+  { "ETLSimWindow", "ETL", kETLSimWindow, 0, MTDHistoDef::k2D, "h_e_sim_window_0",
+    "ETL SIM energy vs integration window (-Z);window [ns];E_{SIM} [MeV]",
+    kWindow, 100, 0., 50.,  kWindowSimEnergy, 100, 0., 1. },
+  { "ETLSimWindow", "ETL", kETLSimWindow, 0, MTDHistoDef::kProfile, "p_e_sim_window_0",
+    "ETL SIM energy vs integration window (-Z);window [ns];E_{SIM} [MeV]",
+    kWindow, 100, 0., 50.,  kWindowSimEnergy },
+  { "ETLSimWindow", "ETL", kETLSimWindow, 1, MTDHistoDef::k2D, "h_e_sim_window_1",
+    "ETL SIM energy vs integration window (+Z);window [ns];E_{SIM} [MeV]",
+    kWindow, 100, 0., 50.,  kWindowSimEnergy, 100, 0., 1. },
+  { "ETLSimWindow", "ETL", kETLSimWindow, 1, MTDHistoDef::kProfile, "p_e_sim_window_1",
+    "ETL SIM energy vs integration window (+Z);window [ns];E_{SIM} [MeV]",
+    kWindow, 100, 0., 50.,  kWindowSimEnergy },
+  { "ETLRecoWindow", "ETL", kETLRecoSimWindow, 0, MTDHistoDef::k2D, "h_e_res_window_0",
+    "ETL energy resolution vs integration window (-Z);window [ns];E_{RECO}-E_{SIM} [MeV]",
+    kWindow, 100, 0., 50.,  kWindowEnergyRes, 200, -1., 1. },
+  { "ETLRecoWindow", "ETL", kETLRecoSimWindow, 0, MTDHistoDef::kProfile, "p_e_res_window_0",
+    "ETL energy resolution vs integration window (-Z);window [ns];E_{RECO}-E_{SIM} [MeV]",
+    kWindow, 100, 0., 50.,  kWindowEnergyRes },
+  { "ETLRecoWindow", "ETL", kETLRecoSimWindow, 1, MTDHistoDef::k2D, "h_e_res_window_1",
+    "ETL energy resolution vs integration window (+Z);window [ns];E_{RECO}-E_{SIM} [MeV]",
+    kWindow, 100, 0., 50.,  kWindowEnergyRes, 200, -1., 1. },
+  { "ETLRecoWindow", "ETL", kETLRecoSimWindow, 1, MTDHistoDef::kProfile, "p_e_res_window_1",
+    "ETL energy resolution vs integration window (+Z);window [ns];E_{RECO}-E_{SIM} [MeV]",
+    kWindow, 100, 0., 50.,  kWindowEnergyRes },
+
+  // --- ETLUReco
+
+  { "ETLUReco", "ETL", kETLEvent, 0, MTDHistoDef::k1D, "h_n_ureco_0",
+    "Number of ETL URECO hits (-Z);N_{URECO hits}",
+    kNUReco, 100, 0., 100. },
+  { "ETLUReco", "ETL", kETLEvent, 1, MTDHistoDef::k1D, "h_n_ureco_1",
+    "Number of ETL URECO hits (+Z);N_{URECO hits}",
+    kNUReco, 100, 0., 100. },
+
+  // --- ETLReco
+
+  { "ETLReco", "ETL", kETLEvent, 0, MTDHistoDef::k1D, "h_n_reco_0",
+    "Number of ETL RECO hits (-Z);N_{RECO hits}",
+    kNReco, 100, 0., 100. },
+  { "ETLReco", "ETL", kETLEvent, 1, MTDHistoDef::k1D, "h_n_reco_1",
+    "Number of ETL RECO hits (+Z);N_{RECO hits}",
+    kNReco, 100, 0., 100. },
+
+};
+
+const size_t mtdNHistoDefs = sizeof(mtdHistoDefs)/sizeof(mtdHistoDefs[0]);
+
+
+///////////////////////////////////////////////////////////////////////////////////////////////
+//
+//  Histograms filling
+//
+///////////////////////////////////////////////////////////////////////////////////////////////
+
+// Each fill point sets its variables in v and fills the histograms booked
+// there; the time-walk correction is computed only when its fill points
+// are active.
+
+// --- the BTL channels are corrected only for the uncalibrated RECO and RECO
+//     hit histograms
+static bool btlTimeWalkActive(const MTDHistoRegistry& h) {
+  return h.active(kBTLURecoHit) || h.active(kBTLRecoHit) || h.active(kBTLRecoSimHit);
+}
+
+
+void mtdFillHistos(MTDHistoRegistry& h, const MTDEventView& event, float btlMinEnergy,
+		   const MTDTimeWalk& btlTimeWalkModel, MTDTimeWalk::Channels& timeWalk) {
+
+  mtdFillBTLEventHistos(h, event, btlTimeWalkModel, timeWalk);
+  mtdFillBTLHitHistos(h, event, 0, event.btl.size, btlMinEnergy, timeWalk);
+
+  mtdFillETLHistos(h, event, 0);
+  mtdFillETLHistos(h, event, 1);
+
+}
+
+
+// ==============================================================================
+//  BTL
+// ==============================================================================
+
+void mtdFillBTLEventHistos(MTDHistoRegistry& h, const MTDEventView& event,
+			   const MTDTimeWalk& btlTimeWalkModel, MTDTimeWalk::Channels& timeWalk) {
+
+  const MTDEventCounts& n = event.counts;
+
+  double v[kNFillVariables] = {};
+
+  const MTDJoinedHit* btl_hits = event.btl.hits;
+  const size_t n_btl = event.btl.size;
+
+  if ( h.active(kBTLSimCell) ) {
+    for (size_t ih=0; ih<n_btl; ++ih) {
+      if ( btl_hits[ih].info.sim_ntrk == 0 ) continue;
+      v[kSimNTrk] = btl_hits[ih].info.sim_ntrk;
+      h.fill(kBTLSimCell, 0, v);
+    }
+  }
+
+  v[kNSimCell] = n.n_sim_btl;
+  v[kNReco]    = n.n_reco_btl;
+  h.fill(kBTLEvent, 0, v);
+
+  for (int iside=0; iside<2; ++iside){
+    v[kNDigi]  = n.n_digi_btl[iside];
+    v[kNUReco] = n.n_ureco_btl[iside];
+    h.fill(kBTLEventSide, iside, v);
+  }
+
+
+  // --- Bunch crossings of the window, for all the records
+
+  const int nBX = event.window.size();
+
+  if ( h.active(kBTLSimBX) && event.btl.bx != nullptr ) {
+    for (size_t ih=0; ih<n_btl; ++ih) {
+      const MTDBXInfo* slots = event.btl.bx + ih*nBX;
+      for (int islot=0; islot<nBX; ++islot) {
+	if ( slots[islot].sim_nhits == 0 ) continue;
+	const int ibx = event.window.first + islot;
+	v[kBX]          = ibx;
+	v[kBXSimEnergy] = slots[islot].sim_energy;
+	v[kBXSimTime]   = slots[islot].sim_time - kMTDBXLength*ibx;
+	h.fill(kBTLSimBX, 0, v);
+      }
+    }
+  }
+
+
+  // Time-walk correction of all the BTL channels at once
+
+  if ( btlTimeWalkActive(h) ) {
+
+    timeWalk.resize(2*n_btl);
+
+    for (int iside=0; iside<2; ++iside){
+      for (size_t ih=0; ih<n_btl; ++ih){
+	timeWalk.amplitude[ih+iside*n_btl] = btl_hits[ih].info.ureco_charge[iside];
+	timeWalk.time[ih+iside*n_btl]      = btl_hits[ih].info.ureco_time[iside];
+      }
+    }
+
+    btlTimeWalkModel.correct(timeWalk);
+
+  }
+
+}
+
+
+void mtdFillBTLHitHistos(MTDHistoRegistry& h, const MTDEventView& event, size_t begin, size_t end,
+			 float btlMinEnergy, const MTDTimeWalk::Channels& timeWalk) {
+
+  double v[kNFillVariables] = {};
+
+  const MTDJoinedHit* btl_hits = event.btl.hits;
+  const MTDHitPosition* btl_pos = event.btl.positions;
+  const size_t n_btl = event.btl.size;
+
+  const bool btlSimHit    = h.active(kBTLSimHit);
+  const bool btlWindow    = h.active(kBTLSimWindow) || h.active(kBTLRecoSimWindow);
+  const bool btlTimeWalk  = btlTimeWalkActive(h);
+
+  for (size_t ih=begin; ih<end; ++ih) {
+
+    const MTDJoinedHit& hit = btl_hits[ih];
+    const MTDHitPosition& pos = btl_pos[ih];
+
+    if ( hit.info.reco_energy < btlMinEnergy ) continue;
+
+    // Cell indices and global position: the crystal center
+    v[kCellIPhi]    = pos.iphi;
+    v[kCellIEta]    = pos.ieta;
+    v[kCellAbsIEta] = std::abs(pos.ieta);
+    v[kCellPhi]     = pos.phi;
+    v[kCellEta]     = pos.eta;
+    v[kCellZ]       = pos.z;
+
+
+    // --- SIM
+
+    if ( hit.info.sim_time != 0. && btlSimHit ) {
+
+      v[kSimEnergy] = hit.info.sim_energy;
+      v[kSimTime]   = hit.info.sim_time;
+
+      v[kSimXLocal] = hit.info.sim_x;
+      v[kSimYLocal] = hit.info.sim_y;
+      v[kSimZLocal] = hit.info.sim_z;
+
+      v[kSimZ]      = pos.sim_z;
+      v[kSimPhi]    = pos.sim_phi;
+      v[kSimEta]    = pos.sim_eta;
+      v[kSimAbsEta] = std::fabs(pos.sim_eta);
+
+      h.fill(kBTLSimHit, 0, v);
+
+    }
+
+    // --- SIM energy per integration window
+
+    if ( hit.info.sim_time != 0. && event.btl.windowEnergy != nullptr && btlWindow ) {
+      const float* energy = event.btl.windowEnergy + ih*event.btl.windows.size;
+      for (size_t iw=0; iw<event.btl.windows.size; ++iw) {
+	v[kWindow]          = event.btl.windows[iw];
+	v[kWindowSimEnergy] = energy[iw];
+	v[kWindowEnergyRes] = hit.info.reco_energy - energy[iw];
+	h.fill(kBTLSimWindow, 0, v);
+	if ( hit.info.reco_energy != 0. ) h.fill(kBTLRecoSimWindow, 0, v);
+      }
+    }
+
+
+    for (int iside=0; iside<2; ++iside){
+
+      // --- DIGI
+
+      if ( hit.info.digi_charge[iside] == 0 ) continue;
+
+      v[kDigiCharge] = hit.info.digi_charge[iside];
+      v[kDigiTime1]  = hit.info.digi_time1[iside];
+      v[kDigiTime2]  = hit.info.digi_time2[iside];
+
+      h.fill(kBTLDigiHit, iside, v);
+
+
+      // --- Uncalibrated RECO
+
+      if ( hit.info.ureco_charge[iside] == 0. || !btlTimeWalk ) continue;
+
+      v[kURecoCharge] = hit.info.ureco_charge[iside];
+      v[kURecoTime]   = hit.info.ureco_time[iside];
+
+      // Reverse the time-walk correction
+      v[kURecoTimeUncorr] = timeWalk.timeUncorr[ih+iside*n_btl];
+
+      h.fill(kBTLURecoHit, iside, v);
+
+    } // for iside
+
+
+    // --- RECO
+
+    if ( hit.info.reco_energy == 0. || !btlTimeWalk ) continue;
+
+    // Time-walk correction (0 for the sides without uncalibrated RECO)
+    const float time_corr[2] = { timeWalk.correction[ih], timeWalk.correction[ih+n_btl] };
+
+    float reco_time_uncorr = hit.info.reco_time + 0.5*(time_corr[0]+time_corr[1]); 
+
+    v[kRecoEnergy]     = hit.info.reco_energy;
+    v[kRecoTime]       = hit.info.reco_time;
+    v[kRecoTimeUncorr] = reco_time_uncorr;
+
+    h.fill(kBTLRecoHit, 0, v);
+
+    if ( hit.info.sim_time != 0. ) {
+
+      v[kSimEnergy] = hit.info.sim_energy;
+      v[kSimTime]   = hit.info.sim_time;
+
+      v[kEnergyRes]     = hit.info.reco_energy-hit.info.sim_energy;
+      v[kTimeRes]       = hit.info.reco_time-hit.info.sim_time;
+      v[kTimeResUncorr] = reco_time_uncorr-hit.info.sim_time;
+
+      h.fill(kBTLRecoSimHit, 0, v);
+
+    }
+
+  } // BTL hit loop
+
+}
+
+
+// ==============================================================================
+//  ETL
+// ==============================================================================
+
+void mtdFillETLHistos(MTDHistoRegistry& h, const MTDEventView& event, int idet) {
+
+  const MTDEventCounts& n = event.counts;
+
+  double v[kNFillVariables] = {};
+
+  const bool etlSimHit  = h.active(kETLSimHit);
+  const bool etlDigiHit = h.active(kETLDigiHit);
+  const bool etlWindow  = h.active(kETLSimWindow) || h.active(kETLRecoSimWindow);
+
+  const int nBX = event.window.size();
+
+  const MTDJoinedHit* etl_hits = event.etl[idet].hits;
+  const MTDHitPosition* etl_pos = event.etl[idet].positions;
+  const size_t n_etl = event.etl[idet].size;
+
+  if ( h.active(kETLSimCell) ) {
+    for (size_t ih=0; ih<n_etl; ++ih) {
+      if ( etl_hits[ih].info.sim_ntrk == 0 ) continue;
+      v[kSimNTrk] = etl_hits[ih].info.sim_ntrk;
+      h.fill(kETLSimCell, idet, v);
+    }
+  }
+
+  v[kNSimCell] = n.n_sim_etl[idet];
+  v[kNDigi]    = n.n_digi_etl[idet];
+  v[kNUReco]   = n.n_ureco_etl[idet];
+  v[kNReco]    = n.n_reco_etl[idet];
+  h.fill(kETLEvent, idet, v);
+
+  if ( event.etl[idet].bx != nullptr && (h.active(kETLSimBX) || h.active(kETLDigiBX)) ) {
+    for (size_t ih=0; ih<n_etl; ++ih) {
+      const MTDBXInfo* slots = event.etl[idet].bx + ih*nBX;
+      for (int islot=0; islot<nBX; ++islot) {
+	v[kBX] = event.window.first + islot;
+	if ( slots[islot].sim_nhits != 0 ) {
+	  v[kBXSimEnergy] = slots[islot].sim_energy;
+	  v[kBXSimTime]   = slots[islot].sim_time - kMTDBXLength*v[kBX];
+	  h.fill(kETLSimBX, idet, v);
+	}
+	if ( slots[islot].digi_charge != 0 ) {
+	  v[kBXDigiCharge] = slots[islot].digi_charge;
+	  v[kBXDigiTime]   = slots[islot].digi_time1;
+	  h.fill(kETLDigiBX, idet, v);
+	}
+      }
+    }
+  }
+
+  if ( etlWindow && event.etl[idet].windowEnergy != nullptr ) {
+    const size_t nWindows = event.etl[idet].windows.size;
+    for (size_t ih=0; ih<n_etl; ++ih) {
+      const MTDinfo& info = etl_hits[ih].info;
+      if ( info.sim_time == 0. ) continue;
+      const float* energy = event.etl[idet].windowEnergy + ih*nWindows;
+      for (size_t iw=0; iw<nWindows; ++iw) {
+	v[kWindow]          = event.etl[idet].windows[iw];
+	v[kWindowSimEnergy] = energy[iw];
+	v[kWindowEnergyRes] = info.reco_energy - energy[iw];
+	h.fill(kETLSimWindow, idet, v);
+	if ( info.reco_energy != 0. ) h.fill(kETLRecoSimWindow, idet, v);
+      }
+    }
+  }
+
+  if ( !etlSimHit && !etlDigiHit ) return;
+
+
+  for (size_t ih=0; ih<n_etl; ++ih) {
+
+    const MTDJoinedHit& hit = etl_hits[ih];
+    const MTDHitPosition& pos = etl_pos[ih];
+
+    // --- SIM
+
+    if ( hit.info.sim_time != 0. && etlSimHit ) {
+
+      v[kSimEnergy] = hit.info.sim_energy;
+      v[kSimTime]   = hit.info.sim_time;
+      
+      v[kSimXLocal] = hit.info.sim_x;
+      v[kSimYLocal] = hit.info.sim_y;
+      v[kSimZLocal] = hit.info.sim_z;
+
+      v[kSimX]   = pos.sim_x;
+      v[kSimY]   = pos.sim_y;
+      v[kSimZ]   = pos.sim_z;
+      v[kSimPhi] = pos.sim_phi;
+      v[kSimEta] = pos.sim_eta;
+
+      h.fill(kETLSimHit, idet, v);
+
+    }
+
+    // --- DIGI
+
+    if ( hit.info.digi_charge[0] == 0 || !etlDigiHit ) continue;
+
+    v[kDigiCharge] = hit.info.digi_charge[0];
+    v[kDigiTime1]  = hit.info.digi_time1[0];
+    v[kDigiRow]    = hit.info.digi_row[0];
+    v[kDigiCol]    = hit.info.digi_col[0];
+
+    v[kCellModule] = pos.iphi;
+    v[kCellRing]   = pos.ieta;
+
+    // DIGI hit global position: the pad center
+    v[kDigiX]   = pos.x;
+    v[kDigiY]   = pos.y;
+    v[kDigiPhi] = pos.phi;
+    v[kDigiEta] = pos.eta;
+
+    h.fill(kETLDigiHit, idet, v);
+
+  } // ETL hit loop
+
+}
+
+
+std::vector<std::string> mtdBTLHitGroups(const std::vector<std::string>& groups) {
+
+  static const int hitPoints[] = { kBTLSimHit, kBTLDigiHit, kBTLURecoHit, kBTLRecoHit, kBTLRecoSimHit,
+				   kBTLSimWindow, kBTLRecoSimWindow };
+
+  auto hitDef = [](const MTDHistoDef& def) {
+    return std::find(std::begin(hitPoints), std::end(hitPoints), def.point) != std::end(hitPoints);
+  };
+
+  std::vector<std::string> hitGroups;
+  for (auto const& group: groups) {
+    if ( std::any_of(mtdHistoDefs, mtdHistoDefs+mtdNHistoDefs,
+		     [&](const MTDHistoDef& def) { return group == def.group && hitDef(def); }) )
+      hitGroups.push_back(group);
+  }
+
+  return hitGroups;
+
+}
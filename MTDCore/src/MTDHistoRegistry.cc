@@ -0,0 +1,107 @@
+#include "MTDtools/MTDCore/interface/MTDHistoRegistry.h"
+
+#include <algorithm>
+#include <stdexcept>
+
+
+void MTDHistoRegistry::book(const MTDHistoDef* defs, size_t nDefs, const std::vector<std::string>& groups,
+			    unsigned int flushSize) {
+
+  for (auto const& group: groups) {
+    if ( std::none_of(defs, defs+nDefs, [&](const MTDHistoDef& def) { return group == def.group; }) )
+      throw std::invalid_argument("MTDHistoRegistry: unknown histogram group " + group);
+  }
+
+  nDefs_ = nDefs;
+  flushSize_ = flushSize;
+
+  for (size_t id = 0; id < nDefs; ++id) {
+
+    const MTDHistoDef& def = defs[id];
+
+    if ( std::find(groups.begin(), groups.end(), def.group) == groups.end() ) continue;
+
+    if ( 2*def.point+def.side >= int(points_.size()) )
+      points_.resize(2*def.point+2);
+    Point& point = points_[2*def.point+def.side];
+
+    MTDHisto* histo = nullptr;
+
+    switch ( def.kind ) {
+
+    case MTDHistoDef::k1D: {
+      auto h = new MTDHisto1D(def.dir, def.name, def.title, def.nx, def.xlo, def.xhi);
+      point.h1.push_back({h, def.x, def.y});
+      histo = h;
+      break;
+    }
+
+    case MTDHistoDef::k2D: {
+      auto h = new MTDHisto2D(def.dir, def.name, def.title, def.nx, def.xlo, def.xhi, def.ny, def.ylo, def.yhi);
+      point.h2.push_back({h, def.x, def.y});
+      histo = h;
+      break;
+    }
+
+    case MTDHistoDef::kProfile: {
+      auto h = new MTDProfile(def.dir, def.name, def.title, def.nx, def.xlo, def.xhi);
+      point.prof.push_back({h, def.x, def.y});
+      histo = h;
+      break;
+    }
+
+    case MTDHistoDef::kChannelMap: {
+      auto h = new MTDChannelMap(def.dir, def.name, def.title, int(def.xlo), def.nx, int(def.ylo), def.ny);
+      point.maps.push_back({h, def.x, def.y});
+      histo = h;
+      break;
+    }
+
+    }
+
+    histo->setFlushSize(flushSize_);
+    all_.emplace_back(histo);
+    defIndex_.push_back(id);
+
+  }
+
+}
+
+
+void MTDHistoRegistry::flush() {
+
+  for (auto& histo: all_)
+    histo->flush();
+
+}
+
+
+// Both sets are in definition order, those of other being a subset.
+void MTDHistoRegistry::add(const MTDHistoRegistry& other) {
+
+  size_t ih = 0;
+
+  for (size_t io = 0; io < other.all_.size(); ++io) {
+
+    while ( ih < all_.size() && defIndex_[ih] < other.defIndex_[io] ) ++ih;
+
+    if ( ih == all_.size() || defIndex_[ih] != other.defIndex_[io] )
+      throw std::invalid_argument("MTDHistoRegistry: cannot add histogram " + other.all_[io]->name() +
+				  ", not booked here");
+
+    all_[ih]->add(*other.all_[io]);
+
+  }
+
+}
+
+
+size_t MTDHistoRegistry::bytes() const {
+
+  size_t n = 0;
+  for (auto const& histo: all_)
+    n += histo->bytes();
+
+  return n;
+
+}
@@ -0,0 +1,45 @@
+#include "MTDtools/MTDCore/interface/MTDHitJoiner.h"
+
+
+void MTDHitJoiner::order(const MTDTierInputs& in, const MTDBXWindow& window) {
+
+  window_ = window;
+
+  simHitSorter_.sort(in.sim, window_);
+
+  digiOrder_.build(in.digi);
+  urecoOrder_.build(in.ureco);
+  recoOrder_.build(in.reco);
+
+}
+
+
+void MTDHitJoiner::integrate(const MTDSpan<MTDSimHitInput>& sim, size_t i, const MTDSpan<float>& windows,
+			     float* energy) const {
+
+  // --- running sum over the time-ordered hits, read at each window edge as
+  //     the first hit beyond it comes; float as MTDinfo::sim_energy, so that
+  //     the window of MTDinfo gives the same value
+
+  const auto& hitRefs = simHitSorter_.refs();
+  const uint32_t rawId = hitRefs[i].rawId();
+
+  float sum = 0.;
+  size_t iw = 0;
+
+  for ( ; i < hitRefs.size() && hitRefs[i].rawId() == rawId; ++i) {
+
+    const MTDSimHitInput& hit = sim[hitRefs[i].index];
+    if ( MTDBXWindow::bx(hit.tof) != 0 ) continue;
+
+    for ( ; iw < windows.size && hit.tof >= windows[iw]; ++iw)
+      energy[iw] = sum;
+
+    sum += 1000.*hit.energyLoss;
+
+  }
+
+  for ( ; iw < windows.size; ++iw)
+    energy[iw] = sum;
+
+}
@@ -0,0 +1,175 @@
+#include "MTDtools/MTDCore/interface/MTDModuleHistos.h"
+
+#include <algorithm>
+#include <iterator>
+#include <stdexcept>
+
+
+// ==============================================================================
+//  Module histogram definitions
+// ==============================================================================
+
+const MTDHistoDef mtdModuleHistoDefs[] = {
+
+  // --- BTL modules
+
+  { "BTLModule", "", kModuleEvent, 0, MTDHistoDef::k1D, "h_n_reco",
+    "Number of RECO hits in the BTL module;N_{RECO hits}",
+    kNReco, 64, 0., 64. },
+  { "BTLModule", "", kModuleRecoHit, 0, MTDHistoDef::k1D, "h_e_reco",
+    "BTL module RECO hits energy;E [MeV]",
+    kRecoEnergy, 100, 0., 20. },
+  { "BTLModule", "", kModuleRecoHit, 0, MTDHistoDef::k1D, "h_t_reco",
+    "BTL module RECO hits ToA;ToA [ns]",
+    kRecoTime, 125, 0., 25. },
+  { "BTLModule", "", kModuleRecoSimHit, 0, MTDHistoDef::k1D, "h_t_res",
+    "BTL module ToA resolution;ToA_{RECO}-ToA_{SIM} [ns]",
+    kTimeRes, 140, -2., 5. },
+
+  // --- ETL rings
+
+  { "ETLModule", "", kModuleEvent, 0, MTDHistoDef::k1D, "h_n_reco",
+    "Number of RECO hits in the ETL ring;N_{RECO hits}",
+    kNReco, 100, 0., 100. },
+  { "ETLModule", "", kModuleRecoHit, 0, MTDHistoDef::k1D, "h_e_reco",
+    "ETL ring RECO hits energy;E [MeV]",
+    kRecoEnergy, 100, 0., 2. },
+  { "ETLModule", "", kModuleRecoHit, 0, MTDHistoDef::k1D, "h_t_reco",
+    "ETL ring RECO hits ToA;ToA [ns]",
+    kRecoTime, 125, 0., 25. },
+  { "ETLModule", "", kModuleRecoSimHit, 0, MTDHistoDef::k1D, "h_t_res",
+    "ETL ring ToA resolution;ToA_{RECO}-ToA_{SIM} [ns]",
+    kTimeRes, 140, -2., 5. }
+
+};
+
+const size_t mtdNModuleHistoDefs = sizeof(mtdModuleHistoDefs)/sizeof(MTDHistoDef);
+
+
+// ==============================================================================
+//  MTDModuleHistos
+// ==============================================================================
+
+void MTDModuleHistos::book(const MTDHistoDef* defs, size_t nDefs, const std::string& group, Directory directory,
+			   unsigned int flushSize) {
+
+  defs_.clear();
+  std::copy_if(defs, defs+nDefs, std::back_inserter(defs_), [&](const MTDHistoDef& def) { return group == def.group; });
+
+  if ( defs_.empty() )
+    throw std::invalid_argument("MTDModuleHistos: unknown histogram group " + group);
+
+  group_ = group;
+  directory_ = std::move(directory);
+  flushSize_ = flushSize;
+
+}
+
+
+MTDModuleHistos::Module* MTDModuleHistos::bookModule(uint32_t key) {
+
+  // --- the definitions of the group, in the directory of the module
+  const std::string dir = directory_(key);
+  std::vector<MTDHistoDef> defs(defs_);
+  for (auto& def: defs)
+    def.dir = dir.c_str();
+
+  auto module = std::make_unique<Module>();
+  module->key = key;
+  module->histos.book(defs.data(), defs.size(), { group_ }, flushSize_);
+
+  index_.emplace(key, modules_.size());
+  modules_.push_back(std::move(module));
+
+  return modules_.back().get();
+
+}
+
+
+void MTDModuleHistos::flush() {
+
+  for (auto& module: modules_)
+    module->histos.flush();
+
+}
+
+
+void MTDModuleHistos::add(const MTDModuleHistos& other) {
+
+  for (auto const& module: other.modules_)
+    this->module(module->key).histos.add(module->histos);
+
+}
+
+
+size_t MTDModuleHistos::bytes() const {
+
+  size_t n = 0;
+  for (auto const& module: modules_)
+    n += module->histos.bytes();
+
+  return n;
+
+}
+
+
+// ==============================================================================
+//  Filling
+// ==============================================================================
+
+static void fillModules(MTDModuleHistos& h, const MTDJoinedHit* hits, size_t n, float minEnergy,
+			const std::function<uint32_t(uint32_t)>& moduleKey) {
+
+  double v[kNFillVariables] = {};
+
+  for (size_t ih=0; ih<n; ++ih) {
+
+    const MTDinfo& info = hits[ih].info;
+    if ( info.reco_energy == 0. || info.reco_energy < minEnergy ) continue;
+
+    MTDModuleHistos::Module& m = h.module(moduleKey(hits[ih].rawId));
+    h.countCell(m);
+
+    v[kRecoEnergy] = info.reco_energy;
+    v[kRecoTime]   = info.reco_time;
+    m.histos.fill(kModuleRecoHit, 0, v);
+
+    if ( info.sim_time == 0. ) continue;
+
+    v[kTimeRes] = info.reco_time - info.sim_time;
+    m.histos.fill(kModuleRecoSimHit, 0, v);
+
+  }
+
+}
+
+
+static void fillModuleEvents(MTDModuleHistos& h) {
+
+  double v[kNFillVariables] = {};
+
+  h.endEvent([&](MTDModuleHistos::Module& m) {
+      v[kNReco] = m.nCells;
+      m.histos.fill(kModuleEvent, 0, v);
+    });
+
+}
+
+
+void mtdFillBTLModuleHistos(MTDModuleHistos& h, const MTDEventView& event, float btlMinEnergy,
+			    const std::function<uint32_t(uint32_t)>& moduleKey) {
+
+  fillModules(h, event.btl.hits, event.btl.size, btlMinEnergy, moduleKey);
+  fillModuleEvents(h);
+
+}
+
+
+void mtdFillETLModuleHistos(MTDModuleHistos& h, const MTDEventView& event,
+			    const std::function<uint32_t(uint32_t)>& moduleKey) {
+
+  for (int idet=0; idet<2; ++idet)
+    fillModules(h, event.etl[idet].hits, event.etl[idet].size, 0.f, moduleKey);
+  fillModuleEvents(h);
+
+}
@@ -0,0 +1,325 @@
+#include "MTDtools/MTDCore/interface/MTDResolution.h"
+
+#include <algorithm>
+#include <cmath>
+#include <iomanip>
+#include <limits>
+#include <stdexcept>
+#include <string>
+
+
+// ==============================================================================
+//  MTDSketch
+// ==============================================================================
+
+int MTDSketch::position(double x) const {
+
+  const double a = std::fabs(x);
+  if ( !(a >= std::exp2(kMinExponent)) ) return kNBuckets;   // zero and NaN
+
+  const int bucket = std::min(int((std::log2(a) - kMinExponent)*kBucketsPerOctave), kNBuckets - 1);
+  return x > 0. ? kNBuckets + 1 + bucket : kNBuckets - 1 - bucket;
+
+}
+
+
+double MTDSketch::value(int position) const {
+
+  if ( position == kNBuckets ) return std::min(max_, std::max(min_, 0.));
+
+  const int bucket = position > kNBuckets ? position - kNBuckets - 1 : kNBuckets - 1 - position;
+  const double a = std::exp2((bucket + 0.5)/kBucketsPerOctave + kMinExponent);
+
+  return std::min(max_, std::max(min_, position > kNBuckets ? a : -a));
+
+}
+
+
+void MTDSketch::add(double x) {
+
+  if ( buckets_.empty() ) buckets_.resize(2*kNBuckets);
+
+  min_ = n_ > 0 ? std::min(min_, x) : x;
+  max_ = n_ > 0 ? std::max(max_, x) : x;
+  ++n_;
+  sum_ += x;
+
+  const int p = position(x);
+  if ( p == kNBuckets ) ++zero_;
+  else ++buckets_[p < kNBuckets ? p : p-1];
+
+}
+
+
+void MTDSketch::add(const MTDSketch& other) {
+
+  if ( other.n_ == 0 ) return;
+  if ( buckets_.empty() ) buckets_.resize(2*kNBuckets);
+
+  min_ = n_ > 0 ? std::min(min_, other.min_) : other.min_;
+  max_ = n_ > 0 ? std::max(max_, other.max_) : other.max_;
+  n_ += other.n_;
+  zero_ += other.zero_;
+  sum_ += other.sum_;
+
+  for (size_t ib = 0; ib < buckets_.size(); ++ib)
+    buckets_[ib] += other.buckets_[ib];
+
+}
+
+
+double MTDSketch::quantile(double q) const {
+
+  if ( n_ == 0 ) return 0.;
+
+  const uint64_t rank = std::min(n_ - 1, uint64_t(std::max(0., q)*n_));
+
+  uint64_t below = 0;
+  for (int p = 0; p <= 2*kNBuckets; ++p) {
+    below += count(p);
+    if ( below > rank ) return value(p);
+  }
+
+  return max_;
+
+}
+
+
+// Two-pointer scan of the buckets: for each first bucket, the last one is
+// the first which completes the coverage.
+
+double MTDSketch::effectiveSigma(double coverage) const {
+
+  if ( n_ == 0 ) return 0.;
+
+  const uint64_t needed = std::max(uint64_t(1), uint64_t(std::ceil(coverage*n_)));
+
+  double width = max_ - min_;
+  uint64_t inside = 0;
+
+  for (int first = 0, last = -1; first <= 2*kNBuckets; ++first) {
+
+    while ( inside < needed && last < 2*kNBuckets ) inside += count(++last);
+    if ( inside < needed ) break;
+
+    if ( count(first) > 0 ) width = std::min(width, value(last) - value(first));
+    inside -= count(first);
+
+  }
+
+  return 0.5*width;
+
+}
+
+
+double MTDSketch::outside(double lo, double hi) const {
+
+  if ( n_ == 0 ) return 0.;
+
+  uint64_t out = 0;
+  for (int p = 0; p <= 2*kNBuckets; ++p) {
+    const double x = value(p);
+    if ( x < lo || x > hi ) out += count(p);
+  }
+
+  return double(out)/n_;
+
+}
+
+
+// ==============================================================================
+//  MTDResolution
+// ==============================================================================
+
+static constexpr float kResolutionMaxEta = 3.;
+
+
+MTDResolution::MTDResolution(const Binning& binning) :
+  binning_(binning),
+  nRegions_(binning.nEta*binning.nPhi*binning.nAmplitude) {
+
+  if ( nRegions_ == 0 || !(binning_.minAmplitude > 0.f) || !(binning_.maxAmplitude > binning_.minAmplitude) )
+    throw std::invalid_argument("MTDResolution: " + std::to_string(binning_.nEta) + " x " +
+				std::to_string(binning_.nPhi) + " x " + std::to_string(binning_.nAmplitude) +
+				" regions with amplitudes in [" + std::to_string(binning_.minAmplitude) + ", " +
+				std::to_string(binning_.maxAmplitude) + "] pC are not valid");
+
+  sketches_.resize(kNDetectors*kNQuantities*nRegions_);
+  std::fill(outside_, outside_+kNDetectors, 0);
+
+}
+
+
+// --- out of range values go to the first or last bin
+unsigned int MTDResolution::region(float eta, float phi, float amplitude) const {
+
+  auto bin = [](float x, unsigned int n) {
+    return x >= float(n) ? n-1 : x > 0.f ? unsigned(x) : 0u;
+  };
+
+  const unsigned int ieta = bin(std::fabs(eta)*binning_.nEta/kResolutionMaxEta, binning_.nEta);
+  const unsigned int iphi = bin((phi + float(M_PI))*binning_.nPhi/float(2.*M_PI), binning_.nPhi);
+  const unsigned int iamp = bin(std::log(amplitude/binning_.minAmplitude)*binning_.nAmplitude/
+				std::log(binning_.maxAmplitude/binning_.minAmplitude), binning_.nAmplitude);
+
+  return (ieta*binning_.nPhi + iphi)*binning_.nAmplitude + iamp;
+
+}
+
+
+void MTDResolution::add(const MTDResolution& other) {
+
+  if ( other.binning_.nEta != binning_.nEta || other.binning_.nPhi != binning_.nPhi ||
+       other.binning_.nAmplitude != binning_.nAmplitude || other.binning_.minAmplitude != binning_.minAmplitude ||
+       other.binning_.maxAmplitude != binning_.maxAmplitude )
+    throw std::invalid_argument("MTDResolution: sketches with different binnings cannot be added");
+
+  for (size_t is = 0; is < sketches_.size(); ++is)
+    sketches_[is].add(other.sketches_[is]);
+
+  for (int det = 0; det < kNDetectors; ++det)
+    outside_[det] += other.outside_[det];
+
+}
+
+
+size_t MTDResolution::bytes() const {
+
+  size_t n = 0;
+  for (auto const& sketch: sketches_)
+    n += sketch.bytes();
+
+  return n;
+
+}
+
+
+void MTDResolution::write(std::ostream& os) const {
+
+  static const char* detectors[kNDetectors] = { "BTL", "ETL" };
+  static const char* quantities[kNQuantities] = { "time", "time_uncorr", "energy" };
+
+  const double ampStep = std::log(binning_.maxAmplitude/binning_.minAmplitude)/binning_.nAmplitude;
+
+  auto edge = [](unsigned int i, unsigned int n, double lo, double hi) { return lo + (hi-lo)*i/n; };
+  auto ampEdge = [&](unsigned int i) {
+    return i == 0 ? 0. : i == binning_.nAmplitude ? std::numeric_limits<double>::infinity() :
+      binning_.minAmplitude*std::exp(ampStep*i);
+  };
+
+  auto line = [&](int det, int quantity, double etaLo, double etaHi, double phiLo, double phiHi,
+		  double ampLo, double ampHi, const MTDSketch& s) {
+    const double median = s.quantile(0.5);
+    const double core = (s.quantile(0.75) - s.quantile(0.25))/1.349;
+    os << detectors[det] << " " << std::setw(11) << quantities[quantity] << std::fixed << std::setprecision(2)
+       << " " << std::setw(5) << etaLo << " " << std::setw(5) << etaHi
+       << " " << std::setw(5) << phiLo << " " << std::setw(5) << phiHi
+       << " " << std::setw(7) << ampLo << " " << std::setw(7) << ampHi
+       << std::defaultfloat << std::setprecision(5)
+       << " " << std::setw(10) << s.n() << " " << std::setw(11) << s.mean() << " " << std::setw(11) << median
+       << " " << std::setw(11) << core << " " << std::setw(11) << s.effectiveSigma()
+       << " " << std::setw(11) << s.outside(median - 3.*core, median + 3.*core) << "\n";
+  };
+
+  os << "# MTD resolution: RECO - SIM time [ns] and energy [MeV] residuals, |eta|, phi and amplitude [pC] regions\n";
+  for (int det = 0; det < kNDetectors; ++det)
+    if ( outside_[det] > 0 )
+      os << "# WARNING: " << outside_[det] << " " << detectors[det] << " hits out of |eta| ["
+	 << kMinEta[det] << ", " << kMaxEta[det] << "]\n";
+  os << "# detector quantity etaLo etaHi phiLo phiHi ampLo ampHi entries mean median coreSigma effSigma tail3\n";
+
+  for (int det = 0; det < kNDetectors; ++det) {
+    for (int quantity = 0; quantity < kNQuantities; ++quantity) {
+
+      const MTDSketch* sketches = &sketches_[(det*kNQuantities + quantity)*nRegions_];
+
+      MTDSketch all;
+      for (unsigned int ir = 0; ir < nRegions_; ++ir) all.add(sketches[ir]);
+      if ( all.n() == 0 ) continue;
+
+      line(det, quantity, 0., kResolutionMaxEta, -M_PI, M_PI, 0., std::numeric_limits<double>::infinity(), all);
+
+      for (unsigned int ir = 0; ir < nRegions_; ++ir) {
+	if ( sketches[ir].n() == 0 ) continue;
+	const unsigned int iamp = ir % binning_.nAmplitude;
+	const unsigned int iphi = ir / binning_.nAmplitude % binning_.nPhi;
+	const unsigned int ieta = ir / binning_.nAmplitude / binning_.nPhi;
+	line(det, quantity,
+	     edge(ieta, binning_.nEta, 0., kResolutionMaxEta), edge(ieta+1, binning_.nEta, 0., kResolutionMaxEta),
+	     edge(iphi, binning_.nPhi, -M_PI, M_PI), edge(iphi+1, binning_.nPhi, -M_PI, M_PI),
+	     ampEdge(iamp), ampEdge(iamp+1), sketches[ir]);
+      }
+
+    }
+  }
+
+}
+
+
+void mtdFillResolution(MTDResolution& resolution, const MTDEventView& event, float btlMinEnergy,
+		       const MTDTimeWalk& btlTimeWalkModel, MTDResolution::Scratch& scratch) {
+
+  // --- BTL: time-walk corrections of both sides of the selected records,
+  //     in one pass
+
+  const MTDJoinedHit* btl_hits = event.btl.hits;
+
+  scratch.hits.clear();
+  for (size_t ih=0; ih<event.btl.size; ++ih) {
+    const MTDinfo& info = btl_hits[ih].info;
+    if ( info.sim_time == 0. || info.reco_energy == 0. || info.reco_energy < btlMinEnergy ) continue;
+    scratch.hits.push_back(ih);
+  }
+
+  MTDTimeWalk::Channels& channels = scratch.channels;
+  const size_t n = scratch.hits.size();
+  channels.resize(2*n);
+
+  for (int iside=0; iside<2; ++iside){
+    for (size_t ic=0; ic<n; ++ic) {
+      const MTDinfo& info = btl_hits[scratch.hits[ic]].info;
+      channels.amplitude[ic+iside*n] = info.ureco_charge[iside];
+      channels.time[ic+iside*n]      = info.ureco_time[iside];
+    }
+  }
+
+  btlTimeWalkModel.correct(channels);
+
+  for (size_t ic=0; ic<n; ++ic) {
+
+    const MTDinfo& info = btl_hits[scratch.hits[ic]].info;
+    const MTDHitPosition& pos = event.btl.positions[scratch.hits[ic]];
+
+    const int nSides = (info.ureco_charge[0] > 0.) + (info.ureco_charge[1] > 0.);
+    const float amplitude = nSides > 0 ?
+      (std::max(info.ureco_charge[0], 0.f) + std::max(info.ureco_charge[1], 0.f))/nSides : 0.f;
+
+    const float reco_time_uncorr = info.reco_time + 0.5*(channels.correction[ic] + channels.correction[ic+n]);
+
+    resolution.add(MTDResolution::kBTL, MTDResolution::kTime, pos.eta, pos.phi, amplitude,
+		   info.reco_time - info.sim_time);
+    resolution.add(MTDResolution::kBTL, MTDResolution::kTimeUncorr, pos.eta, pos.phi, amplitude,
+		   reco_time_uncorr - info.sim_time);
+    resolution.add(MTDResolution::kBTL, MTDResolution::kEnergy, pos.eta, pos.phi, amplitude,
+		   info.reco_energy - info.sim_energy);
+
+  }
+
+  // --- ETL
+
+  for (int idet=0; idet<2; ++idet){
+    for (size_t ih=0; ih<event.etl[idet].size; ++ih) {
+
+      const MTDinfo& info = event.etl[idet].hits[ih].info;
+      const MTDHitPosition& pos = event.etl[idet].positions[ih];
+      if ( info.sim_time == 0. || info.reco_energy == 0. ) continue;
+
+      resolution.add(MTDResolution::kETL, MTDResolution::kTime, pos.eta, pos.phi, info.ureco_charge[0],
+		     info.reco_time - info.sim_time);
+      resolution.add(MTDResolution::kETL, MTDResolution::kEnergy, pos.eta, pos.phi, info.ureco_charge[0],
+		     info.reco_energy - info.sim_energy);
+
+    }
+  }
+
+}
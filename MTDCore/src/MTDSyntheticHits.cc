@@ -0,0 +1,232 @@
+#include "MTDtools/MTDCore/interface/MTDSyntheticHits.h"
+
+#include <algorithm>
+#include <cmath>
+
+
+// Synthetic DetIds: the Forward/FastTime bits of the MTD DetIds, the
+// detector (1 for BTL, 2 for ETL), the side and the cell number.
+
+static const uint32_t kDetIdBase = (6u << 28) | (1u << 25);
+static const uint32_t kCellBits = 22;
+
+// BTL: 2304 crystals in phi x 144 in eta on a cylinder
+static const uint32_t kBTLNPhi = 2304;
+static const uint32_t kBTLNEta = 144;
+static const float kBTLRadius = 114.8;      // [cm]
+static const float kBTLEtaMax = 1.48;
+
+// ETL: 20 rings of 200 modules on each side
+static const uint32_t kETLNPhi = 200;
+static const uint32_t kETLNRing = 20;
+static const float kETLZ = 300.;            // [cm]
+static const float kETLRMin = 32.;
+static const float kETLRingPitch = 4.4;
+static const float kETLPadPitch = 0.13;
+
+static const float kPi = 3.14159265358979f;
+
+
+MTDSyntheticHits::MTDSyntheticHits(Detector detector, unsigned int pileup, uint64_t seed) :
+  detector_(detector), pileup_(pileup), rng_(seed) {
+}
+
+
+uint32_t MTDSyntheticHits::nCells() const {
+
+  return detector_ == kBTL ? kBTLNPhi*kBTLNEta : kETLNPhi*kETLNRing;
+
+}
+
+
+uint32_t MTDSyntheticHits::rawId(int side, uint32_t cell) const {
+
+  return kDetIdBase | (uint32_t(detector_+1) << (kCellBits+1)) | (uint32_t(side) << kCellBits) | cell;
+
+}
+
+
+int MTDSyntheticHits::route(uint32_t rawId, uint32_t& cell) const {
+
+  cell = rawId & ((1u << kCellBits) - 1);
+
+  if ( (rawId >> (kCellBits+1)) != ((kDetIdBase >> (kCellBits+1)) | uint32_t(detector_+1)) || cell >= nCells() )
+    return -1;
+
+  return detector_ == kBTL ? 0 : (rawId >> kCellBits) & 1;
+
+}
+
+
+void MTDSyntheticHits::generate(const MTDBXWindow& window) {
+
+  sim_.clear();
+  digi_.clear();
+  ureco_.clear();
+  reco_.clear();
+  digiBX_.clear();
+
+  const bool btl = detector_ == kBTL;
+  const int nBX = !btl && window.size() > 1 ? window.size() : 0;
+
+  // --- hit cells per side, SIM hits per cell beyond the first
+  const uint32_t nHitCells = btl ? 150 + 45*pileup_ : 40 + 12*pileup_;
+  const double simHitsPerCell = btl ? 3. : 2.;
+
+  std::uniform_int_distribution<uint32_t> cellDist(0, nCells()-1);
+  std::uniform_int_distribution<uint32_t> trackDist(1, 1000*(pileup_+1));
+  std::uniform_int_distribution<uint32_t> adcDist(1, 1023);
+  std::uniform_int_distribution<uint32_t> padDist(0, 15);
+  std::geometric_distribution<int> nSimDist(1./simHitsPerCell);
+  std::exponential_distribution<float> timeDist(1./3.);
+  std::exponential_distribution<float> lossDist(btl ? 1./1.5e-3 : 1./2.e-5);    // [GeV]
+  std::exponential_distribution<float> amplitudeDist(1./8.);                      // [pC]
+  std::exponential_distribution<float> energyDist(btl ? 1./4. : 1./0.02);        // [MeV]
+  std::normal_distribution<float> resolutionDist(0., 0.05);                       // [ns]
+  std::uniform_real_distribution<float> uniform(0., 1.);
+
+  for (int side = 0; side < (btl ? 1 : 2); ++side) {
+
+    cells_.resize(nHitCells);
+    for (auto& cell: cells_) cell = cellDist(rng_);
+
+    std::sort(cells_.begin(), cells_.end());
+    cells_.erase(std::unique(cells_.begin(), cells_.end()), cells_.end());
+
+    for (uint32_t cell: cells_) {
+
+      const uint32_t id = rawId(side, cell);
+      const float t0 = 2. + timeDist(rng_);
+
+      // --- SIM hits, 15% of them out of time, none for the noise
+      const bool noise = uniform(rng_) < 0.03;
+
+      if ( !noise ) {
+
+	const int nSim = 1 + nSimDist(rng_);
+	int32_t trackId = trackDist(rng_);
+
+	for (int is = 0; is < nSim; ++is) {
+
+	  float tof = t0 + 0.02*is;
+	  if ( uniform(rng_) < 0.15 ) tof = uniform(rng_) < 0.5 ? -25.*uniform(rng_) : 25.5 + 75.*uniform(rng_);
+
+	  if ( is > 0 && uniform(rng_) < 0.2 ) trackId = trackDist(rng_);
+
+	  sim_.push_back( {id, trackId, tof, lossDist(rng_),
+			   3.f*uniform(rng_) - 1.5f, 56.f*uniform(rng_) - 28.f, 3.8f*uniform(rng_) - 1.9f} );
+
+	}
+
+      }
+
+      // --- DIGI, uncalibrated RECO and RECO hits of 90% of the cells
+      if ( !noise && uniform(rng_) > 0.9 ) continue;
+
+      MTDDigiHitInput digi = MTDDigiHitInput();
+      MTDURecoHitInput urecHit = MTDURecoHitInput();
+      digi.rawId = urecHit.rawId = id;
+
+      for (int iside = 0; iside < (btl ? 2 : 1); ++iside) {
+
+	digi.row[iside]    = btl ? cell % 16 : padDist(rng_);
+	digi.column[iside] = btl ? 0 : padDist(rng_);
+	digi.charge[iside] = btl || uniform(rng_) > 0.05 ? adcDist(rng_) : 0;
+	digi.toa[iside]    = adcDist(rng_);
+	digi.toa2[iside]   = btl ? adcDist(rng_) : 0;
+
+	urecHit.amplitude[iside] = amplitudeDist(rng_);
+	urecHit.time[iside]      = t0 + 2. + resolutionDist(rng_);
+
+      }
+
+      digi_.push_back(digi);
+
+      // --- samples of the BX window, the in-time one being the DIGI hit
+      for (int islot = 0; islot < nBX; ++islot) {
+	if ( islot == window.slot(0) )
+	  digiBX_.push_back( {digi.charge[0], digi.toa[0]} );
+	else if ( uniform(rng_) < 0.1 )
+	  digiBX_.push_back( {adcDist(rng_), adcDist(rng_)} );
+	else
+	  digiBX_.push_back( {0, 0} );
+      }
+      ureco_.push_back(urecHit);
+      reco_.push_back( {id, energyDist(rng_), t0 + resolutionDist(rng_)} );
+
+    }
+
+  }
+
+  // --- the SIM hits come in the order of the GEANT tracks
+  std::shuffle(sim_.begin(), sim_.end(), rng_);
+
+}
+
+
+void MTDSyntheticHits::positions(const std::vector<MTDJoinedHit>& hits, std::vector<MTDHitPosition>& pos) const {
+
+  pos.resize(hits.size());
+
+  for (size_t ih = 0; ih < hits.size(); ++ih) {
+
+    const MTDJoinedHit& hit = hits[ih];
+    MTDHitPosition& p = pos[ih];
+
+    p = MTDHitPosition();
+
+    float r, phi, z;
+
+    if ( detector_ == kBTL ) {
+
+      const int iphi = hit.cell % kBTLNPhi;
+      const int ieta = int(hit.cell / kBTLNPhi) - int(kBTLNEta/2);
+      const float eta = (ieta + 0.5)*2.*kBTLEtaMax/kBTLNEta;
+
+      r   = kBTLRadius;
+      phi = (iphi + 0.5)*2.*kPi/kBTLNPhi - kPi;
+      z   = r*std::sinh(eta);
+
+      p.iphi = iphi + 1;
+      p.ieta = ieta < 0 ? ieta : ieta + 1;
+
+    }
+    else {
+
+      const uint32_t ring = hit.cell / kETLNPhi;
+
+      r   = kETLRMin + (ring + 0.5)*kETLRingPitch;
+      phi = (hit.cell % kETLNPhi + 0.5)*2.*kPi/kETLNPhi - kPi;
+      z   = ((hit.rawId >> kCellBits) & 1) ? kETLZ : -kETLZ;
+
+      p.iphi = hit.cell % kETLNPhi + 1;
+      p.ieta = ring + 1;
+
+    }
+
+    p.x = r*std::cos(phi);
+    p.y = r*std::sin(phi);
+    p.z = z;
+
+    // --- ETL DIGI pad
+    if ( detector_ == kETL && hit.info.digi_charge[0] != 0 ) {
+      p.x += (hit.info.digi_row[0] - 7.5)*kETLPadPitch;
+      p.y += (hit.info.digi_col[0] - 7.5)*kETLPadPitch;
+    }
+
+    const float rxy = std::hypot(p.x, p.y);
+    p.eta = std::asinh(p.z/rxy);
+    p.phi = std::atan2(p.y, p.x);
+
+    // --- SIM position: local entry point [mm] around the cell center
+    if ( hit.info.sim_time != 0. ) {
+      p.sim_x   = p.x + 0.1*hit.info.sim_x;
+      p.sim_y   = p.y + 0.1*hit.info.sim_z;
+      p.sim_z   = p.z + 0.1*hit.info.sim_y;
+      p.sim_eta = std::asinh(p.sim_z/std::hypot(p.sim_x, p.sim_y));
+      p.sim_phi = std::atan2(p.sim_y, p.sim_x);
+    }
+
+  }
+
+}
@@ -0,0 +1,145 @@
+#include "MTDtools/MTDCore/interface/MTDTimeWalk.h"
+
+#include <cfloat>
+#include <cstdint>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+
+
+// The kernel and its helpers share the no-trapping-math option, since GCC
+// does not inline functions compiled with different optimization options.
+
+#if defined(__GNUC__) && !defined(__clang__)
+#define MTD_TIMEWALK_KERNEL __attribute__((optimize("no-trapping-math")))
+#else
+#define MTD_TIMEWALK_KERNEL
+#endif
+
+
+namespace {
+
+  MTD_TIMEWALK_KERNEL inline int32_t asInt(float x) {
+    int32_t i;
+    std::memcpy(&i, &x, sizeof(i));
+    return i;
+  }
+
+  MTD_TIMEWALK_KERNEL inline float asFloat(int32_t i) {
+    float x;
+    std::memcpy(&x, &i, sizeof(x));
+    return x;
+  }
+
+  // --- natural logarithm of a positive normal number (Cephes logf)
+  MTD_TIMEWALK_KERNEL inline float fastLog(float x) {
+
+    const int32_t bits = asInt(x);
+
+    // x = m * 2^e, with m in [0.5, 1)
+    int32_t e = ((bits >> 23) & 0xff) - 126;
+    float m = asFloat((bits & 0x807fffff) | 0x3f000000);
+
+    // m in [sqrt(0.5), sqrt(2))
+    const bool small = m < 0.707106781186547524f;
+    e = small ? e - 1 : e;
+    m = small ? m + m - 1.f : m - 1.f;
+
+    const float z = m*m;
+    const float fe = e;
+
+    float y =          7.0376836292e-2f;
+    y = y*m - 1.1514610310e-1f;
+    y = y*m + 1.1676998740e-1f;
+    y = y*m - 1.2420140846e-1f;
+    y = y*m + 1.4249322787e-1f;
+    y = y*m - 1.6668057665e-1f;
+    y = y*m + 2.0000714765e-1f;
+    y = y*m - 2.4999993993e-1f;
+    y = y*m + 3.3333331174e-1f;
+    y *= m*z;
+
+    y += -2.12194440e-4f*fe;
+    y += -0.5f*z;
+
+    return m + y + 0.693359375f*fe;
+
+  }
+
+  // --- exponential, clamped to the normal range (Cephes expf)
+  MTD_TIMEWALK_KERNEL inline float fastExp(float x) {
+
+    x = x < -87.f ? -87.f : x;
+    x = x >  88.f ?  88.f : x;
+
+    // x = n*log(2) + r, |r| <= log(2)/2; the offset makes the truncation a floor
+    const int32_t n = int32_t(1.44269504088896341f*x + 128.5f) - 128;
+    const float fn = n;
+
+    float r = x - 0.693359375f*fn;
+    r -= -2.12194440e-4f*fn;
+
+    const float z = r*r;
+
+    float y =          1.9875691500e-4f;
+    y = y*r + 1.3981999507e-3f;
+    y = y*r + 8.3334519073e-3f;
+    y = y*r + 4.1665795894e-2f;
+    y = y*r + 1.6666665459e-1f;
+    y = y*r + 5.0000001201e-1f;
+    y = y*z + r + 1.f;
+
+    return y * asFloat((n+127) << 23);
+
+  }
+
+}
+
+
+MTDTimeWalk::MTDTimeWalk(const std::vector<double>& parameters) {
+
+  if ( parameters.size() != 3 )
+    throw std::invalid_argument("MTDTimeWalk: 3 parameters (p0, p1, p2) expected, " +
+				std::to_string(parameters.size()) + " given");
+
+  p0_ = parameters[0];
+  p1_ = parameters[1];
+  p2_ = parameters[2];
+
+}
+
+
+void MTDTimeWalk::correct(Channels& channels) const {
+
+  correct(channels.amplitude.data(), channels.time.data(),
+	  channels.correction.data(), channels.timeUncorr.data(), channels.size());
+
+}
+
+
+// All the operations are evaluated for every channel and the invalid ones
+// are masked afterwards, so that the loop is vectorized; as for
+// MTDAxis::find() the comparisons need no-trapping-math to be if-converted.
+
+MTD_TIMEWALK_KERNEL
+void MTDTimeWalk::correct(const float* __restrict__ amplitude, const float* __restrict__ time,
+			  float* __restrict__ correction, float* __restrict__ timeUncorr, size_t n) const {
+
+  const float p0 = p0_;
+  const float p1 = p1_;
+  const float p2 = p2_;
+
+  for (size_t i = 0; i < n; ++i) {
+
+    const float q = amplitude[i];
+    const bool valid = (q >= FLT_MIN) & (q <= FLT_MAX);
+
+    const float c = p0*fastExp(p1*fastLog(valid ? q : 1.f)) + p2;
+
+    correction[i] = valid ? c : 0.f;
+    timeUncorr[i] = time[i] + correction[i];
+
+  }
+
+}
+
@@ -0,0 +1,119 @@
+// Bins of MTDAxis::find(), scalar and vectorized, against the fixed-bin
+// arithmetic of TAxis::FindBin, for axes of the histogram definitions and
+// a few uneven ones: at every bin edge and the neighbouring doubles, at
+// lo and hi, for +-inf, NaN (overflow, as TAxis), -0, +-DBL_MAX and for
+// random values around the range. The vectorized version is called on
+// arrays of several lengths and offsets, so that the loop remainders are
+// checked too.
+//
+// Exits with a non-zero status on failure.
+
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+#include <cstdio>
+#include <limits>
+#include <random>
+#include <vector>
+
+#include "MTDtools/MTDCore/interface/MTDHisto.h"
+
+
+// --- TAxis::FindBin of an axis of n fixed bins, without the extendable
+//     axes
+static int findBin(int n, double lo, double hi, double x) {
+
+  if ( x < lo ) return 0;
+  if ( !(x < hi) ) return n+1;
+  return 1 + int(n*(x-lo)/(hi-lo));
+
+}
+
+
+static int checkAxis(int n, double lo, double hi) {
+
+  const MTDAxis axis(n, lo, hi);
+
+  std::vector<double> x = {
+    lo, hi, -0., 0., DBL_MAX, -DBL_MAX, DBL_MIN, -DBL_MIN,
+    std::numeric_limits<double>::infinity(), -std::numeric_limits<double>::infinity(),
+    std::numeric_limits<double>::quiet_NaN(), -std::numeric_limits<double>::quiet_NaN()
+  };
+
+  // --- the bin edges and their neighbours
+  for (int i = 0; i <= n; ++i) {
+    const double edge = lo + (hi-lo)*i/n;
+    x.push_back(edge);
+    x.push_back(std::nextafter(edge, -DBL_MAX));
+    x.push_back(std::nextafter(edge, DBL_MAX));
+  }
+
+  // --- random values over the range and a bin width around it
+  std::mt19937_64 rng(n);
+  std::uniform_real_distribution<double> uniform(lo - (hi-lo)/n, hi + (hi-lo)/n);
+  for (int i = 0; i < 10007; ++i)
+    x.push_back(uniform(rng));
+
+  int failures = 0;
+
+  for (size_t i = 0; i < x.size(); ++i) {
+    const int expected = findBin(n, lo, hi, x[i]);
+    if ( axis.find(x[i]) != expected ) {
+      if ( failures++ < 10 )
+	std::printf("FAIL axis (%d, %g, %g): find(%.17g) = %d, FindBin %d\n", n, lo, hi, x[i], axis.find(x[i]), expected);
+    }
+  }
+
+  // --- vectorized: whole array, then several lengths and offsets
+  std::vector<int> bin(x.size());
+  for (size_t offset: { size_t(0), size_t(1), size_t(3) })
+    for (size_t length: { x.size() - offset, size_t(1), size_t(5), size_t(17) }) {
+      std::fill(bin.begin(), bin.end(), -1);
+      axis.find(x.data() + offset, bin.data() + offset, length);
+      for (size_t i = offset; i < offset + length; ++i) {
+	const int expected = findBin(n, lo, hi, x[i]);
+	if ( bin[i] != expected ) {
+	  if ( failures++ < 10 )
+	    std::printf("FAIL axis (%d, %g, %g): vectorized find(%.17g) = %d, FindBin %d\n", n, lo, hi, x[i], bin[i],
+			expected);
+	}
+      }
+      if ( offset > 0 && bin[offset-1] != -1 ) {
+	std::printf("FAIL axis (%d, %g, %g): vectorized find wrote before its output\n", n, lo, hi);
+	++failures;
+      }
+    }
+
+  // --- the edge cases in words
+  const double nan = std::numeric_limits<double>::quiet_NaN();
+  if ( axis.find(lo) != 1 || axis.find(hi) != n+1 || axis.find(nan) != n+1 ||
+       axis.find(-std::numeric_limits<double>::infinity()) != 0 ) {
+    std::printf("FAIL axis (%d, %g, %g): lo, hi, NaN or -inf in the wrong bin\n", n, lo, hi);
+    ++failures;
+  }
+
+  std::printf("%s axis (%d, %g, %g), %zu values\n", failures == 0 ? "ok  " : "FAIL", n, lo, hi, x.size());
+
+  return failures;
+
+}
+
+
+int main() {
+
+  int failures = 0;
+
+  failures += checkAxis(100, 0., 25.);
+  failures += checkAxis(200, -1., 1.);
+  failures += checkAxis(1000, 0., 20.);
+  failures += checkAxis(3, -0.5, 2.5);
+  failures += checkAxis(7, -3.3, 12.1);
+  failures += checkAxis(1, 0., 1.);
+  failures += checkAxis(97, 1e-3, 1e-3 + 1e-9);
+  failures += checkAxis(1000, -1e6, 1e6);
+
+  std::printf("%s\n", failures == 0 ? "All the axis checks passed" : "Axis checks FAILED");
+
+  return failures == 0 ? 0 : 1;
+
+}
@@ -0,0 +1,151 @@
+// Constants of MTDCalibration::fit() on synthetic channels with known
+// constants: time residuals p0*q^p1 + p2 with a Gaussian smearing, p0 and p2
+// different per channel and p1 common, and a per-cell energy scale. The
+// sums are filled in two halves and added, as those of the streams. The
+// fit must recover p1 and the per-channel p0, p2 and scale; a channel
+// without entries must get no constants and one with too few entries the
+// global ones. An invalid binning must throw.
+//
+// Exits with a non-zero status on failure.
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <random>
+#include <stdexcept>
+#include <vector>
+
+#include "MTDtools/MTDCore/interface/MTDCalibration.h"
+
+
+static constexpr int kNCells = 2000;
+static constexpr int kNSides = 2;
+static constexpr unsigned int kMinEntries = 50;
+static constexpr int kEmptyCell = 7;       // no entries
+static constexpr int kSparseCell = 11;     // less than kMinEntries entries
+
+static constexpr double kMaxP1Deviation = 0.002;
+static constexpr double kMaxP0Deviation = 0.1;    // [ns]
+static constexpr double kMaxP2Deviation = 0.05;   // [ns]
+static constexpr double kMaxScaleDeviation = 1e-3;
+
+
+static int checkFit(float p1, float sigma, size_t nEntries) {
+
+  std::mt19937 rng(3);
+  std::uniform_real_distribution<float> uniform(0.f, 1.f);
+  std::normal_distribution<float> smearing(0.f, sigma);
+
+  std::vector<float> p0(kNSides*kNCells), p2(kNSides*kNCells), scale(kNCells);
+  for (int ich = 0; ich < kNSides*kNCells; ++ich) {
+    p0[ich] = 2.2f*(0.8f + 0.4f*uniform(rng));
+    p2[ich] = 0.2f*uniform(rng) - 0.1f;
+  }
+  for (int cell = 0; cell < kNCells; ++cell)
+    scale[cell] = 0.9f + 0.2f*uniform(rng);
+
+  MTDCalibration::Binning binning;
+  binning.minAmplitude = 0.5;
+  binning.maxAmplitude = 50.;
+  binning.nBins = 8;
+  MTDCalibration halves[2] = { MTDCalibration(kNSides, binning), MTDCalibration(kNSides, binning) };
+
+  for (size_t i = 0; i < nEntries; ++i) {
+    const int cell = int(kNCells*uniform(rng));
+    if ( cell == kEmptyCell ) continue;
+    if ( cell == kSparseCell && i % 100 != 0 ) continue;
+    const int side = uniform(rng) < 0.5f;
+    const int ich = kNSides*cell + side;
+    const float q = binning.minAmplitude*std::pow(binning.maxAmplitude/binning.minAmplitude, uniform(rng));
+    halves[i % 2].addTime(cell, 1000 + cell, side, q, p0[ich]*std::pow(q, p1) + p2[ich] + smearing(rng));
+    const float energy = 1.f + 5.f*uniform(rng);
+    halves[i % 2].addEnergy(cell, 1000 + cell, energy*scale[cell], energy);
+  }
+
+  halves[0].add(halves[1]);
+  const MTDCalibration::Constants constants = halves[0].fit(kMinEntries);
+
+  int failures = 0;
+
+  const double dp1 = std::fabs(constants.globalTimeWalk.p1 - p1);
+  if ( dp1 > kMaxP1Deviation ) {
+    std::printf("FAIL p1 = %g: fitted %g\n", p1, constants.globalTimeWalk.p1);
+    ++failures;
+  }
+
+  double maxP0 = 0., maxP2 = 0., maxScale = 0.;
+  for (int cell = 0; cell < kNCells; ++cell) {
+
+    const bool fitted = cell != kEmptyCell && cell != kSparseCell;
+
+    for (int side = 0; side < kNSides; ++side) {
+      const int ich = kNSides*cell + side;
+      const MTDCalibration::TimeWalk& timeWalk = constants.timeWalk[ich];
+      const MTDCalibration::Status expected = cell == kEmptyCell ? MTDCalibration::kNoData :
+	cell == kSparseCell ? MTDCalibration::kGlobal : MTDCalibration::kFitted;
+      if ( timeWalk.status != expected ) {
+	std::printf("FAIL p1 = %g: channel %d has status %u, %u expected\n", p1, ich, unsigned(timeWalk.status),
+		    unsigned(expected));
+	++failures;
+      }
+      if ( fitted ) {
+	maxP0 = std::max(maxP0, double(std::fabs(timeWalk.p0 - p0[ich])));
+	maxP2 = std::max(maxP2, double(std::fabs(timeWalk.p2 - p2[ich])));
+      }
+    }
+
+    if ( fitted )
+      maxScale = std::max(maxScale, double(std::fabs(constants.energyScale[cell].scale - scale[cell])));
+
+  }
+
+  if ( maxP0 > kMaxP0Deviation || maxP2 > kMaxP2Deviation || maxScale > kMaxScaleDeviation ) {
+    std::printf("FAIL p1 = %g: max deviations p0 %g, p2 %g, scale %g\n", p1, maxP0, maxP2, maxScale);
+    ++failures;
+  }
+
+  std::printf("%s p1 = %g, sigma %g ns: fitted p1 %g, max deviations p0 %.3g ns, p2 %.3g ns, scale %.3g\n",
+	      failures == 0 ? "ok  " : "FAIL", p1, sigma, constants.globalTimeWalk.p1, maxP0, maxP2, maxScale);
+
+  return failures;
+
+}
+
+
+static int checkInvalidBinning() {
+
+  int failures = 0;
+
+  for (auto const& binning: { MTDCalibration::Binning{ 1.f, 0.5f, 4 }, MTDCalibration::Binning{ 0.f, 1.f, 4 },
+			      MTDCalibration::Binning{ 0.1f, 100.f, 0 } }) {
+    try {
+      MTDCalibration calibration(2, binning);
+      std::printf("FAIL binning [%g, %g] pC, %u bins accepted\n", binning.minAmplitude, binning.maxAmplitude,
+		  binning.nBins);
+      ++failures;
+    }
+    catch (std::invalid_argument&) {}
+  }
+
+  std::printf("%s invalid binnings rejected\n", failures == 0 ? "ok  " : "FAIL");
+
+  return failures;
+
+}
+
+
+int main() {
+
+  int failures = 0;
+
+  // --- the default BTLTimeWalkParameters exponent, and another one
+  failures += checkFit(-0.933552f, 0.03f, 1000000);
+  failures += checkFit(-0.5f, 0.03f, 1000000);
+
+  failures += checkInvalidBinning();
+
+  std::printf("%s\n", failures == 0 ? "All the calibration checks passed" : "Calibration checks FAILED");
+
+  return failures == 0 ? 0 : 1;
+
+}
@@ -0,0 +1,231 @@
+// Records and counts of the merge-join of MTDHitJoiner against a plain
+// std::map join of the same synthetic events (see MTDSyntheticHits), for
+// BTL and ETL at pileup 0, 140 and 200: the records must be bitwise equal
+// and in the same (DetId) order. The DIGI, uncalibrated RECO and RECO
+// tiers are also given shuffled, so that the radix-sorted path of
+// MTDSortedIndex is checked as well as the already ordered one.
+//
+// Exits with a non-zero status on failure.
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <map>
+#include <random>
+#include <set>
+#include <vector>
+
+#include "MTDtools/MTDCore/interface/MTDHitJoiner.h"
+#include "MTDtools/MTDCore/interface/MTDSyntheticHits.h"
+
+
+static constexpr float kBTLIntegrationWindow = 25.;   // [ns]
+
+
+// --- hits of an event, with the DIGI and RECO tiers optionally shuffled
+struct Event {
+
+  std::vector<MTDSimHitInput> sim;
+  std::vector<MTDDigiHitInput> digi;
+  std::vector<MTDURecoHitInput> ureco;
+  std::vector<MTDRecoHitInput> reco;
+
+  Event(const MTDTierInputs& in, bool shuffle, uint64_t seed) :
+    sim(in.sim.begin(), in.sim.end()), digi(in.digi.begin(), in.digi.end()),
+    ureco(in.ureco.begin(), in.ureco.end()), reco(in.reco.begin(), in.reco.end()) {
+    if ( !shuffle ) return;
+    std::mt19937_64 rng(seed);
+    std::shuffle(digi.begin(), digi.end(), rng);
+    std::shuffle(ureco.begin(), ureco.end(), rng);
+    std::shuffle(reco.begin(), reco.end(), rng);
+  }
+
+  MTDTierInputs inputs() const { return { sim, digi, ureco, reco, MTDSpan<MTDDigiSampleInput>() }; }
+
+};
+
+
+// --- the join semantics of MTDHitJoiner for the in-time BX, one std::map
+//     entry per DetId
+static void mapJoin(const MTDSyntheticHits& gen, const MTDTierInputs& in, bool btl,
+		    std::vector<MTDJoinedHit>* out, MTDEventCounts& counts) {
+
+  std::map<uint32_t, MTDJoinedHit> records;
+  std::set<uint32_t> touched;
+  std::map<uint32_t, std::set<int> > tracks;
+
+  auto side = [&](uint32_t rawId) { uint32_t cell; return gen.route(rawId, cell); };
+
+  auto record = [&](uint32_t rawId) -> MTDinfo* {
+    uint32_t cell;
+    if ( gen.route(rawId, cell) < 0 ) return nullptr;
+    auto it = records.find(rawId);
+    if ( it == records.end() ) {
+      MTDJoinedHit hit;
+      std::memset(&hit, 0, sizeof(hit));
+      hit.rawId = rawId;
+      hit.cell = cell;
+      it = records.emplace(rawId, hit).first;
+    }
+    return &it->second.info;
+  };
+
+  // --- SIM hits of BX 0, per DetId in time order
+  std::vector<size_t> simOrder;
+  for (size_t i = 0; i < in.sim.size; ++i)
+    if ( in.sim[i].tof >= 0.f && in.sim[i].tof <= kMTDBXLength && in.sim[i].rawId != 0 )
+      simOrder.push_back(i);
+  std::stable_sort(simOrder.begin(), simOrder.end(), [&](size_t a, size_t b) {
+      return in.sim[a].rawId != in.sim[b].rawId ? in.sim[a].rawId < in.sim[b].rawId : in.sim[a].tof < in.sim[b].tof;
+    });
+
+  for (size_t i: simOrder) {
+    const MTDSimHitInput& hit = in.sim[i];
+    MTDinfo* info = record(hit.rawId);
+    if ( info == nullptr ) continue;
+    touched.insert(hit.rawId);
+    if ( tracks[hit.rawId].empty() ) {
+      if ( btl ) counts.n_sim_btl++;
+      else counts.n_sim_etl[side(hit.rawId)]++;
+    }
+    if ( !btl || hit.tof < kBTLIntegrationWindow )
+      info->sim_energy += 1000.*hit.energyLoss;
+    tracks[hit.rawId].insert(hit.trackId);
+    info->sim_ntrk = tracks[hit.rawId].size();
+    if ( info->sim_time == 0 ) {
+      info->sim_time = hit.tof;
+      info->sim_x = hit.x;
+      info->sim_y = hit.y;
+      info->sim_z = hit.z;
+    }
+  }
+
+  for (auto const& digi: in.digi) {
+    MTDinfo* info = record(digi.rawId);
+    if ( info == nullptr ) continue;
+    if ( btl ) {
+      touched.insert(digi.rawId);
+      for (int iside = 0; iside < 2; ++iside) {
+	info->digi_row[iside] = digi.row[iside];
+	info->digi_col[iside] = digi.column[iside];
+	info->digi_charge[iside] = digi.charge[iside];
+	info->digi_time1[iside] = digi.toa[iside];
+	info->digi_time2[iside] = digi.toa2[iside];
+	if ( digi.charge[iside] > 0 ) counts.n_digi_btl[iside]++;
+      }
+    }
+    else if ( digi.charge[0] != 0 && digi.toa[0] != 0 ) {
+      touched.insert(digi.rawId);
+      info->digi_row[0] = digi.row[0];
+      info->digi_col[0] = digi.column[0];
+      info->digi_charge[0] = digi.charge[0];
+      info->digi_time1[0] = digi.toa[0];
+      counts.n_digi_etl[side(digi.rawId)]++;
+    }
+  }
+
+  for (auto const& urecHit: in.ureco) {
+    MTDinfo* info = record(urecHit.rawId);
+    if ( info == nullptr ) continue;
+    touched.insert(urecHit.rawId);
+    for (int iside = 0; iside < (btl ? 2 : 1); ++iside) {
+      info->ureco_charge[iside] = urecHit.amplitude[iside];
+      info->ureco_time[iside] = urecHit.time[iside];
+      if ( urecHit.amplitude[iside] > 0. ) {
+	if ( btl ) counts.n_ureco_btl[iside]++;
+	else counts.n_ureco_etl[side(urecHit.rawId)]++;
+      }
+    }
+  }
+
+  for (auto const& recHit: in.reco) {
+    MTDinfo* info = record(recHit.rawId);
+    if ( info == nullptr ) continue;
+    touched.insert(recHit.rawId);
+    info->reco_energy = recHit.energy;
+    info->reco_time = recHit.time;
+    if ( recHit.energy > 0. ) {
+      if ( btl ) counts.n_reco_btl++;
+      else counts.n_reco_etl[side(recHit.rawId)]++;
+    }
+  }
+
+  for (auto const& entry: records)
+    if ( touched.count(entry.first) )
+      out[btl ? 0 : side(entry.first)].push_back(entry.second);
+
+}
+
+
+static int checkEvents(MTDSyntheticHits::Detector detector, unsigned int pileup, bool shuffle) {
+
+  const bool btl = detector == MTDSyntheticHits::kBTL;
+
+  MTDHitJoiner joiner;
+  size_t nRecords = 0;
+  int failures = 0;
+
+  for (uint64_t seed = 1; seed <= 5; ++seed) {
+
+    MTDSyntheticHits gen(detector, pileup, seed);
+    gen.generate();
+    const Event event(gen.inputs(), shuffle, seed);
+    const MTDTierInputs in = event.inputs();
+
+    auto route = [&](uint32_t rawId, uint32_t& cell) { return gen.route(rawId, cell); };
+
+    std::vector<MTDJoinedHit> joined[2], expected[2];
+    MTDEventCounts joinedCounts = {}, expectedCounts = {};
+
+    joiner.order(in);
+    if ( btl ) joiner.joinBTL(in, kBTLIntegrationWindow, route, joined, joinedCounts);
+    else joiner.joinETL(in, kMTDNoWindow, route, joined, joinedCounts);
+
+    mapJoin(gen, in, btl, expected, expectedCounts);
+
+    for (int iout = 0; iout < 2; ++iout) {
+      nRecords += joined[iout].size();
+      if ( joined[iout].size() != expected[iout].size() ) {
+	std::printf("FAIL seed %lu output %d: %zu records, %zu expected\n", (unsigned long)seed, iout,
+		    joined[iout].size(), expected[iout].size());
+	++failures;
+	continue;
+      }
+      for (size_t i = 0; i < joined[iout].size(); ++i)
+	if ( std::memcmp(&joined[iout][i], &expected[iout][i], sizeof(MTDJoinedHit)) != 0 ) {
+	  std::printf("FAIL seed %lu output %d: record %zu of DetId %u differs\n", (unsigned long)seed, iout, i,
+		      expected[iout][i].rawId);
+	  ++failures;
+	  break;
+	}
+    }
+
+    if ( std::memcmp(&joinedCounts, &expectedCounts, sizeof(MTDEventCounts)) != 0 ) {
+      std::printf("FAIL seed %lu: counts differ\n", (unsigned long)seed);
+      ++failures;
+    }
+
+  }
+
+  std::printf("%s %s pileup %u%s: %zu records\n", failures == 0 ? "ok  " : "FAIL", btl ? "BTL" : "ETL", pileup,
+	      shuffle ? ", shuffled tiers" : "", nRecords);
+
+  return failures;
+
+}
+
+
+int main() {
+
+  int failures = 0;
+
+  for (auto detector: { MTDSyntheticHits::kBTL, MTDSyntheticHits::kETL })
+    for (unsigned int pileup: { 0u, 140u, 200u })
+      for (bool shuffle: { false, true })
+	failures += checkEvents(detector, pileup, shuffle);
+
+  std::printf("%s\n", failures == 0 ? "All the join checks passed" : "Join checks FAILED");
+
+  return failures == 0 ? 0 : 1;
+
+}
@@ -0,0 +1,113 @@
+// Quantiles of MTDSketch against the exact ones of the sorted entries, for
+// narrow and wide distributions of both signs, with zeros and values below
+// 2^-12: every quantile must be within the documented 0.55% of |x|, or
+// 2^-12, of the entry of the same rank. The sketch of all the entries must
+// also give the same quantiles as the merge of the sketches of parts of
+// them, as the per-stream sketches are merged at the end of the job.
+//
+// Exits with a non-zero status on failure.
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <functional>
+#include <random>
+#include <vector>
+
+#include "MTDtools/MTDCore/interface/MTDResolution.h"
+
+
+static constexpr double kMaxRelativeError = 0.0055;
+static const double kMinAbsolute = std::exp2(-12);
+static constexpr size_t kNParts = 4;
+
+
+static int checkDistribution(const char* name, const std::function<double(std::mt19937_64&)>& draw, size_t n) {
+
+  std::mt19937_64 rng(n);
+
+  MTDSketch sketch;
+  MTDSketch parts[kNParts];
+  std::vector<double> x(n);
+
+  for (size_t i = 0; i < n; ++i) {
+    x[i] = draw(rng);
+    sketch.add(x[i]);
+    parts[i % kNParts].add(x[i]);
+  }
+
+  MTDSketch merged;
+  for (auto const& part: parts)
+    merged.add(part);
+
+  std::sort(x.begin(), x.end());
+
+  int failures = 0;
+  double maxError = 0.;
+  double worst = 0.;
+
+  for (int iq = 0; iq <= 1000; ++iq) {
+
+    const double q = iq/1000.;
+    const double exact = x[std::min(n - 1, size_t(q*n))];
+    const double estimate = sketch.quantile(q);
+    const double error = std::fabs(estimate - exact);
+    const double bound = std::max(kMaxRelativeError*std::fabs(exact), kMinAbsolute);
+
+    if ( error/bound > maxError ) { maxError = error/bound; worst = q; }
+    if ( error > bound && failures++ < 10 )
+      std::printf("FAIL %s: quantile %g = %.9g, exact %.9g\n", name, q, estimate, exact);
+
+    if ( merged.quantile(q) != estimate && failures++ < 10 )
+      std::printf("FAIL %s: quantile %g of the merged sketches %.9g, %.9g\n", name, q, merged.quantile(q), estimate);
+
+  }
+
+  if ( merged.n() != sketch.n() || merged.min() != sketch.min() || merged.max() != sketch.max() ) {
+    std::printf("FAIL %s: merged entries, min or max differ\n", name);
+    ++failures;
+  }
+
+  std::printf("%s %s, %zu entries: max error %.3g of the bound at q = %g\n", failures == 0 ? "ok  " : "FAIL", name, n,
+	      maxError, worst);
+
+  return failures;
+
+}
+
+
+int main() {
+
+  int failures = 0;
+
+  // --- RECO - SIM time residuals [ns], with a tail
+  failures += checkDistribution("time residuals", [](std::mt19937_64& rng) {
+      std::normal_distribution<double> core(0.01, 0.035);
+      std::exponential_distribution<double> tail(1./0.3);
+      return std::uniform_real_distribution<double>(0., 1.)(rng) < 0.9 ? core(rng) : tail(rng);
+    }, 200003);
+
+  // --- relative energy residuals
+  failures += checkDistribution("energy residuals", [](std::mt19937_64& rng) {
+      return std::normal_distribution<double>(-0.02, 0.08)(rng);
+    }, 100003);
+
+  // --- log-uniform |x| over the whole range of the buckets and below, both
+  //     signs, and 5% of exact zeros
+  failures += checkDistribution("log-uniform", [](std::mt19937_64& rng) {
+      std::uniform_real_distribution<double> uniform(0., 1.);
+      if ( uniform(rng) < 0.05 ) return 0.;
+      const double a = std::exp2(-16. + 27.99*uniform(rng));
+      return uniform(rng) < 0.5 ? -a : a;
+    }, 300007);
+
+  // --- few entries
+  failures += checkDistribution("few entries", [](std::mt19937_64& rng) {
+      return std::normal_distribution<double>(0., 1.)(rng);
+    }, 7);
+
+  std::printf("%s\n", failures == 0 ? "All the sketch checks passed" : "Sketch checks FAILED");
+
+  return failures == 0 ? 0 : 1;
+
+}
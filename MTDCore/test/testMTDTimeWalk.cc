@@ -0,0 +1,124 @@
+// Deviation of the vectorized BTL time-walk correction (see MTDTimeWalk)
+// from p0*std::pow(q,p1) + p2 in double precision, over the amplitudes
+// 1e-3 to 1e4 pC, edges included, and exponents up to |p1| = 2: the
+// relative deviation must stay below the documented 2e-6, and the
+// amplitudes which are not positive, finite and normal must get no
+// correction. The arrays have lengths which are not multiples of the
+// vector width, so that the loop remainders are checked too.
+//
+// Exits with a non-zero status on failure.
+
+#include <cfloat>
+#include <cmath>
+#include <cstdio>
+#include <limits>
+#include <vector>
+
+#include "MTDtools/MTDCore/interface/MTDTimeWalk.h"
+
+
+static constexpr double kMaxRelativeDeviation = 2e-6;
+static constexpr float kMinAmplitude = 1e-3f;   // [pC]
+static constexpr float kMaxAmplitude = 1e4f;
+
+
+static int checkRange(double p0, double p1, double p2, size_t n) {
+
+  MTDTimeWalk timeWalk({ p0, p1, p2 });
+
+  // --- log-spaced amplitudes, the range edges exactly
+  MTDTimeWalk::Channels channels;
+  channels.resize(n);
+  for (size_t i = 0; i < n; ++i) {
+    channels.amplitude[i] = i == 0 ? kMinAmplitude : i == n-1 ? kMaxAmplitude :
+      kMinAmplitude*std::pow(kMaxAmplitude/kMinAmplitude, double(i)/(n-1));
+    channels.time[i] = 0.1f*i;
+  }
+
+  timeWalk.correct(channels);
+
+  // --- deviation relative to the size of both terms, p2 not being part of
+  //     the approximation
+  double maxDeviation = 0.;
+  float worst = channels.amplitude[0];
+  for (size_t i = 0; i < n; ++i) {
+    const double q = channels.amplitude[i];
+    const double power = float(p0)*std::pow(q, double(float(p1)));
+    const double expected = power + float(p2);
+    const double deviation = std::fabs(channels.correction[i] - expected)/(std::fabs(power) + std::fabs(float(p2)));
+    if ( deviation > maxDeviation ) { maxDeviation = deviation; worst = q; }
+    if ( channels.timeUncorr[i] != channels.time[i] + channels.correction[i] ) {
+      std::printf("FAIL p1 = %g: timeUncorr of q = %g is not time + correction\n", p1, q);
+      return 1;
+    }
+  }
+
+  const bool ok = maxDeviation < kMaxRelativeDeviation;
+  std::printf("%s p0 = %g p1 = %g p2 = %g, %zu amplitudes: max relative deviation %.3g at q = %g pC\n",
+	      ok ? "ok  " : "FAIL", p0, p1, p2, n, maxDeviation, worst);
+
+  return ok ? 0 : 1;
+
+}
+
+
+static int checkMasked() {
+
+  const std::vector<float> invalid = {
+    0.f, -0.f, -1.f, -FLT_MAX, FLT_MIN/2.f, std::numeric_limits<float>::denorm_min(),
+    std::numeric_limits<float>::infinity(), -std::numeric_limits<float>::infinity(),
+    std::numeric_limits<float>::quiet_NaN()
+  };
+
+  MTDTimeWalk timeWalk({ 2.21103, -0.933552, 0.5 });
+
+  // --- invalid amplitudes between valid ones
+  MTDTimeWalk::Channels channels;
+  channels.resize(2*invalid.size()+1);
+  for (size_t i = 0; i < channels.size(); ++i) {
+    channels.amplitude[i] = i % 2 == 1 ? invalid[i/2] : 1.f;
+    channels.time[i] = 5.f + i;
+  }
+
+  timeWalk.correct(channels);
+
+  int failures = 0;
+  for (size_t i = 0; i < channels.size(); ++i) {
+    const bool masked = i % 2 == 1;
+    const bool ok = masked ? channels.correction[i] == 0.f && channels.timeUncorr[i] == channels.time[i] :
+      std::fabs(channels.correction[i] - float(2.21103 + 0.5)) < 1e-5f;
+    if ( !ok ) {
+      std::printf("FAIL q = %g: correction %g, time %g, timeUncorr %g\n", channels.amplitude[i],
+		  channels.correction[i], channels.time[i], channels.timeUncorr[i]);
+      ++failures;
+    }
+  }
+
+  std::printf("%s %zu invalid amplitudes without correction\n", failures == 0 ? "ok  " : "FAIL", invalid.size());
+
+  return failures;
+
+}
+
+
+int main() {
+
+  int failures = 0;
+
+  // --- the default parameters of the configuration, and exponents over
+  //     |p1| < 2
+  failures += checkRange(2.21103, -0.933552, 0., 100003);
+  for (double p1: { -1.999, -1.5, -1., -0.5, -0.1, 0., 0.1, 0.5, 1., 1.5, 1.999 })
+    failures += checkRange(1., p1, 0., 10007);
+  failures += checkRange(2.21103, -0.933552, -0.3, 1001);
+
+  for (size_t n: { size_t(1), size_t(2), size_t(3), size_t(7), size_t(17) })
+    failures += checkRange(2.21103, -0.933552, 0., n);
+
+  failures += checkMasked();
+
+  std::printf("%s\n", failures == 0 ? "All the time-walk checks passed" : "Time-walk checks FAILED");
+
+  return failures == 0 ? 0 : 1;
+
+}